@@ -0,0 +1,136 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#include "benchmark-peer.hpp"
+
+#include <algorithm>
+
+namespace chronochat {
+namespace bench {
+
+BenchmarkStats::BenchmarkStats(size_t nPeers)
+  : m_nPeers(nPeers)
+  , m_nPublished(0)
+{
+}
+
+void
+BenchmarkStats::onPublished(const std::string& messageId)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_pending[messageId] = {Clock::now(), 0};
+  m_nPublished++;
+}
+
+void
+BenchmarkStats::onReceived(const std::string& messageId)
+{
+  Clock::time_point now = Clock::now();
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto it = m_pending.find(messageId);
+  if (it == m_pending.end())
+    return;
+
+  it->second.nReceived++;
+  if (it->second.nReceived + 1 < m_nPeers)
+    return;
+
+  std::chrono::duration<double, std::milli> latency = now - it->second.publishTime;
+  m_latencies.push_back(latency.count());
+  m_pending.erase(it);
+}
+
+std::vector<double>
+BenchmarkStats::getLatencies()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  std::vector<double> latencies = m_latencies;
+  std::sort(latencies.begin(), latencies.end());
+  return latencies;
+}
+
+size_t
+BenchmarkStats::getNPublished()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_nPublished;
+}
+
+size_t
+BenchmarkStats::getNUndelivered()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_pending.size();
+}
+
+BenchmarkPeer::BenchmarkPeer(const shared_ptr<SyncRuntime>& runtime,
+                             const Name& chatroomPrefix,
+                             const Name& userPrefix,
+                             size_t index,
+                             BenchmarkStats& stats)
+  : m_backend(runtime,
+              chatroomPrefix,
+              Name(userPrefix).append("CHRONOCHAT-CHATDATA").append(chatroomPrefix.get(-1)),
+              userPrefix,
+              chatroomPrefix.get(-1).toUri(),
+              "peer" + boost::lexical_cast<std::string>(index))
+  , m_index(index)
+  , m_idPrefix(QString::number(index) + "/")
+  , m_nPublished(0)
+  , m_stats(stats)
+{
+  // the slot runs on the shard thread, as no event loop runs here
+  connect(&m_backend, SIGNAL(messagesReceived(chronochat::MessageBatch)),
+          this, SLOT(onMessagesReceived(chronochat::MessageBatch)),
+          Qt::DirectConnection);
+}
+
+void
+BenchmarkPeer::start()
+{
+  m_backend.start();
+}
+
+void
+BenchmarkPeer::publish(size_t messageSize)
+{
+  QString messageId = m_idPrefix + QString::number(m_nPublished++);
+
+  QString text = messageId + " ";
+  if (static_cast<size_t>(text.size()) < messageSize)
+    text.append(QString(messageSize - text.size(), 'x'));
+
+  m_stats.onPublished(messageId.toStdString());
+  m_backend.sendChatMessage(text, std::time(nullptr));
+}
+
+void
+BenchmarkPeer::shutdown()
+{
+  m_backend.shutdown();
+}
+
+void
+BenchmarkPeer::onMessagesReceived(chronochat::MessageBatch messages)
+{
+  for (const MessageInfo& info : *messages) {
+    // own messages are reported as well
+    if (!info.isChat || info.text.startsWith(m_idPrefix))
+      continue;
+
+    m_stats.onReceived(info.text.section(' ', 0, 0).toStdString());
+  }
+}
+
+} // namespace bench
+} // namespace chronochat
+
+#if WAF
+#include "benchmark-peer.moc"
+#endif
@@ -0,0 +1,104 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#ifndef CHRONOCHAT_BENCH_BENCHMARK_PEER_HPP
+#define CHRONOCHAT_BENCH_BENCHMARK_PEER_HPP
+
+#include <QObject>
+
+#ifndef Q_MOC_RUN
+#include "chat-dialog-backend.hpp"
+
+#include <chrono>
+#include <mutex>
+#endif
+
+namespace chronochat {
+namespace bench {
+
+/**
+ * @brief Delivery statistics of all peers, may be updated from any thread
+ *
+ * A message is delivered when every peer except its publisher has received it.
+ */
+class BenchmarkStats : noncopyable
+{
+public:
+  typedef std::chrono::steady_clock Clock;
+
+  explicit
+  BenchmarkStats(size_t nPeers);
+
+  void
+  onPublished(const std::string& messageId);
+
+  void
+  onReceived(const std::string& messageId);
+
+  /// @brief publish-to-delivery latencies in milliseconds, sorted
+  std::vector<double>
+  getLatencies();
+
+  size_t
+  getNPublished();
+
+  size_t
+  getNUndelivered();
+
+private:
+  struct Pending
+  {
+    Clock::time_point publishTime;
+    size_t nReceived;
+  };
+
+  std::mutex m_mutex;
+  size_t m_nPeers;
+  size_t m_nPublished;
+  std::map<std::string, Pending> m_pending;
+  std::vector<double> m_latencies;
+};
+
+/// @brief Synthetic chatroom participant, a ChatDialogBackend without GUI
+class BenchmarkPeer : public QObject
+{
+  Q_OBJECT
+
+public:
+  BenchmarkPeer(const shared_ptr<SyncRuntime>& runtime,
+                const Name& chatroomPrefix,
+                const Name& userPrefix,
+                size_t index,
+                BenchmarkStats& stats);
+
+  void
+  start();
+
+  /// @brief publish the next message of this peer, padded to @p messageSize characters
+  void
+  publish(size_t messageSize);
+
+  void
+  shutdown();
+
+private slots:
+  void
+  onMessagesReceived(chronochat::MessageBatch messages);
+
+private:
+  ChatDialogBackend m_backend;
+  size_t m_index;
+  QString m_idPrefix;                    // prefix of the ids of messages of this peer
+  uint64_t m_nPublished;
+  BenchmarkStats& m_stats;
+};
+
+} // namespace bench
+} // namespace chronochat
+
+#endif // CHRONOCHAT_BENCH_BENCHMARK_PEER_HPP
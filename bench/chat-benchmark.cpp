@@ -0,0 +1,245 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+// Runs N synthetic participants of one chatroom on the loopback forwarder and reports
+// how fast chat messages reach every participant.
+
+#include "benchmark-peer.hpp"
+#include "loopback-forwarder.hpp"
+
+#include <boost/filesystem.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <unistd.h>
+#include <sys/resource.h>
+
+namespace chronochat {
+namespace bench {
+
+using tests::LoopbackForwarder;
+
+namespace fs = boost::filesystem;
+
+// time for all peers to join before messages are published
+static const std::chrono::seconds WARMUP_PERIOD(3);
+// time for the last messages to arrive after publishing stopped
+static const std::chrono::seconds DRAIN_PERIOD(5);
+
+struct Options
+{
+  size_t nPeers;
+  double rate;                           // messages per second of one peer
+  int duration;                          // seconds of publishing
+  size_t messageSize;                    // characters of chat text
+  int linkDelay;                         // milliseconds
+  double lossRate;
+};
+
+static void
+usage(const char* programName)
+{
+  std::cerr << "Usage: " << programName << " [options]\n"
+            << "  -n <peers>     number of participants (default 10)\n"
+            << "  -r <rate>      messages per second of one participant (default 1)\n"
+            << "  -d <seconds>   duration of publishing (default 30)\n"
+            << "  -s <size>      characters of one chat message (default 100)\n"
+            << "  -l <ms>        delay of one link to the forwarder (default 5)\n"
+            << "  -p <rate>      loss rate of one link (default 0)\n";
+}
+
+static double
+getPercentile(const std::vector<double>& sorted, double percentile)
+{
+  if (sorted.empty())
+    return 0;
+
+  size_t index = static_cast<size_t>(percentile / 100 * (sorted.size() - 1) + 0.5);
+  return sorted[index];
+}
+
+/**
+ * @brief Points HOME to a new temporary directory while it lives
+ *
+ * Every peer keeps a chat history and a publish cache under $HOME/.chronos, and signs with
+ * a key under $HOME/.ndn.  The run leaves the profile of the user alone that way, and its
+ * files are removed at the end.
+ */
+class TemporaryHome : noncopyable
+{
+public:
+  TemporaryHome()
+    : m_path(fs::temp_directory_path() / fs::unique_path("chronochat-benchmark-%%%%-%%%%"))
+  {
+    fs::create_directories(m_path);
+
+    const char* home = getenv("HOME");
+    m_hasHome = (home != nullptr);
+    if (m_hasHome)
+      m_home = home;
+    setenv("HOME", m_path.c_str(), 1);
+  }
+
+  ~TemporaryHome()
+  {
+    if (m_hasHome)
+      setenv("HOME", m_home.c_str(), 1);
+    else
+      unsetenv("HOME");
+
+    boost::system::error_code error;
+    fs::remove_all(m_path, error);
+  }
+
+private:
+  fs::path m_path;
+  bool m_hasHome;
+  std::string m_home;
+};
+
+static double
+getCpuSeconds(const rusage& usage)
+{
+  return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 +
+         usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
+static int
+runBenchmark(const Options& options)
+{
+  // outlives the peers, which write to it until they are destroyed
+  TemporaryHome home;
+
+  // prefixes of every run are new, so the chat histories of earlier runs are not hit
+  std::string runId = boost::lexical_cast<std::string>(std::time(nullptr));
+  Name chatroomPrefix("/ndn/broadcast/ChronoChat");
+  chatroomPrefix.append("benchmark-" + runId);
+
+  // The forwarder lives on the only shard, so all faces and rooms share one thread.  Every
+  // peer has a connection of its own, which stands for the link of its host.
+  LoopbackForwarder* forwarder = nullptr;
+  auto runtime = make_shared<SyncRuntime>(1,
+                                          [&forwarder] (boost::asio::io_service&) {
+                                            return forwarder->makeFace();
+                                          },
+                                          nullptr, false);
+  runtime->invoke(0, [&] {
+      forwarder = new LoopbackForwarder(runtime->getIoService(0));
+      forwarder->setDefaultLink({time::milliseconds(options.linkDelay), options.lossRate});
+    });
+
+  BenchmarkStats stats(options.nPeers);
+  std::vector<unique_ptr<BenchmarkPeer>> peers;
+  for (size_t i = 0; i < options.nPeers; i++) {
+    Name userPrefix("/benchmark");
+    userPrefix.append(runId).appendNumber(i);
+    peers.emplace_back(new BenchmarkPeer(runtime, chatroomPrefix, userPrefix, i, stats));
+    peers.back()->start();
+  }
+
+  std::this_thread::sleep_for(WARMUP_PERIOD);
+
+  rusage startUsage;
+  getrusage(RUSAGE_SELF, &startUsage);
+  BenchmarkStats::Clock::time_point start = BenchmarkStats::Clock::now();
+
+  // peers take turns, so messages are spread evenly over time
+  auto interval = std::chrono::duration<double>(1.0 / (options.rate * options.nPeers));
+  BenchmarkStats::Clock::time_point end = start + std::chrono::seconds(options.duration);
+  BenchmarkStats::Clock::time_point next = start;
+  for (size_t turn = 0; next < end; turn++) {
+    std::this_thread::sleep_until(next);
+    peers[turn % peers.size()]->publish(options.messageSize);
+    next = start +
+           std::chrono::duration_cast<BenchmarkStats::Clock::duration>(interval * (turn + 1));
+  }
+
+  std::this_thread::sleep_for(DRAIN_PERIOD);
+
+  rusage endUsage;
+  getrusage(RUSAGE_SELF, &endUsage);
+  std::chrono::duration<double> elapsed = BenchmarkStats::Clock::now() - start;
+  double cpuSeconds = getCpuSeconds(endUsage) - getCpuSeconds(startUsage);
+
+  std::vector<double> latencies = stats.getLatencies();
+  uint64_t nBytes = 0;
+  size_t nDropped = 0;
+  runtime->invoke(0, [&] {
+      nBytes = forwarder->getNBytes();
+      nDropped = forwarder->getNDropped();
+    });
+
+  // every delivered message has been received by all other peers
+  double nReceptions = static_cast<double>(latencies.size()) * (options.nPeers - 1);
+
+  std::cout << "participants:              " << options.nPeers << "\n"
+            << "messages published:        " << stats.getNPublished() << "\n"
+            << "messages delivered:        " << latencies.size() << "\n"
+            << "messages undelivered:      " << stats.getNUndelivered() << "\n"
+            << "latency p50 (ms):          " << getPercentile(latencies, 50) << "\n"
+            << "latency p99 (ms):          " << getPercentile(latencies, 99) << "\n"
+            << "receptions per second:     " << nReceptions / elapsed.count() << "\n"
+            << "receptions per cpu-second: " << nReceptions / cpuSeconds << "\n"
+            << "bytes on the wire:         " << nBytes << "\n"
+            << "packets dropped:           " << nDropped << "\n"
+            << "peak RSS (KB):             " << endUsage.ru_maxrss << std::endl;
+
+  for (auto& peer : peers)
+    peer->shutdown();
+  peers.clear();
+
+  // the faces have been released on the shard by now, the forwarder can go
+  runtime->invoke(0, [&] { delete forwarder; });
+
+  return 0;
+}
+
+} // namespace bench
+} // namespace chronochat
+
+int
+main(int argc, char** argv)
+{
+  chronochat::bench::Options options = {10, 1.0, 30, 100, 5, 0.0};
+
+  int opt;
+  while ((opt = getopt(argc, argv, "n:r:d:s:l:p:h")) != -1) {
+    switch (opt) {
+    case 'n':
+      options.nPeers = std::max(std::atoi(optarg), 2);
+      break;
+    case 'r':
+      options.rate = std::atof(optarg);
+      break;
+    case 'd':
+      options.duration = std::atoi(optarg);
+      break;
+    case 's':
+      options.messageSize = std::atoi(optarg);
+      break;
+    case 'l':
+      options.linkDelay = std::atoi(optarg);
+      break;
+    case 'p':
+      options.lossRate = std::atof(optarg);
+      break;
+    default:
+      chronochat::bench::usage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (options.rate <= 0) {
+    chronochat::bench::usage(argv[0]);
+    return 1;
+  }
+
+  return chronochat::bench::runBenchmark(options);
+}
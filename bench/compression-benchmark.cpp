@@ -0,0 +1,234 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+// Compresses the chat data of text corpora, e.g., IRC or chat logs with one message per
+// line, and reports the bytes saved against the time spent, for single messages and for
+// bundles of consecutive messages.
+
+#include "payload-compressor.hpp"
+#include "chat-message-bundle.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <unistd.h>
+
+namespace chronochat {
+namespace bench {
+
+typedef std::chrono::steady_clock Clock;
+
+struct Options
+{
+  size_t threshold;                      // minimum size of compressed content
+  size_t maxBundleSize;                  // bytes of the messages of one bundle
+  int nIterations;                       // passes over the corpus, for stable timing
+};
+
+struct Result
+{
+  size_t nPackets;
+  size_t nCompressed;
+  uint64_t nRawBytes;
+  uint64_t nWireBytes;
+  double compressSeconds;                // of one pass
+  double decompressSeconds;              // of one pass
+};
+
+static void
+usage(const char* programName)
+{
+  std::cerr << "Usage: " << programName << " [options] <corpus>...\n"
+            << "  -t <bytes>     minimum size of compressed content (default "
+            << PayloadCompressor::DEFAULT_THRESHOLD << ")\n"
+            << "  -b <bytes>     maximum size of the messages of one bundle (default 4096)\n"
+            << "  -i <passes>    passes over the corpus (default 10)\n"
+            << "A corpus is a text file with one chat message per line.\n";
+}
+
+static bool
+readCorpus(const std::string& fileName, std::vector<ChatMessage>& messages)
+{
+  std::ifstream file(fileName.c_str());
+  if (!file)
+    return false;
+
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.empty())
+      continue;
+
+    ChatMessage msg;
+    msg.setNick("benchmark");
+    msg.setChatroomName("corpus");
+    msg.setMsgType(ChatMessage::CHAT);
+    msg.setData(line);
+    msg.setTimestamp(std::time(nullptr));
+    msg.setPreciseTimestamp(time::system_clock::now());
+    messages.push_back(msg);
+  }
+  return true;
+}
+
+// consecutive messages are bundled like ChatDialogBackend does with a burst
+static std::vector<Block>
+makeBundles(const std::vector<ChatMessage>& messages, size_t maxBundleSize)
+{
+  std::vector<Block> contents;
+  ChatMessageBundle bundle;
+  size_t bundleSize = 0;
+
+  auto addBundle = [&] {
+    if (bundle.size() == 1)
+      contents.push_back(bundle.getMessages().front().wireEncode());
+    else if (!bundle.empty())
+      contents.push_back(bundle.wireEncode());
+    bundle.clear();
+    bundleSize = 0;
+  };
+
+  for (const ChatMessage& msg : messages) {
+    size_t msgSize = msg.wireEncode().size();
+    if (bundleSize + msgSize > maxBundleSize)
+      addBundle();
+    bundle.addMessage(msg);
+    bundleSize += msgSize;
+  }
+  addBundle();
+
+  return contents;
+}
+
+static Result
+measure(const std::vector<Block>& contents, const Options& options)
+{
+  PayloadCompressor compressor(options.threshold);
+  Result result = {contents.size(), 0, 0, 0, 0, 0};
+
+  std::vector<Block> wires;
+  Clock::time_point start = Clock::now();
+  for (int i = 0; i < options.nIterations; i++) {
+    wires.clear();
+    for (const Block& content : contents)
+      wires.push_back(compressor.compress(content));
+  }
+  std::chrono::duration<double> elapsed = Clock::now() - start;
+  result.compressSeconds = elapsed.count() / options.nIterations;
+
+  for (size_t i = 0; i < contents.size(); i++) {
+    result.nRawBytes += contents[i].size();
+    result.nWireBytes += wires[i].size();
+    if (wires[i].type() == tlv::CompressedContent)
+      result.nCompressed++;
+  }
+
+  // the decompressed size is checked, so the work cannot be optimized away
+  uint64_t nDecompressedBytes = 0;
+  start = Clock::now();
+  for (int i = 0; i < options.nIterations; i++) {
+    for (const Block& wire : wires) {
+      if (wire.type() == tlv::CompressedContent)
+        nDecompressedBytes += compressor.decompress(wire).size();
+      else
+        nDecompressedBytes += wire.size();
+    }
+  }
+  elapsed = Clock::now() - start;
+  result.decompressSeconds = elapsed.count() / options.nIterations;
+
+  if (nDecompressedBytes != result.nRawBytes * options.nIterations)
+    std::cerr << "decompressed content differs in size" << std::endl;
+
+  return result;
+}
+
+static void
+printResult(const std::string& title, const Result& result)
+{
+  double saved = result.nRawBytes == 0 ? 0 :
+    100.0 * (1 - static_cast<double>(result.nWireBytes) / result.nRawBytes);
+  double megabytes = result.nRawBytes / 1e6;
+
+  std::cout << title << "\n"
+            << "  packets:                 " << result.nPackets << "\n"
+            << "  packets compressed:      " << result.nCompressed << "\n"
+            << "  bytes before:            " << result.nRawBytes << "\n"
+            << "  bytes after:             " << result.nWireBytes << "\n"
+            << "  bytes saved (%):         " << saved << "\n"
+            << "  compress (MB/s):         " << megabytes / result.compressSeconds << "\n"
+            << "  compress (us/packet):    "
+            << result.compressSeconds * 1e6 / result.nPackets << "\n"
+            << "  decompress (MB/s):       " << megabytes / result.decompressSeconds << "\n"
+            << "  decompress (us/packet):  "
+            << result.decompressSeconds * 1e6 / result.nPackets << std::endl;
+}
+
+static int
+runBenchmark(const Options& options, const std::vector<std::string>& corpora)
+{
+  std::vector<ChatMessage> messages;
+  for (const std::string& corpus : corpora) {
+    if (!readCorpus(corpus, messages)) {
+      std::cerr << "Cannot read " << corpus << std::endl;
+      return 1;
+    }
+  }
+
+  if (messages.empty()) {
+    std::cerr << "No messages in the corpora" << std::endl;
+    return 1;
+  }
+
+  std::vector<Block> singles;
+  for (const ChatMessage& msg : messages)
+    singles.push_back(msg.wireEncode());
+
+  std::cout << "messages:                  " << messages.size() << "\n"
+            << "threshold (bytes):         " << options.threshold << "\n";
+  printResult("single messages", measure(singles, options));
+  printResult("bundles", measure(makeBundles(messages, options.maxBundleSize), options));
+
+  return 0;
+}
+
+} // namespace bench
+} // namespace chronochat
+
+int
+main(int argc, char** argv)
+{
+  chronochat::bench::Options options = {chronochat::PayloadCompressor::DEFAULT_THRESHOLD,
+                                        4096, 10};
+
+  int opt;
+  while ((opt = getopt(argc, argv, "t:b:i:h")) != -1) {
+    switch (opt) {
+    case 't':
+      options.threshold = std::atoi(optarg);
+      break;
+    case 'b':
+      options.maxBundleSize = std::atoi(optarg);
+      break;
+    case 'i':
+      options.nIterations = std::max(std::atoi(optarg), 1);
+      break;
+    default:
+      chronochat::bench::usage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (optind == argc) {
+    chronochat::bench::usage(argv[0]);
+    return 1;
+  }
+
+  return chronochat::bench::runBenchmark(options,
+                                         std::vector<std::string>(argv + optind, argv + argc));
+}
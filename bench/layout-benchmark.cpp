@@ -0,0 +1,193 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+// Lays out and paints the sync tree and the trust tree of rooms of 10 to 10,000
+// participants, and reports the time spent with and without the level of detail.  The
+// scenes are painted into an image of the size of a tree view, the way the view fits them.
+// Painting text needs a display, e.g., run it in xvfb-run.
+
+#include "digest-tree-scene.hpp"
+#include "trust-tree-scene.hpp"
+
+#include <QtGui>
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <unistd.h>
+
+namespace chronochat {
+namespace bench {
+
+typedef std::chrono::steady_clock Clock;
+
+static const int VIEW_WIDTH = 400;
+static const int VIEW_HEIGHT = 300;
+
+struct Options
+{
+  int nIterations;                       // paints of every scene, for stable timing
+};
+
+static void
+usage(const char* programName)
+{
+  std::cerr << "Usage: " << programName << " [options]\n"
+            << "  -i <paints>    paints of every scene (default 10)\n";
+}
+
+static double
+getSeconds(Clock::time_point start)
+{
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// paints like ChatDialog::fitView shows the scene
+static double
+paint(QGraphicsScene& scene, int nIterations)
+{
+  QImage image(VIEW_WIDTH, VIEW_HEIGHT, QImage::Format_ARGB32_Premultiplied);
+  QRectF rect = scene.itemsBoundingRect();
+
+  Clock::time_point start = Clock::now();
+  for (int i = 0; i < nIterations; i++) {
+    image.fill(0);
+    QPainter painter(&image);
+    scene.render(&painter, QRectF(), rect, Qt::KeepAspectRatio);
+  }
+  return getSeconds(start) / nIterations;
+}
+
+static double
+getScale(QGraphicsScene& scene)
+{
+  QRectF rect = scene.itemsBoundingRect();
+  return std::min(VIEW_WIDTH / rect.width(), VIEW_HEIGHT / rect.height());
+}
+
+// the scene places every node by its slot
+static double
+layOut(TreeLayout& layout, size_t nNodes, int nIterations)
+{
+  std::vector<TreeLayout::Coordinate> co(nNodes);
+
+  Clock::time_point start = Clock::now();
+  for (int i = 0; i < nIterations; i++) {
+    for (size_t slot = 0; slot < nNodes; slot++)
+      co[slot] = layout.getSlotPosition(slot);
+  }
+  return getSeconds(start) / nIterations;
+}
+
+static void
+measureDigestTree(size_t nNodes, const Options& options)
+{
+  OneLevelTreeLayout line;
+  line.setSiblingDistance(100);
+  line.setLevelDistance(100);
+  RingTreeLayout rings;
+  rings.setSiblingDistance(100);
+  rings.setLevelDistance(300);
+
+  std::vector<MessageInfo> messages(nNodes);
+  for (size_t i = 0; i < nNodes; i++) {
+    messages[i].sessionId = i + 1;
+    messages[i].nick = QString("user%1").arg(i);
+    messages[i].seqNo = 1;
+  }
+
+  DigestTreeScene scene;
+  Clock::time_point start = Clock::now();
+  scene.updateNodes(messages);
+  // there is no event loop to run the animation, the nodes are measured in their place
+  scene.finishMoves();
+  double plotSeconds = getSeconds(start);
+
+  double detailedSeconds = paint(scene, options.nIterations);
+  double scale = getScale(scene);
+  scene.setLevelOfDetail(scale);
+  double lodSeconds = paint(scene, options.nIterations);
+
+  std::cout << "sync tree, " << nNodes << " nodes\n"
+            << "  line layout (us):        "
+            << layOut(line, nNodes, options.nIterations) * 1e6 << "\n"
+            << "  ring layout (us):        "
+            << layOut(rings, nNodes, options.nIterations) * 1e6 << "\n"
+            << "  plot (ms):               " << plotSeconds * 1e3 << "\n"
+            << "  view scale:              " << scale << "\n"
+            << "  paint (ms):              " << detailedSeconds * 1e3 << "\n"
+            << "  paint with LOD (ms):     " << lodSeconds * 1e3 << std::endl;
+}
+
+static void
+measureTrustTree(size_t nNodes, const Options& options)
+{
+  // one anchor, which introduced a tenth of the room, which introduced the rest
+  TrustTreeNodeList nodeList;
+  for (size_t i = 0; i < nNodes; i++) {
+    shared_ptr<TrustTreeNode> node =
+      make_shared<TrustTreeNode>(Name("/ndn/user").appendNumber(i));
+    size_t nIntroducers = std::max<size_t>(nNodes / 10, 1);
+    if (i == 0)
+      node->setLevel(0);
+    else if (i <= nIntroducers) {
+      node->setLevel(1);
+      nodeList[0]->addIntroducee(node);
+    }
+    else {
+      node->setLevel(2);
+      nodeList[1 + i % nIntroducers]->addIntroducee(node);
+    }
+    nodeList.push_back(node);
+  }
+
+  TrustTreeScene scene;
+  Clock::time_point start = Clock::now();
+  scene.plotTrustTree(nodeList);
+  double plotSeconds = getSeconds(start);
+
+  double detailedSeconds = paint(scene, options.nIterations);
+  double scale = getScale(scene);
+  scene.setLevelOfDetail(scale);
+  double lodSeconds = paint(scene, options.nIterations);
+
+  std::cout << "trust tree, " << nNodes << " nodes\n"
+            << "  plot (ms):               " << plotSeconds * 1e3 << "\n"
+            << "  view scale:              " << scale << "\n"
+            << "  paint (ms):              " << detailedSeconds * 1e3 << "\n"
+            << "  paint with LOD (ms):     " << lodSeconds * 1e3 << std::endl;
+}
+
+} // namespace bench
+} // namespace chronochat
+
+int
+main(int argc, char** argv)
+{
+  QApplication app(argc, argv);
+  chronochat::bench::Options options = {10};
+
+  int opt;
+  while ((opt = getopt(argc, argv, "i:h")) != -1) {
+    switch (opt) {
+    case 'i':
+      options.nIterations = std::max(std::atoi(optarg), 1);
+      break;
+    default:
+      chronochat::bench::usage(argv[0]);
+      return 1;
+    }
+  }
+
+  for (size_t nNodes : {10, 100, 1000, 10000}) {
+    chronochat::bench::measureDigestTree(nNodes, options);
+    chronochat::bench::measureTrustTree(nNodes, options);
+  }
+
+  return 0;
+}
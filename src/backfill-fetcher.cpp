@@ -0,0 +1,288 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#include "backfill-fetcher.hpp"
+
+#include <algorithm>
+#include "logging.h"
+
+INIT_LOGGER("BackfillFetcher");
+
+namespace chronochat {
+
+const double BackfillFetcher::INITIAL_WINDOW = 2.0;
+const double BackfillFetcher::MAX_WINDOW = 32.0;
+
+BackfillFetcher::BackfillFetcher(const FetchFunction& fetch,
+                                 const DataCallback& onDeliver,
+                                 size_t maxOutstanding,
+                                 uint64_t maxDepth)
+  : m_fetch(fetch)
+  , m_onDeliver(onDeliver)
+  , m_maxOutstanding(maxOutstanding)
+  , m_maxDepth(maxDepth)
+  , m_nOutstanding(0)
+  , m_nextEpoch(0)
+  , m_isScheduling(false)
+  , m_isSuspended(false)
+{
+}
+
+void
+BackfillFetcher::addGap(const Name& session, uint64_t low, uint64_t high)
+{
+  if (high < low)
+    return;
+
+  if (high - low >= m_maxDepth) {
+    _LOG_DEBUG("Skip " << session << " [" << low << ", " << high - m_maxDepth << "]");
+    low = high - m_maxDepth + 1;
+  }
+
+  SessionStates::iterator it = m_sessions.find(session);
+  if (it == m_sessions.end()) {
+    SessionState& state = m_sessions[session];
+    state.epoch = m_nextEpoch++;
+    state.window = INITIAL_WINDOW;
+    state.threshold = MAX_WINDOW;
+    state.nOutstanding = 0;
+    state.nextSeqNo = 0;
+    it = m_sessions.find(session);
+  }
+
+  // gaps of a session only grow upwards, do not request anything twice
+  SessionState& state = it->second;
+  low = std::max(low, state.nextSeqNo);
+  if (high < low)
+    return;
+
+  state.pending[low] = high;
+  state.nextSeqNo = high + 1;
+
+  schedule();
+}
+
+void
+BackfillFetcher::removeSession(const Name& session)
+{
+  SessionStates::iterator it = m_sessions.find(session);
+  if (it == m_sessions.end())
+    return;
+
+  m_nOutstanding -= it->second.nOutstanding;
+  m_sessions.erase(it);
+
+  schedule();
+}
+
+void
+BackfillFetcher::clear()
+{
+  m_sessions.clear();
+  m_nOutstanding = 0;
+}
+
+void
+BackfillFetcher::suspend()
+{
+  m_isSuspended = true;
+
+  for (auto& session : m_sessions) {
+    SessionState& state = session.second;
+    // late results of the forgotten fetches are ignored
+    state.epoch = m_nextEpoch++;
+    state.window = INITIAL_WINDOW;
+    state.nOutstanding = 0;
+
+    std::map<uint64_t, Result>::iterator it = state.requested.begin();
+    while (it != state.requested.end()) {
+      if (it->second.isDone)
+        ++it;
+      else {
+        state.pending[it->first] = it->first;
+        it = state.requested.erase(it);
+      }
+    }
+  }
+  m_nOutstanding = 0;
+}
+
+void
+BackfillFetcher::resume()
+{
+  if (!m_isSuspended)
+    return;
+
+  m_isSuspended = false;
+  schedule();
+}
+
+double
+BackfillFetcher::getWindow(const Name& session) const
+{
+  SessionStates::const_iterator it = m_sessions.find(session);
+  if (it == m_sessions.end())
+    return 0;
+  return it->second.window;
+}
+
+void
+BackfillFetcher::schedule()
+{
+  if (m_isScheduling || m_isSuspended)
+    return;
+  m_isScheduling = true;
+
+  // Serve the sessions round-robin, one fetch per session in each round, until either the
+  // outstanding cap is reached or no session can send more.
+  bool isProgressing = true;
+  while (isProgressing && m_nOutstanding < m_maxOutstanding) {
+    isProgressing = false;
+    size_t nSessions = m_sessions.size();
+    for (size_t i = 0; i < nSessions && m_nOutstanding < m_maxOutstanding; i++) {
+      SessionStates::iterator it = m_sessions.upper_bound(m_lastScheduled);
+      if (it == m_sessions.end())
+        it = m_sessions.begin();
+      if (it == m_sessions.end())
+        break;
+
+      m_lastScheduled = it->first;
+      if (fetchNext(m_lastScheduled, it->second))
+        isProgressing = true;
+    }
+  }
+
+  m_isScheduling = false;
+}
+
+bool
+BackfillFetcher::fetchNext(const Name& session, SessionState& state)
+{
+  if (state.pending.empty() || state.nOutstanding >= static_cast<size_t>(state.window))
+    return false;
+
+  // newest first
+  std::map<uint64_t, uint64_t>::iterator gap = --state.pending.end();
+  uint64_t seqNo = gap->second;
+  if (gap->first == gap->second)
+    state.pending.erase(gap);
+  else
+    gap->second--;
+
+  Result& result = state.requested[seqNo];
+  result.isDone = false;
+  result.isValidated = false;
+
+  state.nOutstanding++;
+  m_nOutstanding++;
+
+  uint64_t epoch = state.epoch;
+  _LOG_DEBUG("<<< Fetching " << session << "/" << seqNo);
+
+  // the fetch may complete synchronously, state must not be used below
+  m_fetch(session, seqNo,
+          [this, session, epoch, seqNo] (const shared_ptr<const Data>& data, bool isValidated) {
+            this->onData(session, epoch, seqNo, data, isValidated);
+          },
+          [this, session, epoch, seqNo] {
+            this->onTimeout(session, epoch, seqNo);
+          });
+  return true;
+}
+
+void
+BackfillFetcher::onData(const Name& session, uint64_t epoch, uint64_t seqNo,
+                        const shared_ptr<const Data>& data, bool isValidated)
+{
+  SessionStates::iterator it = findSession(session, epoch);
+  if (it == m_sessions.end())
+    return;
+
+  SessionState& state = it->second;
+  std::map<uint64_t, Result>::iterator result = state.requested.find(seqNo);
+  if (result == state.requested.end() || result->second.isDone)
+    return;
+
+  result->second.isDone = true;
+  result->second.isValidated = isValidated;
+  result->second.data = data;
+
+  state.nOutstanding--;
+  m_nOutstanding--;
+
+  if (state.window < state.threshold)
+    state.window += 1;
+  else
+    state.window += 1 / state.window;
+  state.window = std::min(state.window, MAX_WINDOW);
+
+  deliver(session);
+  schedule();
+}
+
+void
+BackfillFetcher::onTimeout(const Name& session, uint64_t epoch, uint64_t seqNo)
+{
+  SessionStates::iterator it = findSession(session, epoch);
+  if (it == m_sessions.end())
+    return;
+
+  SessionState& state = it->second;
+  std::map<uint64_t, Result>::iterator result = state.requested.find(seqNo);
+  if (result == state.requested.end() || result->second.isDone)
+    return;
+
+  _LOG_DEBUG("Give up " << session << "/" << seqNo);
+
+  // a timed out seq is skipped, so that it does not hold back the newer ones
+  result->second.isDone = true;
+
+  state.nOutstanding--;
+  m_nOutstanding--;
+
+  state.threshold = std::max(state.window / 2, 1.0);
+  state.window = state.threshold;
+
+  deliver(session);
+  schedule();
+}
+
+void
+BackfillFetcher::deliver(const Name& session)
+{
+  // The consumer may remove the session, so look it up again after every delivery.
+  while (true) {
+    SessionStates::iterator it = m_sessions.find(session);
+    if (it == m_sessions.end() || it->second.requested.empty())
+      return;
+
+    SessionState& state = it->second;
+    std::map<uint64_t, Result>::iterator first = state.requested.begin();
+    if (!first->second.isDone)
+      return;
+    if (!state.pending.empty() && state.pending.begin()->first < first->first)
+      return;
+
+    Result result = first->second;
+    state.requested.erase(first);
+
+    if (static_cast<bool>(result.data))
+      m_onDeliver(result.data, result.isValidated);
+  }
+}
+
+BackfillFetcher::SessionStates::iterator
+BackfillFetcher::findSession(const Name& session, uint64_t epoch)
+{
+  SessionStates::iterator it = m_sessions.find(session);
+  if (it != m_sessions.end() && it->second.epoch != epoch)
+    return m_sessions.end();
+  return it;
+}
+
+} // namespace chronochat
@@ -0,0 +1,144 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#ifndef CHRONOCHAT_BACKFILL_FETCHER_HPP
+#define CHRONOCHAT_BACKFILL_FETCHER_HPP
+
+#include "common.hpp"
+
+namespace chronochat {
+
+/**
+ * @brief Pipelined fetcher of the chat data missing after a sync update
+ *
+ * Each session has its own window of outstanding fetches.  The window grows
+ * like a congestion window (slow start, then additive increase) as data arrives
+ * and is halved on every timeout.  The gap of a session is requested newest-first,
+ * but the fetched data is handed to the consumer in ascending sequence order.
+ * The total number of outstanding fetches of all sessions is capped, so that
+ * a reconnect in a room with many senders does not flood the forwarder.
+ */
+class BackfillFetcher : noncopyable
+{
+public:
+  typedef function<void(const shared_ptr<const Data>& data, bool isValidated)> DataCallback;
+  typedef function<void()> TimeoutCallback;
+
+  /// @brief express a fetch for data @p seqNo of @p session
+  typedef function<void(const Name& session, uint64_t seqNo,
+                        const DataCallback& onData,
+                        const TimeoutCallback& onTimeout)> FetchFunction;
+
+  BackfillFetcher(const FetchFunction& fetch,
+                  const DataCallback& onDeliver,
+                  size_t maxOutstanding = 64,
+                  uint64_t maxDepth = 1000);
+
+  /**
+   * @brief request the data [@p low, @p high] of @p session
+   *
+   * Only the newest maxDepth sequence numbers of a gap are fetched.
+   */
+  void
+  addGap(const Name& session, uint64_t low, uint64_t high);
+
+  /// @brief drop the state of @p session, late results of its fetches are ignored
+  void
+  removeSession(const Name& session);
+
+  /// @brief drop the state of all sessions
+  void
+  clear();
+
+  /**
+   * @brief stop fetching, e.g. while the face is down
+   *
+   * The fetches in flight are forgotten and requested again after resume().  Gaps that
+   * are added meanwhile are only recorded, and the data that has arrived already as well
+   * as the sequence numbers seen so far are kept, so nothing is requested twice.
+   */
+  void
+  suspend();
+
+  /// @brief continue fetching after suspend()
+  void
+  resume();
+
+  size_t
+  getNOutstanding() const
+  {
+    return m_nOutstanding;
+  }
+
+  double
+  getWindow(const Name& session) const;
+
+CHRONOCHAT_PUBLIC_WITH_TESTS_ELSE_PRIVATE:
+  static const double INITIAL_WINDOW;
+  static const double MAX_WINDOW;
+
+private:
+  struct Result
+  {
+    bool isDone;
+    bool isValidated;
+    shared_ptr<const Data> data;
+  };
+
+  struct SessionState
+  {
+    uint64_t epoch;
+    double window;
+    double threshold;
+    size_t nOutstanding;
+    // the lowest seq that has never been part of a gap
+    uint64_t nextSeqNo;
+    // gaps which are not requested yet, low -> high
+    std::map<uint64_t, uint64_t> pending;
+    // requested data which is either in flight or waiting for delivery
+    std::map<uint64_t, Result> requested;
+  };
+
+  typedef std::map<Name, SessionState> SessionStates;
+
+  void
+  schedule();
+
+  bool
+  fetchNext(const Name& session, SessionState& state);
+
+  void
+  onData(const Name& session, uint64_t epoch, uint64_t seqNo,
+         const shared_ptr<const Data>& data, bool isValidated);
+
+  void
+  onTimeout(const Name& session, uint64_t epoch, uint64_t seqNo);
+
+  void
+  deliver(const Name& session);
+
+  SessionStates::iterator
+  findSession(const Name& session, uint64_t epoch);
+
+private:
+  FetchFunction m_fetch;
+  DataCallback m_onDeliver;
+  size_t m_maxOutstanding;
+  uint64_t m_maxDepth;
+
+  SessionStates m_sessions;
+  Name m_lastScheduled;
+  size_t m_nOutstanding;
+  uint64_t m_nextEpoch;
+  bool m_isScheduling;
+  bool m_isSuspended;
+};
+
+} // namespace chronochat
+
+#endif // CHRONOCHAT_BACKFILL_FETCHER_HPP
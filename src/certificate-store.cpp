@@ -0,0 +1,293 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#include "certificate-store.hpp"
+
+#include <ndn-cxx/security/validator.hpp>
+#include <boost/filesystem.hpp>
+#include "cryptopp.hpp"
+#include "logging.h"
+
+INIT_LOGGER("CertificateStore");
+
+namespace chronochat {
+
+namespace fs = boost::filesystem;
+
+using std::string;
+using ndn::IdentityCertificate;
+
+const string INIT_CERTIFICATE_TABLE =
+  "CREATE TABLE IF NOT EXISTS                                          "
+  "  Certificate(                                                      "
+  "      name              BLOB NOT NULL PRIMARY KEY,                  "
+  "      not_after         INTEGER NOT NULL,                           "
+  "      certificate       BLOB NOT NULL                               "
+  "  );                                                                ";
+
+static int64_t
+toMilliseconds(const time::system_clock::TimePoint& timePoint)
+{
+  return time::toUnixTimestamp(timePoint).count();
+}
+
+CertificateStore::CertificateStore(size_t maxVerified)
+  : m_db(nullptr)
+  , m_maxVerified(maxVerified)
+{
+}
+
+CertificateStore::CertificateStore(const string& path,
+                                   const shared_ptr<const IdentityCertificate>& anchor,
+                                   size_t maxVerified)
+  : m_db(nullptr)
+  , m_anchor(anchor)
+  , m_maxVerified(maxVerified)
+{
+  BOOST_ASSERT(anchor != nullptr);
+
+  int res = sqlite3_open(path.c_str(), &m_db);
+  if (res != SQLITE_OK) {
+    sqlite3_close(m_db);
+    throw Error("certificate DB cannot be open/created");
+  }
+
+  char* errmsg = 0;
+  res = sqlite3_exec(m_db, INIT_CERTIFICATE_TABLE.c_str(), nullptr, nullptr, &errmsg);
+  if (res != SQLITE_OK) {
+    sqlite3_free(errmsg);
+    sqlite3_close(m_db);
+    throw Error("Init \"error\" in Certificate");
+  }
+
+  load();
+}
+
+CertificateStore::~CertificateStore()
+{
+  if (m_db != nullptr)
+    sqlite3_close(m_db);
+}
+
+void
+CertificateStore::insertCertificate(shared_ptr<const IdentityCertificate> certificate)
+{
+  time::system_clock::TimePoint now = time::system_clock::now();
+  if (certificate->getNotAfter() < now)
+    return;
+
+  Name name = certificate->getName().getPrefix(-1);
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_certificates[name] = certificate;
+
+  if (m_db == nullptr)
+    return;
+
+  // certificates are few and far between, so they are written right away
+  sqlite3_stmt* stmt;
+  sqlite3_prepare_v2(m_db,
+                     "INSERT OR REPLACE INTO Certificate (name, not_after, certificate) \
+                      VALUES (?, ?, ?)",
+                     -1, &stmt, 0);
+  sqlite3_bind_blob(stmt, 1, name.wireEncode().wire(), name.wireEncode().size(),
+                    SQLITE_TRANSIENT);
+  sqlite3_bind_int64(stmt, 2, toMilliseconds(certificate->getNotAfter()));
+  sqlite3_bind_blob(stmt, 3, certificate->wireEncode().wire(), certificate->wireEncode().size(),
+                    SQLITE_TRANSIENT);
+  if (sqlite3_step(stmt) != SQLITE_DONE)
+    _LOG_ERROR("Cannot store certificate " << certificate->getName());
+  sqlite3_finalize(stmt);
+}
+
+shared_ptr<const IdentityCertificate>
+CertificateStore::getCertificate(const Name& certificateNameWithoutVersion)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return findCertificate(certificateNameWithoutVersion);
+}
+
+void
+CertificateStore::reset()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_certificates.clear();
+  m_verified.clear();
+  m_verifiedOrder.clear();
+
+  if (m_db != nullptr)
+    sqlite3_exec(m_db, "DELETE FROM Certificate;", nullptr, nullptr, nullptr);
+}
+
+size_t
+CertificateStore::getSize()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_certificates.size();
+}
+
+void
+CertificateStore::addVerified(const Data& data)
+{
+  const Signature& signature = data.getSignature();
+  if (!signature.hasKeyLocator() ||
+      signature.getKeyLocator().getType() != KeyLocator::KeyLocator_Name)
+    return;
+
+  string digest = getDigest(data);
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (!m_verified.insert(std::make_pair(digest, signature.getKeyLocator().getName())).second)
+    return;
+
+  m_verifiedOrder.push_back(digest);
+  if (m_verifiedOrder.size() > m_maxVerified) {
+    m_verified.erase(m_verifiedOrder.front());
+    m_verifiedOrder.pop_front();
+  }
+}
+
+bool
+CertificateStore::isVerified(const Data& data)
+{
+  const Signature& signature = data.getSignature();
+  if (!signature.hasKeyLocator() ||
+      signature.getKeyLocator().getType() != KeyLocator::KeyLocator_Name)
+    return false;
+
+  string digest = getDigest(data);
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  std::map<string, Name>::const_iterator it = m_verified.find(digest);
+  return (it != m_verified.end() && it->second == signature.getKeyLocator().getName() &&
+          findCertificate(it->second) != nullptr);
+}
+
+string
+CertificateStore::getDefaultPath(const IdentityCertificate& anchor)
+{
+  using namespace CryptoPP;
+
+  // a database per anchor, so a build with another anchor does not trust the certificates
+  string anchorDigest;
+  SHA256 hash;
+  StringSource(anchor.wireEncode().wire(), anchor.wireEncode().size(), true,
+               new HashFilter(hash, new HexEncoder(new StringSink(anchorDigest), false)));
+
+  fs::path chronosDir = fs::path(getenv("HOME")) / ".chronos";
+  fs::create_directories(chronosDir);
+  return (chronosDir / ("chat-certificates-" + anchorDigest.substr(0, 16) + ".db")).string();
+}
+
+shared_ptr<const IdentityCertificate>
+CertificateStore::findCertificate(const Name& certificateNameWithoutVersion)
+{
+  Certificates::iterator it = m_certificates.find(certificateNameWithoutVersion);
+  if (it == m_certificates.end())
+    return nullptr;
+
+  // expired certificates are dropped lazily, the database is cleaned up on the next start
+  if (it->second->getNotAfter() < time::system_clock::now()) {
+    m_certificates.erase(it);
+    return nullptr;
+  }
+
+  return it->second;
+}
+
+void
+CertificateStore::load()
+{
+  int64_t now = toMilliseconds(time::system_clock::now());
+
+  sqlite3_stmt* stmt;
+  sqlite3_prepare_v2(m_db, "DELETE FROM Certificate WHERE not_after < ?", -1, &stmt, 0);
+  sqlite3_bind_int64(stmt, 1, now);
+  sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+
+  Certificates loaded;
+  sqlite3_prepare_v2(m_db, "SELECT certificate FROM Certificate", -1, &stmt, 0);
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    try {
+      Block block(reinterpret_cast<const uint8_t*>(sqlite3_column_blob(stmt, 0)),
+                  sqlite3_column_bytes(stmt, 0));
+      shared_ptr<IdentityCertificate> certificate = make_shared<IdentityCertificate>();
+      certificate->wireDecode(block);
+      loaded[certificate->getName().getPrefix(-1)] = certificate;
+    }
+    catch (const std::runtime_error& e) {
+      _LOG_ERROR("Skip a broken certificate: " << e.what());
+    }
+  }
+  sqlite3_finalize(stmt);
+
+  // The database is not trusted by itself: a certificate is taken once its signer is, starting
+  // from the anchor.  The signers of a chain need not have been stored in order.
+  bool isChanged = true;
+  while (isChanged) {
+    isChanged = false;
+    for (Certificates::iterator it = loaded.begin(); it != loaded.end();) {
+      const ndn::PublicKey* signerKey = findSignerKey(*it->second);
+      if (signerKey != nullptr && ndn::Validator::verifySignature(*it->second, *signerKey)) {
+        m_certificates.insert(*it);
+        it = loaded.erase(it);
+        isChanged = true;
+      }
+      else
+        ++it;
+    }
+  }
+
+  for (const auto& certificate : loaded) {
+    _LOG_DEBUG("Drop untrusted certificate " << certificate.second->getName());
+    sqlite3_prepare_v2(m_db, "DELETE FROM Certificate WHERE name = ?", -1, &stmt, 0);
+    sqlite3_bind_blob(stmt, 1, certificate.first.wireEncode().wire(),
+                      certificate.first.wireEncode().size(), SQLITE_TRANSIENT);
+    sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+  }
+
+  _LOG_DEBUG("Loaded " << m_certificates.size() << " certificates");
+}
+
+const ndn::PublicKey*
+CertificateStore::findSignerKey(const IdentityCertificate& certificate) const
+{
+  const Signature& signature = certificate.getSignature();
+  if (!signature.hasKeyLocator() ||
+      signature.getKeyLocator().getType() != KeyLocator::KeyLocator_Name)
+    return nullptr;
+
+  // the key locator names the certificate with or without its version
+  const Name& signerName = signature.getKeyLocator().getName();
+  if (signerName == m_anchor->getName() || signerName == m_anchor->getName().getPrefix(-1))
+    return &m_anchor->getPublicKeyInfo();
+
+  Certificates::const_iterator it = m_certificates.find(signerName);
+  if (it == m_certificates.end() && !signerName.empty())
+    it = m_certificates.find(signerName.getPrefix(-1));
+  if (it == m_certificates.end())
+    return nullptr;
+
+  return &it->second->getPublicKeyInfo();
+}
+
+string
+CertificateStore::getDigest(const Data& data)
+{
+  using namespace CryptoPP;
+
+  string digest;
+  SHA256 hash;
+  StringSource(data.wireEncode().wire(), data.wireEncode().size(), true,
+               new HashFilter(hash, new StringSink(digest)));
+  return digest;
+}
+
+} // namespace chronochat
@@ -0,0 +1,126 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#ifndef CHRONOCHAT_CERTIFICATE_STORE_HPP
+#define CHRONOCHAT_CERTIFICATE_STORE_HPP
+
+#include "common.hpp"
+#include <ndn-cxx/security/certificate-cache.hpp>
+#include <ndn-cxx/security/identity-certificate.hpp>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <sqlite3.h>
+
+namespace chronochat {
+
+/**
+ * @brief certificate cache shared by the validators of one policy and anchor
+ *
+ * Validators only insert certificates which they have verified, and take the cached ones as
+ * trusted, so all validators sharing a store must have the same rules and trust the same
+ * anchor.  A validator with looser rules needs a store of its own.  A certificate is kept
+ * until the end of its validity period, also across restarts if the store has a database.
+ * The store also remembers which Data packets have been verified, so that a packet fetched
+ * again, e.g. after a reconnect or by another room, is not verified twice.
+ *
+ * All methods are thread-safe.
+ */
+class CertificateStore : public ndn::CertificateCache
+{
+public:
+  class Error : public std::runtime_error
+  {
+  public:
+    explicit
+    Error(const std::string& what)
+      : std::runtime_error(what)
+    {
+    }
+  };
+
+  /// @brief keep the certificates in memory only
+  explicit
+  CertificateStore(size_t maxVerified = 65536);
+
+  /**
+   * @brief keep the certificates in the database at @p path as well
+   *
+   * The database belongs to the validators which trust @p anchor.  A stored certificate is
+   * only loaded if its chain of signatures through the other stored certificates ends at
+   * @p anchor, the others are removed.
+   *
+   * @throw Error if the database cannot be opened
+   */
+  CertificateStore(const std::string& path,
+                   const shared_ptr<const ndn::IdentityCertificate>& anchor,
+                   size_t maxVerified = 65536);
+
+  ~CertificateStore();
+
+  virtual void
+  insertCertificate(shared_ptr<const ndn::IdentityCertificate> certificate);
+
+  /// @return the certificate, or nullptr if it is unknown or expired
+  virtual shared_ptr<const ndn::IdentityCertificate>
+  getCertificate(const Name& certificateNameWithoutVersion);
+
+  virtual void
+  reset();
+
+  virtual size_t
+  getSize();
+
+  /// @brief remember that the signature of @p data has been verified
+  void
+  addVerified(const Data& data);
+
+  /**
+   * @brief check whether @p data has been verified before
+   *
+   * A packet only counts as verified while the certificate of its signer is in the store.
+   */
+  bool
+  isVerified(const Data& data);
+
+  /// @brief get the path of the database of the chat validators which trust @p anchor,
+  ///        under ~/.chronos
+  static std::string
+  getDefaultPath(const ndn::IdentityCertificate& anchor);
+
+private:
+  shared_ptr<const ndn::IdentityCertificate>
+  findCertificate(const Name& certificateNameWithoutVersion);
+
+  /// @return the key of the signer of @p certificate if the signer is trusted, or nullptr
+  const ndn::PublicKey*
+  findSignerKey(const ndn::IdentityCertificate& certificate) const;
+
+  void
+  load();
+
+  static std::string
+  getDigest(const Data& data);
+
+private:
+  typedef std::map<Name, shared_ptr<const ndn::IdentityCertificate>> Certificates;
+
+  sqlite3* m_db;
+  shared_ptr<const ndn::IdentityCertificate> m_anchor; // of the database
+  Certificates m_certificates;
+
+  size_t m_maxVerified;
+  std::map<std::string, Name> m_verified;   // Data digest -> certificate of the signer
+  std::deque<std::string> m_verifiedOrder;  // oldest first
+
+  std::mutex m_mutex;
+};
+
+} // namespace chronochat
+
+#endif // CHRONOCHAT_CERTIFICATE_STORE_HPP
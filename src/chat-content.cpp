@@ -0,0 +1,81 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#include "chat-content.hpp"
+#include "tlv-codec.hpp"
+
+namespace chronochat {
+
+const uint64_t ChatContent::VERSION;
+
+// Content := CONTENT-TYPE TLV-LENGTH
+//              ContentVersion
+//              (ChatMessage | ChatMessageBundle | CompressedContent)
+//
+// ContentVersion := CONTENT-VERSION-TYPE TLV-LENGTH
+//                     nonNegativeInteger
+//
+// The content of the first release is a ChatMessage alone.
+typedef codec::Tlv<tlv::ContentVersion, codec::NonNegativeInteger<uint64_t>> ContentVersionTlv;
+
+bool
+ChatContent::isLegacy(const ChatMessage& msg)
+{
+  return (msg.hasNick() && msg.hasChatroomName() && !msg.hasPreciseTimestamp() &&
+          !msg.hasHelloInterval() && msg.getMsgType() != ChatMessage::FILE);
+}
+
+Block
+ChatContent::encode(const Block& payload)
+{
+  size_t length = ContentVersionTlv::size(VERSION) + payload.size();
+  size_t totalLength = codec::sizeOfVarNumber(ndn::tlv::Content) +
+                       codec::sizeOfVarNumber(length) + length;
+
+  auto buffer = make_shared<ndn::Buffer>(totalLength);
+  uint8_t* pos = codec::writeVarNumber(&buffer->front(), ndn::tlv::Content);
+  pos = codec::writeVarNumber(pos, length);
+  pos = ContentVersionTlv::write(pos, VERSION);
+  pos = codec::writeBytes(pos, payload.wire(), payload.size());
+  BOOST_ASSERT(pos == &buffer->front() + totalLength);
+
+  return Block(buffer);
+}
+
+Block
+ChatContent::encodeLegacy(const Block& msgWire)
+{
+  return Block(ndn::tlv::Content, msgWire);
+}
+
+Block
+ChatContent::decode(const Block& content)
+{
+  try {
+    content.parse();
+  }
+  catch (const ndn::tlv::Error& e) {
+    throw Error(std::string("Malformed content: ") + e.what());
+  }
+
+  const Block::element_container& elements = content.elements();
+  if (elements.size() == 1 && elements.front().type() != tlv::ContentVersion)
+    return elements.front();
+
+  if (elements.size() != 2 || elements.front().type() != tlv::ContentVersion)
+    throw Error("Malformed content");
+
+  uint64_t version = 0;
+  ContentVersionTlv::read(elements.front(), version);
+  if (version > VERSION)
+    throw Error("Unknown content version " + std::to_string(version));
+
+  return elements.back();
+}
+
+} // namespace chronochat
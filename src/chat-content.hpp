@@ -0,0 +1,65 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#ifndef CHRONOCHAT_CHAT_CONTENT_HPP
+#define CHRONOCHAT_CHAT_CONTENT_HPP
+
+#include "common.hpp"
+#include "tlv.hpp"
+#include "chat-message.hpp"
+#include <ndn-cxx/encoding/block.hpp>
+
+namespace chronochat {
+
+/**
+ * @brief Content of chat data, which is kept and served for late joiners
+ *
+ * The content of the first release is a single ChatMessage with the elements it knows, see
+ * isLegacy().  Any other content starts with a ContentVersion element, which is followed
+ * by the payload: a ChatMessage, a ChatMessageBundle, or a CompressedContent of either.
+ * The first release cannot parse a content of two elements, which it drops as a tlv::Error,
+ * so whoever fetches the data later either understands it or skips it.
+ */
+class ChatContent
+{
+public:
+  class Error : public std::runtime_error
+  {
+  public:
+    explicit
+    Error(const std::string& what)
+      : std::runtime_error(what)
+    {
+    }
+  };
+
+  static const uint64_t VERSION = 1;
+
+  /// @brief true if the first release can decode @p msg
+  static bool
+  isLegacy(const ChatMessage& msg);
+
+  /// @brief get the Content element of @p payload, which starts with the ContentVersion
+  static Block
+  encode(const Block& payload);
+
+  /// @brief get the Content element of the single message @p msgWire of the first release
+  static Block
+  encodeLegacy(const Block& msgWire);
+
+  /**
+   * @brief get the payload of the Content element @p content
+   * @throw Error @p content is malformed, or of a later version
+   */
+  static Block
+  decode(const Block& content);
+};
+
+} // namespace chronochat
+
+#endif // CHRONOCHAT_CHAT_CONTENT_HPP
@@ -14,6 +14,8 @@
 #include <QFile>
 
 #ifndef Q_MOC_RUN
+#include <random>
+#include <boost/filesystem.hpp>
 #include <ndn-cxx/util/io.hpp>
 #include <ndn-cxx/security/validator-regex.hpp>
 #include "logging.h"
@@ -25,135 +27,271 @@ INIT_LOGGER("ChatDialogBackend");
 namespace chronochat {
 
 static const time::milliseconds FRESHNESS_PERIOD(60000);
+// hello interval of rooms with up to HELLOS_PER_INTERVAL participants, larger rooms send
+// HELLOS_PER_INTERVAL hellos per HELLO_INTERVAL in total
 static const time::seconds HELLO_INTERVAL(60);
+static const size_t HELLOS_PER_INTERVAL = 20;
+// longest hello interval which is sent or accepted, that of a room of 1200 participants
+static const time::hours MAX_HELLO_INTERVAL(1);
+// granularity of the remote session timeouts
+static const time::seconds SESSION_TIMEOUT_TICK(1);
 static const ndn::Name::Component ROUTING_HINT_SEPARATOR =
   ndn::name::Component::fromEscapedString("%F0%2E");
 static const int IDENTITY_OFFSET = -3;
-static const int CONNECTION_RETRY_TIMER = 3;
+// time for the leave message to go out before the sync session is closed
+static const useconds_t LEAVE_DELAY = 100000;
+static const int FETCH_RETRIES = 2;
+// maximum number of outstanding chat data fetches of all sessions
+static const size_t MAX_OUTSTANDING_FETCHES = 64;
+// maximum number of most recent chat data to fetch from one gap of a session
+static const uint64_t MAX_BACKFILL_DEPTH = 1000;
+static const time::seconds HISTORY_FLUSH_INTERVAL(1);
+// received messages are collected for this long before they are sent to GUI
+static const time::milliseconds MESSAGE_BATCH_INTERVAL(50);
+static const size_t MAX_MESSAGE_BATCH_SIZE = 256;
+// own chat messages sent within this time after the last publish are bundled
+static const time::milliseconds BUNDLE_WINDOW(5);
+// leaves room for the name and the signature within the maximum packet size
+static const size_t MAX_BUNDLE_SIZE = 4096;
+// shared files are published under <session name>/file/<file id>
+static const ndn::Name::Component FILE_COMPONENT("file");
+// the SessionInfo is published as <session name>/info
+static const ndn::Name::Component INFO_COMPONENT("info");
+// progress of a file transfer is reported to GUI at most this often
+static const time::milliseconds FILE_PROGRESS_INTERVAL(200);
+
+namespace fs = boost::filesystem;
+
+// same conversion as QString::fromStdString, without the intermediate string
+static QString
+toQString(const StringRef& str)
+{
+  return QString::fromAscii(str.data(), static_cast<int>(str.size()));
+}
+
+// a name chosen by a remote user as one component of a local path
+static fs::path
+toPathComponent(const std::string& name, const std::string& defaultName)
+{
+  fs::path component = fs::path(name).filename();
+  if (component.empty() || component == "." || component == ".." || component == "/")
+    return defaultName;
+  return component;
+}
 
-ChatDialogBackend::ChatDialogBackend(const Name& chatroomPrefix,
+static shared_ptr<ndn::ValidatorRegex>
+makeChatValidator(ndn::Face* face,
+                  const shared_ptr<ndn::CertificateCache>& certificateCache,
+                  const shared_ptr<ndn::IdentityCertificate>& anchor)
+{
+  shared_ptr<ndn::ValidatorRegex> validator =
+    make_shared<ndn::ValidatorRegex>(face, certificateCache);
+  validator->addDataVerificationRule(
+    make_shared<ndn::SecRuleRelative>("^<>*<%F0.>(<>*)$",
+                                      "^([^<KEY>]*)<KEY>(<>*)<ksk-.*><ID-CERT>$",
+                                      ">", "\\1", "\\1\\2", true));
+  validator->addDataVerificationRule(
+    make_shared<ndn::SecRuleRelative>("(<>*)$",
+                                      "^([^<KEY>]*)<KEY>(<>*)<ksk-.*><ID-CERT>$",
+                                      ">", "\\1", "\\1\\2", true));
+  validator->addTrustAnchor(anchor);
+
+  return validator;
+}
+
+ChatDialogBackend::ChatDialogBackend(const shared_ptr<SyncRuntime>& runtime,
+                                     const Name& chatroomPrefix,
                                      const Name& userChatPrefix,
                                      const Name& routingPrefix,
                                      const std::string& chatroomName,
                                      const std::string& nick,
                                      const Name& signingId,
                                      QObject* parent)
-  : QThread(parent)
-  , m_shouldResume(false)
+  : QObject(parent)
+  , m_runtime(runtime)
+  , m_shard(0)
+  , m_isAttached(false)
+  , m_hasFailed(false)
+  , m_dataFilterId(nullptr)
+  , m_fileFilterId(nullptr)
   , m_localRoutingPrefix(routingPrefix)
   , m_chatroomPrefix(chatroomPrefix)
   , m_userChatPrefix(userChatPrefix)
   , m_chatroomName(chatroomName)
   , m_nick(nick)
   , m_signingId(signingId)
+  , m_validationPool(nullptr)
+  , m_helloInterval(HELLO_INTERVAL, HELLOS_PER_INTERVAL, std::random_device()())
+  , m_filePublisher(bind(&ChatDialogBackend::signData, this, _1),
+                    FilePublisher::DEFAULT_SEGMENT_SIZE,
+                    FRESHNESS_PERIOD)
+  , m_nextFileId(0)
+  , m_joined(false)
+  , m_ownSessionId(0)
+  , m_backfill([this] (const Name& sessionPrefix, uint64_t seqNo,
+                       const BackfillFetcher::DataCallback& onData,
+                       const BackfillFetcher::TimeoutCallback& onTimeout) {
+                 this->fetchChatData(sessionPrefix, seqNo, onData, onTimeout, FETCH_RETRIES);
+               },
+               [this] (const shared_ptr<const ndn::Data>& data, bool isValidated) {
+                 this->processChatData(data, true, isValidated);
+               },
+               MAX_OUTSTANDING_FETCHES,
+               MAX_BACKFILL_DEPTH)
+  , m_nextTransferId(0)
 {
   updatePrefixes();
+
+  // the history is keyed by the non-routable prefix, so it survives prefix changes
+  try {
+    m_history.reset(new ChatHistoryStorage(m_userChatPrefix));
+  }
+  catch (ChatHistoryStorage::Error& e) {
+    _LOG_ERROR("Chat history is disabled: " << e.what());
+  }
+
+  // so is the publish cache, which keeps serving the data of earlier sessions
+  try {
+    fs::path cacheDir = fs::path(getenv("HOME")) / ".chronos" / "cache";
+    fs::create_directories(cacheDir);
+    m_publishCache.reset(
+      new PublishCache((cacheDir / PublishCache::getFileName(m_userChatPrefix)).string()));
+  }
+  catch (const std::exception& e) {
+    _LOG_ERROR("Publish cache is disabled: " << e.what());
+  }
 }
 
 
 ChatDialogBackend::~ChatDialogBackend()
 {
+  shutdown();
 }
 
-// protected methods:
 void
-ChatDialogBackend::run()
+ChatDialogBackend::start()
 {
-  bool shouldResume = false;
-  do {
-    initializeSync();
-
-    if (m_face == nullptr)
-      break;
+  m_shard = m_runtime->attach(this);
+  m_isAttached = true;
 
-    try {
-      m_face->getIoService().run();
-    }
-    catch (std::runtime_error& e) {
-      {
-        std::lock_guard<std::mutex>lock(m_nfdConnectionMutex);
-        m_isNfdConnected = false;
-      }
-      emit nfdError();
-      {
-        std::lock_guard<std::mutex>lock(m_resumeMutex);
-        m_shouldResume = true;
-      }
-#ifdef BOOST_THREAD_USES_CHRONO
-      time::seconds reconnectTimer = time::seconds(CONNECTION_RETRY_TIMER);
-#else
-      boost::posix_time::time_duration reconnectTimer;
-      reconnectTimer = boost::posix_time::seconds(CONNECTION_RETRY_TIMER);
-#endif
-      while (!m_isNfdConnected) {
-#ifdef BOOST_THREAD_USES_CHRONO
-        boost::this_thread::sleep_for(reconnectTimer);
-#else
-        boost::this_thread::sleep(reconnectTimer);
-#endif
-      }
-      emit refreshChatDialog(m_routableUserChatPrefix);
-    }
-    {
-      std::lock_guard<std::mutex>lock(m_resumeMutex);
-      shouldResume = m_shouldResume;
-      m_shouldResume = false;
-    }
-    close();
+  m_runtime->post(m_shard, [this] { this->initializeSync(); });
+}
 
-  } while (shouldResume);
+LatencyHistogram
+ChatDialogBackend::getReceiveLatency()
+{
+  LatencyHistogram latency;
+  if (m_isAttached)
+    m_runtime->invoke(m_shard, [this, &latency] { latency = m_receiveLatency; });
+  else
+    latency = m_receiveLatency;
 
-  std::cerr << "Bye!" << std::endl;
+  return latency;
 }
 
 // private methods:
+void
+ChatDialogBackend::onShardError(const std::runtime_error& e)
+{
+  // all faces of the shard share its connection to the forwarder, which is gone
+  if (m_face == nullptr)
+    return;
+
+  m_hasFailed = true;
+  close();
+
+  emit nfdError();
+}
+
 void
 ChatDialogBackend::initializeSync()
 {
   BOOST_ASSERT(m_sock == nullptr);
 
-  m_face = make_shared<ndn::Face>();
-  m_scheduler = unique_ptr<ndn::Scheduler>(new ndn::Scheduler(m_face->getIoService()));
+  boost::asio::io_service& ioService = m_runtime->getIoService(m_shard);
+  m_face = m_runtime->makeFace(m_shard);
+  if (m_scheduler == nullptr) {
+    m_scheduler = unique_ptr<ndn::Scheduler>(new ndn::Scheduler(ioService));
+    m_sessionWheel = unique_ptr<TimingWheel<UserInfo>>(
+      new TimingWheel<UserInfo>(*m_scheduler, SESSION_TIMEOUT_TICK,
+                                bind(&ChatDialogBackend::remoteSessionsTimeout, this, _1)));
+    m_bundler = unique_ptr<MessageBundler>(
+      new MessageBundler(*m_scheduler, BUNDLE_WINDOW, MAX_BUNDLE_SIZE,
+                         bind(&ChatDialogBackend::publishOutgoing, this, _1)));
+  }
+  m_activeToken = make_shared<bool>(true);
 
   // initialize validator
   shared_ptr<ndn::IdentityCertificate> anchor = loadTrustAnchor();
 
   if (static_cast<bool>(anchor)) {
-    shared_ptr<ndn::ValidatorRegex> validator =
-      make_shared<ndn::ValidatorRegex>(m_face.get()); // TODO: Change to Face*
-    validator->addDataVerificationRule(
-      make_shared<ndn::SecRuleRelative>("^<>*<%F0.>(<>*)$",
-                                        "^([^<KEY>]*)<KEY>(<>*)<ksk-.*><ID-CERT>$",
-                                        ">", "\\1", "\\1\\2", true));
-    validator->addDataVerificationRule(
-      make_shared<ndn::SecRuleRelative>("(<>*)$",
-                                        "^([^<KEY>]*)<KEY>(<>*)<ksk-.*><ID-CERT>$",
-                                        ">", "\\1", "\\1\\2", true));
-    validator->addTrustAnchor(anchor);
-
-    m_validator = validator;
+    // the certificates fetched by any room, also before a restart, need not be fetched again
+    shared_ptr<CertificateStore> certificateStore = m_runtime->getCertificateStore();
+    m_validator = makeChatValidator(m_face.get(), certificateStore, anchor);
+
+    // Chat data is verified by the workers, which only know the anchor and the
+    // certificates that the validators of the rooms have fetched so far.
+    m_validationPool = &m_runtime->getValidationPool([anchor, certificateStore] {
+        return makeChatValidator(nullptr, certificateStore, anchor);
+      });
   }
   else
     m_validator = shared_ptr<ndn::Validator>();
 
 
   // create a new SyncSocket
+  weak_ptr<bool> activeToken = m_activeToken;
+  auto onUpdate = [this, activeToken] (const std::vector<chronosync::MissingDataInfo>& updates) {
+    if (!activeToken.expired())
+      this->processSyncUpdate(updates);
+  };
   m_sock = make_shared<chronosync::Socket>(m_chatroomPrefix,
                                            m_routableUserChatPrefix,
                                            ref(*m_face),
-                                           bind(&ChatDialogBackend::processSyncUpdate, this, _1),
+                                           onUpdate,
                                            m_signingId,
                                            m_validator);
 
+  // Own chat data is served from the publish cache rather than by the socket, also that of
+  // earlier sessions.  The socket has registered the prefix already.
+  m_dataFilterId =
+    m_face->setInterestFilter(m_routableUserChatPrefix,
+                              [this, activeToken] (const Name& prefix,
+                                                   const Interest& interest) {
+                                if (!activeToken.expired())
+                                  this->onDataInterest(interest);
+                              });
+
+  m_ownSessionId = m_sessions.intern(m_sock->getLogic().getSessionName());
+  publishSessionInfo();
+
+  // segments of the shared files
+  Name filePrefix = m_sock->getLogic().getSessionName();
+  filePrefix.append(FILE_COMPONENT);
+  m_fileFilterId =
+    m_face->setInterestFilter(filePrefix,
+                              [this, activeToken] (const Name& prefix,
+                                                   const Interest& interest) {
+                                if (!activeToken.expired())
+                                  this->onFileInterest(interest);
+                              });
+
+  // Resume where the previous session stopped: the known sessions keep their nicks and get
+  // a full timeout to show up again, and only data that has not been seen yet is fetched.
+  for (auto& user : m_roster) {
+    m_sessionWheel->schedule(user.second, HelloInterval::getTimeout(user.second.helloInterval));
+    if (!user.second.hasInfo)
+      fetchSessionInfo(user.first);
+  }
+  m_backfill.resume();
+
   // schedule a new join event
   m_scheduler->scheduleEvent(time::milliseconds(600),
                              bind(&ChatDialogBackend::sendJoin, this));
 
-  // cancel existing hello event if it exists
-  if (m_helloEventId != nullptr) {
-    m_scheduler->cancelEvent(m_helloEventId);
-    m_helloEventId.reset();
-  }
+  // write the buffered history periodically
+  m_scheduler->scheduleEvent(HISTORY_FLUSH_INTERVAL,
+                             bind(&ChatDialogBackend::flushHistory, this));
 }
 
 class IoDeviceSource
@@ -180,32 +318,104 @@ private:
 shared_ptr<ndn::IdentityCertificate>
 ChatDialogBackend::loadTrustAnchor()
 {
-  QFile anchorFile(":/security/anchor.cert");
+  // the anchor is compiled in, so all rooms share one copy
+  static const shared_ptr<ndn::IdentityCertificate> anchor = [] {
+    QFile anchorFile(":/security/anchor.cert");
 
-  if (!anchorFile.open(QIODevice::ReadOnly)) {
-    return {};
-  }
+    if (!anchorFile.open(QIODevice::ReadOnly)) {
+      return shared_ptr<ndn::IdentityCertificate>();
+    }
+
+    boost::iostreams::stream<IoDeviceSource> anchorFileStream(anchorFile);
+    return ndn::io::load<ndn::IdentityCertificate>(anchorFileStream);
+  }();
 
-  boost::iostreams::stream<IoDeviceSource> anchorFileStream(anchorFile);
-  return ndn::io::load<ndn::IdentityCertificate>(anchorFileStream);
+  return anchor;
 }
 
 void
-ChatDialogBackend::exitChatroom() {
-  if (m_joined)
-    sendLeave();
+ChatDialogBackend::exitChatroom()
+{
+  bool isJoined = false;
+  m_runtime->invoke(m_shard, [this, &isJoined] {
+      isJoined = m_joined;
+      try {
+        if (m_joined)
+          sendLeave();
+      }
+      catch (const std::runtime_error& e) {
+        // the face has failed, same as if the error came from the shard
+        isJoined = false;
+        onShardError(e);
+      }
+    });
 
-  usleep(100000);
+  if (isJoined)
+    usleep(LEAVE_DELAY);
 }
 
 void
 ChatDialogBackend::close()
 {
+  emitMessages();
+  m_sessionWheel->clear();
+  // The messages held back for a bundle are published by the next session, as the face
+  // may have failed.  Leaving the room publishes them along with the LEAVE.
+  m_bundler->stop();
   m_scheduler->cancelAllEvents();
   m_helloEventId.reset();
-  m_roster.clear();
-  m_validator.reset();
+  m_joined = false;
+  // the fetches in flight die with the face, they are sent again by the next session
+  m_backfill.suspend();
+  // the files are published under the session name, which does not outlive the session
+  m_filePublisher.clear();
+  while (!m_fileTransfers.empty())
+    finishFileTransfer(m_fileTransfers.begin()->first, FileTransferInfo::FAILED,
+                       "Left the chatroom");
+  if (m_history != nullptr)
+    m_history->flush();
+  if (m_publishCache != nullptr)
+    m_publishCache->flush();
+
+  if (m_sock != nullptr) {
+    const Name& sessionName = m_sock->getLogic().getSessionName();
+    m_ownSessions.insert(sessionName);
+    emit sessionClosed(m_ownSessionId);
+  }
+
+  _LOG_DEBUG("Receive latency of " << m_receiveLatency.getCount() << " messages: p50 " <<
+             m_receiveLatency.getPercentile(50).count() << " us, p99 " <<
+             m_receiveLatency.getPercentile(99).count() << " us");
+
+  // late callbacks of this sync session are ignored from now on
+  m_activeToken.reset();
+  m_validationPool = nullptr;
+
+  // Other rooms keep the io_service and the connection of the shard running, so the face
+  // may still dispatch to the socket and the validator.  They are released only after the
+  // face has shut down, which withdraws the prefixes of the socket as well.  The connection
+  // of the shard and the prefixes of the other rooms stay.
+  if (m_face != nullptr) {
+    m_face->unsetInterestFilter(m_dataFilterId);
+    m_face->unsetInterestFilter(m_fileFilterId);
+    m_face->shutdown();
+
+    shared_ptr<chronosync::Socket> sock = m_sock;
+    shared_ptr<ndn::Validator> validator = m_validator;
+    shared_ptr<ndn::Face> face = m_face;
+    m_face->getIoService().post([sock, validator, face] () mutable {
+        sock.reset();
+        validator.reset();
+        face.reset();
+      });
+  }
+
   m_sock.reset();
+  m_validator.reset();
+  m_face.reset();
+  m_dataFilterId = nullptr;
+  m_fileFilterId = nullptr;
+  m_sessionInfo.reset();
 }
 
 void
@@ -221,40 +431,36 @@ ChatDialogBackend::processSyncUpdate(const std::vector<chronosync::MissingDataIn
 
 
   for (size_t i = 0; i < updates.size(); i++) {
+    // the others remember our earlier sessions for a while, their data is ours
+    if (m_ownSessions.count(updates[i].session) > 0)
+      continue;
+
+    // Only a single new data of a session is live, a longer gap is backfilled.  Before we
+    // have joined, the data of the sessions which we have not seen yet is backfilled too.
+    bool isLive = (updates[i].low == updates[i].high &&
+                   (m_joined || m_roster.count(updates[i].session) > 0));
+
     // update roster
     if (m_roster.find(updates[i].session) == m_roster.end()) {
       m_roster[updates[i].session].sessionPrefix = updates[i].session;
+      m_roster[updates[i].session].sessionId = m_sessions.intern(updates[i].session);
       m_roster[updates[i].session].hasNick = false;
+      // the session goes by its identity until its nick is announced
+      Name identity = updates[i].session.getPrefix(IDENTITY_OFFSET);
+      if (!identity.empty())
+        m_roster[updates[i].session].userNick = identity.get(-1).toUri();
+      m_roster[updates[i].session].hasInfo = false;
+      m_roster[updates[i].session].liveSeqNo = 0;
+      m_roster[updates[i].session].features = 0;
+      m_roster[updates[i].session].helloInterval = HELLO_INTERVAL;
+      fetchSessionInfo(updates[i].session);
     }
 
-    // fetch missing chat data
-    if (updates[i].high - updates[i].low < 3) {
-      for (chronosync::SeqNo seq = updates[i].low; seq <= updates[i].high; ++seq) {
-        m_sock->fetchData(updates[i].session, seq,
-                          [this] (const shared_ptr<const ndn::Data>& data) {
-                            this->processChatData(data, true, true);
-                          },
-                          [this] (const shared_ptr<const ndn::Data>& data, const std::string& msg) {
-                            this->processChatData(data, true, false);
-                          },
-                          ndn::OnTimeout(),
-                          2);
-        _LOG_DEBUG("<<< Fetching " << updates[i].session << "/" << seq);
-      }
-    }
-    else {
-      // There are too many msgs to fetch, let's just fetch the latest one
-      m_sock->fetchData(updates[i].session, updates[i].high,
-                        [this] (const shared_ptr<const ndn::Data>& data) {
-                          this->processChatData(data, false, true);
-                        },
-                        [this] (const shared_ptr<const ndn::Data>& data, const std::string& msg) {
-                          this->processChatData(data, false, false);
-                        },
-                        ndn::OnTimeout(),
-                        2);
-    }
+    if (isLive)
+      m_roster[updates[i].session].liveSeqNo = updates[i].high;
 
+    // fetch missing chat data, the backfill fetcher hands it over in order
+    m_backfill.addGap(updates[i].session, updates[i].low, updates[i].high);
   }
 
   // reflect the changes on GUI
@@ -262,42 +468,191 @@ ChatDialogBackend::processSyncUpdate(const std::vector<chronosync::MissingDataIn
                        QString::fromStdString(getHexEncodedDigest(m_sock->getRootDigest())));
 }
 
+void
+ChatDialogBackend::fetchChatData(const Name& sessionPrefix, uint64_t seqNo,
+                                 const BackfillFetcher::DataCallback& onData,
+                                 const BackfillFetcher::TimeoutCallback& onTimeout,
+                                 int nRetries)
+{
+  // Chat data is fetched directly rather than through the socket, whose validator would
+  // verify it on this thread.
+  Name dataName(sessionPrefix);
+  dataName.appendNumber(seqNo);
+
+  fetchData(dataName, onData, onTimeout, nRetries);
+}
+
+void
+ChatDialogBackend::fetchData(const Name& dataName,
+                             const BackfillFetcher::DataCallback& onData,
+                             const BackfillFetcher::TimeoutCallback& onTimeout,
+                             int nRetries)
+{
+  Interest interest(dataName);
+  interest.setMustBeFresh(true);
+
+  weak_ptr<bool> activeToken = m_activeToken;
+  m_face->expressInterest(interest,
+                          [this, activeToken, onData] (const Interest& interest,
+                                                       const Data& data) {
+                            if (!activeToken.expired())
+                              this->validateChatData(data.shared_from_this(), onData);
+                          },
+                          [=] (const Interest& interest) {
+                            if (activeToken.expired())
+                              return;
+                            if (nRetries > 0)
+                              this->fetchData(dataName, onData, onTimeout, nRetries - 1);
+                            else
+                              onTimeout();
+                          });
+}
+
+void
+ChatDialogBackend::validateChatData(const shared_ptr<const Data>& data,
+                                    const BackfillFetcher::DataCallback& onData)
+{
+  if (m_validationPool == nullptr) {
+    // without a trust anchor nothing can be verified, same as the socket does
+    onData(data, true);
+    return;
+  }
+
+  // e.g., data fetched again after a reconnect
+  shared_ptr<CertificateStore> certificateStore = m_runtime->getCertificateStore();
+  if (certificateStore->isVerified(*data)) {
+    onData(data, true);
+    return;
+  }
+
+  weak_ptr<bool> activeToken = m_activeToken;
+  m_validationPool->validate(data->getName().getPrefix(-1), data, m_face->getIoService(),
+                             [certificateStore, activeToken, onData] (
+                               const shared_ptr<const Data>& data) {
+                               certificateStore->addVerified(*data);
+                               if (!activeToken.expired())
+                                 onData(data, true);
+                             },
+                             [this, activeToken, onData] (const shared_ptr<const Data>& data,
+                                                          const std::string& reason) {
+                               // the signer may just be unknown to the workers yet
+                               if (!activeToken.expired())
+                                 this->validateChatDataWithFetch(data, onData);
+                             });
+}
+
+void
+ChatDialogBackend::validateChatDataWithFetch(const shared_ptr<const Data>& data,
+                                             const BackfillFetcher::DataCallback& onData)
+{
+  // the fetch must complete either way, or the backfill window of the session stalls
+  if (m_validator == nullptr) {
+    onData(data, false);
+    return;
+  }
+
+  weak_ptr<bool> activeToken = m_activeToken;
+  m_validator->validate(*data,
+                        [this, activeToken, onData] (const shared_ptr<const Data>& data) {
+                          if (activeToken.expired())
+                            return;
+
+                          // the workers find the signing certificate in the store now
+                          m_runtime->getCertificateStore()->addVerified(*data);
+                          onData(data, true);
+                        },
+                        [activeToken, onData] (const shared_ptr<const Data>& data,
+                                               const std::string& reason) {
+                          if (activeToken.expired())
+                            return;
+
+                          _LOG_DEBUG("Cannot validate " << data->getName() << ": " << reason);
+                          onData(data, false);
+                        });
+}
+
 void
 ChatDialogBackend::processChatData(const ndn::shared_ptr<const ndn::Data>& data,
                                    bool needDisplay,
                                    bool isValidated)
 {
-  ChatMessage msg;
+  ChatMessageBundle bundle;
 
   try {
-    msg.wireDecode(data->getContent().blockFromValue());
+    // the fields are converted straight from the content into their final representation
+    Block content = ChatContent::decode(data->getContent());
+    if (content.type() == tlv::CompressedContent)
+      content = m_compressor.decompress(content);
+
+    if (content.type() == tlv::ChatMessageBundle)
+      bundle.wireDecode(content);
+    else
+      bundle.addMessage(ChatMessage(content, ChatMessage::DECODE_VIEW));
   }
-  catch (tlv::Error) {
+  catch (const std::runtime_error&) {
     _LOG_DEBUG("Errrrr.. Can not parse msg with name: " <<
                data->getName() << ". what is happening?");
-    // nasty stuff: as a remedy, we'll form some standard msg for inparsable msgs
-    msg.setNick("inconnu");
-    msg.setMsgType(ChatMessage::OTHER);
     return;
   }
 
   Name remoteSessionPrefix = data->getName().getPrefix(-1);
+  uint64_t seqNo = data->getName().get(-1).toNumber();
+  BackendRoster::iterator it = m_roster.find(remoteSessionPrefix);
+
+  // compact messages name their sender by its SessionInfo only, which may still be fetched
+  bool hasNicks = true;
+  for (const ChatMessage& msg : bundle.getMessages())
+    hasNicks = hasNicks && msg.hasNick();
+  if (it != m_roster.end() && !it->second.hasInfo &&
+      (!hasNicks || !it->second.pendingData.empty())) {
+    it->second.pendingData.push_back(std::make_pair(data, isValidated));
+    return;
+  }
+
+  // a message which is already in the history has been displayed before
+  bool isInHistory = false;
+  if (m_history != nullptr)
+    isInHistory = m_history->hasMessage(remoteSessionPrefix, seqNo);
+
+  bool isLive = (needDisplay && !isInHistory &&
+                 it != m_roster.end() && it->second.liveSeqNo == seqNo);
+
+  const std::vector<ChatMessage>& messages = bundle.getMessages();
+  for (size_t i = 0; i < messages.size(); i++) {
+    // the latency includes the clock offset between the hosts
+    if (isLive && messages[i].hasPreciseTimestamp())
+      m_receiveLatency.record(time::system_clock::now() - messages[i].getPreciseTimestamp());
 
+    if (m_history != nullptr && !isInHistory)
+      m_history->addMessage(remoteSessionPrefix, seqNo, messages[i], isValidated, i,
+                            getNick(remoteSessionPrefix, messages[i]));
+
+    processChatMessage(remoteSessionPrefix, seqNo, messages[i],
+                       needDisplay && !isInHistory, isValidated);
+  }
+}
+
+void
+ChatDialogBackend::processChatMessage(const Name& remoteSessionPrefix, uint64_t seqNo,
+                                      const ChatMessage& msg,
+                                      bool needDisplay, bool isValidated)
+{
   if (msg.getMsgType() == ChatMessage::LEAVE) {
     BackendRoster::iterator it = m_roster.find(remoteSessionPrefix);
 
     if (it != m_roster.end()) {
-      // cancel timeout event
-      if (static_cast<bool>(it->second.timeoutEventId))
-        m_scheduler->cancelEvent(it->second.timeoutEventId);
+      // cancel timeout
+      m_sessionWheel->cancel(it->second);
 
       // notify frontend to remove the remote session (node)
-      emit sessionRemoved(QString::fromStdString(remoteSessionPrefix.toUri()),
-                          QString::fromStdString(msg.getNick()),
-                          msg.getTimestamp());
+      emitMessages();
+      emit sessionRemoved(it->second.sessionId,
+                          toQString(getNick(remoteSessionPrefix, msg)),
+                          msg.getTimestamp(), true, seqNo);
 
       // remove roster entry
       m_roster.erase(remoteSessionPrefix);
+      m_backfill.removeSession(remoteSessionPrefix);
 
       emit eraseInRoster(remoteSessionPrefix.getPrefix(IDENTITY_OFFSET),
                          Name::Component(m_chatroomName));
@@ -309,99 +664,484 @@ ChatDialogBackend::processChatData(const ndn::shared_ptr<const ndn::Data>& data,
     if (it == m_roster.end()) {
       // Should not happen
       BOOST_ASSERT(false);
+      return;
     }
 
-    uint64_t seqNo = data->getName().get(-1).toNumber();
-
-    // If a timeout event has been scheduled, cancel it.
-    if (static_cast<bool>(it->second.timeoutEventId))
-      m_scheduler->cancelEvent(it->second.timeoutEventId);
-
-    // (Re)schedule another timeout event after 3 HELLO_INTERVAL;
-    it->second.timeoutEventId =
-      m_scheduler->scheduleEvent(HELLO_INTERVAL * 3,
-                                 bind(&ChatDialogBackend::remoteSessionTimeout,
-                                      this, remoteSessionPrefix));
-
-    // If chat message, notify the frontend
-    if (msg.getMsgType() == ChatMessage::CHAT) {
-      if (isValidated)
-        emit chatMessageReceived(QString::fromStdString(msg.getNick()),
-                                 QString::fromStdString(msg.getData()),
-                                 msg.getTimestamp());
-      else
-        emit chatMessageReceived(QString::fromStdString(msg.getNick() + " (Unverified)"),
-                                 QString::fromStdString(msg.getData()),
-                                 msg.getTimestamp());
-    }
-
-    // Notify frontend to plot notification on DigestTree.
+    // the nick comes with JOIN and HELLO, and with every message of older versions
+    if (msg.hasNick() && msg.getNickView() != it->second.userNick)
+      it->second.userNick = msg.getNickView().toString();
+
+    // the session counts its own roster, which may differ from ours
+    if (msg.hasHelloInterval())
+      it->second.helloInterval = std::max<time::milliseconds>(
+                                   std::min<time::milliseconds>(msg.getHelloInterval(),
+                                                                MAX_HELLO_INTERVAL),
+                                   HELLO_INTERVAL);
+
+    // (Re)schedule the timeout
+    m_sessionWheel->schedule(it->second, HelloInterval::getTimeout(it->second.helloInterval));
+
+    // Notify frontend to print the chat message and plot notification on DigestTree.
+    MessageInfo info;
+    info.sessionId = it->second.sessionId;
+    info.nick = QString::fromStdString(it->second.userNick);
+    info.seqNo = seqNo;
+    info.timestamp = msg.getTimestamp();
+    info.isChat = (msg.getMsgType() == ChatMessage::CHAT && needDisplay);
+    info.isFile = (msg.getMsgType() == ChatMessage::FILE && needDisplay);
+    if (info.isChat)
+      info.text = toQString(msg.getDataView());
+    else if (info.isFile)
+      info.text = QString::fromStdString(msg.getFileManifest().getFileName());
+    info.isValidated = isValidated;
+    info.addSession = false;
+    info.isJoin = (msg.getMsgType() == ChatMessage::JOIN);
+    info.receiveTime = time::steady_clock::now();
 
     // If we haven't got any message from this session yet.
-    if (m_roster[remoteSessionPrefix].hasNick == false) {
-      m_roster[remoteSessionPrefix].userNick = msg.getNick();
-      m_roster[remoteSessionPrefix].hasNick = true;
-
-      emit messageReceived(QString::fromStdString(remoteSessionPrefix.toUri()),
-                           QString::fromStdString(msg.getNick()),
-                           seqNo,
-                           msg.getTimestamp(),
-                           true);
+    if (it->second.hasNick == false) {
+      it->second.hasNick = true;
+      info.addSession = true;
 
       emit addInRoster(remoteSessionPrefix.getPrefix(IDENTITY_OFFSET),
                        Name::Component(m_chatroomName));
     }
-    else
-      emit messageReceived(QString::fromStdString(remoteSessionPrefix.toUri()),
-                           QString::fromStdString(msg.getNick()),
-                           seqNo,
-                           msg.getTimestamp(),
-                           false);
+
+    queueMessage(info);
+
+    // only files of verified senders are offered, and only from their own namespace
+    if (info.isFile && isValidated &&
+        remoteSessionPrefix.isPrefixOf(msg.getFileManifest().getPrefix()))
+      offerFileTransfer(msg.getFileManifest(), it->second.userNick);
   }
 }
 
 void
-ChatDialogBackend::remoteSessionTimeout(const Name& sessionPrefix)
+ChatDialogBackend::remoteSessionsTimeout(const std::vector<UserInfo*>& sessions)
 {
   time_t timestamp =
     static_cast<time_t>(time::toUnixTimestamp(time::system_clock::now()).count() / 1000);
 
+  // the entries are destroyed along the way
+  std::vector<Name> sessionPrefixes;
+  for (const UserInfo* session : sessions)
+    sessionPrefixes.push_back(session->sessionPrefix);
+
   // notify frontend
-  emit sessionRemoved(QString::fromStdString(sessionPrefix.toUri()),
-                      QString::fromStdString(m_roster[sessionPrefix].userNick),
-                      timestamp);
+  emitMessages();
+  for (const Name& sessionPrefix : sessionPrefixes) {
+    emit sessionRemoved(m_roster[sessionPrefix].sessionId,
+                        QString::fromStdString(m_roster[sessionPrefix].userNick),
+                        timestamp, false, 0);
 
-  // remove roster entry
-  m_roster.erase(sessionPrefix);
+    // remove roster entry
+    m_roster.erase(sessionPrefix);
+    m_backfill.removeSession(sessionPrefix);
 
-  emit eraseInRoster(sessionPrefix.getPrefix(IDENTITY_OFFSET),
-                     Name::Component(m_chatroomName));
+    emit eraseInRoster(sessionPrefix.getPrefix(IDENTITY_OFFSET),
+                       Name::Component(m_chatroomName));
+  }
+}
+
+void
+ChatDialogBackend::publishSessionInfo()
+{
+  SessionInfo info;
+  info.setNick(m_nick);
+  uint64_t features = (SessionInfo::FEATURE_COMPACT |
+                       SessionInfo::FEATURE_PRECISE_TIMESTAMP |
+                       SessionInfo::FEATURE_BUNDLE |
+                       SessionInfo::FEATURE_HELLO_INTERVAL);
+  if (PayloadCompressor::isAvailable())
+    features |= SessionInfo::FEATURE_COMPRESSION;
+  info.setFeatures(features);
+
+  Name infoName = m_sock->getLogic().getSessionName();
+  infoName.append(INFO_COMPONENT);
+
+  m_sessionInfo = make_shared<Data>(infoName);
+  m_sessionInfo->setContent(info.wireEncode());
+  m_sessionInfo->setFreshnessPeriod(FRESHNESS_PERIOD);
+  signData(*m_sessionInfo);
+
+  // late joiners also fetch the info of the sessions whose data they catch up on
+  if (m_publishCache != nullptr)
+    m_publishCache->insert(*m_sessionInfo);
+}
+
+void
+ChatDialogBackend::fetchSessionInfo(const Name& sessionPrefix)
+{
+  Name infoName(sessionPrefix);
+  infoName.append(INFO_COMPONENT);
+
+  fetchData(infoName,
+            [this, sessionPrefix] (const shared_ptr<const Data>& data, bool isValidated) {
+              this->processSessionInfo(sessionPrefix, data, isValidated);
+            },
+            [this, sessionPrefix] {
+              this->processSessionInfo(sessionPrefix, nullptr, false);
+            },
+            FETCH_RETRIES);
+}
+
+void
+ChatDialogBackend::processSessionInfo(const Name& sessionPrefix,
+                                      const shared_ptr<const Data>& data,
+                                      bool isValidated)
+{
+  BackendRoster::iterator it = m_roster.find(sessionPrefix);
+  if (it == m_roster.end())
+    return;
+
+  // a session without a valid info keeps no features, like one of an older version
+  it->second.hasInfo = true;
+  if (data == nullptr)
+    _LOG_DEBUG("Session " << sessionPrefix << " has no info, it is of an older version");
+  else if (!isValidated)
+    _LOG_DEBUG("Cannot validate the info of session " << sessionPrefix);
+  else {
+    try {
+      SessionInfo info(data->getContent().blockFromValue());
+      it->second.features = info.getFeatures();
+      it->second.userNick = info.getNick();
+    }
+    catch (const std::runtime_error& e) {
+      _LOG_DEBUG("Cannot parse the info of session " << sessionPrefix << ": " << e.what());
+    }
+  }
+
+  // the held back data goes by the identity of the session if there is no nick after all
+  std::vector<std::pair<shared_ptr<const Data>, bool>> pendingData;
+  pendingData.swap(it->second.pendingData);
+  for (const auto& pending : pendingData)
+    processChatData(pending.first, true, pending.second);
+}
+
+void
+ChatDialogBackend::offerFileTransfer(const FileManifest& manifest, const std::string& nick)
+{
+  FileTransferInfo info;
+  info.id = m_nextTransferId++;
+  info.nick = QString::fromStdString(nick);
+  info.fileName = QString::fromStdString(manifest.getFileName());
+  info.nReceivedBytes = 0;
+  info.fileSize = manifest.getFileSize();
+
+  // a file over the limit is not even offered
+  if (manifest.getFileSize() > FileFetcher::MAX_FILE_SIZE) {
+    info.state = FileTransferInfo::FAILED;
+    info.error = QString("File is larger than %1 bytes").arg(FileFetcher::MAX_FILE_SIZE);
+    emit fileTransferUpdated(info);
+    return;
+  }
+
+  info.state = FileTransferInfo::OFFERED;
+  FileTransfer& transfer = m_fileTransfers[info.id];
+  transfer.manifest = manifest;
+  transfer.info = info;
+  emit fileTransferUpdated(info);
+}
+
+void
+ChatDialogBackend::startFileTransfer(uint64_t id)
+{
+  std::map<uint64_t, FileTransfer>::iterator it = m_fileTransfers.find(id);
+  if (it == m_fileTransfers.end() || it->second.info.state != FileTransferInfo::OFFERED)
+    return;
+
+  FileTransfer& transfer = it->second;
+  const FileManifest& manifest = transfer.manifest;
+  transfer.info.state = FileTransferInfo::TRANSFERRING;
+
+  // the sender only names the file, it is saved to the download directory of the room
+  fs::path fileName = toPathComponent(manifest.getFileName(), "file");
+
+  fs::path path;
+  try {
+    fs::path downloadDir = fs::path(getenv("HOME")) / ".chronos" / "files" /
+                           toPathComponent(m_chatroomName, "chatroom");
+    fs::create_directories(downloadDir);
+
+    path = downloadDir / fileName;
+    for (int i = 1; fs::exists(path) || fs::exists(path.string() + ".part"); i++)
+      path = downloadDir / (fileName.stem().string() + "-" + std::to_string(i) +
+                            fileName.extension().string());
+    transfer.info.path = QString::fromStdString(path.string());
+
+    transfer.fetcher.reset(new FileFetcher(manifest, path.string(),
+      [this] (const Name& segmentName,
+              const FileFetcher::DataCallback& onData,
+              const FileFetcher::TimeoutCallback& onTimeout) {
+        this->fetchData(segmentName, onData, onTimeout, FETCH_RETRIES);
+      },
+      bind(&ChatDialogBackend::onFileTransferProgress, this, id, _1),
+      bind(&ChatDialogBackend::finishFileTransfer, this, id, FileTransferInfo::DONE, ""),
+      bind(&ChatDialogBackend::finishFileTransfer, this, id, FileTransferInfo::FAILED, _1)));
+  }
+  catch (const std::exception& e) {
+    finishFileTransfer(id, FileTransferInfo::FAILED, e.what());
+    return;
+  }
+
+  transfer.lastReportTime = time::steady_clock::now();
+  emit fileTransferUpdated(transfer.info);
+
+  // the transfer may end right away
+  transfer.fetcher->start();
+}
+
+void
+ChatDialogBackend::onFileTransferProgress(uint64_t id, uint64_t nReceivedBytes)
+{
+  std::map<uint64_t, FileTransfer>::iterator it = m_fileTransfers.find(id);
+  if (it == m_fileTransfers.end())
+    return;
+
+  FileTransfer& transfer = it->second;
+  transfer.info.nReceivedBytes = nReceivedBytes;
+
+  time::steady_clock::TimePoint now = time::steady_clock::now();
+  if (now - transfer.lastReportTime < FILE_PROGRESS_INTERVAL)
+    return;
+
+  transfer.lastReportTime = now;
+  emit fileTransferUpdated(transfer.info);
+}
+
+void
+ChatDialogBackend::finishFileTransfer(uint64_t id, FileTransferInfo::State state,
+                                      const std::string& error)
+{
+  std::map<uint64_t, FileTransfer>::iterator it = m_fileTransfers.find(id);
+  if (it == m_fileTransfers.end())
+    return;
+
+  FileTransferInfo info = it->second.info;
+  info.state = state;
+  if (state == FileTransferInfo::DONE)
+    info.nReceivedBytes = info.fileSize;
+  else
+    info.error = QString::fromStdString(error);
+
+  // this may be called by the fetcher, which is destroyed along with the entry
+  m_fileTransfers.erase(it);
+
+  _LOG_DEBUG("File transfer " << id << " of " << info.fileName.toStdString() <<
+             (state == FileTransferInfo::DONE ? " is done" : " failed: " + error));
+  emit fileTransferUpdated(info);
+}
+
+void
+ChatDialogBackend::onFileInterest(const Interest& interest)
+{
+  shared_ptr<const Data> segment = m_filePublisher.makeSegment(interest.getName());
+  if (segment != nullptr)
+    m_face->put(*segment);
+}
+
+void
+ChatDialogBackend::onDataInterest(const Interest& interest)
+{
+  if (m_sessionInfo != nullptr && interest.getName() == m_sessionInfo->getName()) {
+    m_face->put(*m_sessionInfo);
+    return;
+  }
+
+  if (m_publishCache == nullptr)
+    return;
+
+  shared_ptr<const Data> data = m_publishCache->find(interest.getName());
+  if (data != nullptr)
+    m_face->put(*data);
+}
+
+void
+ChatDialogBackend::signData(Data& data)
+{
+  // same as the socket signs
+  if (m_signingId.empty())
+    m_keyChain.sign(data);
+  else
+    m_keyChain.signByIdentity(data, m_signingId);
+}
+
+void
+ChatDialogBackend::flushHistory()
+{
+  // the cached data also reaches the disk, should the process not exit cleanly
+  if (m_history != nullptr)
+    m_history->flush();
+  if (m_publishCache != nullptr)
+    m_publishCache->flush();
+
+  m_scheduler->scheduleEvent(HISTORY_FLUSH_INTERVAL,
+                             bind(&ChatDialogBackend::flushHistory, this));
+}
+
+void
+ChatDialogBackend::queueMessage(const MessageInfo& info)
+{
+  if (m_pendingMessages == nullptr) {
+    m_pendingMessages = make_shared<std::vector<MessageInfo>>();
+    m_emitMessagesEventId =
+      m_scheduler->scheduleEvent(MESSAGE_BATCH_INTERVAL,
+                                 bind(&ChatDialogBackend::emitMessages, this));
+  }
+
+  m_pendingMessages->push_back(info);
+
+  if (m_pendingMessages->size() >= MAX_MESSAGE_BATCH_SIZE)
+    emitMessages();
+}
+
+void
+ChatDialogBackend::emitMessages()
+{
+  if (m_pendingMessages == nullptr)
+    return;
+
+  if (static_cast<bool>(m_emitMessagesEventId)) {
+    m_scheduler->cancelEvent(m_emitMessagesEventId);
+    m_emitMessagesEventId.reset();
+  }
+
+  // the GUI shares the batch, it must not be touched here any more
+  MessageBatch messages = m_pendingMessages;
+  m_pendingMessages.reset();
+
+  emit messagesReceived(messages);
 }
 
 void
 ChatDialogBackend::sendMsg(ChatMessage& msg)
 {
-  // send msg
-  ndn::Block buf = msg.wireEncode();
+  // the chatroom name is in the sync prefix, and the nick in the SessionInfo
+  if (isSupportedByAll(SessionInfo::FEATURE_COMPACT)) {
+    msg.removeChatroomName();
+    msg.removeNick();
+  }
+
+  // older versions reject messages with elements which they do not know
+  if (isSupportedByAll(SessionInfo::FEATURE_PRECISE_TIMESTAMP))
+    msg.setPreciseTimestamp(time::system_clock::now());
+  if ((msg.getMsgType() == ChatMessage::JOIN || msg.getMsgType() == ChatMessage::HELLO) &&
+      isSupportedByAll(SessionInfo::FEATURE_HELLO_INTERVAL))
+    msg.setHelloInterval(getOwnHelloInterval());
+
+  m_bundler->send(msg, isSupportedByAll(SessionInfo::FEATURE_BUNDLE));
+}
+
+void
+ChatDialogBackend::publishOutgoing(const ChatMessageBundle& outgoing)
+{
+  const std::vector<ChatMessage>& messages = outgoing.getMessages();
+  Block buf = (messages.size() == 1 ? messages.front().wireEncode() :
+                                      outgoing.wireEncode());
+
+  if (m_compressor.isWorthCompressing(buf) &&
+      isSupportedByAll(SessionInfo::FEATURE_COMPRESSION))
+    buf = m_compressor.compress(buf);
+
+  // The data outlives the roster, so its format does not depend on who fetches it.  A
+  // message of the first release is published as is, anything else is versioned content,
+  // which the first release skips.
+  Block content;
+  if (buf.type() == tlv::ChatMessage && ChatContent::isLegacy(messages.front()))
+    content = ChatContent::encodeLegacy(buf);
+  else
+    content = ChatContent::encode(buf);
 
   uint64_t nextSequence = m_sock->getLogic().getSeqNo() + 1;
+  Name sessionName = m_sock->getLogic().getSessionName();
 
-  m_sock->publishData(buf.wire(), buf.size(), FRESHNESS_PERIOD);
+  if (m_publishCache != nullptr) {
+    // the data is made and signed here like the socket would, but kept in the cache
+    // instead of the socket's unbounded in-memory storage
+    Name dataName(sessionName);
+    dataName.appendNumber(nextSequence);
+
+    Data data(dataName);
+    data.setContent(content);
+    data.setFreshnessPeriod(FRESHNESS_PERIOD);
+    signData(data);
+
+    m_publishCache->insert(data);
+    m_sock->getLogic().updateSeqNo(nextSequence);
+  }
+  else {
+    m_sock->publishData(content.value(), content.value_size(), FRESHNESS_PERIOD);
+  }
 
   std::vector<NodeInfo> nodeInfos;
-  Name sessionName = m_sock->getLogic().getSessionName();
-  NodeInfo nodeInfo = {QString::fromStdString(sessionName.toUri()),
-                       nextSequence};
+
+  NodeInfo nodeInfo = {m_ownSessionId, nextSequence};
   nodeInfos.push_back(nodeInfo);
 
   emit syncTreeUpdated(nodeInfos,
                        QString::fromStdString(getHexEncodedDigest(m_sock->getRootDigest())));
 
-  emit messageReceived(QString::fromStdString(sessionName.toUri()),
-                       QString::fromStdString(msg.getNick()),
-                       nextSequence,
-                       msg.getTimestamp(),
-                       msg.getMsgType() == ChatMessage::JOIN);
+  for (size_t i = 0; i < messages.size(); i++) {
+    const ChatMessage& msg = messages[i];
+
+    if (m_history != nullptr)
+      m_history->addMessage(sessionName, nextSequence, msg, true, i, m_nick);
+
+    // own messages are not delayed
+    MessageInfo info;
+    info.sessionId = m_ownSessionId;
+    info.nick = QString::fromStdString(m_nick);
+    info.seqNo = nextSequence;
+    info.timestamp = msg.getTimestamp();
+    info.isChat = (msg.getMsgType() == ChatMessage::CHAT);
+    info.isFile = (msg.getMsgType() == ChatMessage::FILE);
+    if (info.isChat)
+      info.text = QString::fromStdString(msg.getData());
+    else if (info.isFile)
+      info.text = QString::fromStdString(msg.getFileManifest().getFileName());
+    info.isValidated = true;
+    info.addSession = (msg.getMsgType() == ChatMessage::JOIN);
+    info.isJoin = info.addSession;
+    info.receiveTime = time::steady_clock::now();
+
+    queueMessage(info);
+  }
+  emitMessages();
+}
+
+bool
+ChatDialogBackend::isSupportedByAll(SessionInfo::Feature feature) const
+{
+  // nobody has announced anything yet, and whoever shows up may be of an older version
+  if (m_roster.empty())
+    return false;
+
+  for (const auto& user : m_roster) {
+    if ((user.second.features & feature) == 0)
+      return false;
+  }
+  return true;
+}
+
+time::milliseconds
+ChatDialogBackend::getOwnHelloInterval() const
+{
+  // older versions time every session out after three minutes
+  if (!isSupportedByAll(SessionInfo::FEATURE_HELLO_INTERVAL))
+    return HELLO_INTERVAL;
+
+  return std::min<time::milliseconds>(m_helloInterval.getMeanInterval(m_roster.size() + 1),
+                                      MAX_HELLO_INTERVAL);
+}
+
+StringRef
+ChatDialogBackend::getNick(const Name& sessionPrefix, const ChatMessage& msg) const
+{
+  if (msg.hasNick())
+    return msg.getNickView();
+
+  BackendRoster::const_iterator it = m_roster.find(sessionPrefix);
+  return it != m_roster.end() ? StringRef(it->second.userNick) : StringRef();
 }
 
 void
@@ -413,7 +1153,8 @@ ChatDialogBackend::sendJoin()
   prepareControlMessage(msg, ChatMessage::JOIN);
   sendMsg(msg);
 
-  m_helloEventId = m_scheduler->scheduleEvent(HELLO_INTERVAL,
+  time::milliseconds interval = m_helloInterval.getNextInterval(getOwnHelloInterval());
+  m_helloEventId = m_scheduler->scheduleEvent(interval,
                                               bind(&ChatDialogBackend::sendHello, this));
   emit newChatroomForDiscovery(Name::Component(m_chatroomName));
 }
@@ -421,11 +1162,23 @@ ChatDialogBackend::sendJoin()
 void
 ChatDialogBackend::sendHello()
 {
+  time::milliseconds interval = m_helloInterval.getNextInterval(getOwnHelloInterval());
+  time::nanoseconds sinceLastPublish = time::steady_clock::now() -
+                                       m_bundler->getLastPublishTime();
+
+  // any own message keeps the session alive at the others, so a hello is only due one
+  // interval after the last of them
+  if (sinceLastPublish < interval) {
+    m_helloEventId = m_scheduler->scheduleEvent(interval - sinceLastPublish,
+                                                bind(&ChatDialogBackend::sendHello, this));
+    return;
+  }
+
   ChatMessage msg;
   prepareControlMessage(msg, ChatMessage::HELLO);
   sendMsg(msg);
 
-  m_helloEventId = m_scheduler->scheduleEvent(HELLO_INTERVAL,
+  m_helloEventId = m_scheduler->scheduleEvent(interval,
                                               bind(&ChatDialogBackend::sendHello, this));
 }
 
@@ -440,7 +1193,6 @@ ChatDialogBackend::sendLeave()
   emit eraseInRoster(m_routableUserChatPrefix.getPrefix(-2),
                      Name::Component(m_chatroomName));
 
-  usleep(5000);
   m_joined = false;
 }
 
@@ -468,6 +1220,19 @@ ChatDialogBackend::prepareChatMessage(const QString& text,
   msg.setMsgType(ChatMessage::CHAT);
 }
 
+void
+ChatDialogBackend::prepareFileMessage(const FileManifest& manifest,
+                                      ChatMessage &msg)
+{
+  msg.setNick(m_nick);
+  msg.setChatroomName(m_chatroomName);
+  int32_t seconds =
+    static_cast<int32_t>(time::toUnixTimestamp(time::system_clock::now()).count() / 1000);
+  msg.setTimestamp(seconds);
+  msg.setMsgType(ChatMessage::FILE);
+  msg.setFileManifest(manifest);
+}
+
 void
 ChatDialogBackend::updatePrefixes()
 {
@@ -498,13 +1263,65 @@ ChatDialogBackend::getHexEncodedDigest(ndn::ConstBufferPtr digest)
 void
 ChatDialogBackend::sendChatMessage(QString text, time_t timestamp)
 {
-  ChatMessage msg;
-  prepareChatMessage(text, timestamp, msg);
-  sendMsg(msg);
+  m_runtime->post(m_shard, [this, text, timestamp] {
+      if (m_sock == nullptr)
+        return;
+
+      ChatMessage msg;
+      prepareChatMessage(text, timestamp, msg);
+      sendMsg(msg);
+    });
+}
+
+void
+ChatDialogBackend::sendFile(QString path)
+{
+  m_runtime->post(m_shard, [this, path] {
+      if (m_sock == nullptr)
+        return;
+
+      Name filePrefix = m_sock->getLogic().getSessionName();
+      filePrefix.append(FILE_COMPONENT).appendNumber(m_nextFileId++);
+
+      FileManifest manifest;
+      try {
+        manifest = m_filePublisher.addFile(filePrefix, path.toStdString());
+      }
+      catch (const FilePublisher::Error& e) {
+        FileTransferInfo info;
+        info.id = m_nextTransferId++;
+        info.nick = QString::fromStdString(m_nick);
+        info.fileName = path;
+        info.path = path;
+        info.nReceivedBytes = 0;
+        info.fileSize = 0;
+        info.state = FileTransferInfo::FAILED;
+        info.error = QString::fromStdString(e.what());
+        emit fileTransferUpdated(info);
+        return;
+      }
+
+      // receivers fetch the file itself, only the manifest goes through sync
+      ChatMessage msg;
+      prepareFileMessage(manifest, msg);
+      sendMsg(msg);
+    });
+}
+
+void
+ChatDialogBackend::acceptFileTransfer(quint64 id)
+{
+  m_runtime->post(m_shard, [this, id] { startFileTransfer(id); });
+}
 
-  emit chatMessageReceived(QString::fromStdString(msg.getNick()),
-                           QString::fromStdString(msg.getData()),
-                           msg.getTimestamp());
+void
+ChatDialogBackend::declineFileTransfer(quint64 id)
+{
+  m_runtime->post(m_shard, [this, id] {
+      std::map<uint64_t, FileTransfer>::iterator it = m_fileTransfers.find(id);
+      if (it != m_fileTransfers.end() && it->second.info.state == FileTransferInfo::OFFERED)
+        m_fileTransfers.erase(it);
+    });
 }
 
 void
@@ -512,47 +1329,66 @@ ChatDialogBackend::updateRoutingPrefix(const QString& localRoutingPrefix)
 {
   Name newLocalRoutingPrefix(localRoutingPrefix.toStdString());
 
-  if (!newLocalRoutingPrefix.empty() && newLocalRoutingPrefix != m_localRoutingPrefix) {
-    // Update localPrefix
-    m_localRoutingPrefix = newLocalRoutingPrefix;
-
-    {
-      std::lock_guard<std::mutex>lock(m_resumeMutex);
-      m_shouldResume = true;
-    }
+  bool isChanged = false;
+  m_runtime->invoke(m_shard, [&] {
+      isChanged = (!newLocalRoutingPrefix.empty() &&
+                   newLocalRoutingPrefix != m_localRoutingPrefix);
+    });
 
-    exitChatroom();
+  if (!isChanged)
+    return;
 
-    updatePrefixes();
+  exitChatroom();
 
-    m_face->getIoService().stop();
-  }
+  m_runtime->invoke(m_shard, [&] {
+      // Update localPrefix
+      m_localRoutingPrefix = newLocalRoutingPrefix;
+      updatePrefixes();
+
+      // rejoin with the new prefix, unless the forwarder is gone
+      if (m_face != nullptr) {
+        close();
+        try {
+          initializeSync();
+        }
+        catch (const std::runtime_error& e) {
+          onShardError(e);
+        }
+      }
+    });
 }
 
 void
 ChatDialogBackend::shutdown()
 {
-  {
-    std::lock_guard<std::mutex>lock(m_resumeMutex);
-    m_shouldResume = false;
-  }
-
-  {
-    // In this case, we just stop checking the nfd connection and exit
-    std::lock_guard<std::mutex>lock(m_nfdConnectionMutex);
-    m_isNfdConnected = true;
-  }
+  if (!m_isAttached)
+    return;
 
   exitChatroom();
 
-  m_face->getIoService().stop();
+  m_runtime->invoke(m_shard, [this] {
+      if (m_face != nullptr)
+        close();
+      m_sessionWheel.reset();
+      m_bundler.reset();
+      m_scheduler.reset();
+    });
+
+  m_runtime->detach(m_shard, this);
+  m_isAttached = false;
 }
 
 void
 ChatDialogBackend::onNfdReconnect()
 {
-  std::lock_guard<std::mutex>lock(m_nfdConnectionMutex);
-  m_isNfdConnected = true;
+  m_runtime->post(m_shard, [this] {
+      if (!m_hasFailed)
+        return;
+
+      m_hasFailed = false;
+      initializeSync();
+      emit refreshChatDialog(m_routableUserChatPrefix);
+    });
 }
 
 } // namespace chronochat
@@ -11,39 +11,105 @@
 #ifndef CHRONOCHAT_CHAT_DIALOG_BACKEND_HPP
 #define CHRONOCHAT_CHAT_DIALOG_BACKEND_HPP
 
-#include <QThread>
+#include <QObject>
 
 #ifndef Q_MOC_RUN
 #include "common.hpp"
 #include "chatroom-info.hpp"
 #include "chat-message.hpp"
-#include <mutex>
+#include "chat-message-bundle.hpp"
+#include "chat-content.hpp"
+#include "message-bundler.hpp"
+#include "session-info.hpp"
+#include "backfill-fetcher.hpp"
+#include "file-fetcher.hpp"
+#include "file-publisher.hpp"
+#include "chat-history-storage.hpp"
+#include "publish-cache.hpp"
+#include "hello-interval.hpp"
+#include "payload-compressor.hpp"
+#include "latency-histogram.hpp"
+#include "sync-runtime.hpp"
+#include "timing-wheel.hpp"
+#include "session-table.hpp"
+#include <ndn-cxx/security/key-chain.hpp>
 #include <socket.hpp>
-#include <boost/thread.hpp>
+#include <set>
 #endif
 
 namespace chronochat {
 
 class NodeInfo {
 public:
-  QString sessionPrefix;
+  SessionId sessionId;
   chronosync::SeqNo seqNo;
 };
 
-class UserInfo {
+class MessageInfo {
+public:
+  SessionId sessionId;
+  QString nick;
+  QString text;                          // empty unless isChat
+  uint64_t seqNo;
+  time_t timestamp;
+  bool isChat;                           // true if text should be displayed
+  bool isFile;                           // true if text is the name of a shared file
+  bool isValidated;
+  bool addSession;                       // true for the first message of a session
+  bool isJoin;                           // true if the message is the JOIN of the session
+  time::steady_clock::TimePoint receiveTime; // when the backend got the message
+};
+
+// received messages are handed to the GUI in batches, which are never modified
+typedef shared_ptr<const std::vector<MessageInfo>> MessageBatch;
+
+class FileTransferInfo {
+public:
+  enum State {
+    OFFERED,                             // waits for the user to accept or decline it
+    TRANSFERRING,
+    DONE,
+    FAILED,
+  };
+
+  uint64_t id;                           // of the transfer, unique within the chatroom
+  QString nick;                          // of the sender
+  QString fileName;
+  QString path;                          // where the file is saved, empty while OFFERED
+  uint64_t nReceivedBytes;
+  uint64_t fileSize;
+  State state;
+  QString error;                         // empty unless FAILED
+};
+
+// the entry times the session out unless it is heard from
+class UserInfo : public TimingWheel<UserInfo>::Entry {
 public:
   ndn::Name sessionPrefix;
-  bool hasNick;
-  std::string userNick;
-  ndn::EventId timeoutEventId;
+  SessionId sessionId;
+  bool hasNick;                          // true once the session has been heard from
+  std::string userNick;                  // from its SessionInfo, or as older versions announce
+  bool hasInfo;                          // true once its SessionInfo is fetched or missing
+  // chat data which does not name its sender, and the data after it, wait for the info
+  std::vector<std::pair<shared_ptr<const Data>, bool>> pendingData; // and isValidated
+  uint64_t liveSeqNo;                    // announced alone while in the room, 0 if none
+  uint64_t features;                     // SessionInfo::Feature flags, none until hasInfo
+  time::milliseconds helloInterval;      // mean, as announced by the session or the legacy one
 };
 
-class ChatDialogBackend : public QThread
+/**
+ * @brief Backend of one chatroom
+ *
+ * The backend lives on a shard of the SyncRuntime.  Its sync state is only touched on the
+ * shard thread, the public slots are called from the GUI thread and hand over to the shard.
+ */
+class ChatDialogBackend : public QObject, public SyncRuntime::Client
 {
   Q_OBJECT
 
 public:
-  ChatDialogBackend(const Name& chatroomPrefix,
+  ChatDialogBackend(const shared_ptr<SyncRuntime>& runtime,
+                    const Name& chatroomPrefix,
                     const Name& userChatPrefix,
                     const Name& routingPrefix,
                     const std::string& chatroomName,
@@ -53,17 +119,46 @@ public:
 
   ~ChatDialogBackend();
 
-protected:
+  /// @brief attach to the runtime and join the chatroom
   void
-  run();
+  start();
+
+  /// @brief get the latency from publishing remote messages until they are received here
+  LatencyHistogram
+  getReceiveLatency();
+
+  /// @brief get the names of the session IDs in the signals
+  const SessionTable&
+  getSessionTable() const
+  {
+    return m_sessions;
+  }
+
+  /// @brief get the latency from receiving messages until they are shown, GUI thread only
+  const LatencyHistogram&
+  getDisplayLatency() const
+  {
+    return m_displayLatency;
+  }
+
+  /// @brief count the display latency of one message, GUI thread only
+  void
+  recordDisplayLatency(const time::nanoseconds& latency)
+  {
+    m_displayLatency.record(latency);
+  }
+
+  /// @brief get the anchor which the chatrooms trust, nullptr if it cannot be loaded
+  static shared_ptr<ndn::IdentityCertificate>
+  loadTrustAnchor();
 
 private:
+  virtual void
+  onShardError(const std::runtime_error& e);
+
   void
   initializeSync();
 
-  shared_ptr<ndn::IdentityCertificate>
-  loadTrustAnchor();
-
   void
   exitChatroom();
 
@@ -73,17 +168,110 @@ private:
   void
   processSyncUpdate(const std::vector<chronosync::MissingDataInfo>& updates);
 
+  void
+  fetchChatData(const Name& sessionPrefix, uint64_t seqNo,
+                const BackfillFetcher::DataCallback& onData,
+                const BackfillFetcher::TimeoutCallback& onTimeout,
+                int nRetries);
+
+  void
+  fetchData(const Name& dataName,
+            const BackfillFetcher::DataCallback& onData,
+            const BackfillFetcher::TimeoutCallback& onTimeout,
+            int nRetries);
+
+  void
+  validateChatData(const shared_ptr<const Data>& data,
+                   const BackfillFetcher::DataCallback& onData);
+
+  void
+  validateChatDataWithFetch(const shared_ptr<const Data>& data,
+                            const BackfillFetcher::DataCallback& onData);
+
   void
   processChatData(const ndn::shared_ptr<const ndn::Data>& data,
                   bool needDisplay,
                   bool isValidated);
 
   void
-  remoteSessionTimeout(const Name& sessionPrefix);
+  processChatMessage(const Name& remoteSessionPrefix, uint64_t seqNo, const ChatMessage& msg,
+                     bool needDisplay, bool isValidated);
+
+  void
+  remoteSessionsTimeout(const std::vector<UserInfo*>& sessions);
+
+  /// @brief make the SessionInfo of the own session, which the others fetch
+  void
+  publishSessionInfo();
+
+  /// @brief fetch the SessionInfo of a remote session, older versions have none
+  void
+  fetchSessionInfo(const Name& sessionPrefix);
+
+  /// @brief learn the features of a remote session, @p data is nullptr if there is no info
+  void
+  processSessionInfo(const Name& sessionPrefix, const shared_ptr<const Data>& data,
+                     bool isValidated);
+
+  /// @brief offer the file shared by a remote session to the user
+  void
+  offerFileTransfer(const FileManifest& manifest, const std::string& nick);
+
+  /// @brief fetch the file of the offered transfer @p id into the download directory
+  void
+  startFileTransfer(uint64_t id);
 
+  void
+  onFileTransferProgress(uint64_t id, uint64_t nReceivedBytes);
+
+  void
+  finishFileTransfer(uint64_t id, FileTransferInfo::State state,
+                     const std::string& error = "");
+
+  void
+  onFileInterest(const Interest& interest);
+
+  /// @brief answer an Interest for own chat data or info, of this or an earlier session
+  void
+  onDataInterest(const Interest& interest);
+
+  void
+  signData(Data& data);
+
+  void
+  flushHistory();
+
+  void
+  queueMessage(const MessageInfo& info);
+
+  void
+  emitMessages();
+
+  /// @brief send @p msg, chat messages may be held back to be bundled with the next ones
   void
   sendMsg(ChatMessage& msg);
 
+  /// @brief publish own messages as the data of the next sequence number
+  void
+  publishOutgoing(const ChatMessageBundle& outgoing);
+
+  /// @brief true if the roster is not empty and every session in it has announced @p feature
+  bool
+  isSupportedByAll(SessionInfo::Feature feature) const;
+
+  /**
+   * @brief get the mean interval of own hellos, which grows with the roster
+   *
+   * The interval stays at the legacy minute unless every session times us out by the
+   * interval we announce.
+   */
+  time::milliseconds
+  getOwnHelloInterval() const;
+
+  /// @brief get the nick of the sender of @p msg, which compact messages do not carry
+  StringRef
+  getNick(const Name& sessionPrefix, const ChatMessage& msg) const;
+
   void
   sendJoin();
 
@@ -102,6 +290,10 @@ private:
                      time_t timestamp,
                      ChatMessage &msg);
 
+  void
+  prepareFileMessage(const FileManifest& manifest,
+                     ChatMessage &msg);
+
   void
   updatePrefixes();
 
@@ -112,15 +304,18 @@ signals:
   void
   syncTreeUpdated(std::vector<chronochat::NodeInfo> updates, QString digest);
 
+  /**
+   * @param isLeave true if the session has sent LEAVE as @p seqNo, false if it has timed out
+   */
   void
-  chatMessageReceived(QString nick, QString text, time_t timestamp);
+  sessionRemoved(chronochat::SessionId sessionId, QString nick, time_t timestamp,
+                 bool isLeave, uint64_t seqNo);
 
   void
-  sessionRemoved(QString sessionPrefix, QString nick, time_t timestamp);
+  messagesReceived(chronochat::MessageBatch messages);
 
   void
-  messageReceived(QString sessionPrefix, QString nick, uint64_t seqNo, time_t timestamp,
-                  bool addSession);
+  fileTransferUpdated(chronochat::FileTransferInfo info);
 
   void
   chatPrefixChanged(ndn::Name newChatPrefix);
@@ -128,6 +323,10 @@ signals:
   void
   refreshChatDialog(ndn::Name chatPrefix);
 
+  /// @brief own sync session @p sessionId is closed, a reconnect starts a new one
+  void
+  sessionClosed(chronochat::SessionId sessionId);
+
   void
   eraseInRoster(ndn::Name sessionPrefix, ndn::Name::Component chatroomName);
 
@@ -144,6 +343,18 @@ public slots:
   void
   sendChatMessage(QString text, time_t timestamp);
 
+  /// @brief share the file at @p path with the chatroom
+  void
+  sendFile(QString path);
+
+  /// @brief download the file of the offered transfer @p id
+  void
+  acceptFileTransfer(quint64 id);
+
+  /// @brief forget the offered transfer @p id
+  void
+  declineFileTransfer(quint64 id);
+
   void
   updateRoutingPrefix(const QString& localRoutingPrefix);
 
@@ -156,9 +367,15 @@ public slots:
 private:
   typedef std::map<ndn::Name, UserInfo> BackendRoster;
 
-  bool m_shouldResume;
-  bool m_isNfdConnected;
-  shared_ptr<ndn::Face> m_face;
+  shared_ptr<SyncRuntime> m_runtime;
+  size_t m_shard;                        // shard of m_runtime this room runs on
+  bool m_isAttached;                     // accessed by GUI thread only
+
+  bool m_hasFailed;                      // true if waiting for the forwarder to come back
+  shared_ptr<bool> m_activeToken;        // expires when the sync session is closed
+  shared_ptr<ndn::Face> m_face;         // shares the connection of the shard
+  const ndn::InterestFilterId* m_dataFilterId; // own chat data, of the current session
+  const ndn::InterestFilterId* m_fileFilterId; // own shared files, likewise
 
   Name m_localRoutingPrefix;             // routable local prefix
   Name m_chatroomPrefix;                 // chatroom sync prefix
@@ -169,18 +386,46 @@ private:
   std::string m_nick;                    // user nick
 
   Name m_signingId;                      // signing identity
-  shared_ptr<ndn::Validator> m_validator;// validator
+  shared_ptr<ndn::Validator> m_validator;// validator which can fetch certificates
+  ValidationPool* m_validationPool;      // verifies chat data off the sync thread
   shared_ptr<chronosync::Socket> m_sock; // SyncSocket
 
   unique_ptr<ndn::Scheduler> m_scheduler;// scheduler
   ndn::EventId m_helloEventId;           // event id of timeout
+  HelloInterval m_helloInterval;         // scales with the roster
+  unique_ptr<MessageBundler> m_bundler; // own messages, held back ones survive reconnects
+  PayloadCompressor m_compressor;
+  ndn::KeyChain m_keyChain;              // signs the segments of shared files
+  FilePublisher m_filePublisher;         // own shared files of this sync session
+  uint64_t m_nextFileId;
+  unique_ptr<TimingWheel<UserInfo>> m_sessionWheel; // timeouts of remote sessions
 
   bool m_joined;                         // true if in a chatroom
 
-  BackendRoster m_roster;                // User roster
-
-  std::mutex m_resumeMutex;
-  std::mutex m_nfdConnectionMutex;
+  BackendRoster m_roster;                // User roster, kept across reconnects
+  SessionTable m_sessions;               // IDs of the sessions in the signals
+  SessionId m_ownSessionId;              // of the current own sync session
+  std::set<Name> m_ownSessions;          // own earlier sync sessions
+  BackfillFetcher m_backfill;            // fetcher of missing chat data
+  unique_ptr<ChatHistoryStorage> m_history; // persistent message log
+  unique_ptr<PublishCache> m_publishCache; // own chat data, nullptr if it cannot be stored
+  shared_ptr<Data> m_sessionInfo;        // of the current own sync session
+
+  struct FileTransfer
+  {
+    FileManifest manifest;
+    unique_ptr<FileFetcher> fetcher;     // nullptr while OFFERED
+    FileTransferInfo info;
+    time::steady_clock::TimePoint lastReportTime; // of the progress to the GUI
+  };
+  std::map<uint64_t, FileTransfer> m_fileTransfers; // offers and downloads of remote files
+  uint64_t m_nextTransferId;
+
+  shared_ptr<std::vector<MessageInfo>> m_pendingMessages; // messages not sent to GUI yet
+  ndn::EventId m_emitMessagesEventId;
+
+  LatencyHistogram m_receiveLatency;     // of live remote messages with a precise timestamp
+  LatencyHistogram m_displayLatency;     // accessed by GUI thread only
 };
 
 } // namespace chronochat
@@ -16,6 +16,7 @@
 #include <QScrollBar>
 #include <QMessageBox>
 #include <QCloseEvent>
+#include <QFileDialog>
 
 Q_DECLARE_METATYPE(ndn::Name)
 Q_DECLARE_METATYPE(time_t)
@@ -25,10 +26,13 @@ Q_DECLARE_METATYPE(uint64_t)
 namespace chronochat {
 
 static const Name PRIVATE_PREFIX("/private/local");
+// the views are fitted to the scenes at most once per frame
+static const int REFRESH_INTERVAL = 1000 / 30;
 static const ndn::Name::Component ROUTING_HINT_SEPARATOR =
   ndn::name::Component::fromEscapedString("%F0%2E");
 
-ChatDialog::ChatDialog(const Name& chatroomPrefix,
+ChatDialog::ChatDialog(const shared_ptr<SyncRuntime>& runtime,
+                       const Name& chatroomPrefix,
                        const Name& userChatPrefix,
                        const Name& routingPrefix,
                        const std::string& chatroomName,
@@ -38,21 +42,37 @@ ChatDialog::ChatDialog(const Name& chatroomPrefix,
                        QWidget* parent)
   : QDialog(parent)
   , ui(new Ui::ChatDialog)
-  , m_backend(chatroomPrefix, userChatPrefix, routingPrefix, chatroomName, nick, signingId)
+  , m_backend(runtime, chatroomPrefix, userChatPrefix, routingPrefix, chatroomName, nick,
+              signingId)
   , m_chatroomName(chatroomName)
   , m_chatroomPrefix(chatroomPrefix)
   , m_nick(nick.c_str())
   , m_isSecured(isSecured)
+  , m_transcript(nullptr)
+  , m_isSyncTreeDirty(false)
+  , m_isTrustTreeDirty(false)
 {
   qRegisterMetaType<ndn::Name>("ndn::Name");
   qRegisterMetaType<time_t>("time_t");
   qRegisterMetaType<std::vector<chronochat::NodeInfo> >("std::vector<chronochat::NodeInfo>");
   qRegisterMetaType<uint64_t>("uint64_t");
+  qRegisterMetaType<chronochat::MessageBatch>("chronochat::MessageBatch");
+  qRegisterMetaType<chronochat::FileTransferInfo>("chronochat::FileTransferInfo");
+  qRegisterMetaType<chronochat::SessionId>("chronochat::SessionId");
 
   m_scene = new DigestTreeScene(this);
   m_trustScene = new TrustTreeScene(this);
   m_rosterModel = new QStringListModel(this);
 
+  m_refreshTimer = new QTimer(this);
+  m_refreshTimer->setSingleShot(true);
+  m_refreshTimer->setInterval(REFRESH_INTERVAL);
+  connect(m_refreshTimer, SIGNAL(timeout()),
+          this, SLOT(refreshView()));
+  m_refreshCounters.nRequested = 0;
+  m_refreshCounters.nPerformed = 0;
+  m_refreshCounters.nSkipped = 0;
+
   ui->setupUi(this);
 
   ui->syncTreeViewer->setScene(m_scene);
@@ -64,6 +84,7 @@ ChatDialog::ChatDialog(const Name& chatroomPrefix,
   ui->trustTreeViewer->hide();
 
   ui->listView->setModel(m_rosterModel);
+  ui->transferLabel->hide();
 
   Name routablePrefix;
 
@@ -86,17 +107,16 @@ ChatDialog::ChatDialog(const Name& chatroomPrefix,
   connect(&m_backend, SIGNAL(syncTreeUpdated(std::vector<chronochat::NodeInfo>, QString)),
           this,       SLOT(updateSyncTree(std::vector<chronochat::NodeInfo>, QString)));
 
-  // When backend receives a new chat message, notify frontent to print it out.
-  connect(&m_backend, SIGNAL(chatMessageReceived(QString, QString, time_t)),
-          this,       SLOT(receiveChatMessage(QString, QString, time_t)));
+  // When backend receives new messages, notify frontend to print them and
+  // plot notifications.
+  connect(&m_backend, SIGNAL(messagesReceived(chronochat::MessageBatch)),
+          this,       SLOT(receiveMessages(chronochat::MessageBatch)));
 
   // When backend detects a deleted session, notify frontend to print the message.
-  connect(&m_backend, SIGNAL(sessionRemoved(QString, QString, time_t)),
-          this,       SLOT(removeSession(QString, QString, time_t)));
-
-  // When backend receives a new message, notify frontend to print notification
-  connect(&m_backend, SIGNAL(messageReceived(QString, QString, uint64_t, time_t, bool)),
-          this,       SLOT(receiveMessage(QString, QString, uint64_t, time_t, bool)));
+  connect(&m_backend,
+          SIGNAL(sessionRemoved(chronochat::SessionId, QString, time_t, bool, uint64_t)),
+          this,
+          SLOT(removeSession(chronochat::SessionId, QString, time_t, bool, uint64_t)));
 
   // When backend updates prefix, notify frontend to update labels.
   connect(&m_backend, SIGNAL(chatPrefixChanged(ndn::Name)),
@@ -105,10 +125,28 @@ ChatDialog::ChatDialog(const Name& chatroomPrefix,
   connect(&m_backend, SIGNAL(refreshChatDialog(ndn::Name)),
           this,       SLOT(updateLabels(ndn::Name)));
 
+  // When backend replaces its sync session, notify frontend to drop the old node.
+  connect(&m_backend, SIGNAL(sessionClosed(chronochat::SessionId)),
+          this,       SLOT(closeSession(chronochat::SessionId)));
+
+  // When backend makes progress with a file, notify frontend to show it.
+  connect(&m_backend, SIGNAL(fileTransferUpdated(chronochat::FileTransferInfo)),
+          this,       SLOT(updateFileTransfer(chronochat::FileTransferInfo)));
+
   // When frontend gets a message to send, notify backend.
   connect(this,       SIGNAL(msgToSent(QString, time_t)),
           &m_backend, SLOT(sendChatMessage(QString, time_t)));
 
+  // When frontend gets a file to send, notify backend.
+  connect(this,       SIGNAL(fileToSent(QString)),
+          &m_backend, SLOT(sendFile(QString)));
+
+  // When the user answers a file offer, notify backend.
+  connect(this,       SIGNAL(fileTransferAccepted(quint64)),
+          &m_backend, SLOT(acceptFileTransfer(quint64)));
+  connect(this,       SIGNAL(fileTransferDeclined(quint64)),
+          &m_backend, SLOT(declineFileTransfer(quint64)));
+
   // When frontend gets a shutdown command, notify backend.
   connect(this,       SIGNAL(shutdownBackend()),
           &m_backend, SLOT(shutdown()));
@@ -117,6 +155,8 @@ ChatDialog::ChatDialog(const Name& chatroomPrefix,
 
   connect(ui->lineEdit, SIGNAL(returnPressed()),
           this, SLOT(onReturnPressed()));
+  connect(ui->fileButton, SIGNAL(pressed()),
+          this, SLOT(onFileButtonPressed()));
   connect(ui->syncTreeButton, SIGNAL(pressed()),
           this, SLOT(onSyncTreeButtonPressed()));
   connect(ui->trustTreeButton, SIGNAL(pressed()),
@@ -125,6 +165,25 @@ ChatDialog::ChatDialog(const Name& chatroomPrefix,
   disableSyncTreeDisplay();
   QTimer::singleShot(2200, this, SLOT(enableSyncTreeDisplay()));
 
+  // Show the latest page of the history, older pages are loaded when the user scrolls up.
+  try {
+    m_history.reset(new ChatHistoryStorage(userChatPrefix));
+  }
+  catch (ChatHistoryStorage::Error& e) {
+    m_history.reset();
+  }
+
+  m_transcript = new TranscriptModel(m_history.get(), &m_backend.getSessionTable(),
+                                     TranscriptModel::DEFAULT_MAX_ROWS,
+                                     TranscriptModel::DEFAULT_PAGE_SIZE, this);
+  ui->transcriptView->setModel(m_transcript);
+  ui->transcriptView->setItemDelegate(new TranscriptDelegate(ui->transcriptView));
+  m_transcript->fetchOlder();
+  ui->transcriptView->scrollToBottom();
+
+  connect(ui->transcriptView->verticalScrollBar(), SIGNAL(valueChanged(int)),
+          this, SLOT(onScrollBarValueChanged(int)));
+
   m_backend.start();
 }
 
@@ -156,6 +215,11 @@ ChatDialog::changeEvent(QEvent *e)
       emit resetIcon();
     }
     break;
+  case QEvent::WindowStateChange:
+    // the scenes which changed while minimized are fitted now
+    if (!isMinimized() && (m_isSyncTreeDirty || m_isTrustTreeDirty))
+      m_refreshTimer->start();
+    break;
   default:
     break;
   }
@@ -178,10 +242,10 @@ ChatDialog::getChatroomInfo()
 {
   ChatroomInfo chatroomInfo;
   chatroomInfo.setName(Name::Component(m_chatroomName));
-  QStringList prefixList = m_scene->getRosterPrefixList();
-  for(QStringList::iterator it = prefixList.begin();
-      it != prefixList.end(); ++it ) {
-    Name participant = Name(it->toStdString()).getPrefix(-3);
+  const SessionTable& sessions = m_backend.getSessionTable();
+  QList<SessionId> sessionIds = m_scene->getRosterSessionIds();
+  for (QList<SessionId>::iterator it = sessionIds.begin(); it != sessionIds.end(); ++it) {
+    Name participant = sessions.getName(*it).getPrefix(-3);
     chatroomInfo.addParticipant(participant);
   }
 
@@ -201,85 +265,46 @@ void ChatDialog::disableSyncTreeDisplay()
   fitView();
 }
 
-void
-ChatDialog::appendChatMessage(const QString& nick, const QString& text, time_t timestamp)
-{
-  QTextCharFormat nickFormat;
-  nickFormat.setForeground(Qt::darkGreen);
-  nickFormat.setFontWeight(QFont::Bold);
-  nickFormat.setFontUnderline(true);
-  nickFormat.setUnderlineColor(Qt::gray);
-
-  // Print who & when
-  QTextCursor cursor(ui->textEdit->textCursor());
-  cursor.movePosition(QTextCursor::End);
-  QTextTableFormat tableFormat;
-  tableFormat.setBorder(0);
-  QTextTable *table = cursor.insertTable(1, 2, tableFormat);
-  QString from = QString("%1 ").arg(nick);
-  QTextTableCell fromCell = table->cellAt(0, 0);
-  fromCell.setFormat(nickFormat);
-  fromCell.firstCursorPosition().insertText(from);
-  printTimeInCell(table, timestamp);
-
-  // Print what
-  QTextCursor nextCursor(ui->textEdit->textCursor());
-  nextCursor.movePosition(QTextCursor::End);
-  table = nextCursor.insertTable(1, 1, tableFormat);
-  table->cellAt(0, 0).firstCursorPosition().insertText(text);
-
-  // Popup notification
-  showMessage(from, text);
-
-  QScrollBar *bar = ui->textEdit->verticalScrollBar();
-  bar->setValue(bar->maximum());
-}
-
 void
 ChatDialog::appendControlMessage(const QString& nick,
                                  const QString& action,
-                                 time_t timestamp)
+                                 time_t timestamp,
+                                 SessionId sessionId,
+                                 uint64_t seqNo)
 {
-  QTextCharFormat nickFormat;
-  nickFormat.setForeground(Qt::gray);
-  nickFormat.setFontWeight(QFont::Bold);
-  nickFormat.setFontUnderline(true);
-  nickFormat.setUnderlineColor(Qt::gray);
-
-  QTextCursor cursor(ui->textEdit->textCursor());
-  cursor.movePosition(QTextCursor::End);
-  QTextTableFormat tableFormat;
-  tableFormat.setBorder(0);
-  QTextTable *table = cursor.insertTable(1, 2, tableFormat);
-
-  QString controlMsg = QString("%1 %2  ").arg(nick).arg(action);
-  QTextTableCell fromCell = table->cellAt(0, 0);
-  fromCell.setFormat(nickFormat);
-  fromCell.firstCursorPosition().insertText(controlMsg);
-  printTimeInCell(table, timestamp);
+  TranscriptRow row;
+  row.type = TranscriptRow::CONTROL;
+  row.nick = nick;
+  row.text = action;
+  row.timestamp = timestamp;
+  row.sessionId = sessionId;
+  row.seqNo = seqNo;
+  m_transcript->appendRows(std::vector<TranscriptRow>(1, row));
 }
 
-QString
-ChatDialog::formatTime(time_t timestamp)
+void
+ChatDialog::loadOlderMessages()
 {
-  struct tm* localTime = localtime(&timestamp);
+  size_t nRows = m_transcript->fetchOlder();
+  if (nRows == 0)
+    return;
 
-  return QString("%1:%2:%3")
-           .arg(localTime->tm_hour, 2, 10, QChar('0'))
-           .arg(localTime->tm_min, 2, 10, QChar('0'))
-           .arg(localTime->tm_sec, 2, 10, QChar('0'));
+  // Keep the row which was on top, so the view does not jump.
+  ui->transcriptView->scrollTo(m_transcript->index(nRows), QAbstractItemView::PositionAtTop);
 }
 
 void
-ChatDialog::printTimeInCell(QTextTable *table, time_t timestamp)
+ChatDialog::loadNewerMessages()
 {
-  QTextCharFormat timeFormat;
-  timeFormat.setForeground(Qt::gray);
-  timeFormat.setFontUnderline(true);
-  timeFormat.setUnderlineColor(Qt::gray);
-  QTextTableCell timeCell = table->cellAt(0, 1);
-  timeCell.setFormat(timeFormat);
-  timeCell.firstCursorPosition().insertText(formatTime(timestamp));
+  int lastRow = m_transcript->rowCount() - 1;
+  size_t nRemoved = 0;
+  size_t nRows = m_transcript->fetchNewer(nRemoved);
+  if (nRows == 0 && nRemoved == 0)
+    return;
+
+  // Keep the row which was at the bottom, so the view does not jump.
+  ui->transcriptView->scrollTo(m_transcript->index(lastRow - static_cast<int>(nRemoved)),
+                               QAbstractItemView::PositionAtBottom);
 }
 
 void
@@ -293,13 +318,52 @@ ChatDialog::showMessage(const QString& from, const QString& data)
 void
 ChatDialog::fitView()
 {
-  QRectF rect = m_scene->itemsBoundingRect();
-  m_scene->setSceneRect(rect);
-  ui->syncTreeViewer->fitInView(m_scene->itemsBoundingRect(), Qt::KeepAspectRatio);
+  m_refreshCounters.nRequested++;
+  m_isSyncTreeDirty = true;
+  m_isTrustTreeDirty = true;
 
-  QRectF trustRect = m_trustScene->itemsBoundingRect();
-  m_trustScene->setSceneRect(trustRect);
-  ui->trustTreeViewer->fitInView(m_trustScene->itemsBoundingRect(), Qt::KeepAspectRatio);
+  // the requests until the timer fires are coalesced
+  if (!m_refreshTimer->isActive())
+    m_refreshTimer->start();
+}
+
+bool
+ChatDialog::fitScene(QGraphicsScene* scene, QGraphicsView* viewer, bool& isDirty,
+                     bool isVisible)
+{
+  if (!isDirty)
+    return false;
+
+  if (!isVisible || viewer->isHidden()) {
+    m_refreshCounters.nSkipped++;
+    return false;
+  }
+
+  QRectF rect = scene->itemsBoundingRect();
+  scene->setSceneRect(rect);
+  viewer->fitInView(rect, Qt::KeepAspectRatio);
+  isDirty = false;
+  m_refreshCounters.nPerformed++;
+  return true;
+}
+
+void
+ChatDialog::updateTransferLabel()
+{
+  if (m_fileTransfers.empty()) {
+    ui->transferLabel->hide();
+    return;
+  }
+
+  QStringList lines;
+  for (const auto& transfer : m_fileTransfers) {
+    const FileTransferInfo& info = transfer.second;
+    int percent = info.fileSize == 0 ? 100 :
+                  static_cast<int>(info.nReceivedBytes * 100 / info.fileSize);
+    lines << QString("Receiving %1 from %2: %3%").arg(info.fileName).arg(info.nick).arg(percent);
+  }
+  ui->transferLabel->setText(lines.join("\n"));
+  ui->transferLabel->show();
 }
 
 // public slots:
@@ -314,10 +378,8 @@ ChatDialog::onShow()
 void
 ChatDialog::shutdown()
 {
-  if (m_backend.isRunning()) {
-    emit shutdownBackend();
-    m_backend.wait();
-  }
+  // the backend leaves the chatroom before this returns
+  emit shutdownBackend();
   hide();
   emit closeChatDialog(QString::fromStdString(m_chatroomName));
 }
@@ -330,40 +392,159 @@ ChatDialog::updateSyncTree(std::vector<chronochat::NodeInfo> updates, QString ro
 }
 
 void
-ChatDialog::receiveChatMessage(QString nick, QString text, time_t timestamp)
+ChatDialog::removeSession(chronochat::SessionId sessionId, QString nick, time_t timestamp,
+                          bool isLeave, uint64_t seqNo)
 {
-  appendChatMessage(nick, text, timestamp);
+  // a timeout is not in the history
+  if (isLeave)
+    appendControlMessage(nick, "leaves room", timestamp, sessionId, seqNo);
+  else
+    appendControlMessage(nick, "leaves room", timestamp);
+  m_scene->removeNode(sessionId);
+  m_rosterModel->setStringList(m_scene->getRosterList());
+  fitView();
 }
 
 void
-ChatDialog::removeSession(QString sessionPrefix, QString nick, time_t timestamp)
+ChatDialog::closeSession(chronochat::SessionId sessionId)
 {
-  appendControlMessage(nick, "leaves room", timestamp);
-  m_scene->removeNode(sessionPrefix);
+  // the other sessions survive a reconnect, as does the transcript
+  m_scene->removeNode(sessionId);
   m_rosterModel->setStringList(m_scene->getRosterList());
   fitView();
 }
 
 void
-ChatDialog::receiveMessage(QString sessionPrefix, QString nick, uint64_t seqNo, time_t timestamp,
-                           bool addSession)
+ChatDialog::receiveMessages(chronochat::MessageBatch messages)
 {
-  m_scene->updateNode(sessionPrefix, nick, seqNo);
-  m_scene->messageReceived(sessionPrefix);
-  if (addSession) {
-    appendControlMessage(nick, "enters room", timestamp);
+  // Append the whole batch in one model update.
+  std::vector<TranscriptRow> rows;
+  bool isRosterChanged = false;
+  const MessageInfo* lastChat = nullptr;
+  for (const auto& message : *messages) {
+    TranscriptRow row;
+    row.nick = message.isValidated ? message.nick : message.nick + " (Unverified)";
+    row.timestamp = message.timestamp;
+    if (message.addSession) {
+      TranscriptRow joinRow = row;
+      joinRow.type = TranscriptRow::CONTROL;
+      joinRow.nick = message.nick;
+      joinRow.text = "enters room";
+      // the first message of a session which has joined before is not a JOIN in the history
+      if (message.isJoin) {
+        joinRow.sessionId = message.sessionId;
+        joinRow.seqNo = message.seqNo;
+      }
+      rows.push_back(joinRow);
+      isRosterChanged = true;
+    }
+
+    // the rows of messages are identified like their history entries
+    row.sessionId = message.sessionId;
+    row.seqNo = message.seqNo;
+    if (message.isChat) {
+      row.type = TranscriptRow::CHAT;
+      row.text = message.text;
+      rows.push_back(row);
+      lastChat = &message;
+    }
+    if (message.isFile) {
+      row.type = TranscriptRow::CONTROL;
+      row.text = "shares file " + message.text;
+      rows.push_back(row);
+    }
+  }
+  m_transcript->appendRows(rows);
+
+  if (lastChat != nullptr) {
+    // Popup notification
+    showMessage(QString("%1 ").arg(lastChat->nick), lastChat->text);
+
+    if (!m_transcript->isDetached())
+      ui->transcriptView->scrollToBottom();
+  }
+
+  m_scene->updateNodes(*messages);
+  if (isRosterChanged)
     m_rosterModel->setStringList(m_scene->getRosterList());
+  fitView();
+
+  // the chat messages are on the screen now
+  time::steady_clock::TimePoint now = time::steady_clock::now();
+  for (const auto& message : *messages) {
+    if (message.isChat)
+      m_backend.recordDisplayLatency(now - message.receiveTime);
   }
+}
+
+void
+ChatDialog::updateFileTransfer(chronochat::FileTransferInfo info)
+{
+  time_t timestamp =
+    static_cast<time_t>(time::toUnixTimestamp(time::system_clock::now()).count() / 1000);
+
+  switch (info.state) {
+  case FileTransferInfo::OFFERED:
+    {
+      // the question does not block the dialog, more offers may come meanwhile
+      QMessageBox* box =
+        new QMessageBox(QMessageBox::Question, tr("ChronoChat"),
+                        QString("%1 shares %2 (%3 bytes). Download it?")
+                          .arg(info.nick).arg(info.fileName).arg(info.fileSize),
+                        QMessageBox::Yes | QMessageBox::No, this);
+      box->setAttribute(Qt::WA_DeleteOnClose);
+      box->setProperty("transferId", QVariant(static_cast<qulonglong>(info.id)));
+      connect(box, SIGNAL(finished(int)), this, SLOT(onFileOfferAnswered(int)));
+      m_fileOffers[info.id] = box;
+      box->open();
+      return;
+    }
+  case FileTransferInfo::TRANSFERRING:
+    m_fileTransfers[info.id] = info;
+    break;
+  case FileTransferInfo::DONE:
+    m_fileTransfers.erase(info.id);
+    appendControlMessage(info.nick,
+                         QString("sent %1, saved to %2").arg(info.fileName).arg(info.path),
+                         timestamp);
+    break;
+  case FileTransferInfo::FAILED:
+    // an offer which is gone cannot be answered any more
+    {
+      std::map<uint64_t, QMessageBox*>::iterator offer = m_fileOffers.find(info.id);
+      if (offer != m_fileOffers.end()) {
+        offer->second->disconnect(this);
+        offer->second->close();
+        m_fileOffers.erase(offer);
+      }
+    }
+    m_fileTransfers.erase(info.id);
+    appendControlMessage(info.nick,
+                         QString("sent %1, which failed: %2").arg(info.fileName).arg(info.error),
+                         timestamp);
+    break;
+  }
+
+  updateTransferLabel();
   fitView();
 }
 
 void
-ChatDialog::updateLabels(Name newChatPrefix)
+ChatDialog::onFileOfferAnswered(int button)
 {
-  // Reset DigestTree
-  m_scene->clearAll();
-  m_scene->plot("Empty");
+  QObject* box = sender();
+  uint64_t id = box->property("transferId").toULongLong();
+  m_fileOffers.erase(id);
+
+  if (button == QMessageBox::Yes)
+    emit fileTransferAccepted(id);
+  else
+    emit fileTransferDeclined(id);
+}
 
+void
+ChatDialog::updateLabels(Name newChatPrefix)
+{
   // Display chatroom name
   QString chatroomName = QString("Chatroom: %1").arg(QString::fromStdString(m_chatroomName));
   ui->infoLabel->setStyleSheet("QLabel {color: #630; font-size: 16px; font: bold \"Verdana\";}");
@@ -408,6 +589,37 @@ ChatDialog::onReturnPressed()
   fitView();
 }
 
+void
+ChatDialog::onFileButtonPressed()
+{
+  QString path = QFileDialog::getOpenFileName(this, tr("Send File"));
+  if (path.isEmpty())
+    return;
+
+  emit fileToSent(path);
+}
+
+void
+ChatDialog::onScrollBarValueChanged(int value)
+{
+  QScrollBar *bar = ui->transcriptView->verticalScrollBar();
+  if (value == bar->minimum())
+    loadOlderMessages();
+  else if (value == bar->maximum())
+    loadNewerMessages();
+}
+
+void
+ChatDialog::refreshView()
+{
+  // a hidden viewer keeps its scene dirty, showing it requests a refresh again
+  bool isVisible = this->isVisible() && !isMinimized();
+  if (fitScene(m_scene, ui->syncTreeViewer, m_isSyncTreeDirty, isVisible))
+    m_scene->setLevelOfDetail(ui->syncTreeViewer->transform().m11());
+  if (fitScene(m_trustScene, ui->trustTreeViewer, m_isTrustTreeDirty, isVisible))
+    m_trustScene->setLevelOfDetail(ui->trustTreeViewer->transform().m11());
+}
+
 void
 ChatDialog::onSyncTreeButtonPressed()
 {
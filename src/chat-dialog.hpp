@@ -13,11 +13,11 @@
 #define CHRONOCHAT_CHAT_DIALOG_HPP
 
 #include <QDialog>
-#include <QTextTable>
 #include <QStringListModel>
 #include <QSystemTrayIcon>
 #include <QMenu>
 #include <QTimer>
+#include <QMessageBox>
 
 #ifndef Q_MOC_RUN
 #include "invitation.hpp"
@@ -26,6 +26,8 @@
 #include "trust-tree-scene.hpp"
 #include "trust-tree-node.hpp"
 #include "chat-dialog-backend.hpp"
+#include "chat-history-storage.hpp"
+#include "transcript-model.hpp"
 
 #include "chatroom-info.hpp"
 #endif
@@ -42,7 +44,8 @@ class ChatDialog : public QDialog
 
 public:
   explicit
-  ChatDialog(const Name& chatroomPrefix,
+  ChatDialog(const shared_ptr<SyncRuntime>& runtime,
+             const Name& chatroomPrefix,
              const Name& userChatPrefix,
              const Name& routingPrefix,
              const std::string& chatroomName,
@@ -79,28 +82,54 @@ public:
   ChatroomInfo
   getChatroomInfo();
 
+  /// @brief counters of the view refreshes, for profiling
+  struct RefreshCounters
+  {
+    uint64_t nRequested;                 // calls of fitView
+    uint64_t nPerformed;                 // scenes fitted into their viewers
+    uint64_t nSkipped;                   // scenes left dirty, as the viewer was hidden
+  };
+
+  const RefreshCounters&
+  getRefreshCounters() const
+  {
+    return m_refreshCounters;
+  }
+
 private:
   void
   disableSyncTreeDisplay();
 
+  /// @param sessionId the session of the message in the history, 0 if it is not stored
   void
-  appendChatMessage(const QString& nick, const QString& text, time_t timestamp);
+  appendControlMessage(const QString& nick, const QString& action, time_t timestamp,
+                       SessionId sessionId = 0, uint64_t seqNo = 0);
 
   void
-  appendControlMessage(const QString& nick, const QString& action, time_t timestamp);
-
-  QString
-  formatTime(time_t timestamp);
+  loadOlderMessages();
 
   void
-  printTimeInCell(QTextTable* table, time_t timestamp);
+  loadNewerMessages();
 
   void
   showMessage(const QString&, const QString&);
 
+  /// @brief mark the scenes dirty, they are fitted into their viewers at most once per frame
   void
   fitView();
 
+  /**
+   * @brief fit a dirty scene into its viewer, unless the viewer cannot be seen
+   *
+   * @param isDirty cleared when the scene has been fitted
+   * @return true if the scene has been fitted
+   */
+  bool
+  fitScene(QGraphicsScene* scene, QGraphicsView* viewer, bool& isDirty, bool isVisible);
+
+  void
+  updateTransferLabel();
+
 signals:
   void
   shutdownBackend();
@@ -108,6 +137,15 @@ signals:
   void
   msgToSent(QString text, time_t timestamp);
 
+  void
+  fileToSent(QString path);
+
+  void
+  fileTransferAccepted(quint64 id);
+
+  void
+  fileTransferDeclined(quint64 id);
+
   void
   closeChatDialog(const QString& chatroomName);
 
@@ -129,14 +167,20 @@ private slots:
   updateSyncTree(std::vector<chronochat::NodeInfo> updates, QString rootDigest);
 
   void
-  receiveChatMessage(QString nick, QString text, time_t timestamp);
+  removeSession(chronochat::SessionId sessionId, QString nick, time_t timestamp,
+                bool isLeave, uint64_t seqNo);
+
+  void
+  closeSession(chronochat::SessionId sessionId);
 
   void
-  removeSession(QString sessionPrefix, QString nick, time_t timestamp);
+  receiveMessages(chronochat::MessageBatch messages);
 
   void
-  receiveMessage(QString sessionPrefix, QString nick, uint64_t seqNo, time_t timestamp,
-                 bool addSession);
+  updateFileTransfer(chronochat::FileTransferInfo info);
+
+  void
+  onFileOfferAnswered(int button);
 
   void
   updateLabels(ndn::Name newChatPrefix);
@@ -144,6 +188,9 @@ private slots:
   void
   onReturnPressed();
 
+  void
+  onFileButtonPressed();
+
   void
   onSyncTreeButtonPressed();
 
@@ -153,6 +200,12 @@ private slots:
   void
   enableSyncTreeDisplay();
 
+  void
+  onScrollBarValueChanged(int value);
+
+  void
+  refreshView();
+
 private:
   Ui::ChatDialog* ui;
 
@@ -167,6 +220,17 @@ private:
   DigestTreeScene* m_scene;
   TrustTreeScene* m_trustScene;
   QStringListModel* m_rosterModel;
+
+  unique_ptr<ChatHistoryStorage> m_history; // read-only view of the message log
+  TranscriptModel* m_transcript;
+
+  std::map<uint64_t, FileTransferInfo> m_fileTransfers; // downloads in progress
+  std::map<uint64_t, QMessageBox*> m_fileOffers; // questions to the user, by transfer
+
+  QTimer* m_refreshTimer;
+  bool m_isSyncTreeDirty;
+  bool m_isTrustTreeDirty;
+  RefreshCounters m_refreshCounters;
 };
 
 } // namespace chronochat
@@ -0,0 +1,331 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#include "chat-history-storage.hpp"
+
+#include <algorithm>
+#include <set>
+#include <boost/filesystem.hpp>
+#include "cryptopp.hpp"
+#include "logging.h"
+
+INIT_LOGGER("ChatHistoryStorage");
+
+namespace chronochat {
+
+namespace fs = boost::filesystem;
+
+using std::string;
+
+const string INIT_HISTORY_TABLE =
+  "CREATE TABLE IF NOT EXISTS                                          "
+  "  ChatHistory(                                                      "
+  "      id                INTEGER PRIMARY KEY AUTOINCREMENT,          "
+  "      session_prefix    BLOB NOT NULL,                              "
+  "      seq_no            INTEGER NOT NULL,                           "
+  "      msg_type          INTEGER NOT NULL,                           "
+  "      nick              BLOB NOT NULL,                              "
+  "      data              BLOB NOT NULL,                              "
+  "      timestamp         INTEGER NOT NULL,                           "
+  "      is_validated      INTEGER DEFAULT 1,                          "
+  "      bundle_index      INTEGER DEFAULT 0,                          "
+  "      UNIQUE (session_prefix, seq_no, bundle_index)                 "
+  "  );                                                                "
+  "CREATE INDEX IF NOT EXISTS ch_time_index ON ChatHistory(timestamp, id); ";
+
+// the terms of one lookup, each binds two of the at most 999 parameters
+static const size_t MAX_LOOKUP_SIZE = 256;
+
+static int
+sqlite3_bind_string(sqlite3_stmt* statement,
+                    int index,
+                    const string& value,
+                    void(*destructor)(void*))
+{
+  return sqlite3_bind_text(statement, index, value.c_str(), value.size(), destructor);
+}
+
+static string
+sqlite3_column_string(sqlite3_stmt* statement, int column)
+{
+  return string(reinterpret_cast<const char*>(sqlite3_column_text(statement, column)),
+                sqlite3_column_bytes(statement, column));
+}
+
+ChatHistoryStorage::ChatHistoryStorage(const Name& userChatPrefix, size_t batchSize)
+  : m_db(nullptr)
+  , m_insertStmt(nullptr)
+  , m_hasMessageStmt(nullptr)
+  , m_batchSize(batchSize)
+{
+  fs::path historyDir = fs::path(getenv("HOME")) / ".chronos" / "history";
+  fs::create_directories(historyDir);
+
+  int res = sqlite3_open((historyDir / getDBName(userChatPrefix)).c_str(), &m_db);
+  if (res != SQLITE_OK)
+    throw Error("chat history DB cannot be open/created");
+
+  // WAL lets the dialog read while the backend writes, and with synchronous=NORMAL
+  // a commit only appends to the log instead of waiting for fsync.
+  sqlite3_exec(m_db, "PRAGMA journal_mode=WAL;", nullptr, nullptr, nullptr);
+  sqlite3_exec(m_db, "PRAGMA synchronous=NORMAL;", nullptr, nullptr, nullptr);
+  sqlite3_busy_timeout(m_db, 1000);
+
+  char* errmsg = 0;
+  res = sqlite3_exec(m_db, INIT_HISTORY_TABLE.c_str(), nullptr, nullptr, &errmsg);
+  if (res != SQLITE_OK && errmsg != 0) {
+    sqlite3_free(errmsg);
+    sqlite3_close(m_db);
+    throw Error("Init \"error\" in ChatHistory");
+  }
+
+  sqlite3_prepare_v2(m_db,
+                     "INSERT OR IGNORE INTO ChatHistory \
+                      (session_prefix, seq_no, msg_type, nick, data, timestamp, is_validated, \
+                       bundle_index) \
+                      VALUES (?, ?, ?, ?, ?, ?, ?, ?)",
+                     -1, &m_insertStmt, 0);
+
+  // looked up for every received message
+  sqlite3_prepare_v2(m_db,
+                     "SELECT id FROM ChatHistory WHERE session_prefix=? AND seq_no=? LIMIT 1",
+                     -1, &m_hasMessageStmt, 0);
+}
+
+ChatHistoryStorage::~ChatHistoryStorage()
+{
+  flush();
+  sqlite3_finalize(m_insertStmt);
+  sqlite3_finalize(m_hasMessageStmt);
+  sqlite3_close(m_db);
+}
+
+string
+ChatHistoryStorage::getDBName(const Name& userChatPrefix)
+{
+  string dbName("chronochat-history-");
+
+  std::stringstream ss;
+  {
+    using namespace CryptoPP;
+
+    SHA256 hash;
+    StringSource(userChatPrefix.wireEncode().wire(), userChatPrefix.wireEncode().size(), true,
+                 new HashFilter(hash, new HexEncoder(new FileSink(ss), false)));
+  }
+  dbName.append(ss.str()).append(".db");
+
+  return dbName;
+}
+
+void
+ChatHistoryStorage::addMessage(const Name& sessionPrefix, uint64_t seqNo,
+                               const ChatMessage& msg, bool isValidated,
+                               size_t bundleIndex, const StringRef& nick)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  ChatHistoryEntry entry;
+  entry.sessionPrefix = sessionPrefix;
+  entry.seqNo = seqNo;
+  entry.msgType = msg.getMsgType();
+  // decoded messages may only hold views of their strings
+  entry.nick = (msg.hasNick() ? msg.getNickView() : nick).toString();
+  if (msg.getMsgType() == ChatMessage::FILE)
+    entry.data = msg.getFileManifest().getFileName();
+  else
+    entry.data = msg.getDataView().toString();
+  entry.timestamp = msg.getTimestamp();
+  entry.isValidated = isValidated;
+  entry.bundleIndex = bundleIndex;
+  m_pending.push_back(entry);
+
+  if (m_pending.size() >= m_batchSize)
+    flushInternal();
+}
+
+void
+ChatHistoryStorage::flush()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  flushInternal();
+}
+
+void
+ChatHistoryStorage::flushInternal()
+{
+  if (m_pending.empty())
+    return;
+
+  sqlite3_exec(m_db, "BEGIN TRANSACTION;", nullptr, nullptr, nullptr);
+  for (const auto& entry : m_pending) {
+    sqlite3_bind_string(m_insertStmt, 1, entry.sessionPrefix.toUri(), SQLITE_TRANSIENT);
+    sqlite3_bind_int64(m_insertStmt, 2, static_cast<sqlite3_int64>(entry.seqNo));
+    sqlite3_bind_int(m_insertStmt, 3, entry.msgType);
+    sqlite3_bind_string(m_insertStmt, 4, entry.nick, SQLITE_STATIC);
+    sqlite3_bind_string(m_insertStmt, 5, entry.data, SQLITE_STATIC);
+    sqlite3_bind_int64(m_insertStmt, 6, static_cast<sqlite3_int64>(entry.timestamp));
+    sqlite3_bind_int(m_insertStmt, 7, (entry.isValidated ? 1 : 0));
+    sqlite3_bind_int64(m_insertStmt, 8, static_cast<sqlite3_int64>(entry.bundleIndex));
+    sqlite3_step(m_insertStmt);
+    sqlite3_reset(m_insertStmt);
+  }
+  int res = sqlite3_exec(m_db, "COMMIT;", nullptr, nullptr, nullptr);
+  if (res != SQLITE_OK)
+    _LOG_ERROR("Cannot write " << m_pending.size() << " messages to chat history");
+
+  sqlite3_clear_bindings(m_insertStmt);
+  m_pending.clear();
+}
+
+bool
+ChatHistoryStorage::hasMessage(const Name& sessionPrefix, uint64_t seqNo)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  for (const auto& entry : m_pending) {
+    if (entry.seqNo == seqNo && entry.sessionPrefix == sessionPrefix)
+      return true;
+  }
+
+  sqlite3_bind_string(m_hasMessageStmt, 1, sessionPrefix.toUri(), SQLITE_TRANSIENT);
+  sqlite3_bind_int64(m_hasMessageStmt, 2, static_cast<sqlite3_int64>(seqNo));
+  bool exists = (sqlite3_step(m_hasMessageStmt) == SQLITE_ROW);
+  sqlite3_reset(m_hasMessageStmt);
+  sqlite3_clear_bindings(m_hasMessageStmt);
+
+  return exists;
+}
+
+std::vector<bool>
+ChatHistoryStorage::hasMessages(const std::vector<std::pair<Name, uint64_t>>& messages)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  std::vector<string> prefixes;
+  for (const auto& message : messages)
+    prefixes.push_back(message.first.toUri());
+
+  std::set<std::pair<string, uint64_t>> found;
+  for (const auto& entry : m_pending)
+    found.insert(std::make_pair(entry.sessionPrefix.toUri(), entry.seqNo));
+
+  for (size_t begin = 0; begin < messages.size(); begin += MAX_LOOKUP_SIZE) {
+    size_t end = std::min(messages.size(), begin + MAX_LOOKUP_SIZE);
+
+    // each term is looked up in the unique index
+    string sql = "SELECT session_prefix, seq_no FROM ChatHistory WHERE ";
+    for (size_t i = begin; i < end; i++)
+      sql += (i == begin ? "" : " OR ") + string("(session_prefix=? AND seq_no=?)");
+
+    sqlite3_stmt* stmt;
+    sqlite3_prepare_v2(m_db, sql.c_str(), -1, &stmt, 0);
+    for (size_t i = begin; i < end; i++) {
+      int index = 2 * (i - begin) + 1;
+      sqlite3_bind_string(stmt, index, prefixes[i], SQLITE_STATIC);
+      sqlite3_bind_int64(stmt, index + 1, static_cast<sqlite3_int64>(messages[i].second));
+    }
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+      found.insert(std::make_pair(sqlite3_column_string(stmt, 0),
+                                  static_cast<uint64_t>(sqlite3_column_int64(stmt, 1))));
+    sqlite3_finalize(stmt);
+  }
+
+  std::vector<bool> exists;
+  for (size_t i = 0; i < messages.size(); i++)
+    exists.push_back(found.count(std::make_pair(prefixes[i], messages[i].second)) > 0);
+  return exists;
+}
+
+void
+ChatHistoryStorage::getMessagesBefore(const ChatHistoryEntry* last, size_t limit,
+                                      std::vector<ChatHistoryEntry>& entries)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  entries.clear();
+
+  sqlite3_stmt* stmt;
+  if (last == nullptr) {
+    sqlite3_prepare_v2(m_db,
+                       "SELECT id, session_prefix, seq_no, msg_type, nick, data, timestamp, \
+                        is_validated, bundle_index FROM ChatHistory WHERE msg_type!=? \
+                        ORDER BY timestamp DESC, id DESC LIMIT ?",
+                       -1, &stmt, 0);
+    sqlite3_bind_int(stmt, 1, ChatMessage::HELLO);
+    sqlite3_bind_int64(stmt, 2, static_cast<sqlite3_int64>(limit));
+  }
+  else {
+    sqlite3_prepare_v2(m_db,
+                       "SELECT id, session_prefix, seq_no, msg_type, nick, data, timestamp, \
+                        is_validated, bundle_index FROM ChatHistory WHERE msg_type!=? \
+                        AND (timestamp<? OR (timestamp=? AND id<?)) \
+                        ORDER BY timestamp DESC, id DESC LIMIT ?",
+                       -1, &stmt, 0);
+    sqlite3_bind_int(stmt, 1, ChatMessage::HELLO);
+    sqlite3_bind_int64(stmt, 2, static_cast<sqlite3_int64>(last->timestamp));
+    sqlite3_bind_int64(stmt, 3, static_cast<sqlite3_int64>(last->timestamp));
+    sqlite3_bind_int64(stmt, 4, last->id);
+    sqlite3_bind_int64(stmt, 5, static_cast<sqlite3_int64>(limit));
+  }
+
+  readEntries(stmt, entries);
+  sqlite3_finalize(stmt);
+
+  std::reverse(entries.begin(), entries.end());
+}
+
+void
+ChatHistoryStorage::getMessagesAfter(const ChatHistoryEntry& first, size_t limit,
+                                     std::vector<ChatHistoryEntry>& entries)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  entries.clear();
+
+  sqlite3_stmt* stmt;
+  sqlite3_prepare_v2(m_db,
+                     "SELECT id, session_prefix, seq_no, msg_type, nick, data, timestamp, \
+                      is_validated, bundle_index FROM ChatHistory WHERE msg_type!=? \
+                      AND (timestamp>? OR (timestamp=? AND id>?)) \
+                      ORDER BY timestamp ASC, id ASC LIMIT ?",
+                     -1, &stmt, 0);
+  sqlite3_bind_int(stmt, 1, ChatMessage::HELLO);
+  sqlite3_bind_int64(stmt, 2, static_cast<sqlite3_int64>(first.timestamp));
+  sqlite3_bind_int64(stmt, 3, static_cast<sqlite3_int64>(first.timestamp));
+  sqlite3_bind_int64(stmt, 4, first.id);
+  sqlite3_bind_int64(stmt, 5, static_cast<sqlite3_int64>(limit));
+
+  readEntries(stmt, entries);
+  sqlite3_finalize(stmt);
+}
+
+void
+ChatHistoryStorage::readEntries(sqlite3_stmt* stmt, std::vector<ChatHistoryEntry>& entries)
+{
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    ChatHistoryEntry entry;
+    entry.id = sqlite3_column_int64(stmt, 0);
+    entry.sessionPrefix = Name(sqlite3_column_string(stmt, 1));
+    entry.seqNo = static_cast<uint64_t>(sqlite3_column_int64(stmt, 2));
+    entry.msgType = static_cast<ChatMessage::ChatMessageType>(sqlite3_column_int(stmt, 3));
+    entry.nick = sqlite3_column_string(stmt, 4);
+    entry.data = sqlite3_column_string(stmt, 5);
+    entry.timestamp = static_cast<time_t>(sqlite3_column_int64(stmt, 6));
+    entry.isValidated = (sqlite3_column_int(stmt, 7) != 0);
+    entry.bundleIndex = static_cast<size_t>(sqlite3_column_int64(stmt, 8));
+    entries.push_back(entry);
+  }
+}
+
+size_t
+ChatHistoryStorage::getNPendingMessages()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_pending.size();
+}
+
+} // namespace chronochat
@@ -0,0 +1,150 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#ifndef CHRONOCHAT_CHAT_HISTORY_STORAGE_HPP
+#define CHRONOCHAT_CHAT_HISTORY_STORAGE_HPP
+
+#include "common.hpp"
+#include "chat-message.hpp"
+#include <mutex>
+#include <sqlite3.h>
+
+namespace chronochat {
+
+class ChatHistoryEntry
+{
+public:
+  ChatHistoryEntry()
+    : id(0)
+    , seqNo(0)
+    , msgType(ChatMessage::CHAT)
+    , timestamp(0)
+    , isValidated(true)
+    , bundleIndex(0)
+  {
+  }
+
+public:
+  int64_t id;                            // position in the log
+  Name sessionPrefix;
+  uint64_t seqNo;
+  ChatMessage::ChatMessageType msgType;
+  std::string nick;
+  std::string data;                      // chat text, or the name of a shared file
+  time_t timestamp;
+  bool isValidated;
+  size_t bundleIndex;                    // position in the bundle of seqNo
+};
+
+/**
+ * @brief Append-only log of the messages of one chatroom
+ *
+ * The log is indexed by (session, seqNo, position in the bundle) and by timestamp.  Appended messages are
+ * buffered and written in one transaction per batch.  The database runs in WAL mode
+ * with relaxed syncing, so a commit does not wait for fsync and readers on other
+ * connections (e.g., the chat dialog) never block the writer.
+ */
+class ChatHistoryStorage : noncopyable
+{
+public:
+  class Error : public std::runtime_error
+  {
+  public:
+    explicit
+    Error(const std::string& what)
+      : std::runtime_error(what)
+    {
+    }
+  };
+
+  /**
+   * @param userChatPrefix the chat prefix of the local user, which identifies both
+   *                       the identity and the chatroom
+   * @param batchSize number of buffered messages which triggers a write
+   */
+  explicit
+  ChatHistoryStorage(const Name& userChatPrefix, size_t batchSize = 64);
+
+  ~ChatHistoryStorage();
+
+  /**
+   * @param bundleIndex position of the message in the bundle published as @p seqNo,
+   *                    0 for a single message
+   * @param nick nick of the session, used if @p msg does not carry it
+   */
+  void
+  addMessage(const Name& sessionPrefix, uint64_t seqNo, const ChatMessage& msg,
+             bool isValidated = true, size_t bundleIndex = 0,
+             const StringRef& nick = StringRef());
+
+  /// @brief write all buffered messages
+  void
+  flush();
+
+  bool
+  hasMessage(const Name& sessionPrefix, uint64_t seqNo);
+
+  /**
+   * @brief look up @p messages at once
+   *
+   * @param messages (session prefix, seqNo) of each message
+   * @return for each message, true if it is in the history
+   */
+  std::vector<bool>
+  hasMessages(const std::vector<std::pair<Name, uint64_t>>& messages);
+
+  /**
+   * @brief get a page of displayable messages which precede @p last
+   *
+   * Messages are ordered by (timestamp, id).  HELLO messages are excluded.
+   *
+   * @param last the oldest entry of the previous page, nullptr for the newest page
+   * @param limit maximum number of entries
+   * @param entries output entries in ascending order
+   */
+  void
+  getMessagesBefore(const ChatHistoryEntry* last, size_t limit,
+                    std::vector<ChatHistoryEntry>& entries);
+
+  /**
+   * @brief get a page of displayable messages which follow @p first
+   *
+   * @param first the newest entry of the previous page
+   * @param limit maximum number of entries
+   * @param entries output entries in ascending order
+   */
+  void
+  getMessagesAfter(const ChatHistoryEntry& first, size_t limit,
+                   std::vector<ChatHistoryEntry>& entries);
+
+  size_t
+  getNPendingMessages();
+
+  static std::string
+  getDBName(const Name& userChatPrefix);
+
+private:
+  void
+  flushInternal();
+
+  static void
+  readEntries(sqlite3_stmt* stmt, std::vector<ChatHistoryEntry>& entries);
+
+private:
+  sqlite3* m_db;
+  sqlite3_stmt* m_insertStmt;
+  sqlite3_stmt* m_hasMessageStmt;
+  size_t m_batchSize;
+
+  std::mutex m_mutex;
+  std::vector<ChatHistoryEntry> m_pending;
+};
+
+} // namespace chronochat
+
+#endif // CHRONOCHAT_CHAT_HISTORY_STORAGE_HPP
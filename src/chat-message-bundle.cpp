@@ -0,0 +1,75 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#include "chat-message-bundle.hpp"
+#include "tlv-codec.hpp"
+
+namespace chronochat {
+
+BOOST_CONCEPT_ASSERT((ndn::WireEncodable<ChatMessageBundle>));
+BOOST_CONCEPT_ASSERT((ndn::WireDecodable<ChatMessageBundle>));
+
+ChatMessageBundle::ChatMessageBundle()
+{
+}
+
+ChatMessageBundle::ChatMessageBundle(const Block& bundleWire)
+{
+  this->wireDecode(bundleWire);
+}
+
+// ChatMessageBundle := CHAT-MESSAGE-BUNDLE-TYPE TLV-LENGTH
+//                        ChatMessage+
+//
+// The messages are in the order they were sent.
+struct ChatMessageView : codec::Self<tlv::ChatMessage, ChatMessage>
+{
+  static void
+  read(const Block& element, ChatMessage& msg)
+  {
+    msg.wireDecode(element, ChatMessage::DECODE_VIEW);
+  }
+};
+
+struct ChatMessageBundle::Schema
+  : codec::Record<ChatMessageBundle, tlv::ChatMessageBundle,
+                  codec::Fields<ChatMessageBundle>::Repeated<ChatMessageView,
+                                                             std::vector<ChatMessage>,
+                                                             &ChatMessageBundle::m_messages>>
+{
+};
+
+const Block&
+ChatMessageBundle::wireEncode() const
+{
+  m_wire = Schema::encode(*this);
+  return m_wire;
+}
+
+void
+ChatMessageBundle::wireDecode(const Block& bundleWire)
+{
+  m_wire = bundleWire;
+  Schema::decode(m_wire, *this);
+}
+
+void
+ChatMessageBundle::addMessage(const ChatMessage& msg)
+{
+  m_wire.reset();
+  m_messages.push_back(msg);
+}
+
+void
+ChatMessageBundle::clear()
+{
+  m_wire.reset();
+  m_messages.clear();
+}
+
+} // namespace chronochat
@@ -0,0 +1,97 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#ifndef CHRONOCHAT_CHAT_MESSAGE_BUNDLE_HPP
+#define CHRONOCHAT_CHAT_MESSAGE_BUNDLE_HPP
+
+#include "common.hpp"
+#include "tlv.hpp"
+#include "chat-message.hpp"
+#include <ndn-cxx/util/concepts.hpp>
+#include <ndn-cxx/encoding/block.hpp>
+
+namespace chronochat {
+
+/**
+ * @brief Messages which are published together as the data of one sequence number
+ *
+ * Decoded messages are views of the wire of the bundle (see ChatMessage::DECODE_VIEW).
+ */
+class ChatMessageBundle
+{
+
+public:
+
+  class Error : public std::runtime_error
+  {
+  public:
+    explicit
+    Error(const std::string& what)
+      : std::runtime_error(what)
+    {
+    }
+  };
+
+public:
+
+  ChatMessageBundle();
+
+  explicit
+  ChatMessageBundle(const Block& bundleWire);
+
+  const Block&
+  wireEncode() const;
+
+  void
+  wireDecode(const Block& bundleWire);
+
+  const std::vector<ChatMessage>&
+  getMessages() const;
+
+  size_t
+  size() const;
+
+  bool
+  empty() const;
+
+  void
+  addMessage(const ChatMessage& msg);
+
+  void
+  clear();
+
+private:
+  // TLV schema, see tlv-codec.hpp
+  struct Schema;
+
+private:
+  mutable Block m_wire;
+  std::vector<ChatMessage> m_messages;
+};
+
+inline const std::vector<ChatMessage>&
+ChatMessageBundle::getMessages() const
+{
+  return m_messages;
+}
+
+inline size_t
+ChatMessageBundle::size() const
+{
+  return m_messages.size();
+}
+
+inline bool
+ChatMessageBundle::empty() const
+{
+  return m_messages.empty();
+}
+
+} // namespace chronochat
+
+#endif //CHRONOCHAT_CHAT_MESSAGE_BUNDLE_HPP
@@ -8,6 +8,7 @@
  */
 
 #include "chat-message.hpp"
+#include "tlv-codec.hpp"
 
 namespace chronochat {
 
@@ -15,150 +16,193 @@ BOOST_CONCEPT_ASSERT((ndn::WireEncodable<ChatMessage>));
 BOOST_CONCEPT_ASSERT((ndn::WireDecodable<ChatMessage>));
 
 ChatMessage::ChatMessage()
+  : m_hasNick(true)
+  , m_hasChatroomName(true)
+  , m_isView(false)
+  , m_hasPreciseTimestamp(false)
+  , m_hasHelloInterval(false)
+  , m_helloInterval(0)
 {
 }
 
-ChatMessage::ChatMessage(const Block& chatMsgWire)
+ChatMessage::ChatMessage(const Block& chatMsgWire, DecodeMode mode)
+  : m_hasNick(true)
+  , m_hasChatroomName(true)
+  , m_isView(false)
+  , m_hasPreciseTimestamp(false)
+  , m_hasHelloInterval(false)
+  , m_helloInterval(0)
 {
-  this->wireDecode(chatMsgWire);
+  this->wireDecode(chatMsgWire, mode);
 }
 
-template<bool T>
-size_t
-ChatMessage::wireEncode(ndn::EncodingImpl<T>& block) const
+// ChatMessage := CHAT-MESSAGE-TYPE TLV-LENGTH
+//                  Nick?
+//                  ChatroomName?
+//                  ChatMessageType
+//                  ChatData
+//                  Timestamp
+//                  PreciseTimestamp?
+//                  FileManifest?
+//                  HelloInterval?
+//
+// Nick := NICK-NAME-TYPE TLV-LENGTH
+//           String
+//
+// ChatroomName := CHATROOM-NAME-TYPE TLV-LENGTH
+//                   String
+//
+// ChatMessageType := CHAT-MESSAGE-TYPE TLV-LENGTH
+//                      nonNegativeInteger
+//
+// ChatData := CHAT-DATA-TYPE TLV-LENGTH
+//               String
+//
+// Timestamp := TIMESTAMP-TYPE TLV-LENGTH
+//                VarNumber
+//
+// PreciseTimestamp := PRECISE-TIMESTAMP-TYPE TLV-LENGTH
+//                       nonNegativeInteger (milliseconds since the epoch)
+//
+// FileManifest := see file-manifest.cpp
+//
+// HelloInterval := HELLO-INTERVAL-TYPE TLV-LENGTH
+//                    nonNegativeInteger (mean interval of the sender's hellos in milliseconds)
+//
+// ChatData is only present in CHAT messages, FileManifest only in FILE messages.
+//
+// Elements added by later versions are skipped.  The first release rejects any element
+// after Timestamp though, so PreciseTimestamp is only added for receivers which announced
+// SessionInfo::FEATURE_PRECISE_TIMESTAMP, HelloInterval only for receivers which announced
+// SessionInfo::FEATURE_HELLO_INTERVAL, and Nick and ChatroomName are only left out for
+// receivers which announced SessionInfo::FEATURE_COMPACT.
+static bool
+hasChatData(const ChatMessage& msg)
 {
-  // ChatMessage := CHAT-MESSAGE-TYPE TLV-LENGTH
-  //                  Nick
-  //                  ChatroomName
-  //                  ChatMessageType
-  //                  ChatData
-  //                  Timestamp
-  //
-  // Nick := NICK-NAME-TYPE TLV-LENGTH
-  //           String
-  //
-  // ChatroomName := CHATROOM-NAME-TYPE TLV-LENGTH
-  //                   String
-  //
-  // ChatMessageType := CHAT-MESSAGE-TYPE TLV-LENGTH
-  //                      nonNegativeInteger
-  //
-  // ChatData := CHAT-DATA-TYPE TLV-LENGTH
-  //               String
-  //
-  // Timestamp := TIMESTAMP-TYPE TLV-LENGTH
-  //                VarNumber
-  //
-  size_t totalLength = 0;
-
-  // Timestamp
-  totalLength += ndn::prependNonNegativeIntegerBlock(block, tlv::Timestamp, m_timestamp);
-
-  // ChatData
-  if (m_msgType == CHAT) {
-    const uint8_t* dataWire = reinterpret_cast<const uint8_t*>(m_data.c_str());
-    totalLength += block.prependByteArrayBlock(tlv::ChatData, dataWire, m_data.length());
-  }
-
-  // ChatMessageType
-  totalLength += ndn::prependNonNegativeIntegerBlock(block, tlv::ChatMessageType, m_msgType);
-
-  // ChatroomName
-  const uint8_t* chatroomWire = reinterpret_cast<const uint8_t*>(m_chatroomName.c_str());
-  totalLength += block.prependByteArrayBlock(tlv::ChatroomName, chatroomWire,
-                                             m_chatroomName.length());
-
-  // Nick
-  const uint8_t* nickWire = reinterpret_cast<const uint8_t*>(m_nick.c_str());
-  totalLength += block.prependByteArrayBlock(tlv::Nick, nickWire, m_nick.length());
-
-  // Chat Message
-  totalLength += block.prependVarNumber(totalLength);
-  totalLength += block.prependVarNumber(tlv::ChatMessage);
+  return msg.getMsgType() == ChatMessage::CHAT;
+}
 
-  return totalLength;
+static bool
+hasFileManifest(const ChatMessage& msg)
+{
+  return msg.getMsgType() == ChatMessage::FILE;
 }
 
+typedef codec::Fields<ChatMessage> ChatMessageFields;
+typedef codec::Tlv<tlv::ChatMessageType,
+                   codec::NonNegativeInteger<ChatMessage::ChatMessageType>> ChatMessageTypeTlv;
+
+// the string fields are encoded from and decoded into the views
+struct ChatMessage::Schema
+  : codec::Record<ChatMessage, tlv::ChatMessage,
+                  ChatMessageFields::Flagged<codec::Tlv<tlv::Nick, codec::StringView>,
+                                             &ChatMessage::m_nickView,
+                                             &ChatMessage::m_hasNick>,
+                  ChatMessageFields::Flagged<codec::Tlv<tlv::ChatroomName, codec::StringView>,
+                                             &ChatMessage::m_chatroomNameView,
+                                             &ChatMessage::m_hasChatroomName>,
+                  ChatMessageFields::Required<ChatMessageTypeTlv, &ChatMessage::m_msgType>,
+                  ChatMessageFields::Conditional<codec::Tlv<tlv::ChatData, codec::StringView>,
+                                                 &ChatMessage::m_dataView, &hasChatData>,
+                  ChatMessageFields::Required<codec::Tlv<tlv::Timestamp,
+                                                         codec::NonNegativeInteger<time_t>>,
+                                              &ChatMessage::m_timestamp>,
+                  ChatMessageFields::Flagged<codec::Tlv<tlv::PreciseTimestamp,
+                                                        codec::UnixTimestamp>,
+                                             &ChatMessage::m_preciseTimestamp,
+                                             &ChatMessage::m_hasPreciseTimestamp>,
+                  ChatMessageFields::Conditional<codec::Self<tlv::FileManifest, FileManifest>,
+                                                 &ChatMessage::m_fileManifest,
+                                                 &hasFileManifest>,
+                  ChatMessageFields::Flagged<codec::Tlv<tlv::HelloInterval,
+                                                        codec::NonNegativeInteger<uint64_t>>,
+                                             &ChatMessage::m_helloInterval,
+                                             &ChatMessage::m_hasHelloInterval>,
+                  codec::IgnoreRest>
+{
+};
+
 const Block&
 ChatMessage::wireEncode() const
 {
-  ndn::EncodingEstimator estimator;
-  size_t estimatedSize = wireEncode(estimator);
-
-  ndn::EncodingBuffer buffer(estimatedSize, 0);
-  wireEncode(buffer);
+  // the viewed wire is unmodified, and re-encoding would release the viewed buffer;
+  // otherwise the wire is kept until the message is modified
+  if (m_isView || m_wire.hasWire())
+    return m_wire;
 
-  m_wire = buffer.block();
-  m_wire.parse();
+  m_nickView = m_nick;
+  m_chatroomNameView = m_chatroomName;
+  m_dataView = m_data;
+  m_wire = Schema::encode(*this);
 
   return m_wire;
 }
 
 void
-ChatMessage::wireDecode(const Block& chatMsgWire)
+ChatMessage::wireDecode(const Block& chatMsgWire, DecodeMode mode)
 {
+  m_isView = false;
+  m_nickView = m_chatroomNameView = StringRef();
   m_wire = chatMsgWire;
-  m_wire.parse();
-
-  if (m_wire.type() != tlv::ChatMessage)
-    throw Error("Unexpected TLV number when decoding chat message packet");
-
-  Block::element_const_iterator i = m_wire.elements_begin();
-  if (i == m_wire.elements_end() || i->type() != tlv::Nick)
-    throw Error("Expect Nick but get ...");
-  m_nick = std::string(reinterpret_cast<const char* >(i->value()),
-                       i->value_size());;
-  i++;
-
-  if (i == m_wire.elements_end() || i->type() != tlv::ChatroomName)
-    throw Error("Expect Chatroom Name but get ...");
-  m_chatroomName = std::string(reinterpret_cast<const char* >(i->value()),
-                       i->value_size());;
-  i++;
-
-  if (i == m_wire.elements_end() || i->type() != tlv::ChatMessageType)
-    throw Error("Expect Chat Message Type but get ...");
-  m_msgType = static_cast<ChatMessageType>(readNonNegativeInteger(*i));
-  i++;
-
-  if (m_msgType != CHAT)
-    m_data = "";
-  else {
-    if (i == m_wire.elements_end() || i->type() != tlv::ChatData)
-      throw Error("Expect Chat Data but get ...");
-    m_data = std::string(reinterpret_cast<const char* >(i->value()),
-                       i->value_size());;
-    i++;
-  }
-
-  if (i == m_wire.elements_end() || i->type() != tlv::Timestamp)
-    throw Error("Expect Timestamp but get ...");
-  m_timestamp = static_cast<time_t>(readNonNegativeInteger(*i));
-  i++;
-
-  if (i != m_wire.elements_end()) {
-    throw Error("Unexpected element");
-  }
+  Schema::decode(m_wire, *this);
 
+  m_isView = true;
+  if (mode == DECODE_COPY)
+    makeStrings();
+}
+
+void
+ChatMessage::makeStrings() const
+{
+  if (!m_isView)
+    return;
+
+  m_nick = m_nickView.toString();
+  m_chatroomName = m_chatroomNameView.toString();
+  m_data = m_dataView.toString();
+  m_isView = false;
 }
 
 void
 ChatMessage::setNick(const std::string& nick)
 {
+  makeStrings();
   m_wire.reset();
   m_nick = nick;
+  m_hasNick = true;
+}
+
+void
+ChatMessage::removeNick()
+{
+  makeStrings();
+  m_wire.reset();
+  m_nick.clear();
+  m_hasNick = false;
 }
 
 void
 ChatMessage::setChatroomName(const std::string& chatroomName)
 {
+  makeStrings();
   m_wire.reset();
   m_chatroomName = chatroomName;
+  m_hasChatroomName = true;
+}
+
+void
+ChatMessage::removeChatroomName()
+{
+  makeStrings();
+  m_wire.reset();
+  m_chatroomName.clear();
+  m_hasChatroomName = false;
 }
 
 void
 ChatMessage::setMsgType(const ChatMessageType msgType)
 {
+  makeStrings();
   m_wire.reset();
   m_msgType = msgType;
 }
@@ -166,6 +210,7 @@ ChatMessage::setMsgType(const ChatMessageType msgType)
 void
 ChatMessage::setData(const std::string& data)
 {
+  makeStrings();
   m_wire.reset();
   m_data = data;
 }
@@ -173,8 +218,35 @@ ChatMessage::setData(const std::string& data)
 void
 ChatMessage::setTimestamp(const time_t timestamp)
 {
+  makeStrings();
   m_wire.reset();
   m_timestamp = timestamp;
 }
 
+void
+ChatMessage::setPreciseTimestamp(const time::system_clock::TimePoint& timestamp)
+{
+  makeStrings();
+  m_wire.reset();
+  m_preciseTimestamp = timestamp;
+  m_hasPreciseTimestamp = true;
+}
+
+void
+ChatMessage::setHelloInterval(const time::milliseconds& interval)
+{
+  makeStrings();
+  m_wire.reset();
+  m_helloInterval = static_cast<uint64_t>(interval.count());
+  m_hasHelloInterval = true;
+}
+
+void
+ChatMessage::setFileManifest(const FileManifest& manifest)
+{
+  makeStrings();
+  m_wire.reset();
+  m_fileManifest = manifest;
+}
+
 }// namespace chronochat
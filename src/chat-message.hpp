@@ -12,6 +12,8 @@
 
 #include "common.hpp"
 #include "tlv.hpp"
+#include "string-ref.hpp"
+#include "file-manifest.hpp"
 #include <ndn-cxx/util/concepts.hpp>
 #include <ndn-cxx/encoding/block.hpp>
 #include <ndn-cxx/encoding/encoding-buffer.hpp>
@@ -40,6 +42,13 @@ public:
     LEAVE = 2,
     JOIN = 3,
     OTHER = 4,
+    FILE = 5,  ///< shares the file of its FileManifest
+  };
+
+  /// @brief how wireDecode treats the string fields
+  enum DecodeMode {
+    DECODE_COPY, ///< copy them into the message
+    DECODE_VIEW, ///< refer to them in the retained wire, strings are only made on demand
   };
 
 public:
@@ -47,17 +56,25 @@ public:
   ChatMessage();
 
   explicit
-  ChatMessage(const Block& chatMsgWire);
+  ChatMessage(const Block& chatMsgWire, DecodeMode mode = DECODE_COPY);
 
   const Block&
   wireEncode() const;
 
   void
-  wireDecode(const Block& chatMsgWire);
+  wireDecode(const Block& chatMsgWire, DecodeMode mode = DECODE_COPY);
+
+  /// @brief true unless the nick is left out, which the receivers know from the session
+  bool
+  hasNick() const;
 
   const std::string&
   getNick() const;
 
+  /// @brief true unless the chatroom name is left out, which is in the sync prefix
+  bool
+  hasChatroomName() const;
+
   const std::string&
   getChatroomName() const;
 
@@ -67,15 +84,58 @@ public:
   const std::string&
   getData() const;
 
+  /**
+   * @brief get views of the string fields, which copy nothing
+   *
+   * A view is valid until the message is modified or destroyed.  Copies of a message
+   * decoded with DECODE_VIEW share the wire, so their views stay valid as well.
+   */
+  StringRef
+  getNickView() const;
+
+  StringRef
+  getChatroomNameView() const;
+
+  StringRef
+  getDataView() const;
+
   const time_t
   getTimestamp() const;
 
+  /// @brief true if the message carries a millisecond timestamp, messages of older
+  ///        versions only have the timestamp in seconds
+  bool
+  hasPreciseTimestamp() const;
+
+  const time::system_clock::TimePoint&
+  getPreciseTimestamp() const;
+
+  /// @brief true if the message announces the mean interval of the sender's hellos,
+  ///        senders of older versions send one every minute
+  bool
+  hasHelloInterval() const;
+
+  time::milliseconds
+  getHelloInterval() const;
+
+  /// @brief get the manifest of the shared file, only FILE messages have one
+  const FileManifest&
+  getFileManifest() const;
+
   void
   setNick(const std::string& nick);
 
+  /// @brief leave the nick out of the wire, see SessionInfo::FEATURE_COMPACT
+  void
+  removeNick();
+
   void
   setChatroomName(const std::string& chatroomName);
 
+  /// @brief leave the chatroom name out of the wire, see SessionInfo::FEATURE_COMPACT
+  void
+  removeChatroomName();
+
   void
   setMsgType(const ChatMessageType msgType);
 
@@ -85,30 +145,69 @@ public:
   void
   setTimestamp(const time_t timestamp);
 
+  void
+  setPreciseTimestamp(const time::system_clock::TimePoint& timestamp);
+
+  void
+  setHelloInterval(const time::milliseconds& interval);
+
+  void
+  setFileManifest(const FileManifest& manifest);
+
 private:
-  template<bool T>
-  size_t
-  wireEncode(ndn::EncodingImpl<T>& block) const;
+  // TLV schema, see tlv-codec.hpp
+  struct Schema;
+
+  /// @brief copy the viewed string fields into the message
+  void
+  makeStrings() const;
 
 private:
   mutable Block m_wire;
-  std::string m_nick;
-  std::string m_chatroomName;
+  bool m_hasNick;
+  mutable std::string m_nick;
+  bool m_hasChatroomName;
+  mutable std::string m_chatroomName;
   ChatMessageType m_msgType;
-  std::string m_data;
+  mutable std::string m_data;
+  // the string fields in m_wire, used instead of the strings while m_isView
+  mutable bool m_isView;
+  mutable StringRef m_nickView;
+  mutable StringRef m_chatroomNameView;
+  mutable StringRef m_dataView;
   time_t m_timestamp;
-
+  bool m_hasPreciseTimestamp;
+  time::system_clock::TimePoint m_preciseTimestamp;
+  FileManifest m_fileManifest;
+  bool m_hasHelloInterval;
+  uint64_t m_helloInterval;              // milliseconds
 };
 
+inline bool
+ChatMessage::hasNick() const
+{
+  return m_hasNick;
+}
+
 inline const std::string&
 ChatMessage::getNick() const
 {
+  if (m_isView)
+    makeStrings();
   return m_nick;
 }
 
+inline bool
+ChatMessage::hasChatroomName() const
+{
+  return m_hasChatroomName;
+}
+
 inline const std::string&
 ChatMessage::getChatroomName() const
 {
+  if (m_isView)
+    makeStrings();
   return m_chatroomName;
 }
 
@@ -121,15 +220,65 @@ ChatMessage::getMsgType() const
 inline const std::string&
 ChatMessage::getData() const
 {
+  if (m_isView)
+    makeStrings();
   return m_data;
 }
 
+inline StringRef
+ChatMessage::getNickView() const
+{
+  return m_isView ? m_nickView : StringRef(m_nick);
+}
+
+inline StringRef
+ChatMessage::getChatroomNameView() const
+{
+  return m_isView ? m_chatroomNameView : StringRef(m_chatroomName);
+}
+
+inline StringRef
+ChatMessage::getDataView() const
+{
+  return m_isView ? m_dataView : StringRef(m_data);
+}
+
 inline const time_t
 ChatMessage::getTimestamp() const
 {
   return m_timestamp;
 }
 
+inline bool
+ChatMessage::hasPreciseTimestamp() const
+{
+  return m_hasPreciseTimestamp;
+}
+
+inline const time::system_clock::TimePoint&
+ChatMessage::getPreciseTimestamp() const
+{
+  return m_preciseTimestamp;
+}
+
+inline bool
+ChatMessage::hasHelloInterval() const
+{
+  return m_hasHelloInterval;
+}
+
+inline time::milliseconds
+ChatMessage::getHelloInterval() const
+{
+  return time::milliseconds(m_helloInterval);
+}
+
+inline const FileManifest&
+ChatMessage::getFileManifest() const
+{
+  return m_fileManifest;
+}
+
 } // namespace chronochat
 
 #endif //CHRONOCHAT_CHAT_MESSAGE_HPP
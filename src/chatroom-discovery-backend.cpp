@@ -26,13 +26,18 @@ static const ndn::Name::Component ROUTING_HINT_SEPARATOR =
 // a count enforced when a manager himself find another one publish chatroom data
 static const int MAXIMUM_COUNT = 3;
 static const int IDENTITY_OFFSET = -1;
-static const int CONNECTION_RETRY_TIMER = 3;
+// granularity of the chatroom timeouts
+static const time::seconds CHATROOM_TIMEOUT_TICK(1);
 
 ChatroomDiscoveryBackend::ChatroomDiscoveryBackend(const Name& routingPrefix,
                                                    const Name& identity,
+                                                   const shared_ptr<SyncRuntime>& runtime,
                                                    QObject* parent)
-  : QThread(parent)
-  , m_shouldResume(false)
+  : QObject(parent)
+  , m_runtime(runtime)
+  , m_shard(0)
+  , m_isAttached(false)
+  , m_hasFailed(false)
   , m_routingPrefix(routingPrefix)
   , m_identity(identity)
   , m_randomGenerator(static_cast<unsigned int>(std::time(0)))
@@ -48,54 +53,29 @@ ChatroomDiscoveryBackend::ChatroomDiscoveryBackend(const Name& routingPrefix,
 
 ChatroomDiscoveryBackend::~ChatroomDiscoveryBackend()
 {
+  shutdown();
 }
 
 void
-ChatroomDiscoveryBackend::run()
+ChatroomDiscoveryBackend::start()
 {
-  bool shouldResume = false;
-  do {
-    initializeSync();
+  m_shard = m_runtime->attach(this);
+  m_isAttached = true;
 
-    if (m_face == nullptr)
-      break;
+  m_runtime->post(m_shard, [this] { this->initializeSync(); });
+}
 
-    try {
-      m_face->getIoService().run();
-    }
-    catch (std::runtime_error& e) {
-      {
-        std::lock_guard<std::mutex>lock(m_nfdConnectionMutex);
-        m_isNfdConnected = false;
-      }
-      emit nfdError();
-      {
-        std::lock_guard<std::mutex>lock(m_resumeMutex);
-        m_shouldResume = true;
-      }
-#ifdef BOOST_THREAD_USES_CHRONO
-      time::seconds reconnectTimer = time::seconds(CONNECTION_RETRY_TIMER);
-#else
-      boost::posix_time::time_duration reconnectTimer = boost::posix_time::seconds(CONNECTION_RETRY_TIMER);
-#endif
-      while (!m_isNfdConnected) {
-#ifdef BOOST_THREAD_USES_CHRONO
-        boost::this_thread::sleep_for(reconnectTimer);
-#else
-        boost::this_thread::sleep(reconnectTimer);
-#endif
-      }
-    }
-    {
-      std::lock_guard<std::mutex>lock(m_resumeMutex);
-      shouldResume = m_shouldResume;
-      m_shouldResume = false;
-    }
-    close();
+void
+ChatroomDiscoveryBackend::onShardError(const std::runtime_error& e)
+{
+  // all faces of the shard share its connection to the forwarder, which is gone
+  if (m_face == nullptr)
+    return;
 
-  } while (shouldResume);
+  m_hasFailed = true;
+  close();
 
-  std::cerr << "DiscoveryBackend: Bye!" << std::endl;
+  emit nfdError();
 }
 
 void
@@ -103,14 +83,26 @@ ChatroomDiscoveryBackend::initializeSync()
 {
   BOOST_ASSERT(m_sock == nullptr);
 
-  m_face = shared_ptr<ndn::Face>(new ndn::Face);
-  m_scheduler = unique_ptr<ndn::Scheduler>(new ndn::Scheduler(m_face->getIoService()));
+  m_face = m_runtime->makeFace(m_shard);
+  if (m_scheduler == nullptr) {
+    m_scheduler = unique_ptr<ndn::Scheduler>(
+      new ndn::Scheduler(m_runtime->getIoService(m_shard)));
+    m_chatroomWheel = unique_ptr<TimingWheel<ChatroomInfoBackend>>(
+      new TimingWheel<ChatroomInfoBackend>(*m_scheduler, CHATROOM_TIMEOUT_TICK,
+                                           bind(&ChatroomDiscoveryBackend::chatroomsTimeout,
+                                                this, _1)));
+  }
+  m_activeToken = make_shared<bool>(true);
 
+  weak_ptr<bool> activeToken = m_activeToken;
+  auto onUpdate = [this, activeToken] (const std::vector<chronosync::MissingDataInfo>& updates) {
+    if (!activeToken.expired())
+      this->processSyncUpdate(updates);
+  };
   m_sock = make_shared<chronosync::Socket>(m_discoveryPrefix,
                                            Name(),
                                            ref(*m_face),
-                                           bind(&ChatroomDiscoveryBackend::processSyncUpdate,
-                                                this, _1));
+                                           onUpdate);
 
   // add an timer to refresh front end
   if (m_refreshPanelId != nullptr) {
@@ -120,13 +112,43 @@ ChatroomDiscoveryBackend::initializeSync()
                                                 [this] { sendChatroomList(); });
 }
 
+void
+ChatroomDiscoveryBackend::restartSync()
+{
+  if (m_face == nullptr)
+    return;
+
+  close();
+  initializeSync();
+}
+
 void
 ChatroomDiscoveryBackend::close()
 {
+  m_chatroomWheel->clear();
   m_scheduler->cancelAllEvents();
   m_refreshPanelId.reset();
   m_chatroomList.clear();
+
+  // late callbacks of this sync session are ignored from now on
+  m_activeToken.reset();
+
+  // Other clients keep the io_service and the connection of the shard running, so the face
+  // may still dispatch to the socket.  It is released only after the face has shut down,
+  // which withdraws the prefixes of the socket.
+  if (m_face != nullptr) {
+    m_face->shutdown();
+
+    shared_ptr<chronosync::Socket> sock = m_sock;
+    shared_ptr<ndn::Face> face = m_face;
+    m_face->getIoService().post([sock, face] () mutable {
+        sock.reset();
+        face.reset();
+      });
+  }
+
   m_sock.reset();
+  m_face.reset();
 }
 
 void
@@ -135,9 +157,14 @@ ChatroomDiscoveryBackend::processSyncUpdate(const std::vector<chronosync::Missin
   if (updates.empty()) {
     return;
   }
+  weak_ptr<bool> activeToken = m_activeToken;
   for (const auto& update : updates) {
     m_sock->fetchData(update.session, update.high,
-                      bind(&ChatroomDiscoveryBackend::processChatroomData, this, _1), 2);
+                      [this, activeToken] (const shared_ptr<const Data>& data) {
+                        if (!activeToken.expired())
+                          this->processChatroomData(data);
+                      },
+                      2);
   }
 }
 
@@ -180,9 +207,6 @@ ChatroomDiscoveryBackend::processChatroomData(const ndn::shared_ptr<const ndn::D
   }
 
   else if (it->second.isParticipant) {
-    if (it->second.localChatroomTimeoutEventId != nullptr)
-      m_scheduler->cancelEvent(it->second.localChatroomTimeoutEventId);
-
     // If a user start a random timer it means that he think his own chatroom is not alive
     // But when he receive some packet, it means that this chatroom is alive, so he can
     // cancel the timer
@@ -190,10 +214,7 @@ ChatroomDiscoveryBackend::processChatroomData(const ndn::shared_ptr<const ndn::D
       m_scheduler->cancelEvent(it->second.managerSelectionTimeoutEventId);
     it->second.managerSelectionTimeoutEventId = nullptr;
 
-    it->second.localChatroomTimeoutEventId =
-      m_scheduler->scheduleEvent(HELLO_INTERVAL * 3,
-                                 bind(&ChatroomDiscoveryBackend::localSessionTimeout,
-                                      this, chatroomName));
+    m_chatroomWheel->schedule(it->second, HELLO_INTERVAL * 3);
   }
   else {
     if (!data->getContent().empty()) {
@@ -202,13 +223,7 @@ ChatroomDiscoveryBackend::processChatroomData(const ndn::shared_ptr<const ndn::D
       it->second.info = chatroom;
     }
 
-    if (it->second.remoteChatroomTimeoutEventId != nullptr)
-      m_scheduler->cancelEvent(it->second.remoteChatroomTimeoutEventId);
-
-    it->second.remoteChatroomTimeoutEventId =
-      m_scheduler->scheduleEvent(HELLO_INTERVAL * 5,
-                                 bind(&ChatroomDiscoveryBackend::remoteSessionTimeout,
-                                      this, chatroomName));
+    m_chatroomWheel->schedule(it->second, HELLO_INTERVAL * 5);
   }
   // if this is a chatroom that haven't been print on the discovery panel, print it.
   if(!it->second.isPrint) {
@@ -217,6 +232,23 @@ ChatroomDiscoveryBackend::processChatroomData(const ndn::shared_ptr<const ndn::D
   }
 }
 
+void
+ChatroomDiscoveryBackend::chatroomsTimeout(const std::vector<ChatroomInfoBackend*>& chatrooms)
+{
+  // the entries of remote chatrooms are destroyed along the way
+  std::vector<std::pair<Name::Component, bool>> timeouts;
+  for (const ChatroomInfoBackend* chatroom : chatrooms)
+    timeouts.push_back(std::make_pair(Name::Component::fromEscapedString(chatroom->chatroomName),
+                                      chatroom->isParticipant));
+
+  for (const auto& timeout : timeouts) {
+    if (timeout.second)
+      localSessionTimeout(timeout.first);
+    else
+      remoteSessionTimeout(timeout.first);
+  }
+}
+
 void
 ChatroomDiscoveryBackend::localSessionTimeout(const Name::Component& chatroomName)
 {
@@ -294,24 +326,30 @@ void
 ChatroomDiscoveryBackend::updateRoutingPrefix(const QString& routingPrefix)
 {
   Name newRoutingPrefix(routingPrefix.toStdString());
-  if (!newRoutingPrefix.empty() && newRoutingPrefix != m_routingPrefix) {
-    // Update localPrefix
-    m_routingPrefix = newRoutingPrefix;
-
-    updatePrefixes();
-
-    {
-      std::lock_guard<std::mutex>lock(m_resumeMutex);
-      m_shouldResume = true;
-    }
+  m_runtime->post(m_shard, [this, newRoutingPrefix] {
+      if (!newRoutingPrefix.empty() && newRoutingPrefix != m_routingPrefix) {
+        // Update localPrefix
+        m_routingPrefix = newRoutingPrefix;
 
-    m_face->getIoService().stop();
-  }
+        updatePrefixes();
+        restartSync();
+      }
+    });
 }
 
 void
 ChatroomDiscoveryBackend::onEraseInRoster(ndn::Name sessionPrefix,
                                           ndn::Name::Component chatroomName)
+{
+  m_runtime->post(m_shard, [this, sessionPrefix, chatroomName] {
+      if (m_sock != nullptr)
+        eraseInRoster(sessionPrefix, chatroomName);
+    });
+}
+
+void
+ChatroomDiscoveryBackend::eraseInRoster(const Name& sessionPrefix,
+                                        const Name::Component& chatroomName)
 {
   auto it = m_chatroomList.find(chatroomName);
   if (it != m_chatroomList.end()) {
@@ -338,14 +376,7 @@ ChatroomDiscoveryBackend::onEraseInRoster(ndn::Name sessionPrefix,
         m_scheduler->cancelEvent(it->second.helloTimeoutEventId);
       it->second.helloTimeoutEventId = nullptr;
 
-      if (it->second.localChatroomTimeoutEventId != nullptr)
-        m_scheduler->cancelEvent(it->second.localChatroomTimeoutEventId);
-      it->second.localChatroomTimeoutEventId = nullptr;
-
-      it->second.remoteChatroomTimeoutEventId =
-      m_scheduler->scheduleEvent(HELLO_INTERVAL * 5,
-                                bind(&ChatroomDiscoveryBackend::remoteSessionTimeout,
-                                     this, chatroomName));
+      m_chatroomWheel->schedule(it->second, HELLO_INTERVAL * 5);
     }
 
     if (it->second.isManager) {
@@ -357,6 +388,16 @@ ChatroomDiscoveryBackend::onEraseInRoster(ndn::Name sessionPrefix,
 void
 ChatroomDiscoveryBackend::onAddInRoster(ndn::Name sessionPrefix,
                                         ndn::Name::Component chatroomName)
+{
+  m_runtime->post(m_shard, [this, sessionPrefix, chatroomName] {
+      if (m_sock != nullptr)
+        addInRoster(sessionPrefix, chatroomName);
+    });
+}
+
+void
+ChatroomDiscoveryBackend::addInRoster(const Name& sessionPrefix,
+                                      const Name::Component& chatroomName)
 {
   auto it = m_chatroomList.find(chatroomName);
   if (it != m_chatroomList.end()) {
@@ -365,17 +406,27 @@ ChatroomDiscoveryBackend::onAddInRoster(ndn::Name sessionPrefix,
       sendUpdate(chatroomName);
   }
   else {
-    onNewChatroomForDiscovery(chatroomName);
+    addChatroom(chatroomName);
   }
 }
 
 void
 ChatroomDiscoveryBackend::onNewChatroomForDiscovery(ndn::Name::Component chatroomName)
+{
+  m_runtime->post(m_shard, [this, chatroomName] {
+      if (m_sock != nullptr)
+        addChatroom(chatroomName);
+    });
+}
+
+void
+ChatroomDiscoveryBackend::addChatroom(const Name::Component& chatroomName)
 {
   Name newPrefix = m_routableUserDiscoveryPrefix;
   newPrefix.append(chatroomName);
   auto it = m_chatroomList.find(chatroomName);
   if (it == m_chatroomList.end()) {
+    m_chatroomList[chatroomName].chatroomName = chatroomName.toUri();
     m_chatroomList[chatroomName].chatroomPrefix = newPrefix;
     m_chatroomList[chatroomName].isParticipant = true;
     m_chatroomList[chatroomName].isManager = false;
@@ -391,15 +442,9 @@ ChatroomDiscoveryBackend::onNewChatroomForDiscovery(ndn::Name::Component chatroo
     it->second.isManager = false;
     it->second.chatroomPrefix = newPrefix;
 
-    if (it->second.remoteChatroomTimeoutEventId != nullptr)
-      m_scheduler->cancelEvent(it->second.remoteChatroomTimeoutEventId);
     it->second.isPrint = false;
-    it->second.remoteChatroomTimeoutEventId = nullptr;
 
-    it->second.localChatroomTimeoutEventId =
-      m_scheduler->scheduleEvent(HELLO_INTERVAL * 3,
-                                 bind(&ChatroomDiscoveryBackend::localSessionTimeout,
-                                      this, chatroomName));
+    m_chatroomWheel->schedule(it->second, HELLO_INTERVAL * 3);
     emit chatroomInfoRequest(chatroomName.toUri(), false);
   }
 }
@@ -407,32 +452,34 @@ ChatroomDiscoveryBackend::onNewChatroomForDiscovery(ndn::Name::Component chatroo
 void
 ChatroomDiscoveryBackend::onRespondChatroomInfoRequest(ChatroomInfo chatroomInfo, bool isManager)
 {
-  if (isManager)
-    chatroomInfo.setManager(m_routableUserDiscoveryPrefix.getPrefix(IDENTITY_OFFSET));
-  Name::Component chatroomName = chatroomInfo.getName();
-  m_chatroomList[chatroomName].chatroomName = chatroomName.toUri();
-  m_chatroomList[chatroomName].isManager = isManager;
-  m_chatroomList[chatroomName].count = 0;
-  m_chatroomList[chatroomName].info = chatroomInfo;
-  sendChatroomList();
-  onAddInRoster(m_routableUserDiscoveryPrefix.getPrefix(IDENTITY_OFFSET), chatroomName);
+  m_runtime->post(m_shard, [this, chatroomInfo, isManager] () mutable {
+      if (m_sock == nullptr)
+        return;
+
+      if (isManager)
+        chatroomInfo.setManager(m_routableUserDiscoveryPrefix.getPrefix(IDENTITY_OFFSET));
+      Name::Component chatroomName = chatroomInfo.getName();
+      m_chatroomList[chatroomName].chatroomName = chatroomName.toUri();
+      m_chatroomList[chatroomName].isManager = isManager;
+      m_chatroomList[chatroomName].count = 0;
+      m_chatroomList[chatroomName].info = chatroomInfo;
+      sendChatroomList();
+      addInRoster(m_routableUserDiscoveryPrefix.getPrefix(IDENTITY_OFFSET), chatroomName);
+    });
 }
 
 void
 ChatroomDiscoveryBackend::onIdentityUpdated(const QString& identity)
 {
-  m_chatroomList.clear();
-  m_identity = Name(identity.toStdString());
-  m_userDiscoveryPrefix.clear();
-  m_userDiscoveryPrefix.append(m_identity).append("CHRONOCHAT-DISCOVERYDATA");
-  updatePrefixes();
-
-  {
-    std::lock_guard<std::mutex>lock(m_resumeMutex);
-    m_shouldResume = true;
-  }
-
-  m_face->getIoService().stop();
+  Name identityName(identity.toStdString());
+  m_runtime->post(m_shard, [this, identityName] {
+      m_chatroomList.clear();
+      m_identity = identityName;
+      m_userDiscoveryPrefix.clear();
+      m_userDiscoveryPrefix.append(m_identity).append("CHRONOCHAT-DISCOVERYDATA");
+      updatePrefixes();
+      restartSync();
+    });
 }
 
 void
@@ -454,33 +501,49 @@ ChatroomDiscoveryBackend::sendChatroomList()
 void
 ChatroomDiscoveryBackend::onWaitForChatroomInfo(const QString& chatroomName)
 {
-  auto chatroom = m_chatroomList.find(Name::Component(chatroomName.toStdString()));
-  if (chatroom != m_chatroomList.end())
-    emit chatroomInfoReady(chatroom->second.info, chatroom->second.isParticipant);
+  bool isFound = false;
+  ChatroomInfo info;
+  bool isParticipant = false;
+  m_runtime->invoke(m_shard, [&] {
+      auto chatroom = m_chatroomList.find(Name::Component(chatroomName.toStdString()));
+      if (chatroom != m_chatroomList.end()) {
+        isFound = true;
+        info = chatroom->second.info;
+        isParticipant = chatroom->second.isParticipant;
+      }
+    });
+
+  if (isFound)
+    emit chatroomInfoReady(info, isParticipant);
 }
 
 void
 ChatroomDiscoveryBackend::shutdown()
 {
-  {
-    std::lock_guard<std::mutex>lock(m_resumeMutex);
-    m_shouldResume = false;
-  }
+  if (!m_isAttached)
+    return;
 
-  {
-    // In this case, we just stop checking the nfd connection and exit
-    std::lock_guard<std::mutex>lock(m_nfdConnectionMutex);
-    m_isNfdConnected = true;
-  }
+  m_runtime->invoke(m_shard, [this] {
+      if (m_face != nullptr)
+        close();
+      m_chatroomWheel.reset();
+      m_scheduler.reset();
+    });
 
-  m_face->getIoService().stop();
+  m_runtime->detach(m_shard, this);
+  m_isAttached = false;
 }
 
 void
 ChatroomDiscoveryBackend::onNfdReconnect()
 {
-  std::lock_guard<std::mutex>lock(m_nfdConnectionMutex);
-  m_isNfdConnected = true;
+  m_runtime->post(m_shard, [this] {
+      if (!m_hasFailed)
+        return;
+
+      m_hasFailed = false;
+      initializeSync();
+    });
 }
 
 } // namespace chronochat
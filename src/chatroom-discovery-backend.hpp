@@ -11,30 +11,28 @@
 #ifndef CHRONOCHAT_CHATROOM_DISCOVERY_BACKEND_HPP
 #define CHRONOCHAT_CHATROOM_DISCOVERY_BACKEND_HPP
 
-#include <QThread>
+#include <QObject>
 
 #ifndef Q_MOC_RUN
 #include "common.hpp"
 #include "chatroom-info.hpp"
+#include "sync-runtime.hpp"
+#include "timing-wheel.hpp"
 #include <boost/random.hpp>
-#include <mutex>
 #include <socket.hpp>
-#include <boost/thread.hpp>
 #endif
 
 namespace chronochat {
 
-class ChatroomInfoBackend {
+// The entry times the chatroom out unless it is heard from: for a chatroom's user to check
+// whether his own chatroom is alive, for others to check whether the chatroom still exists.
+class ChatroomInfoBackend : public TimingWheel<ChatroomInfoBackend>::Entry {
 public:
   std::string chatroomName;
   Name chatroomPrefix;
   ChatroomInfo info;
-  // For a chatroom's user to check whether his own chatroom is alive
-  ndn::EventId localChatroomTimeoutEventId;
   // If the manager no longer exist, set a random timer to compete for manager
   ndn::EventId managerSelectionTimeoutEventId;
-  // For a user to check the status of the chatroom that he is not in.
-  ndn::EventId remoteChatroomTimeoutEventId;
   // If the user is manager, he will need the helloEventId to keep track of hello message
   ndn::EventId helloTimeoutEventId;
   // To tell whether the user is in this chatroom
@@ -48,26 +46,39 @@ public:
 
 };
 
-class ChatroomDiscoveryBackend : public QThread
+/**
+ * @brief Backend of the chatroom discovery
+ *
+ * The backend lives on a shard of the SyncRuntime like the chatrooms.  The public slots
+ * are called from the GUI thread and hand over to the shard.
+ */
+class ChatroomDiscoveryBackend : public QObject, public SyncRuntime::Client
 {
   Q_OBJECT
 
 public:
   ChatroomDiscoveryBackend(const Name& routingPrefix,
                            const Name& identity,
+                           const shared_ptr<SyncRuntime>& runtime,
                            QObject* parent = nullptr);
 
   ~ChatroomDiscoveryBackend();
 
-
-protected:
+  /// @brief attach to the runtime and start the discovery
   void
-  run();
+  start();
 
 private:
+  virtual void
+  onShardError(const std::runtime_error& e);
+
   void
   initializeSync();
 
+  /// @brief start a new sync session, unless the forwarder is gone
+  void
+  restartSync();
+
   void
   close();
 
@@ -77,6 +88,9 @@ private:
   void
   processChatroomData(const ndn::shared_ptr<const ndn::Data>& data);
 
+  void
+  chatroomsTimeout(const std::vector<ChatroomInfoBackend*>& chatrooms);
+
   void
   localSessionTimeout(const Name::Component& chatroomName);
 
@@ -95,6 +109,15 @@ private:
   void
   sendChatroomList();
 
+  void
+  eraseInRoster(const Name& sessionPrefix, const Name::Component& chatroomName);
+
+  void
+  addInRoster(const Name& sessionPrefix, const Name::Component& chatroomName);
+
+  void
+  addChatroom(const Name::Component& chatroomName);
+
 signals:
   /**
    * @brief request to get chatroom info
@@ -214,8 +237,12 @@ private:
 
   typedef std::map<ndn::Name::Component, ChatroomInfoBackend> ChatroomList;
 
-  bool m_shouldResume;
-  bool m_isNfdConnected;
+  shared_ptr<SyncRuntime> m_runtime;
+  size_t m_shard;                        // shard of m_runtime the backend runs on
+  bool m_isAttached;                     // accessed by GUI thread only
+  bool m_hasFailed;                      // true if waiting for the forwarder to come back
+  shared_ptr<bool> m_activeToken;        // expires when the sync session is closed
+
   Name m_discoveryPrefix;
   Name m_routableUserDiscoveryPrefix;
   Name m_routingPrefix;
@@ -225,16 +252,14 @@ private:
   boost::mt19937 m_randomGenerator;
   boost::variate_generator<boost::mt19937&, boost::uniform_int<> > m_rangeUniformRandom;
 
-  shared_ptr<ndn::Face> m_face;
+  shared_ptr<ndn::Face> m_face;          // shares the connection of the shard
 
   unique_ptr<ndn::Scheduler> m_scheduler;            // scheduler
+  unique_ptr<TimingWheel<ChatroomInfoBackend>> m_chatroomWheel; // chatroom timeouts
   ndn::EventId m_refreshPanelId;
   shared_ptr<chronosync::Socket> m_sock; // SyncSocket
 
   ChatroomList m_chatroomList;
-  std::mutex m_resumeMutex;
-  std::mutex m_nfdConnectionMutex;
-
 };
 
 } // namespace chronochat
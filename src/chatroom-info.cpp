@@ -10,6 +10,7 @@
  *         Qiuhan Ding <qiuhanding@cs.ucla.edu>
  */
 #include "chatroom-info.hpp"
+#include "tlv-codec.hpp"
 
 namespace chronochat {
 
@@ -25,84 +26,51 @@ ChatroomInfo::ChatroomInfo(const Block& chatroomWire)
   this->wireDecode(chatroomWire);
 }
 
-template<bool T>
-size_t
-ChatroomInfo::wireEncode(ndn::EncodingImpl<T>& block) const
+// ChatroomInfo := CHATROOM-INFO-TYPE TLV-LENGTH
+//                   ChatroomName
+//                   TrustModel
+//                   ChatroomPrefix
+//                   ManagerPrefix
+//                   Participants
+//
+// ChatroomName := CHATROOM-NAME-TYPE TLV-LENGTH
+//                   NameComponent
+//
+// TrustModel := TRUST-MODEL-TYPE TLV-LENGTH
+//                 nonNegativeInteger
+//
+// ChatroomPrefix := CHATROOM-PREFIX-TYPE TLV-LENGTH
+//                     Name
+//
+// ManagerPrefix := MANAGER-PREFIX-TYPE TLV-LENGTH
+//                    Name
+//
+// Participants := PARTICIPANTS-TYPE TLV-LENGTH
+//                   Name+
+typedef codec::Fields<ChatroomInfo> ChatroomInfoFields;
+typedef codec::Tlv<tlv::ChatroomName, codec::Wire<Name::Component>> ChatroomNameTlv;
+typedef codec::Tlv<tlv::TrustModel,
+                   codec::NonNegativeInteger<ChatroomInfo::TrustModel>> TrustModelTlv;
+typedef codec::Tlv<tlv::ChatroomPrefix, codec::Wire<Name>> ChatroomPrefixTlv;
+typedef codec::Tlv<tlv::ManagerPrefix, codec::Wire<Name>> ManagerPrefixTlv;
+typedef codec::Tlv<tlv::Participants,
+                   codec::Sequence<codec::Self<ndn::tlv::Name, Name>,
+                                   std::list<Name>>> ParticipantsTlv;
+
+struct ChatroomInfo::Schema
+  : codec::Record<ChatroomInfo, tlv::ChatroomInfo,
+                  ChatroomInfoFields::Required<ChatroomNameTlv, &ChatroomInfo::m_chatroomName>,
+                  ChatroomInfoFields::Required<TrustModelTlv, &ChatroomInfo::m_trustModel>,
+                  ChatroomInfoFields::Required<ChatroomPrefixTlv, &ChatroomInfo::m_syncPrefix>,
+                  ChatroomInfoFields::Required<ManagerPrefixTlv, &ChatroomInfo::m_manager>,
+                  ChatroomInfoFields::Required<ParticipantsTlv, &ChatroomInfo::m_participants>>
 {
-  size_t totalLength = 0;
-
-  // ChatroomInfo := CHATROOM-INFO-TYPE TLV-LENGTH
-  //                   ChatroomName
-  //                   TrustModel
-  //                   ChatroomPrefix
-  //                   ManagerPrefix
-  //                   Participants
-  //
-  // ChatroomName := CHATROOM-NAME-TYPE TLV-LENGTH
-  //                   NameComponent
-  //
-  // TrustModel := TRUST-MODEL-TYPE TLV-LENGTH
-  //                 nonNegativeInteger
-  //
-  // ChatroomPrefix := CHATROOM-PREFIX-TYPE TLV-LENGTH
-  //                     Name
-  //
-  // ManagerPrefix := MANAGER-PREFIX-TYPE TLV-LENGTH
-  //                    Name
-  //
-  // Participants := PARTICIPANTS-TYPE TLV-LENGTH
-  //                   Name+
-
-  // Participants
-  size_t participantsLength = 0;
-  for (std::list<Name>::const_reverse_iterator it = m_participants.rbegin();
-       it != m_participants.rend(); ++it) {
-    participantsLength += it->wireEncode(block);
-  }
-  participantsLength += block.prependVarNumber(participantsLength);
-  participantsLength += block.prependVarNumber(tlv::Participants);
-  totalLength += participantsLength;
-
-  // Manager Prefix
-  size_t managerLength = m_manager.wireEncode(block);
-  totalLength += managerLength;
-  totalLength += block.prependVarNumber(managerLength);
-  totalLength += block.prependVarNumber(tlv::ManagerPrefix);
-
-  // Chatroom Sync Prefix
-  size_t chatroomSyncPrefixLength = m_syncPrefix.wireEncode(block);
-  totalLength += chatroomSyncPrefixLength;
-  totalLength += block.prependVarNumber(chatroomSyncPrefixLength);
-  totalLength += block.prependVarNumber(tlv::ChatroomPrefix);
-
-  // Trust Model
-  totalLength += ndn::prependNonNegativeIntegerBlock(block, tlv::TrustModel, m_trustModel);
-
-  // Chatroom Name
-  size_t chatroomNameLength = m_chatroomName.wireEncode(block);
-  totalLength += chatroomNameLength;
-  totalLength += block.prependVarNumber(chatroomNameLength);
-  totalLength += block.prependVarNumber(tlv::ChatroomName);
-
-  // Chatroom Info
-  totalLength += block.prependVarNumber(totalLength);
-  totalLength += block.prependVarNumber(tlv::ChatroomInfo);
-
-  return totalLength;
-}
+};
 
 const Block&
 ChatroomInfo::wireEncode() const
 {
-  ndn::EncodingEstimator estimator;
-  size_t estimatedSize = wireEncode(estimator);
-
-  ndn::EncodingBuffer buffer(estimatedSize, 0);
-  wireEncode(buffer);
-
-  m_wire = buffer.block();
-  m_wire.parse();
-
+  m_wire = Schema::encode(*this);
   return m_wire;
 }
 
@@ -110,95 +78,7 @@ void
 ChatroomInfo::wireDecode(const Block& chatroomWire)
 {
   m_wire = chatroomWire;
-  m_wire.parse();
-
-  m_participants.clear();
-
-  // ChatroomInfo := CHATROOM-INFO-TYPE TLV-LENGTH
-  //                   ChatroomName
-  //                   TrustModel
-  //                   ChatroomPrefix
-  //                   ManagerPrefix
-  //                   Participants
-  //
-  // ChatroomName := CHATROOM-NAME-TYPE TLV-LENGTH
-  //                   NameComponent
-  //
-  // TrustModel := TRUST-MODEL-TYPE TLV-LENGTH
-  //                 nonNegativeInteger
-  //
-  // ChatroomPrefix := CHATROOM-PREFIX-TYPE TLV-LENGTH
-  //                     Name
-  //
-  // ManagerPrefix := MANAGER-PREFIX-TYPE TLV-LENGTH
-  //                    Name
-  //
-  // Participants := PARTICIPANTS-TYPE TLV-LENGTH
-  //                   Name+
-
-  if (m_wire.type() != tlv::ChatroomInfo)
-    throw Error("Unexpected TLV number when decoding chatroom packet");
-
-  // Chatroom Info
-  Block::element_const_iterator i = m_wire.elements_begin();
-  if (i == m_wire.elements_end())
-    throw Error("Missing Chatroom Name");
-  if (i->type() != tlv::ChatroomName)
-    throw Error("Expect Chatroom Name but get TLV Type " + std::to_string(i->type()));
-  m_chatroomName.wireDecode(i->blockFromValue());
-  ++i;
-
-  // Trust Model
-  if (i == m_wire.elements_end())
-    throw Error("Missing Trust Model");
-  if (i->type() != tlv::TrustModel)
-    throw Error("Expect Trust Model but get TLV Type " + std::to_string(i->type()));
-  m_trustModel =
-      static_cast<TrustModel>(readNonNegativeInteger(*i));
-  ++i;
-
-  // Chatroom Sync Prefix
-  if (i == m_wire.elements_end())
-    throw Error("Missing Chatroom Prefix");
-  if (i->type() != tlv::ChatroomPrefix)
-    throw Error("Expect Chatroom Prefix but get TLV Type " + std::to_string(i->type()));
-  m_syncPrefix.wireDecode(i->blockFromValue());
-  ++i;
-
-  // Manager Prefix
-  if (i == m_wire.elements_end())
-    throw Error("Missing Manager Prefix");
-  if (i->type() != tlv::ManagerPrefix)
-    throw Error("Expect Manager Prefix but get TLV Type " + std::to_string(i->type()));
-  m_manager.wireDecode(i->blockFromValue());
-  ++i;
-
-  // Participants
-  if (i == m_wire.elements_end())
-    throw Error("Missing Participant");
-  if (i->type() != tlv::Participants)
-    throw Error("Expect Participant but get TLV Type " + std::to_string(i->type()));
-
-  Block temp = *i;
-  temp.parse();
-
-  Block::element_const_iterator j = temp.elements_begin();
-
-  while (j != temp.elements_end() && j->type() == tlv::Name) {
-    m_participants.push_back(Name(*j));
-    ++j;
-  }
-  if (j != temp.elements_end())
-    throw Error("Unexpected element");
-
-  if (m_participants.empty())
-    throw Error("No participant in the chatroom");
-
-  ++i;
-
-  if (i != m_wire.elements_end()) {
-    throw Error("Unexpected element");
-  }
+  Schema::decode(m_wire, *this);
 }
 
 void
@@ -95,9 +95,8 @@ public:
   setManager(const Name& manager);
 
 private:
-  template<bool T>
-  size_t
-  wireEncode(ndn::EncodingImpl<T>& block) const;
+  // TLV schema, see tlv-codec.hpp
+  struct Schema;
 
 private:
   mutable Block m_wire;
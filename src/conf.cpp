@@ -8,6 +8,7 @@
  */
 
 #include "conf.hpp"
+#include "tlv-codec.hpp"
 
 namespace chronochat {
 
@@ -23,45 +24,27 @@ Conf::Conf(const Block& confWire)
   this->wireDecode(confWire);
 }
 
-template<bool T>
-size_t
-Conf::wireEncode(ndn::EncodingImpl<T>& block) const
+// Conf := CONF-TYPE TLV-LENGTH
+//           Name
+//           Nick
+//
+// Nick := NICK-TYPE TLV-LENGTH
+//            String
+//
+// Nick is missing in the confs of old versions
+typedef codec::Fields<Conf> ConfFields;
+
+struct Conf::Schema
+  : codec::Record<Conf, tlv::Conf,
+                  ConfFields::Required<codec::Self<ndn::tlv::Name, Name>, &Conf::m_identity>,
+                  ConfFields::Optional<codec::Tlv<tlv::Nick, codec::String>, &Conf::m_nick>>
 {
-  size_t totalLength = 0;
-
-  // Conf := CONF-TYPE TLV-LENGTH
-  //           Name
-  //           Nick
-  //
-  // Nick := NICK-TYPE TLV-LENGTH
-  //            String
-
-  // Nick
-  const uint8_t* nickWire = reinterpret_cast<const uint8_t*>(m_nick.c_str());
-  totalLength += block.prependByteArrayBlock(tlv::Nick, nickWire, m_nick.length());
-
-  // Identity
-  totalLength += m_identity.wireEncode(block);
-
-  // Conf
-  totalLength += block.prependVarNumber(totalLength);
-  totalLength += block.prependVarNumber(tlv::Conf);
-
-  return totalLength;
-}
+};
 
 const Block&
 Conf::wireEncode() const
 {
-  ndn::EncodingEstimator estimator;
-  size_t estimatedSize = wireEncode(estimator);
-
-  ndn::EncodingBuffer buffer(estimatedSize, 0);
-  wireEncode(buffer);
-
-  m_wire = buffer.block();
-  m_wire.parse();
-
+  m_wire = Schema::encode(*this);
   return m_wire;
 }
 
@@ -69,41 +52,7 @@ void
 Conf::wireDecode(const Block& confWire)
 {
   m_wire = confWire;
-  m_wire.parse();
-
-  // Conf := CONF-TYPE TLV-LENGTH
-  //           Name
-  //           Nick
-  //
-  // Nick := NICK-TYPE TLV-LENGTH
-  //            String
-
-  if (m_wire.type() != tlv::Conf)
-    throw Error("Unexpected TLV number when decoding conf packet");
-
-  // Identity
-  Block::element_const_iterator i = m_wire.elements_begin();
-  if (i == m_wire.elements_end())
-    throw Error("Missing Identity");
-  if (i->type() != tlv::Name)
-    throw Error("Expect Identity but get TLV Type " + std::to_string(i->type()));
-
-  m_identity.wireDecode(*i);
-  ++i;
-
-  // Nick
-  if (i == m_wire.elements_end())
-    return;
-  if (i->type() != tlv::Nick)
-    throw Error("Expect Nick but get TLV Type " + std::to_string(i->type()));
-
-  m_nick = std::string(reinterpret_cast<const char* >(i->value()),
-                       i->value_size());
-  ++i;
-
-  if (i != m_wire.elements_end()) {
-    throw Error("Unexpected element");
-  }
+  Schema::decode(m_wire, *this);
 }
 
 void
@@ -110,6 +110,7 @@ ContactManager::initializeSecurity()
 {
   shared_ptr<IdentityCertificate> anchor = loadTrustAnchor();
 
+  // the rules are looser than those of the chatrooms, so the certificates are not shared
   shared_ptr<ValidatorRegex> validator = make_shared<ValidatorRegex>(boost::ref(m_face));
   validator->addDataVerificationRule(make_shared<SecRuleRelative>("^([^<DNS>]*)<DNS><ENDORSED>",
                                                                   "^([^<KEY>]*)<KEY>(<>*)<><ID-CERT>$",
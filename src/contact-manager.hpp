@@ -37,7 +37,8 @@ class ContactManager : public QObject
   Q_OBJECT
 
 public:
-  ContactManager(ndn::Face& m_face, QObject* parent = 0);
+  /// @param face face to fetch contacts and certificates with
+  ContactManager(ndn::Face& face, QObject* parent = 0);
 
   ~ContactManager();
 
@@ -33,13 +33,17 @@ using ndn::OnInterestValidationFailed;
 static const ndn::Name::Component ROUTING_HINT_SEPARATOR =
   ndn::name::Component::fromEscapedString("%F0%2E");
 static const int MAXIMUM_REQUEST = 3;
-static const int CONNECTION_RETRY_TIMER = 3;
 
-ControllerBackend::ControllerBackend(QObject* parent)
-  : QThread(parent)
-  , m_shouldResume(false)
-  , m_contactManager(m_face)
+ControllerBackend::ControllerBackend(const shared_ptr<SyncRuntime>& runtime, QObject* parent)
+  : QObject(parent)
+  , m_runtime(runtime)
+  , m_shard(runtime->attach(this))
+  , m_isAttached(true)
+  , m_hasFailed(false)
+  , m_face(runtime->makeFace(m_shard))
+  , m_contactManager(*m_face)
   , m_invitationListenerId(0)
+  , m_requestListenerId(0)
 {
   // connection to contact manager
   connect(this, SIGNAL(identityUpdated(const QString&)),
@@ -52,51 +56,32 @@ ControllerBackend::ControllerBackend(QObject* parent)
 
 ControllerBackend::~ControllerBackend()
 {
+  shutdown();
+
+  // The face is released on its shard, where it may still be dispatching.  The contact
+  // manager does not use it any more.
+  shared_ptr<ndn::Face> face = m_face;
+  m_face.reset();
+  m_runtime->post(m_shard, [face] () mutable { face.reset(); });
 }
 
 void
-ControllerBackend::run()
+ControllerBackend::start()
 {
-  bool shouldResume = false;
-  do {
-    try {
-      setInvitationListener();
-      m_face.processEvents();
-    }
-    catch (std::runtime_error& e) {
-      {
-        std::lock_guard<std::mutex>lock(m_nfdConnectionMutex);
-        m_isNfdConnected = false;
-      }
-      emit nfdError();
-      {
-        std::lock_guard<std::mutex>lock(m_resumeMutex);
-        m_shouldResume = true;
-      }
-#ifdef BOOST_THREAD_USES_CHRONO
-      time::seconds reconnectTimer = time::seconds(CONNECTION_RETRY_TIMER);
-#else
-      boost::posix_time::time_duration reconnectTimer;
-      reconnectTimer = boost::posix_time::seconds(CONNECTION_RETRY_TIMER);
-#endif
-      while (!m_isNfdConnected) {
-#ifdef BOOST_THREAD_USES_CHRONO
-        boost::this_thread::sleep_for(reconnectTimer);
-#else
-        boost::this_thread::sleep(reconnectTimer);
-#endif
-      }
-    }
-    {
-      std::lock_guard<std::mutex>lock(m_resumeMutex);
-      shouldResume = m_shouldResume;
-      m_shouldResume = false;
-    }
-  } while (shouldResume);
-  std::cerr << "Bye!" << std::endl;
+  m_runtime->post(m_shard, [this] { this->setInvitationListener(); });
 }
 
 // private methods:
+void
+ControllerBackend::onShardError(const std::runtime_error& e)
+{
+  // all faces of the shard share its connection to the forwarder, which is gone
+  if (m_hasFailed)
+    return;
+
+  m_hasFailed = true;
+  emit nfdError();
+}
 
 void
 tmpOnInvitationInterest(const ndn::Name& prefix,
@@ -127,8 +112,6 @@ tmpUnregisterPrefixFailureCallback(const string& failInfo)
 void
 ControllerBackend::setInvitationListener()
 {
-  QMutexLocker locker(&m_mutex);
-
   Name invitationPrefix;
   Name requestPrefix;
   Name routingPrefix = getInvitationRoutingPrefix();
@@ -142,14 +125,14 @@ ControllerBackend::setInvitationListener()
   requestPrefix.append(m_identity).append("CHRONOCHAT-INVITATION-REQUEST");
 
   const ndn::RegisteredPrefixId* invitationListenerId =
-    m_face.setInterestFilter(invitationPrefix,
+    m_face->setInterestFilter(invitationPrefix,
                              bind(&ControllerBackend::onInvitationInterest,
                                   this, _1, _2, offset),
                              bind(&ControllerBackend::onInvitationRegisterFailed,
                                   this, _1, _2));
 
   if (m_invitationListenerId != 0) {
-    m_face.unregisterPrefix(m_invitationListenerId,
+    m_face->unregisterPrefix(m_invitationListenerId,
                             bind(&ControllerBackend::onInvitationPrefixReset, this),
                             bind(&ControllerBackend::onInvitationPrefixResetFailed, this, _1));
   }
@@ -157,13 +140,13 @@ ControllerBackend::setInvitationListener()
   m_invitationListenerId = invitationListenerId;
 
   const ndn::RegisteredPrefixId* requestListenerId =
-    m_face.setInterestFilter(requestPrefix,
+    m_face->setInterestFilter(requestPrefix,
                              bind(&ControllerBackend::onInvitationRequestInterest,
                                   this, _1, _2, offset),
                              [] (const Name& prefix, const std::string& failInfo) {});
 
   if (m_requestListenerId != 0) {
-    m_face.unregisterPrefix(m_requestListenerId,
+    m_face->unregisterPrefix(m_requestListenerId,
                             []{},
                             [] (const std::string& failInfo) {});
   }
@@ -230,7 +213,7 @@ ControllerBackend::onInvitationRequestInterest(const ndn::Name& prefix,
 {
   shared_ptr<const Data> data = m_ims.find(interest);
   if (data != nullptr) {
-    m_face.put(*data);
+    m_face->put(*data);
     return;
   }
   Name interestName = interest.getName();
@@ -342,7 +325,7 @@ void
 ControllerBackend::onRequestTimeout(const Interest& interest, int& resendTimes)
 {
   if (resendTimes < MAXIMUM_REQUEST)
-    m_face.expressInterest(interest,
+    m_face->expressInterest(interest,
                            bind(&ControllerBackend::onRequestResponse, this, _1, _2),
                            bind(&ControllerBackend::onRequestTimeout, this, _1, resendTimes + 1));
   else
@@ -353,62 +336,88 @@ ControllerBackend::onRequestTimeout(const Interest& interest, int& resendTimes)
 void
 ControllerBackend::shutdown()
 {
-  {
-    std::lock_guard<std::mutex>lock(m_resumeMutex);
-    m_shouldResume = false;
-  }
-  {
-    // In this case, we just stop checking the nfd connection and exit
-    std::lock_guard<std::mutex>lock(m_nfdConnectionMutex);
-    m_isNfdConnected = true;
-  }
-  m_face.getIoService().stop();
+  if (!m_isAttached)
+    return;
+
+  // the prefixes of the backend are withdrawn, the connection of the shard stays
+  m_runtime->invoke(m_shard, [this] { m_face->shutdown(); });
+  m_runtime->detach(m_shard, this);
+  m_isAttached = false;
+}
+
+void
+ControllerBackend::onNfdReconnect()
+{
+  m_runtime->post(m_shard, [this] {
+      if (!m_hasFailed)
+        return;
+
+      // the prefixes are gone along with the connection, they are registered anew
+      m_hasFailed = false;
+      m_invitationListenerId = 0;
+      m_requestListenerId = 0;
+      setInvitationListener();
+    });
 }
 
 void
 ControllerBackend::addChatroom(QString chatroom)
 {
-  m_chatDialogList.append(chatroom);
+  m_runtime->post(m_shard, [this, chatroom] { m_chatDialogList.append(chatroom); });
 }
 
 void
 ControllerBackend::removeChatroom(QString chatroom)
 {
-  m_chatDialogList.removeAll(chatroom);
+  m_runtime->post(m_shard, [this, chatroom] { m_chatDialogList.removeAll(chatroom); });
 }
 
 void
 ControllerBackend::onUpdateLocalPrefixAction()
 {
-  Interest interest("/localhop/nfd/rib/routable-prefixes");
-  interest.setInterestLifetime(time::milliseconds(1000));
-  interest.setMustBeFresh(true);
-
-  ndn::util::SegmentFetcher::fetch(m_face,
-                                   interest,
-                                   ndn::util::DontVerifySegment(),
-                                   bind(&ControllerBackend::onLocalPrefix, this, _1),
-                                   bind(&ControllerBackend::onLocalPrefixError, this, _1, _2));
+  m_runtime->post(m_shard, [this] {
+      Interest interest("/localhop/nfd/rib/routable-prefixes");
+      interest.setInterestLifetime(time::milliseconds(1000));
+      interest.setMustBeFresh(true);
+
+      ndn::util::SegmentFetcher::fetch(*m_face,
+                                       interest,
+                                       ndn::util::DontVerifySegment(),
+                                       bind(&ControllerBackend::onLocalPrefix, this, _1),
+                                       bind(&ControllerBackend::onLocalPrefixError,
+                                            this, _1, _2));
+    });
 }
 
 void
 ControllerBackend::onIdentityChanged(const QString& identity)
 {
-  m_chatDialogList.clear();
+  // the contact manager learns the identity after the listeners are set
+  m_runtime->invoke(m_shard, [this, &identity] {
+      m_chatDialogList.clear();
 
-  m_identity = Name(identity.toStdString());
+      m_identity = Name(identity.toStdString());
 
-  std::cerr << "ControllerBackend::onIdentityChanged: " << m_identity << std::endl;
+      std::cerr << "ControllerBackend::onIdentityChanged: " << m_identity << std::endl;
 
-  m_keyChain.createIdentity(m_identity);
+      m_keyChain.createIdentity(m_identity);
 
-  setInvitationListener();
+      setInvitationListener();
+    });
 
   emit identityUpdated(identity);
 }
 
 void
 ControllerBackend::onInvitationResponded(const ndn::Name& invitationName, bool accepted)
+{
+  m_runtime->post(m_shard, [this, invitationName, accepted] {
+      respondToInvitation(invitationName, accepted);
+    });
+}
+
+void
+ControllerBackend::respondToInvitation(const ndn::Name& invitationName, bool accepted)
 {
   shared_ptr<Data> response = make_shared<Data>();
   shared_ptr<IdentityCertificate> chatroomCert;
@@ -438,7 +447,7 @@ ControllerBackend::onInvitationResponded(const ndn::Name& invitationName, bool a
   // Check if we need a wrapper
   Name invitationRoutingPrefix = getInvitationRoutingPrefix();
   if (invitationRoutingPrefix.isPrefixOf(m_identity))
-    m_face.put(*response);
+    m_face->put(*response);
   else {
     Name wrappedName;
     wrappedName.append(invitationRoutingPrefix)
@@ -452,7 +461,7 @@ ControllerBackend::onInvitationResponded(const ndn::Name& invitationName, bool a
     wrappedData->setFreshnessPeriod(time::milliseconds(1000));
 
     m_keyChain.signByIdentity(*wrappedData, m_identity);
-    m_face.put(*wrappedData);
+    m_face->put(*wrappedData);
   }
 
   Invitation invitation(invitationName);
@@ -463,15 +472,17 @@ void
 ControllerBackend::onInvitationRequestResponded(const ndn::Name& invitationResponseName,
                                                 bool accepted)
 {
-  shared_ptr<Data> response = make_shared<Data>(invitationResponseName);
-  if (accepted)
-    response->setContent(ndn::nonNegativeIntegerBlock(tlv::Content, 1));
-  else
-    response->setContent(ndn::nonNegativeIntegerBlock(tlv::Content, 0));
+  m_runtime->post(m_shard, [this, invitationResponseName, accepted] {
+      shared_ptr<Data> response = make_shared<Data>(invitationResponseName);
+      if (accepted)
+        response->setContent(ndn::nonNegativeIntegerBlock(tlv::Content, 1));
+      else
+        response->setContent(ndn::nonNegativeIntegerBlock(tlv::Content, 0));
 
-  m_keyChain.signByIdentity(*response, m_identity);
-  m_ims.insert(*response);
-  m_face.put(*response);
+      m_keyChain.signByIdentity(*response, m_identity);
+      m_ims.insert(*response);
+      m_face->put(*response);
+    });
 }
 
 void
@@ -479,19 +490,22 @@ ControllerBackend::onSendInvitationRequest(const QString& chatroomName, const QS
 {
   if (prefix.length() == 0)
     return;
-  Name interestName = getInvitationRoutingPrefix();
-  interestName.append(ROUTING_HINT_SEPARATOR).append(prefix.toStdString());
-  interestName.append("CHRONOCHAT-INVITATION-REQUEST");
-  interestName.append(chatroomName.toStdString());
-  interestName.append(m_identity);
-  interestName.appendTimestamp();
-  Interest interest(interestName);
-  interest.setInterestLifetime(time::milliseconds(10000));
-  interest.setMustBeFresh(true);
-  interest.getNonce();
-  m_face.expressInterest(interest,
-                         bind(&ControllerBackend::onRequestResponse, this, _1, _2),
-                         bind(&ControllerBackend::onRequestTimeout, this, _1, 0));
+
+  m_runtime->post(m_shard, [this, chatroomName, prefix] {
+      Name interestName = getInvitationRoutingPrefix();
+      interestName.append(ROUTING_HINT_SEPARATOR).append(prefix.toStdString());
+      interestName.append("CHRONOCHAT-INVITATION-REQUEST");
+      interestName.append(chatroomName.toStdString());
+      interestName.append(m_identity);
+      interestName.appendTimestamp();
+      Interest interest(interestName);
+      interest.setInterestLifetime(time::milliseconds(10000));
+      interest.setMustBeFresh(true);
+      interest.getNonce();
+      m_face->expressInterest(interest,
+                              bind(&ControllerBackend::onRequestResponse, this, _1, _2),
+                              bind(&ControllerBackend::onRequestTimeout, this, _1, 0));
+    });
 }
 
 void
@@ -500,18 +514,15 @@ ControllerBackend::onContactIdListReady(const QStringList& list)
   ContactList contactList;
 
   m_contactManager.getContactList(contactList);
-  m_validator.cleanTrustAnchor();
 
-  for (ContactList::const_iterator it  = contactList.begin(); it != contactList.end(); it++)
-    m_validator.addTrustAnchor((*it)->getPublicKeyName(), (*it)->getPublicKey());
+  // the validator is used on the shard
+  m_runtime->post(m_shard, [this, contactList] {
+      m_validator.cleanTrustAnchor();
 
-}
-
-void
-ControllerBackend::onNfdReconnect()
-{
-  std::lock_guard<std::mutex>lock(m_nfdConnectionMutex);
-  m_isNfdConnected = true;
+      for (ContactList::const_iterator it  = contactList.begin();
+           it != contactList.end(); it++)
+        m_validator.addTrustAnchor((*it)->getPublicKeyName(), (*it)->getPublicKey());
+    });
 }
 
 
@@ -12,43 +12,52 @@
 #define CHRONOCHAT_CONTROLLER_BACKEND_HPP
 
 #include <QString>
-#include <QThread>
+#include <QObject>
 #include <QStringList>
-#include <QMutex>
 
 #ifndef Q_MOC_RUN
 #include "common.hpp"
 #include "contact-manager.hpp"
+#include "sync-runtime.hpp"
 #include "invitation.hpp"
 #include "validator-invitation.hpp"
 #include <ndn-cxx/security/key-chain.hpp>
 #include <ndn-cxx/util/in-memory-storage-persistent.hpp>
-#include <boost/thread.hpp>
-#include <mutex>
 #endif
 
 namespace chronochat {
 
-class ControllerBackend : public QThread
+/**
+ * @brief Backend of the invitations and the contacts
+ *
+ * The backend is attached to a shard of the SyncRuntime when it is constructed, its face
+ * is only used on the shard thread, except by the contact manager.  The public slots are
+ * called from the GUI thread and hand over to the shard.
+ */
+class ControllerBackend : public QObject, public SyncRuntime::Client
 {
   Q_OBJECT
 
 public:
-  ControllerBackend(QObject* parent = nullptr);
+  explicit
+  ControllerBackend(const shared_ptr<SyncRuntime>& runtime, QObject* parent = nullptr);
 
   ~ControllerBackend();
 
+  /// @brief start listening to invitations
+  void
+  start();
+
   ContactManager*
   getContactManager()
   {
     return &m_contactManager;
   }
 
-protected:
-  void
-  run();
-
 private:
+  virtual void
+  onShardError(const std::runtime_error& e);
+
   void
   setInvitationListener();
 
@@ -88,6 +97,9 @@ private:
   void
   updateLocalPrefix(const Name& localPrefix);
 
+  void
+  respondToInvitation(const ndn::Name& invitationName, bool accepted);
+
   void
   onRequestResponse(const Interest& interest, Data& data);
 
@@ -123,6 +135,9 @@ public slots:
   void
   shutdown();
 
+  void
+  onNfdReconnect();
+
   void
   addChatroom(QString chatroom);
 
@@ -144,17 +159,16 @@ public slots:
   void
   onSendInvitationRequest(const QString& chatroomName, const QString& prefix);
 
-  void
-  onNfdReconnect();
-
 private slots:
   void
   onContactIdListReady(const QStringList& list);
 
 private:
-  bool m_isNfdConnected;
-  bool m_shouldResume;
-  ndn::Face m_face;
+  shared_ptr<SyncRuntime> m_runtime;
+  size_t m_shard;                        // shard of m_runtime the backend runs on
+  bool m_isAttached;                     // accessed by GUI thread only
+  bool m_hasFailed;                      // true if waiting for the forwarder to come back
+  shared_ptr<ndn::Face> m_face;          // shares the connection of the shard
 
   Name m_identity;  //TODO: set/get
 
@@ -174,10 +188,6 @@ private:
   // ChatRoomList
   QStringList m_chatDialogList;
 
-  QMutex m_mutex;
-  std::mutex m_resumeMutex;
-  std::mutex m_nfdConnectionMutex;
-
   ndn::util::InMemoryStoragePersistent m_ims;
 };
 
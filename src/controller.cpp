@@ -41,6 +41,23 @@ namespace chronochat {
 
 using std::string;
 
+static shared_ptr<CertificateStore>
+makeCertificateStore()
+{
+  // the stored certificates are only valid for the validators of the chatrooms
+  shared_ptr<const ndn::IdentityCertificate> anchor = ChatDialogBackend::loadTrustAnchor();
+  if (anchor == nullptr)
+    return make_shared<CertificateStore>();
+
+  try {
+    return make_shared<CertificateStore>(CertificateStore::getDefaultPath(*anchor), anchor);
+  }
+  catch (const std::exception& e) {
+    _LOG_ERROR("Certificates are kept in memory only: " << e.what());
+    return make_shared<CertificateStore>();
+  }
+}
+
 // constructor & destructor
 Controller::Controller(QWidget* parent)
   : QDialog(parent)
@@ -55,6 +72,11 @@ Controller::Controller(QWidget* parent)
   , m_browseContactDialog(new BrowseContactDialog(this))
   , m_addContactPanel(new AddContactPanel(this))
   , m_discoveryPanel(new DiscoveryPanel(this))
+  , m_certificateStore(makeCertificateStore())
+  , m_syncRuntime(make_shared<SyncRuntime>(SyncRuntime::getDefaultNShards(), &makeNfdFace,
+                                           m_certificateStore))
+  , m_nfdConnectionChecker(m_syncRuntime)
+  , m_backend(m_syncRuntime)
 {
   qRegisterMetaType<ndn::Name>("ndn.Name");
   qRegisterMetaType<ndn::IdentityCertificate>("ndn.IdentityCertificate");
@@ -157,6 +179,13 @@ Controller::Controller(QWidget* parent)
           m_contactPanel, SLOT(onContactInfoReady(const QString&, const QString&,
                                                   const QString&, bool)));
 
+  // Connection to the forwarder, the backends connect again on nfdReconnect()
+  connect(&m_nfdConnectionChecker, SIGNAL(nfdConnected()),
+          this, SLOT(onNfdReconnect()));
+  connect(this, SIGNAL(shutdownNfdChecker()),
+          &m_nfdConnectionChecker, SLOT(shutdown()));
+  m_nfdConnectionChecker.start();
+
   // Connection to backend thread
   connect(&m_backend, SIGNAL(nfdError()),
           this, SLOT(onNfdError()));
@@ -202,6 +231,7 @@ Controller::Controller(QWidget* parent)
   m_chatroomDiscoveryBackend
     = new ChatroomDiscoveryBackend(m_localPrefix,
                                    m_identity,
+                                   m_syncRuntime,
                                    this);
 
   // connect to chatroom discovery back end
@@ -217,10 +247,10 @@ Controller::Controller(QWidget* parent)
           m_chatroomDiscoveryBackend, SLOT(shutdown()));
   connect(this, SIGNAL(identityUpdated(const QString&)),
           m_chatroomDiscoveryBackend, SLOT(onIdentityUpdated(const QString&)));
-  connect(this, SIGNAL(nfdReconnect()),
-          m_chatroomDiscoveryBackend, SLOT(onNfdReconnect()));
   connect(m_chatroomDiscoveryBackend, SIGNAL(nfdError()),
           this, SLOT(onNfdError()));
+  connect(this, SIGNAL(nfdReconnect()),
+          m_chatroomDiscoveryBackend, SLOT(onNfdReconnect()));
 
   // connect chatroom discovery back end with front end
   connect(m_discoveryPanel, SIGNAL(waitForChatroomInfo(const QString&)),
@@ -680,21 +710,14 @@ Controller::onQuitAction()
   delete m_browseContactDialog;
   delete m_addContactPanel;
   delete m_discoveryPanel;
-  if (m_chatroomDiscoveryBackend->isRunning()) {
-    emit shutdownDiscoveryBackend();
-    m_chatroomDiscoveryBackend->wait();
-  }
+  // the backends detach from the runtime, whose connections to the forwarder stay open
+  // until the last chatroom is gone
+  emit shutdownDiscoveryBackend();
   delete m_chatroomDiscoveryBackend;
+  m_chatroomDiscoveryBackend = nullptr;
 
-  if (m_backend.isRunning()) {
-    emit shutdownBackend();
-    m_backend.wait();
-  }
-
-  if (m_nfdConnectionChecker != nullptr && m_nfdConnectionChecker->isRunning()) {
-    emit shutdownNfdChecker();
-    m_nfdConnectionChecker->wait();
-  }
+  emit shutdownBackend();
+  emit shutdownNfdChecker();
 
   QApplication::quit();
 }
@@ -724,7 +747,8 @@ Controller::onStartChatroom(const QString& chatroomName, bool secured)
   chatPrefix.append(m_identity).append("CHRONOCHAT-CHATDATA").append(chatroomName.toStdString());
 
   ChatDialog* chatDialog
-    = new ChatDialog(chatroomPrefix,
+    = new ChatDialog(m_syncRuntime,
+                     chatroomPrefix,
                      chatPrefix,
                      m_localPrefix,
                      chatroomName.toStdString(),
@@ -801,30 +825,19 @@ Controller::onWarning(const QString& msg)
 void
 Controller::onNfdError()
 {
+  // the chatrooms report through here, the checker ignores repeated reports
+  m_nfdConnectionChecker.reportFailure();
+
   if (m_isInConnectionDetection)
     return;
-  // begin a thread
-  
-  m_isInConnectionDetection = true;
-  m_nfdConnectionChecker = new NfdConnectionChecker(this);
-
-  connect(m_nfdConnectionChecker, SIGNAL(nfdConnected()),
-          this, SLOT(onNfdReconnect()));
-  connect(this, SIGNAL(shutdownNfdChecker()),
-          m_nfdConnectionChecker, SLOT(shutdown()));
 
-  m_nfdConnectionChecker->start();
+  m_isInConnectionDetection = true;
   QMessageBox::information(this, tr("ChronoChat"), "Nfd is not running");
 }
 
 void
 Controller::onNfdReconnect()
 {
-  if (m_nfdConnectionChecker != nullptr && m_nfdConnectionChecker->isRunning()) {
-    m_nfdConnectionChecker->wait();
-  }
-  delete m_nfdConnectionChecker;
-  m_nfdConnectionChecker = nullptr;
   m_isInConnectionDetection = false;
   emit nfdReconnect();
 }
@@ -243,9 +243,11 @@ private: // private member
   QSqlDatabase m_db;
 
   // Backend
+  shared_ptr<CertificateStore> m_certificateStore;   // of the validators of the chatrooms
+  shared_ptr<SyncRuntime>    m_syncRuntime;  // shared by all backends and chatrooms
+  NfdConnectionChecker       m_nfdConnectionChecker; // shared by the backends
   ControllerBackend          m_backend;
   ChatroomDiscoveryBackend*  m_chatroomDiscoveryBackend;
-  NfdConnectionChecker*      m_nfdConnectionChecker;
 };
 
 } // namespace chronochat
@@ -25,13 +25,26 @@ namespace chronochat {
 
 static const double Pi = 3.14159265358979323846264338327950288419717;
 static const int NODE_SIZE = 40;
+// larger rosters are laid out on rings
+static const int RING_LAYOUT_SIZE = 32;
+// in milliseconds
+static const int MOVE_DURATION = 300;
+// new nodes glide out of the root from this fraction of their distance
+static const double MOVE_START = 0.2;
 
 //DisplayUserPtr DisplayUserNullPtr;
 
 DigestTreeScene::DigestTreeScene(QWidget *parent)
   : QGraphicsScene(parent)
+  , m_isDetailed(true)
+  , m_nSlots(0)
+  , m_timeLine(new QTimeLine(MOVE_DURATION, this))
 {
   m_previouslyUpdatedUser = DisplayUserNullPtr;
+  plotRoot();
+
+  connect(m_timeLine, SIGNAL(valueChanged(qreal)), this, SLOT(animateMoves(qreal)));
+  connect(m_timeLine, SIGNAL(finished()), this, SLOT(finishMoves()));
 }
 
 void
@@ -42,36 +55,66 @@ DigestTreeScene::processSyncUpdate(const std::vector<chronochat::NodeInfo>& node
 }
 
 void
-DigestTreeScene::updateNode(QString sessionPrefix, QString nick, uint64_t seqNo)
+DigestTreeScene::updateNode(SessionId sessionId, QString nick, uint64_t seqNo)
 {
-  Roster_iterator it = m_roster.find(sessionPrefix);
+  Roster_iterator it = m_roster.find(sessionId);
   if (it == m_roster.end()) {
     DisplayUserPtr p(new DisplayUser());
-    p->setPrefix(sessionPrefix);
+    p->setSessionId(sessionId);
     p->setSeq(seqNo);
-    m_roster.insert(p->getPrefix(), p);
+    p->setSlot(acquireSlot());
+    m_roster.insert(p->getSessionId(), p);
+    addNodeItems(p);
     plot(m_rootDigest);
   }
   else {
     it.value()->setSeq(seqNo);
-    DisplayUserPtr p = it.value();
-    QGraphicsTextItem *item = p->getSeqTextItem();
-    QGraphicsRectItem *rectItem = p->getInnerRectItem();
-    std::string s = boost::lexical_cast<std::string>(p->getSeqNo());
-    item->setPlainText(s.c_str());
-    QRectF textBR = item->boundingRect();
-    QRectF rectBR = rectItem->boundingRect();
-    item->setPos(rectBR.x() + (rectBR.width() - textBR.width())/2,
-                 rectBR.y() + (rectBR.height() - textBR.height())/2);
+    updateSeqText(it.value());
+  }
+  setRootDigest(m_rootDigest);
+  updateNick(sessionId, nick);
+}
+
+void
+DigestTreeScene::updateNodes(const std::vector<chronochat::MessageInfo>& messages)
+{
+  if (messages.empty())
+    return;
+
+  // Update the roster first, so that new sessions cost a single layout.
+  bool needPlot = false;
+  QMap<SessionId, QString> nicks;
+  for (const auto& message : messages) {
+    Roster_iterator it = m_roster.find(message.sessionId);
+    if (it == m_roster.end()) {
+      DisplayUserPtr p(new DisplayUser());
+      p->setSessionId(message.sessionId);
+      p->setNick(message.nick);
+      p->setSlot(acquireSlot());
+      it = m_roster.insert(p->getSessionId(), p);
+      addNodeItems(p);
+      needPlot = true;
+    }
+    it.value()->setSeq(message.seqNo);
+    nicks[message.sessionId] = message.nick;
   }
-  m_displayRootDigest->setPlainText(m_rootDigest);
-  updateNick(sessionPrefix, nick);
+
+  if (needPlot)
+    plot(m_rootDigest);
+  for (QMap<SessionId, QString>::iterator it = nicks.begin(); it != nicks.end(); ++it)
+    updateSeqText(m_roster[it.key()]);
+  setRootDigest(m_rootDigest);
+
+  for (QMap<SessionId, QString>::iterator it = nicks.begin(); it != nicks.end(); ++it)
+    updateNick(it.key(), it.value());
+
+  messageReceived(messages.back().sessionId);
 }
 
 void
-DigestTreeScene::updateNick(QString sessionPrefix, QString nick)
+DigestTreeScene::updateNick(SessionId sessionId, QString nick)
 {
-  Roster_iterator it = m_roster.find(sessionPrefix);
+  Roster_iterator it = m_roster.find(sessionId);
   if (it != m_roster.end()) {
     DisplayUserPtr p = it.value();
     if (nick != p->getNick()) {
@@ -87,9 +130,9 @@ DigestTreeScene::updateNick(QString sessionPrefix, QString nick)
 }
 
 void
-DigestTreeScene::messageReceived(QString sessionPrefix)
+DigestTreeScene::messageReceived(SessionId sessionId)
 {
-  Roster_iterator it = m_roster.find(sessionPrefix);
+  Roster_iterator it = m_roster.find(sessionId);
   if (it != m_roster.end()) {
     DisplayUserPtr p = it.value();
 
@@ -106,14 +149,29 @@ DigestTreeScene::messageReceived(QString sessionPrefix)
 void
 DigestTreeScene::clearAll()
 {
-  clear();
+  m_timeLine->stop();
+  m_moves.clear();
+
+  for (Roster_iterator it = m_roster.begin(); it != m_roster.end(); ++it)
+    removeNodeItems(it.value());
   m_roster.clear();
+  m_previouslyUpdatedUser = DisplayUserNullPtr;
+  m_freeSlots.clear();
+  m_nSlots = 0;
 }
 
 void
-DigestTreeScene::removeNode(const QString sessionPrefix)
+DigestTreeScene::removeNode(SessionId sessionId)
 {
-  m_roster.remove(sessionPrefix);
+  Roster_iterator it = m_roster.find(sessionId);
+  if (it == m_roster.end())
+    return;
+
+  if (it.value() == m_previouslyUpdatedUser)
+    m_previouslyUpdatedUser = DisplayUserNullPtr;
+  removeNodeItems(it.value());
+  releaseSlot(it.value()->getSlot());
+  m_roster.erase(it);
   plot(m_rootDigest);
 }
 
@@ -132,127 +190,241 @@ DigestTreeScene::getRosterList()
   return rosterList;
 }
 
-QStringList
-DigestTreeScene::getRosterPrefixList()
+QList<SessionId>
+DigestTreeScene::getRosterSessionIds()
+{
+  return m_roster.keys();
+}
+
+void
+DigestTreeScene::plot(QString rootDigest)
 {
-  QStringList prefixList;
+  setRootDigest(rootDigest);
+
+  shared_ptr<TreeLayout> layout;
+  if (m_roster.size() <= RING_LAYOUT_SIZE) {
+    layout = make_shared<OneLevelTreeLayout>();
+    layout->setLevelDistance(100);
+  }
+  else {
+    // the first ring clears the digest above the root
+    layout = make_shared<RingTreeLayout>();
+    layout->setLevelDistance(300);
+  }
+  layout->setSiblingDistance(100);
+
+  // a move under way goes on from where the node is now
+  m_timeLine->stop();
+  m_moves.clear();
+
   RosterIterator it(m_roster);
   while (it.hasNext()) {
     it.next();
     DisplayUserPtr p = it.value();
-    if (p != DisplayUserNullPtr) {
-      prefixList << p->getPrefix();
+    Move move = {p, p->getPosition(), layout->getSlotPosition(p->getSlot())};
+    if (p->isPlacedAt(move.to))
+      continue;
+
+    if (!p->isPlaced()) {
+      move.from.x = move.to.x * MOVE_START;
+      move.from.y = move.to.y * MOVE_START;
+      placeNode(p, move.from);
     }
+    m_moves.push_back(move);
   }
-  return prefixList;
+
+  if (!m_moves.empty())
+    m_timeLine->start();
 }
 
 void
-DigestTreeScene::plot(QString rootDigest)
+DigestTreeScene::animateMoves(qreal progress)
 {
-  clear();
+  for (const Move& move : m_moves) {
+    TreeLayout::Coordinate position;
+    position.x = move.from.x + (move.to.x - move.from.x) * progress;
+    position.y = move.from.y + (move.to.y - move.from.y) * progress;
+    placeNode(move.user, position);
+  }
+}
 
-  shared_ptr<TreeLayout> layout(new OneLevelTreeLayout());
-  layout->setSiblingDistance(100);
-  layout->setLevelDistance(100);
+void
+DigestTreeScene::finishMoves()
+{
+  m_timeLine->stop();
+  for (const Move& move : m_moves)
+    placeNode(move.user, move.to);
+  m_moves.clear();
+}
 
-  std::vector<TreeLayout::Coordinate> childNodesCo(m_roster.size());
-  layout->setOneLevelLayout(childNodesCo);
-  plotEdge(childNodesCo, NODE_SIZE);
-  plotNode(childNodesCo, rootDigest, NODE_SIZE);
+size_t
+DigestTreeScene::acquireSlot()
+{
+  if (m_freeSlots.empty())
+    return m_nSlots++;
 
-  m_previouslyUpdatedUser = DisplayUserNullPtr;
+  size_t slot = *m_freeSlots.begin();
+  m_freeSlots.erase(m_freeSlots.begin());
+  return slot;
 }
 
 void
-DigestTreeScene::plotEdge(const std::vector<TreeLayout::Coordinate> &childNodesCo, int nodeSize)
+DigestTreeScene::releaseSlot(size_t slot)
 {
-  int n = childNodesCo.size();
-  for (int i = 0; i < n; i++) {
-    double x1 = 0.0, y1 = 0.0;
-    double x2 = childNodesCo[i].x, y2 = childNodesCo[i].y;
-    QPointF src(x1 + nodeSize/2, y1 + nodeSize/2);
-    QPointF dest(x2 + nodeSize/2, y2 + nodeSize/2);
-    QLineF line(src, dest);
-    double angle = ::acos(line.dx() / line.length());
-
-    double arrowSize = 10;
-    QPointF sourceArrowP0 = src + QPointF((nodeSize/2 + 10) * line.dx() / line.length(),
-                                          (nodeSize/2 +10) * line.dy() / line.length());
-    QPointF sourceArrowP1 = sourceArrowP0 + QPointF(cos(angle + Pi / 3 - Pi/2) * arrowSize,
-                                                    sin(angle + Pi / 3 - Pi/2) * arrowSize);
-    QPointF sourceArrowP2 = sourceArrowP0 + QPointF(cos(angle + Pi - Pi / 3 - Pi/2) * arrowSize,
-                                                    sin(angle + Pi - Pi / 3 - Pi/2) * arrowSize);
-
-    addLine(QLineF(sourceArrowP0, dest), QPen(Qt::black));
-    addPolygon(QPolygonF() << sourceArrowP0<< sourceArrowP1 <<
-               sourceArrowP2, QPen(Qt::black), QBrush(Qt::black));
+  m_freeSlots.insert(slot);
+
+  // the free slots at the end are dropped, so that the layout does not keep growing
+  while (!m_freeSlots.empty() && *m_freeSlots.rbegin() == m_nSlots - 1) {
+    m_freeSlots.erase(--m_freeSlots.end());
+    m_nSlots--;
   }
 }
 
 void
-DigestTreeScene::plotNode(const std::vector<TreeLayout::Coordinate>& childNodesCo,
-                          QString digest, int nodeSize)
+DigestTreeScene::plotRoot()
 {
-  RosterIterator it(m_roster);
-  int n = childNodesCo.size();
   int rim = 3;
 
-  // plot root node
-  QRectF rootBoundingRect(0, 0, nodeSize, nodeSize);
-  QRectF rootInnerBoundingRect(rim, rim, nodeSize - rim * 2, nodeSize - rim * 2);
+  QRectF rootBoundingRect(0, 0, NODE_SIZE, NODE_SIZE);
+  QRectF rootInnerBoundingRect(rim, rim, NODE_SIZE - rim * 2, NODE_SIZE - rim * 2);
   addRect(rootBoundingRect, QPen(Qt::black), QBrush(Qt::darkRed));
   addRect(rootInnerBoundingRect, QPen(Qt::black), QBrush(Qt::lightGray));
-  QRectF digestRect(- 5.5 * nodeSize , - nodeSize, 12 * nodeSize, 30);
+  QRectF digestRect(- 5.5 * NODE_SIZE , - NODE_SIZE, 12 * NODE_SIZE, 30);
   addRect(digestRect, QPen(Qt::darkCyan), QBrush(Qt::darkCyan));
 
-  QGraphicsTextItem *digestItem = addText(digest);
-  QRectF digestBoundingRect = digestItem->boundingRect();
-  digestItem->setDefaultTextColor(Qt::black);
-  digestItem->setFont(QFont("Cursive", 12, QFont::Bold));
-  digestItem->setPos(- 4.5 * nodeSize + (12 * nodeSize - digestBoundingRect.width()) / 2,
-                     - nodeSize + 5);
-  m_displayRootDigest = digestItem;
-
-  // plot child nodes
-  for (int i = 0; i < n; i++) {
-    if (it.hasNext())
-      it.next();
-    else
-      abort();
-
-    double x = childNodesCo[i].x;
-    double y = childNodesCo[i].y;
-    QRectF boundingRect(x, y, nodeSize, nodeSize);
-    QRectF innerBoundingRect(x + rim, y + rim, nodeSize - rim * 2, nodeSize - rim * 2);
-    DisplayUserPtr p = it.value();
-    QGraphicsRectItem *rectItem = addRect(boundingRect, QPen(Qt::black), QBrush(Qt::darkBlue));
-    p->setRimRectItem(rectItem);
+  m_displayRootDigest = addText("");
+  m_displayRootDigest->setDefaultTextColor(Qt::black);
+  m_displayRootDigest->setFont(QFont("Cursive", 12, QFont::Bold));
+}
+
+void
+DigestTreeScene::setRootDigest(const QString& digest)
+{
+  if (m_displayRootDigest->toPlainText() == digest)
+    return;
+
+  m_displayRootDigest->setPlainText(digest);
+  QRectF digestBoundingRect = m_displayRootDigest->boundingRect();
+  m_displayRootDigest->setPos(- 4.5 * NODE_SIZE +
+                              (12 * NODE_SIZE - digestBoundingRect.width()) / 2,
+                              - NODE_SIZE + 5);
+}
 
-    QGraphicsRectItem *innerRectItem = addRect(innerBoundingRect,
-                                               QPen(Qt::black),
-                                               QBrush(Qt::lightGray));
-    p->setInnerRectItem(innerRectItem);
+void
+DigestTreeScene::addNodeItems(DisplayUserPtr p)
+{
+  int rim = 3;
 
-    std::string s = boost::lexical_cast<std::string>(p->getSeqNo());
-    QGraphicsTextItem *seqItem = addText(s.c_str());
-    seqItem->setFont(QFont("Cursive", 12, QFont::Bold));
-    QRectF seqBoundingRect = seqItem->boundingRect();
-    seqItem->setPos(x + nodeSize / 2 - seqBoundingRect.width() / 2,
-                    y + nodeSize / 2 - seqBoundingRect.height() / 2);
-    p->setSeqTextItem(seqItem);
-
-    QRectF textRect(x - nodeSize / 2, y + nodeSize, 2 * nodeSize, 30);
-    QGraphicsRectItem *nickRectItem = addRect(textRect, QPen(Qt::darkCyan), QBrush(Qt::darkCyan));
-    p->setNickRectItem(nickRectItem);
-    QGraphicsTextItem *nickItem = addText(p->getNick());
-    QRectF textBoundingRect = nickItem->boundingRect();
-    nickItem->setDefaultTextColor(Qt::white);
-    nickItem->setFont(QFont("Cursive", 12, QFont::Bold));
-    nickItem->setPos(x + nodeSize / 2 - textBoundingRect.width() / 2, y + nodeSize + 5);
-    p->setNickTextItem(nickItem);
-  }
+  // the other items are children of the rim, in its coordinates
+  QGraphicsRectItem *rectItem = addRect(QRectF(0, 0, NODE_SIZE, NODE_SIZE),
+                                        QPen(Qt::black), QBrush(Qt::darkBlue));
+  p->setRimRectItem(rectItem);
+
+  QGraphicsRectItem *innerRectItem =
+    new QGraphicsRectItem(QRectF(rim, rim, NODE_SIZE - rim * 2, NODE_SIZE - rim * 2), rectItem);
+  innerRectItem->setPen(QPen(Qt::black));
+  innerRectItem->setBrush(QBrush(Qt::lightGray));
+  p->setInnerRectItem(innerRectItem);
+
+  QGraphicsTextItem *seqItem = new QGraphicsTextItem(rectItem);
+  seqItem->setFont(QFont("Cursive", 12, QFont::Bold));
+  p->setSeqTextItem(seqItem);
+  updateSeqText(p);
+
+  QGraphicsRectItem *nickRectItem =
+    new QGraphicsRectItem(QRectF(- NODE_SIZE / 2, NODE_SIZE, 2 * NODE_SIZE, 30), rectItem);
+  nickRectItem->setPen(QPen(Qt::darkCyan));
+  nickRectItem->setBrush(QBrush(Qt::darkCyan));
+  p->setNickRectItem(nickRectItem);
+
+  QGraphicsTextItem *nickItem = new QGraphicsTextItem(p->getNick(), rectItem);
+  nickItem->setDefaultTextColor(Qt::white);
+  nickItem->setFont(QFont("Cursive", 12, QFont::Bold));
+  QRectF textBoundingRect = nickItem->boundingRect();
+  nickItem->setPos(NODE_SIZE / 2 - textBoundingRect.width() / 2, NODE_SIZE + 5);
+  p->setNickTextItem(nickItem);
+
+  // below the nodes
+  QGraphicsLineItem* edgeItem = addLine(QLineF(), QPen(Qt::black));
+  edgeItem->setZValue(-1);
+  QGraphicsPolygonItem* arrowItem = addPolygon(QPolygonF(), QPen(Qt::black), QBrush(Qt::black));
+  arrowItem->setZValue(-1);
+  p->setEdgeItems(edgeItem, arrowItem);
+
+  if (!m_isDetailed)
+    showNodeDetails(p, false);
+}
+
+void
+DigestTreeScene::removeNodeItems(DisplayUserPtr p)
+{
+  // the children go with the rim
+  delete p->getRimRectItem();
+  delete p->getEdgeItem();
+  delete p->getArrowItem();
+  p->setRimRectItem(NULL);
+  p->setEdgeItems(NULL, NULL);
+}
+
+void
+DigestTreeScene::placeNode(DisplayUserPtr p, const TreeLayout::Coordinate& position)
+{
+  p->setPosition(position);
+  p->getRimRectItem()->setPos(position.x, position.y);
+
+  // the edge points from the root to the node
+  QPointF src(NODE_SIZE / 2, NODE_SIZE / 2);
+  QPointF dest(position.x + NODE_SIZE / 2, position.y + NODE_SIZE / 2);
+  QLineF line(src, dest);
+  double angle = ::atan2(line.dy(), line.dx());
+
+  double arrowSize = 10;
+  QPointF sourceArrowP0 = src + QPointF((NODE_SIZE / 2 + 10) * line.dx() / line.length(),
+                                        (NODE_SIZE / 2 + 10) * line.dy() / line.length());
+  QPointF sourceArrowP1 = sourceArrowP0 + QPointF(cos(angle + Pi / 3 - Pi/2) * arrowSize,
+                                                  sin(angle + Pi / 3 - Pi/2) * arrowSize);
+  QPointF sourceArrowP2 = sourceArrowP0 + QPointF(cos(angle + Pi - Pi / 3 - Pi/2) * arrowSize,
+                                                  sin(angle + Pi - Pi / 3 - Pi/2) * arrowSize);
+
+  p->getEdgeItem()->setLine(QLineF(sourceArrowP0, dest));
+  p->getArrowItem()->setPolygon(QPolygonF() << sourceArrowP0 << sourceArrowP1 << sourceArrowP2);
+}
+
+void
+DigestTreeScene::setLevelOfDetail(double scale)
+{
+  bool isDetailed = scale >= LEVEL_OF_DETAIL_SCALE;
+  if (isDetailed == m_isDetailed)
+    return;
+
+  m_isDetailed = isDetailed;
+  for (Roster_iterator it = m_roster.begin(); it != m_roster.end(); ++it)
+    showNodeDetails(it.value(), isDetailed);
+}
 
+void
+DigestTreeScene::showNodeDetails(DisplayUserPtr p, bool isDetailed)
+{
+  // hidden items are not painted
+  p->getInnerRectItem()->setVisible(isDetailed);
+  p->getSeqTextItem()->setVisible(isDetailed);
+  p->getNickRectItem()->setVisible(isDetailed);
+  p->getNickTextItem()->setVisible(isDetailed);
+  p->getEdgeItem()->setVisible(isDetailed);
+  p->getArrowItem()->setVisible(isDetailed);
+}
+
+void
+DigestTreeScene::updateSeqText(DisplayUserPtr p)
+{
+  QGraphicsTextItem *item = p->getSeqTextItem();
+  QGraphicsRectItem *rectItem = p->getInnerRectItem();
+  std::string s = boost::lexical_cast<std::string>(p->getSeqNo());
+  item->setPlainText(s.c_str());
+  QRectF textBR = item->boundingRect();
+  QRectF rectBR = rectItem->boundingRect();
+  item->setPos(rectBR.x() + (rectBR.width() - textBR.width())/2,
+               rectBR.y() + (rectBR.height() - textBR.height())/2);
 }
 
 void
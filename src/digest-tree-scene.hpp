@@ -20,21 +20,23 @@
 #include "tree-layout.hpp"
 #include "chat-dialog-backend.hpp"
 #include <ctime>
+#include <set>
 #include <vector>
 #endif
 
 const int FRESHNESS = 60;
 
 class QGraphicsTextItem;
+class QTimeLine;
 
 namespace chronochat {
 
 class User;
 class DisplayUser;
 typedef std::shared_ptr<DisplayUser> DisplayUserPtr;
-typedef QMap<QString, DisplayUserPtr> Roster;
-typedef QMap<QString, DisplayUserPtr>::iterator Roster_iterator;
-typedef QMapIterator<QString, DisplayUserPtr> RosterIterator;
+typedef QMap<SessionId, DisplayUserPtr> Roster;
+typedef QMap<SessionId, DisplayUserPtr>::iterator Roster_iterator;
+typedef QMapIterator<SessionId, DisplayUserPtr> RosterIterator;
 
 static DisplayUserPtr DisplayUserNullPtr;
 
@@ -51,39 +53,89 @@ public:
                     const QString& digest);
 
   void
-  updateNode(QString sessionPrefix, QString nick, uint64_t seqNo);
+  updateNode(SessionId sessionId, QString nick, uint64_t seqNo);
 
   void
-  updateNick(QString sessionPrefix, QString nick);
+  updateNick(SessionId sessionId, QString nick);
 
+  /// @brief update the nodes of all @p messages, the scene is replotted at most once
   void
-  messageReceived(QString sessionPrefix);
+  updateNodes(const std::vector<chronochat::MessageInfo>& messages);
 
+  void
+  messageReceived(SessionId sessionId);
+
+  /// @brief remove all nodes but the root
   void
   clearAll();
 
   void
-  removeNode(const QString sessionPrefix);
+  removeNode(SessionId sessionId);
 
   QStringList
   getRosterList();
 
-  QStringList
-  getRosterPrefixList();
+  QList<SessionId>
+  getRosterSessionIds();
 
+  /**
+   * @brief show @p rootDigest and lay out the nodes
+   *
+   * Every node keeps its slot of the layout while others join and leave, so only new nodes
+   * and, when the roster crosses RING_LAYOUT_SIZE, the others glide to their place.
+   */
   void
   plot(QString rootDigest);
 
+  /**
+   * @brief draw the nodes as plain squares if the view shows the scene below LEVEL_OF_DETAIL_SCALE
+   *
+   * @param scale of the view showing the scene
+   */
+  void
+  setLevelOfDetail(double scale);
+
+public slots:
+  /// @brief put the moving nodes in their place at once, e.g., without an event loop
+  void
+  finishMoves();
+
+private slots:
+  void
+  animateMoves(qreal progress);
+
 private:
   void
-  plotEdge(const std::vector<chronochat::TreeLayout::Coordinate>& v, int nodeSize);
+  plotRoot();
+
+  /// @brief get the lowest free slot of the layout
+  size_t
+  acquireSlot();
+
+  void
+  releaseSlot(size_t slot);
+
+  void
+  setRootDigest(const QString& digest);
 
   void
-  plotNode(const std::vector<chronochat::TreeLayout::Coordinate>& v, QString digest, int nodeSize);
+  addNodeItems(DisplayUserPtr p);
+
+  void
+  removeNodeItems(DisplayUserPtr p);
+
+  void
+  placeNode(DisplayUserPtr p, const TreeLayout::Coordinate& position);
+
+  void
+  showNodeDetails(DisplayUserPtr p, bool isDetailed);
 
   void
   reDrawNode(DisplayUserPtr p, QColor rimColor);
 
+  void
+  updateSeqText(DisplayUserPtr p);
+
 private:
   Roster m_roster;
 
@@ -91,18 +143,33 @@ private:
   QGraphicsTextItem* m_displayRootDigest;
 
   DisplayUserPtr m_previouslyUpdatedUser;
+  bool m_isDetailed;
+
+  // the slots below m_nSlots which no node holds
+  std::set<size_t> m_freeSlots;
+  size_t m_nSlots;
+
+  struct Move
+  {
+    DisplayUserPtr user;
+    TreeLayout::Coordinate from;
+    TreeLayout::Coordinate to;
+  };
+  QTimeLine* m_timeLine;
+  std::vector<Move> m_moves;
 };
 
 class User
 {
 public:
   User()
+    : m_sessionId(0)
   {
   }
 
-  User(QString n, QString p)
+  User(QString n, SessionId id)
     : m_nick(n)
-    , m_prefix(p)
+    , m_sessionId(id)
   {
   }
 
@@ -113,9 +180,9 @@ public:
   }
 
   void
-  setPrefix(QString prefix)
+  setSessionId(SessionId id)
   {
-    m_prefix = prefix;
+    m_sessionId = id;
   }
 
   void
@@ -130,9 +197,10 @@ public:
     return m_nick;
   }
 
-  QString getPrefix()
+  SessionId
+  getSessionId()
   {
-    return m_prefix;
+    return m_sessionId;
   }
 
   chronosync::SeqNo
@@ -143,7 +211,7 @@ public:
 
 private:
   QString m_nick;
-  QString m_prefix;
+  SessionId m_sessionId;
   chronosync::SeqNo m_seq;
 };
 
@@ -154,14 +222,26 @@ public:
     : m_seqTextItem(NULL)
     , m_nickTextItem(NULL)
     , m_rimRectItem(NULL)
+    , m_innerRectItem(NULL)
+    , m_nickRectItem(NULL)
+    , m_edgeItem(NULL)
+    , m_arrowItem(NULL)
+    , m_slot(0)
+    , m_isPlaced(false)
   {
   }
 
-  DisplayUser(QString n, QString p)
-    : User(n, p)
+  DisplayUser(QString n, SessionId id)
+    : User(n, id)
     , m_seqTextItem(NULL)
     , m_nickTextItem(NULL)
     , m_rimRectItem(NULL)
+    , m_innerRectItem(NULL)
+    , m_nickRectItem(NULL)
+    , m_edgeItem(NULL)
+    , m_arrowItem(NULL)
+    , m_slot(0)
+    , m_isPlaced(false)
   {
   }
 
@@ -225,12 +305,76 @@ public:
     m_nickRectItem = item;
   }
 
+  QGraphicsLineItem*
+  getEdgeItem()
+  {
+    return m_edgeItem;
+  }
+
+  QGraphicsPolygonItem*
+  getArrowItem()
+  {
+    return m_arrowItem;
+  }
+
+  void
+  setEdgeItems(QGraphicsLineItem* edgeItem, QGraphicsPolygonItem* arrowItem)
+  {
+    m_edgeItem = edgeItem;
+    m_arrowItem = arrowItem;
+  }
+
+  size_t
+  getSlot()
+  {
+    return m_slot;
+  }
+
+  void
+  setSlot(size_t slot)
+  {
+    m_slot = slot;
+  }
+
+  bool
+  isPlaced()
+  {
+    return m_isPlaced;
+  }
+
+  /// @brief true if the node is at @p position already
+  bool
+  isPlacedAt(const TreeLayout::Coordinate& position)
+  {
+    return m_isPlaced && m_position.x == position.x && m_position.y == position.y;
+  }
+
+  const TreeLayout::Coordinate&
+  getPosition()
+  {
+    return m_position;
+  }
+
+  void
+  setPosition(const TreeLayout::Coordinate& position)
+  {
+    m_position = position;
+    m_isPlaced = true;
+  }
+
 private:
+  // the rim rect is the parent of the other items of the node, which move with it
   QGraphicsTextItem* m_seqTextItem;
   QGraphicsTextItem* m_nickTextItem;
   QGraphicsRectItem* m_rimRectItem;
   QGraphicsRectItem* m_innerRectItem;
   QGraphicsRectItem* m_nickRectItem;
+  // the edge from the root is in scene coordinates
+  QGraphicsLineItem* m_edgeItem;
+  QGraphicsPolygonItem* m_arrowItem;
+  size_t m_slot;
+  TreeLayout::Coordinate m_position;
+  bool m_isPlaced;
 };
 
 } // namespace chronochat
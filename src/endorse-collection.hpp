@@ -60,9 +60,8 @@ public:
   addCollectionEntry(const Name& certName, const std::string& hash);
 
 private:
-  template<bool T>
-  size_t
-  wireEncode(ndn::EncodingImpl<T>& block) const;
+  // TLV schema, see tlv-codec.hpp
+  struct Schema;
 
 private:
   mutable Block m_wire;
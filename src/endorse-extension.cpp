@@ -8,6 +8,7 @@
  */
 
 #include "endorse-extension.hpp"
+#include "tlv-codec.hpp"
 
 namespace chronochat {
 
@@ -23,45 +24,25 @@ EndorseExtension::EndorseExtension(const Block& endorseWire)
   this->wireDecode(endorseWire);
 }
 
-template<bool T>
-size_t
-EndorseExtension::wireEncode(ndn::EncodingImpl<T>& block) const
+// EndorseExtension := ENDORSE-EXTENSION-TYPE TLV-LENGTH
+//                       EntryData+
+//
+// EntryData := ENTRYDATA-TYPE TLV-LENGTH
+//                String
+//
+struct EndorseExtension::Schema
+  : codec::Record<EndorseExtension, tlv::EndorseExtension,
+                  codec::Fields<EndorseExtension>::Repeated<codec::Tlv<tlv::EntryData,
+                                                                       codec::String>,
+                                                            std::list<std::string>,
+                                                            &EndorseExtension::m_entries>>
 {
-  size_t totalLength = 0;
-
-  // EndorseExtension := ENDORSE-EXTENSION-TYPE TLV-LENGTH
-  //                       EntryData+
-  //
-  // EntryData := ENTRYDATA-TYPE TLV-LENGTH
-  //                String
-  //
-
-  // EntryData
-  for (std::list<std::string>::const_reverse_iterator it = m_entries.rbegin();
-       it != m_entries.rend(); it++) {
-    const uint8_t *entryWire = reinterpret_cast<const uint8_t*>(it->c_str());
-    totalLength += block.prependByteArrayBlock(tlv::EntryData, entryWire, it->length());
-  }
-
-  // EndorseExtension
-  totalLength += block.prependVarNumber(totalLength);
-  totalLength += block.prependVarNumber(tlv::EndorseExtension);
-
-  return totalLength;
-}
+};
 
 const Block&
 EndorseExtension::wireEncode() const
 {
-  ndn::EncodingEstimator estimator;
-  size_t estimatedSize = wireEncode(estimator);
-
-  ndn::EncodingBuffer buffer(estimatedSize, 0);
-  wireEncode(buffer);
-
-  m_wire = buffer.block();
-  m_wire.parse();
-
+  m_wire = Schema::encode(*this);
   return m_wire;
 }
 
@@ -69,34 +50,7 @@ void
 EndorseExtension::wireDecode(const Block& endorseWire)
 {
   m_wire = endorseWire;
-  m_wire.parse();
-
-  // EndorseExtension := ENDORSE-EXTENSION-TYPE TLV-LENGTH
-  //                       EntryData+
-  //
-  // EntryData := ENTRYDATA-TYPE TLV-LENGTH
-  //                String
-  //
-
-  if (m_wire.type() != tlv::EndorseExtension)
-    throw Error("Unexpected TLV number when decoding endorse extension packet");
-
-  // EntryData
-  Block::element_const_iterator i = m_wire.elements_begin();
-  if (i == m_wire.elements_end())
-    throw Error("Missing Entry Data");
-  if (i->type() != tlv::EntryData)
-    throw Error("Expect Entry Data but get TLV Type " + std::to_string(i->type()));
-
-   while (i != m_wire.elements_end() && i->type() == tlv::EntryData) {
-     m_entries.push_back(std::string(reinterpret_cast<const char* >(i->value()),
-                                     i->value_size()));
-     ++i;
-  }
-
-  if (i != m_wire.elements_end()) {
-    throw Error("Unexpected element");
-  }
+  Schema::decode(m_wire, *this);
 }
 
 void
@@ -57,9 +57,8 @@ public:
   removeEntry(const std::string& entry);
 
 private:
-  template<bool T>
-  size_t
-  wireEncode(ndn::EncodingImpl<T>& block) const;
+  // TLV schema, see tlv-codec.hpp
+  struct Schema;
 
 private:
   mutable Block m_wire;
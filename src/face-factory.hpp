@@ -0,0 +1,35 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#ifndef CHRONOCHAT_FACE_FACTORY_HPP
+#define CHRONOCHAT_FACE_FACTORY_HPP
+
+#include "common.hpp"
+
+#include <ndn-cxx/face.hpp>
+
+namespace chronochat {
+
+/**
+ * @brief Creates the Face of a backend, whose events are processed by @p ioService
+ *
+ * Backends get their faces from a factory, so that tests and benchmarks can connect
+ * them to an in-process forwarder instead of NFD.
+ */
+typedef function<shared_ptr<ndn::Face>(boost::asio::io_service& ioService)> FaceFactory;
+
+/// @brief make a Face connected to the local NFD
+inline shared_ptr<ndn::Face>
+makeNfdFace(boost::asio::io_service& ioService)
+{
+  return make_shared<ndn::Face>(ref(ioService));
+}
+
+} // namespace chronochat
+
+#endif // CHRONOCHAT_FACE_FACTORY_HPP
@@ -0,0 +1,492 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#include "face-multiplexer.hpp"
+
+#include <ndn-cxx/transport/transport.hpp>
+#include <ndn-cxx/management/nfd-control-parameters.hpp>
+#include <ndn-cxx/management/nfd-control-response.hpp>
+#include "logging.h"
+
+INIT_LOGGER("FaceMultiplexer");
+
+namespace chronochat {
+
+static const Name LOCALHOST_RIB("/localhost/nfd/rib");
+static const ssize_t COMMAND_VERB_OFFSET = 3;
+static const ssize_t COMMAND_PARAMETERS_OFFSET = 4;
+static const uint32_t COMMAND_OK = 200;
+static const uint32_t COMMAND_FAILED = 400;
+// the forwarder lets the clients see the uplink as the face of the command
+static const uint64_t COMMAND_FACE_ID = 1;
+
+/**
+ * @brief Transport of the Face of a client, which hands the packets to the multiplexer
+ *
+ * Everything is posted to the multiplexer, so neither the Face nor the multiplexer is
+ * re-entered, and the Face may be used by other threads as far as Face allows it.
+ */
+class FaceMultiplexer::ClientTransport : public ndn::Transport,
+                                         public enable_shared_from_this<ClientTransport>
+{
+public:
+  ClientTransport(FaceMultiplexer& multiplexer, ClientId id)
+    : m_multiplexer(multiplexer)
+    , m_multiplexerToken(multiplexer.m_activeToken)
+    , m_id(id)
+  {
+  }
+
+  ~ClientTransport()
+  {
+    close();
+  }
+
+  virtual void
+  connect(boost::asio::io_service& ioService, const ReceiveCallback& receiveCallback)
+  {
+    if (m_multiplexerToken.expired())
+      throw Error("Face multiplexer is gone");
+
+    Transport::connect(ioService, receiveCallback);
+    m_isConnected = true;
+    m_isExpectedToReceive = true;
+
+    // Face::put connects on the thread of the caller
+    weak_ptr<ClientTransport> self = shared_from_this();
+    post([self] (FaceMultiplexer& multiplexer, ClientId id) {
+        shared_ptr<ClientTransport> transport = self.lock();
+        if (transport != nullptr && transport->isConnected())
+          multiplexer.connectClient(id, transport);
+      });
+  }
+
+  virtual void
+  close()
+  {
+    if (!m_isConnected)
+      return;
+
+    m_isConnected = false;
+    post([] (FaceMultiplexer& multiplexer, ClientId id) {
+        multiplexer.disconnectClient(id);
+      });
+  }
+
+  virtual void
+  send(const Block& wire)
+  {
+    post([wire] (FaceMultiplexer& multiplexer, ClientId id) {
+        multiplexer.onClientPacket(id, wire);
+      });
+  }
+
+  virtual void
+  send(const Block& header, const Block& payload)
+  {
+    // the multiplexer is no local face of the forwarder, the header means nothing to it
+    send(payload);
+  }
+
+  virtual void
+  pause()
+  {
+    m_isExpectedToReceive = false;
+  }
+
+  virtual void
+  resume()
+  {
+    m_isExpectedToReceive = true;
+  }
+
+  /// @brief the multiplexer has dropped the client, the next packet connects it again
+  void
+  disconnect()
+  {
+    m_isConnected = false;
+  }
+
+  void
+  deliver(const Block& wire)
+  {
+    m_receiveCallback(wire);
+  }
+
+private:
+  void
+  post(const function<void(FaceMultiplexer&, ClientId)>& task)
+  {
+    FaceMultiplexer* multiplexer = &m_multiplexer;
+    weak_ptr<bool> multiplexerToken = m_multiplexerToken;
+    ClientId id = m_id;
+    m_ioService->post([task, multiplexer, multiplexerToken, id] {
+        if (!multiplexerToken.expired())
+          task(*multiplexer, id);
+      });
+  }
+
+private:
+  FaceMultiplexer& m_multiplexer;
+  weak_ptr<bool> m_multiplexerToken;
+  ClientId m_id;
+};
+
+FaceMultiplexer::FaceMultiplexer(boost::asio::io_service& ioService,
+                                 const FaceFactory& makeFace)
+  : m_ioService(ioService)
+  , m_makeFace(makeFace)
+  , m_activeToken(make_shared<bool>(true))
+  , m_nextClientId(0)
+{
+}
+
+FaceMultiplexer::~FaceMultiplexer()
+{
+  m_activeToken.reset();
+  reset();
+}
+
+shared_ptr<ndn::Face>
+FaceMultiplexer::makeFace()
+{
+  auto transport = make_shared<ClientTransport>(ref(*this), m_nextClientId++);
+  return make_shared<ndn::Face>(transport, ref(m_ioService));
+}
+
+void
+FaceMultiplexer::reset()
+{
+  for (auto& client : m_clients) {
+    shared_ptr<ClientTransport> transport = client.second.transport.lock();
+    if (transport != nullptr)
+      transport->disconnect();
+  }
+  m_clients.clear();
+  m_registrations.clear();
+  m_pit.clear();
+
+  if (m_uplink == nullptr)
+    return;
+
+  // the uplink may still be dispatching, it is released after it has shut down
+  m_uplinkToken.reset();
+  m_uplink->shutdown();
+  shared_ptr<ndn::Face> uplink = m_uplink;
+  m_ioService.post([uplink] () mutable { uplink.reset(); });
+  m_uplink.reset();
+}
+
+void
+FaceMultiplexer::connectClient(ClientId client, const shared_ptr<ClientTransport>& transport)
+{
+  m_clients[client].transport = transport;
+}
+
+void
+FaceMultiplexer::disconnectClient(ClientId client)
+{
+  auto it = m_clients.find(client);
+  if (it == m_clients.end())
+    return;
+
+  // only the prefixes of this client are withdrawn, the others keep theirs
+  for (const auto& prefix : it->second.prefixes)
+    releasePrefix(prefix.first, prefix.second);
+  m_clients.erase(it);
+
+  m_pit.remove_if([client] (const PitEntry& entry) { return entry.client == client; });
+}
+
+void
+FaceMultiplexer::onClientPacket(ClientId client, const Block& wire)
+{
+  // the packets sent before a reset are lost along with the uplink
+  if (m_clients.count(client) == 0)
+    return;
+
+  if (wire.type() == tlv::Interest)
+    onClientInterest(client, Interest(wire));
+  else if (wire.type() == tlv::Data)
+    onClientData(client, Data(wire));
+}
+
+void
+FaceMultiplexer::onClientInterest(ClientId client, const Interest& interest)
+{
+  if (processCommand(client, interest))
+    return;
+
+  removeExpiredEntries();
+  m_pit.push_back({interest, client,
+                   time::steady_clock::now() + interest.getInterestLifetime()});
+
+  for (const auto& other : m_clients) {
+    if (other.first == client)
+      continue;
+
+    for (const auto& prefix : other.second.prefixes) {
+      if (prefix.first.isPrefixOf(interest.getName())) {
+        deliver(other.first, interest.wireEncode());
+        break;
+      }
+    }
+  }
+
+  ndn::Face& uplink = getUplink();
+  weak_ptr<bool> uplinkToken = m_uplinkToken;
+  uplink.expressInterest(interest,
+                         [this, uplinkToken, client] (const Interest& interest,
+                                                      const Data& data) {
+                           if (!uplinkToken.expired())
+                             this->deliver(client, data.wireEncode());
+                         },
+                         [] (const Interest& interest) {});
+}
+
+void
+FaceMultiplexer::onClientData(ClientId client, const Data& data)
+{
+  removeExpiredEntries();
+
+  // every other client gets the Data once
+  std::set<ClientId> downstreams;
+  for (auto it = m_pit.begin(); it != m_pit.end();) {
+    if (it->client != client && it->interest.matchesData(data)) {
+      downstreams.insert(it->client);
+      it = m_pit.erase(it);
+    }
+    else
+      ++it;
+  }
+
+  for (ClientId downstream : downstreams)
+    deliver(downstream, data.wireEncode());
+
+  getUplink().put(data);
+}
+
+bool
+FaceMultiplexer::processCommand(ClientId client, const Interest& interest)
+{
+  const Name& name = interest.getName();
+  if (!LOCALHOST_RIB.isPrefixOf(name) ||
+      name.size() <= static_cast<size_t>(COMMAND_PARAMETERS_OFFSET))
+    return false;
+
+  const name::Component& verb = name.get(COMMAND_VERB_OFFSET);
+  bool isRegister = (verb == name::Component("register"));
+  if (!isRegister && verb != name::Component("unregister"))
+    return false;
+
+  ndn::nfd::ControlParameters parameters;
+  try {
+    parameters.wireDecode(name.get(COMMAND_PARAMETERS_OFFSET).blockFromValue());
+  }
+  catch (tlv::Error& e) {
+    answerCommand(client, interest, COMMAND_FAILED, e.what());
+    return true;
+  }
+
+  if (isRegister)
+    registerPrefix(client, parameters.getName(), interest);
+  else {
+    unregisterPrefix(client, parameters.getName());
+    answerCommand(client, interest, COMMAND_OK, "OK");
+  }
+
+  return true;
+}
+
+void
+FaceMultiplexer::registerPrefix(ClientId client, const Name& prefix, const Interest& command)
+{
+  m_clients[client].prefixes[prefix]++;
+
+  auto it = m_registrations.find(prefix);
+  if (it != m_registrations.end()) {
+    it->second.nRegistrations++;
+    if (it->second.isRegistered)
+      answerCommand(client, command, COMMAND_OK, "OK");
+    else
+      it->second.pendingCommands.push_back(std::make_pair(client, command));
+    return;
+  }
+
+  Registration& registration = m_registrations[prefix];
+  registration.nRegistrations = 1;
+  registration.isRegistered = false;
+  registration.pendingCommands.push_back(std::make_pair(client, command));
+
+  ndn::Face& uplink = getUplink();
+  weak_ptr<bool> uplinkToken = m_uplinkToken;
+  registration.id =
+    uplink.registerPrefix(prefix,
+                          [this, uplinkToken] (const Name& prefix) {
+                            if (!uplinkToken.expired())
+                              this->onPrefixRegistered(prefix);
+                          },
+                          [this, uplinkToken] (const Name& prefix, const std::string& reason) {
+                            if (!uplinkToken.expired())
+                              this->onPrefixRegisterFailed(prefix, reason);
+                          });
+}
+
+void
+FaceMultiplexer::unregisterPrefix(ClientId client, const Name& prefix)
+{
+  std::map<Name, size_t>& prefixes = m_clients[client].prefixes;
+  auto it = prefixes.find(prefix);
+  if (it == prefixes.end())
+    return;
+
+  if (--it->second == 0)
+    prefixes.erase(it);
+  releasePrefix(prefix, 1);
+}
+
+void
+FaceMultiplexer::releasePrefix(const Name& prefix, size_t nRegistrations)
+{
+  auto it = m_registrations.find(prefix);
+  if (it == m_registrations.end())
+    return;
+
+  it->second.nRegistrations -= std::min(nRegistrations, it->second.nRegistrations);
+  if (it->second.nRegistrations > 0)
+    return;
+
+  // an unanswered registration is withdrawn once the forwarder has answered it
+  if (!it->second.isRegistered)
+    return;
+
+  _LOG_DEBUG("Unregister " << prefix);
+  m_uplink->unregisterPrefix(it->second.id, [] {}, [] (const std::string& reason) {});
+  m_registrations.erase(it);
+}
+
+void
+FaceMultiplexer::onPrefixRegistered(const Name& prefix)
+{
+  auto it = m_registrations.find(prefix);
+  if (it == m_registrations.end())
+    return;
+
+  _LOG_DEBUG("Registered " << prefix);
+  it->second.isRegistered = true;
+  std::vector<std::pair<ClientId, Interest>> commands;
+  commands.swap(it->second.pendingCommands);
+  for (const auto& command : commands)
+    answerCommand(command.first, command.second, COMMAND_OK, "OK");
+
+  // all clients are gone already
+  if (it->second.nRegistrations == 0)
+    releasePrefix(prefix, 0);
+}
+
+void
+FaceMultiplexer::onPrefixRegisterFailed(const Name& prefix, const std::string& reason)
+{
+  auto it = m_registrations.find(prefix);
+  if (it == m_registrations.end())
+    return;
+
+  _LOG_DEBUG("Cannot register " << prefix << ": " << reason);
+  std::vector<std::pair<ClientId, Interest>> commands;
+  commands.swap(it->second.pendingCommands);
+  m_registrations.erase(it);
+
+  for (auto& client : m_clients)
+    client.second.prefixes.erase(prefix);
+
+  for (const auto& command : commands)
+    answerCommand(command.first, command.second, COMMAND_FAILED, reason);
+}
+
+void
+FaceMultiplexer::answerCommand(ClientId client, const Interest& command, uint32_t code,
+                               const std::string& text)
+{
+  ndn::nfd::ControlResponse response(code, text);
+  if (code == COMMAND_OK) {
+    const Name& name = command.getName();
+    ndn::nfd::ControlParameters parameters;
+    parameters.wireDecode(name.get(COMMAND_PARAMETERS_OFFSET).blockFromValue());
+    parameters.setFaceId(COMMAND_FACE_ID);
+    parameters.setOrigin(0);
+    if (name.get(COMMAND_VERB_OFFSET) == name::Component("register"))
+      parameters.setCost(0);
+    response.setBody(parameters.wireEncode());
+  }
+
+  Data data(command.getName());
+  data.setContent(response.wireEncode());
+  m_keyChain.signWithSha256(data);
+
+  deliver(client, data.wireEncode());
+}
+
+void
+FaceMultiplexer::onUplinkInterest(const Interest& interest)
+{
+  for (const auto& client : m_clients) {
+    for (const auto& prefix : client.second.prefixes) {
+      if (prefix.first.isPrefixOf(interest.getName())) {
+        deliver(client.first, interest.wireEncode());
+        break;
+      }
+    }
+  }
+}
+
+void
+FaceMultiplexer::deliver(ClientId client, const Block& wire)
+{
+  weak_ptr<bool> activeToken = m_activeToken;
+  m_ioService.post([this, activeToken, client, wire] {
+      if (activeToken.expired())
+        return;
+
+      auto it = m_clients.find(client);
+      if (it == m_clients.end())
+        return;
+
+      shared_ptr<ClientTransport> transport = it->second.transport.lock();
+      if (transport != nullptr)
+        transport->deliver(wire);
+    });
+}
+
+ndn::Face&
+FaceMultiplexer::getUplink()
+{
+  if (m_uplink != nullptr)
+    return *m_uplink;
+
+  m_uplink = m_makeFace(m_ioService);
+  m_uplinkToken = make_shared<bool>(true);
+
+  // the forwarder only sends the Interests of the registered prefixes
+  weak_ptr<bool> uplinkToken = m_uplinkToken;
+  m_uplink->setInterestFilter(Name(),
+                              [this, uplinkToken] (const Name& prefix,
+                                                   const Interest& interest) {
+                                if (!uplinkToken.expired())
+                                  this->onUplinkInterest(interest);
+                              });
+  return *m_uplink;
+}
+
+void
+FaceMultiplexer::removeExpiredEntries()
+{
+  time::steady_clock::TimePoint now = time::steady_clock::now();
+  m_pit.remove_if([now] (const PitEntry& entry) { return entry.expiry <= now; });
+}
+
+} // namespace chronochat
@@ -0,0 +1,167 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#ifndef CHRONOCHAT_FACE_MULTIPLEXER_HPP
+#define CHRONOCHAT_FACE_MULTIPLEXER_HPP
+
+#include "common.hpp"
+#include "face-factory.hpp"
+
+#include <ndn-cxx/security/key-chain.hpp>
+
+namespace chronochat {
+
+/**
+ * @brief Shares one connection to the forwarder among the faces of many clients
+ *
+ * Every client gets a Face of its own, so that it can register prefixes, express Interests
+ * and shut its Face down as usual.  The faces do not connect to the forwarder themselves,
+ * their packets go through the uplink Face of the multiplexer:
+ *
+ * - a prefix is registered with the forwarder by its first client, and unregistered when
+ *   its last client unregisters it or shuts its Face down;
+ * - Interests of the forwarder go to the clients which registered a matching prefix;
+ * - Interests of a client go to the forwarder and to the other clients which registered
+ *   a matching prefix, the forwarder would not send them back to the uplink.
+ *
+ * The multiplexer must only be used on the thread which runs the io_service of the uplink.
+ * The faces of the clients hand their packets over to that thread.
+ */
+class FaceMultiplexer : noncopyable
+{
+public:
+  /**
+   * @param ioService io_service of the uplink and the faces of the clients
+   * @param makeFace factory of the uplink, which is made again after reset()
+   */
+  FaceMultiplexer(boost::asio::io_service& ioService, const FaceFactory& makeFace);
+
+  ~FaceMultiplexer();
+
+  /// @brief make the Face of a new client, which connects when it is first used
+  shared_ptr<ndn::Face>
+  makeFace();
+
+  /**
+   * @brief drop the uplink, which has failed
+   *
+   * The prefixes of all clients are forgotten and their faces disconnected.  A client
+   * which uses its Face again connects it to a new uplink, and has to register again.
+   */
+  void
+  reset();
+
+  /// @brief get the number of connected clients
+  size_t
+  getNClients() const
+  {
+    return m_clients.size();
+  }
+
+  /// @brief get the number of prefixes registered with the forwarder or being registered
+  size_t
+  getNRegisteredPrefixes() const
+  {
+    return m_registrations.size();
+  }
+
+private:
+  class ClientTransport;
+  typedef uint64_t ClientId;
+
+  struct Client
+  {
+    weak_ptr<ClientTransport> transport; // the Face may be gone before it disconnects
+    std::map<Name, size_t> prefixes;     // and the number of their registrations
+  };
+
+  struct Registration
+  {
+    size_t nRegistrations;               // of all clients
+    const ndn::RegisteredPrefixId* id;   // of the uplink
+    bool isRegistered;                   // false while the forwarder has not answered
+    std::vector<std::pair<ClientId, Interest>> pendingCommands; // answered with it
+  };
+
+  struct PitEntry
+  {
+    Interest interest;
+    ClientId client;
+    time::steady_clock::TimePoint expiry;
+  };
+
+  void
+  connectClient(ClientId client, const shared_ptr<ClientTransport>& transport);
+
+  void
+  disconnectClient(ClientId client);
+
+  void
+  onClientPacket(ClientId client, const Block& wire);
+
+  void
+  onClientInterest(ClientId client, const Interest& interest);
+
+  void
+  onClientData(ClientId client, const Data& data);
+
+  /// @return false if @p interest is not a prefix registration command
+  bool
+  processCommand(ClientId client, const Interest& interest);
+
+  void
+  registerPrefix(ClientId client, const Name& prefix, const Interest& command);
+
+  void
+  unregisterPrefix(ClientId client, const Name& prefix);
+
+  /// @brief drop @p nRegistrations of @p prefix, the last one unregisters it
+  void
+  releasePrefix(const Name& prefix, size_t nRegistrations);
+
+  void
+  onPrefixRegistered(const Name& prefix);
+
+  void
+  onPrefixRegisterFailed(const Name& prefix, const std::string& reason);
+
+  /// @brief answer a prefix registration command as the forwarder would
+  void
+  answerCommand(ClientId client, const Interest& command, uint32_t code,
+                const std::string& text);
+
+  void
+  onUplinkInterest(const Interest& interest);
+
+  /// @brief hand @p wire to @p client, unless it has disconnected meanwhile
+  void
+  deliver(ClientId client, const Block& wire);
+
+  ndn::Face&
+  getUplink();
+
+  void
+  removeExpiredEntries();
+
+private:
+  boost::asio::io_service& m_ioService;
+  FaceFactory m_makeFace;
+  shared_ptr<ndn::Face> m_uplink;        // nullptr until a client connects
+  shared_ptr<bool> m_activeToken;        // expires with the multiplexer
+  shared_ptr<bool> m_uplinkToken;        // expires with the uplink
+  ndn::KeyChain m_keyChain;              // signs the answers to the commands
+
+  ClientId m_nextClientId;
+  std::map<ClientId, Client> m_clients;  // connected ones
+  std::map<Name, Registration> m_registrations;
+  std::list<PitEntry> m_pit;             // Interests of clients, for the other clients
+};
+
+} // namespace chronochat
+
+#endif // CHRONOCHAT_FACE_MULTIPLEXER_HPP
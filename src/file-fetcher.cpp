@@ -0,0 +1,244 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#include "file-fetcher.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <boost/filesystem.hpp>
+#include "logging.h"
+
+INIT_LOGGER("FileFetcher");
+
+namespace chronochat {
+
+namespace fs = boost::filesystem;
+
+const double FileFetcher::INITIAL_WINDOW = 2.0;
+const double FileFetcher::MAX_WINDOW = 64.0;
+const int FileFetcher::MAX_RETRIES = 4;
+const uint64_t FileFetcher::MAX_FILE_SIZE = static_cast<uint64_t>(4) << 30;
+
+FileFetcher::FileFetcher(const FileManifest& manifest,
+                         const std::string& path,
+                         const FetchFunction& fetch,
+                         const ProgressCallback& onProgress,
+                         const CompleteCallback& onComplete,
+                         const ErrorCallback& onError)
+  : m_manifest(manifest)
+  , m_path(path)
+  , m_partPath(path + ".part")
+  , m_fetch(fetch)
+  , m_onProgress(onProgress)
+  , m_onComplete(onComplete)
+  , m_onError(onError)
+  , m_window(INITIAL_WINDOW)
+  , m_threshold(MAX_WINDOW)
+  , m_nextSegment(0)
+  , m_nReceivedSegments(0)
+  , m_nReceivedBytes(0)
+  , m_isScheduling(false)
+  , m_isDone(false)
+{
+  if (m_manifest.getFileSize() > MAX_FILE_SIZE)
+    throw Error("File size " + std::to_string(m_manifest.getFileSize()) +
+                " exceeds the limit of " + std::to_string(MAX_FILE_SIZE) + " bytes");
+
+  try {
+    if (m_manifest.getFileSize() > 0) {
+      boost::iostreams::mapped_file_params params(m_partPath);
+      params.flags = boost::iostreams::mapped_file::readwrite;
+      params.new_file_size = static_cast<boost::iostreams::stream_offset>(
+                               m_manifest.getFileSize());
+      m_sink.open(params);
+    }
+    else {
+      // an empty file cannot be mapped
+      std::ofstream os(m_partPath.c_str(), std::ios::binary | std::ios::trunc);
+      if (!os)
+        throw Error("Cannot create " + m_partPath);
+    }
+  }
+  catch (const std::exception& e) {
+    throw Error("Cannot create " + m_partPath + ": " + e.what());
+  }
+}
+
+FileFetcher::~FileFetcher()
+{
+  if (!m_isDone)
+    cancel();
+}
+
+void
+FileFetcher::start()
+{
+  m_activeToken = make_shared<bool>(true);
+
+  if (m_manifest.getNSegments() == 0) {
+    complete();
+    return;
+  }
+
+  schedule();
+}
+
+void
+FileFetcher::cancel()
+{
+  m_isDone = true;
+  m_activeToken.reset();
+  close();
+
+  boost::system::error_code error;
+  fs::remove(m_partPath, error);
+}
+
+void
+FileFetcher::schedule()
+{
+  if (m_isScheduling)
+    return;
+  m_isScheduling = true;
+
+  uint64_t nSegments = m_manifest.getNSegments();
+  weak_ptr<bool> activeToken = m_activeToken;
+  while (!activeToken.expired() &&
+         m_outstanding.size() < static_cast<size_t>(m_window) &&
+         (!m_retransmissions.empty() || m_nextSegment < nSegments)) {
+    // timed out segments first, they hold back the completion
+    uint64_t segment;
+    if (!m_retransmissions.empty()) {
+      segment = *m_retransmissions.begin();
+      m_retransmissions.erase(m_retransmissions.begin());
+    }
+    else {
+      segment = m_nextSegment++;
+    }
+    m_outstanding.insert(segment);
+
+    Name segmentName(m_manifest.getPrefix());
+    segmentName.appendSegment(segment);
+
+    m_fetch(segmentName,
+            [this, activeToken, segment] (const shared_ptr<const Data>& data, bool isValidated) {
+              if (!activeToken.expired())
+                this->onData(segment, data, isValidated);
+            },
+            [this, activeToken, segment] {
+              if (!activeToken.expired())
+                this->onTimeout(segment);
+            });
+
+    // the fetch may complete synchronously and end the transfer, which may destroy this
+    if (activeToken.expired())
+      return;
+  }
+
+  m_isScheduling = false;
+}
+
+void
+FileFetcher::onData(uint64_t segment, const shared_ptr<const Data>& data, bool isValidated)
+{
+  if (m_outstanding.erase(segment) == 0)
+    return;
+
+  if (!isValidated) {
+    fail("Cannot validate " + data->getName().toUri());
+    return;
+  }
+
+  uint64_t offset = segment * m_manifest.getSegmentSize();
+  uint64_t length = std::min(m_manifest.getSegmentSize(), m_manifest.getFileSize() - offset);
+  const Block& content = data->getContent();
+  if (content.value_size() != length) {
+    fail("Unexpected size of " + data->getName().toUri());
+    return;
+  }
+
+  std::memcpy(m_sink.data() + offset, content.value(), length);
+  m_nReceivedSegments++;
+  m_nReceivedBytes += length;
+
+  if (m_window < m_threshold)
+    m_window += 1;
+  else
+    m_window += 1 / m_window;
+  m_window = std::min(m_window, MAX_WINDOW);
+
+  if (m_nReceivedSegments == m_manifest.getNSegments()) {
+    complete();
+    return;
+  }
+
+  // the callback may end the transfer
+  weak_ptr<bool> activeToken = m_activeToken;
+  m_onProgress(m_nReceivedBytes);
+  if (!activeToken.expired())
+    schedule();
+}
+
+void
+FileFetcher::onTimeout(uint64_t segment)
+{
+  if (m_outstanding.erase(segment) == 0)
+    return;
+
+  if (++m_nRetries[segment] > MAX_RETRIES) {
+    fail("Cannot fetch segment " + std::to_string(segment) + " of " +
+         m_manifest.getPrefix().toUri());
+    return;
+  }
+
+  _LOG_DEBUG("Retry segment " << segment << " of " << m_manifest.getPrefix());
+  m_retransmissions.insert(segment);
+
+  m_threshold = std::max(m_window / 2, 1.0);
+  m_window = m_threshold;
+
+  schedule();
+}
+
+void
+FileFetcher::complete()
+{
+  m_isDone = true;
+  m_activeToken.reset();
+  close();
+
+  boost::system::error_code error;
+  fs::rename(m_partPath, m_path, error);
+  if (error) {
+    fs::remove(m_partPath, error);
+    m_onError("Cannot rename " + m_partPath + " to " + m_path);
+    return;
+  }
+
+  m_onComplete();
+}
+
+void
+FileFetcher::fail(const std::string& reason)
+{
+  _LOG_DEBUG("Give up " << m_manifest.getPrefix() << ": " << reason);
+  cancel();
+  m_onError(reason);
+}
+
+void
+FileFetcher::close()
+{
+  m_outstanding.clear();
+  m_retransmissions.clear();
+  if (m_sink.is_open())
+    m_sink.close();
+}
+
+} // namespace chronochat
@@ -0,0 +1,156 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#ifndef CHRONOCHAT_FILE_FETCHER_HPP
+#define CHRONOCHAT_FILE_FETCHER_HPP
+
+#include "common.hpp"
+#include "file-manifest.hpp"
+
+#include <boost/iostreams/device/mapped_file.hpp>
+
+namespace chronochat {
+
+/**
+ * @brief Pipelined fetcher of a file which is published as a segmented object
+ *
+ * The segments are requested in ascending order within a window, which grows like a
+ * congestion window (slow start, then additive increase) and is halved on every timeout.
+ * A timed out segment is requested again, up to MAX_RETRIES times.
+ *
+ * The segments are written straight into <path>.part, which is mapped into memory, so the
+ * file is never held in memory as a whole.  The file is renamed to its final path once all
+ * segments have arrived, and removed if the transfer fails or is cancelled.
+ */
+class FileFetcher : noncopyable
+{
+public:
+  class Error : public std::runtime_error
+  {
+  public:
+    explicit
+    Error(const std::string& what)
+      : std::runtime_error(what)
+    {
+    }
+  };
+
+  typedef function<void(const shared_ptr<const Data>& data, bool isValidated)> DataCallback;
+  typedef function<void()> TimeoutCallback;
+
+  /// @brief express a fetch for the segment @p segmentName
+  typedef function<void(const Name& segmentName,
+                        const DataCallback& onData,
+                        const TimeoutCallback& onTimeout)> FetchFunction;
+
+  typedef function<void(uint64_t nReceivedBytes)> ProgressCallback;
+  typedef function<void()> CompleteCallback;
+  typedef function<void(const std::string& reason)> ErrorCallback;
+
+  // the size of a file is announced by its sender, larger files are not fetched
+  static const uint64_t MAX_FILE_SIZE;
+
+  /**
+   * @brief create the file for the transfer of @p manifest to @p path
+   *
+   * The callbacks may destroy the fetcher.
+   *
+   * @throw Error the file is larger than MAX_FILE_SIZE or cannot be created
+   */
+  FileFetcher(const FileManifest& manifest,
+              const std::string& path,
+              const FetchFunction& fetch,
+              const ProgressCallback& onProgress,
+              const CompleteCallback& onComplete,
+              const ErrorCallback& onError);
+
+  /// @brief cancel the transfer unless it is complete
+  ~FileFetcher();
+
+  void
+  start();
+
+  /// @brief stop the transfer and remove the partial file, late fetches are ignored
+  void
+  cancel();
+
+  const FileManifest&
+  getManifest() const
+  {
+    return m_manifest;
+  }
+
+  uint64_t
+  getNReceivedBytes() const
+  {
+    return m_nReceivedBytes;
+  }
+
+  size_t
+  getNOutstanding() const
+  {
+    return m_outstanding.size();
+  }
+
+  double
+  getWindow() const
+  {
+    return m_window;
+  }
+
+CHRONOCHAT_PUBLIC_WITH_TESTS_ELSE_PRIVATE:
+  static const double INITIAL_WINDOW;
+  static const double MAX_WINDOW;
+  static const int MAX_RETRIES;
+
+private:
+  void
+  schedule();
+
+  void
+  onData(uint64_t segment, const shared_ptr<const Data>& data, bool isValidated);
+
+  void
+  onTimeout(uint64_t segment);
+
+  void
+  complete();
+
+  void
+  fail(const std::string& reason);
+
+  void
+  close();
+
+private:
+  FileManifest m_manifest;
+  std::string m_path;
+  std::string m_partPath;
+  FetchFunction m_fetch;
+  ProgressCallback m_onProgress;
+  CompleteCallback m_onComplete;
+  ErrorCallback m_onError;
+
+  boost::iostreams::mapped_file_sink m_sink;
+  shared_ptr<bool> m_activeToken;        // expires when the transfer ends
+
+  double m_window;
+  double m_threshold;
+  uint64_t m_nextSegment;                // the lowest segment never requested
+  std::set<uint64_t> m_outstanding;
+  std::set<uint64_t> m_retransmissions;  // timed out segments to request again
+  std::map<uint64_t, int> m_nRetries;
+  uint64_t m_nReceivedSegments;
+  uint64_t m_nReceivedBytes;
+  bool m_isScheduling;
+  bool m_isDone;                         // true once the file is complete or removed
+};
+
+} // namespace chronochat
+
+#endif // CHRONOCHAT_FILE_FETCHER_HPP
@@ -0,0 +1,119 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#include "file-manifest.hpp"
+#include "tlv-codec.hpp"
+
+#include <limits>
+
+namespace chronochat {
+
+BOOST_CONCEPT_ASSERT((ndn::WireEncodable<FileManifest>));
+BOOST_CONCEPT_ASSERT((ndn::WireDecodable<FileManifest>));
+
+FileManifest::FileManifest()
+  : m_fileSize(0)
+  , m_segmentSize(1)
+{
+}
+
+FileManifest::FileManifest(const Block& manifestWire)
+  : m_fileSize(0)
+  , m_segmentSize(1)
+{
+  this->wireDecode(manifestWire);
+}
+
+// FileManifest := FILE-MANIFEST-TYPE TLV-LENGTH
+//                   Name
+//                   FileName
+//                   FileSize
+//                   SegmentSize
+//
+// FileName := FILE-NAME-TYPE TLV-LENGTH
+//               String (without directories)
+//
+// FileSize := FILE-SIZE-TYPE TLV-LENGTH
+//               nonNegativeInteger (bytes)
+//
+// SegmentSize := SEGMENT-SIZE-TYPE TLV-LENGTH
+//                  nonNegativeInteger (bytes, at least 1)
+//
+// Name is the prefix of the segments.  Elements added by later versions are skipped.
+typedef codec::Fields<FileManifest> FileManifestFields;
+
+struct FileManifest::Schema
+  : codec::Record<FileManifest, tlv::FileManifest,
+                  FileManifestFields::Required<codec::Self<ndn::tlv::Name, Name>,
+                                               &FileManifest::m_prefix>,
+                  FileManifestFields::Required<codec::Tlv<tlv::FileName, codec::String>,
+                                               &FileManifest::m_fileName>,
+                  FileManifestFields::Required<codec::Tlv<tlv::FileSize,
+                                                          codec::NonNegativeInteger<uint64_t>>,
+                                               &FileManifest::m_fileSize>,
+                  FileManifestFields::Required<codec::Tlv<tlv::SegmentSize,
+                                                          codec::NonNegativeInteger<uint64_t>>,
+                                               &FileManifest::m_segmentSize>,
+                  codec::IgnoreRest>
+{
+};
+
+const Block&
+FileManifest::wireEncode() const
+{
+  if (m_wire.hasWire())
+    return m_wire;
+
+  m_wire = Schema::encode(*this);
+  return m_wire;
+}
+
+void
+FileManifest::wireDecode(const Block& manifestWire)
+{
+  m_wire = manifestWire;
+  Schema::decode(m_wire, *this);
+
+  if (m_segmentSize == 0)
+    throw Error("Segment size is zero");
+
+  // the number of segments is rounded up
+  if (m_fileSize > std::numeric_limits<uint64_t>::max() - (m_segmentSize - 1))
+    throw Error("File size " + std::to_string(m_fileSize) + " is too large");
+}
+
+void
+FileManifest::setPrefix(const Name& prefix)
+{
+  m_wire.reset();
+  m_prefix = prefix;
+}
+
+void
+FileManifest::setFileName(const std::string& fileName)
+{
+  m_wire.reset();
+  m_fileName = fileName;
+}
+
+void
+FileManifest::setFileSize(uint64_t fileSize)
+{
+  m_wire.reset();
+  m_fileSize = fileSize;
+}
+
+void
+FileManifest::setSegmentSize(uint64_t segmentSize)
+{
+  BOOST_ASSERT(segmentSize > 0);
+  m_wire.reset();
+  m_segmentSize = segmentSize;
+}
+
+} // namespace chronochat
@@ -0,0 +1,126 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#ifndef CHRONOCHAT_FILE_MANIFEST_HPP
+#define CHRONOCHAT_FILE_MANIFEST_HPP
+
+#include "common.hpp"
+#include "tlv.hpp"
+#include <ndn-cxx/util/concepts.hpp>
+#include <ndn-cxx/encoding/block.hpp>
+
+namespace chronochat {
+
+/**
+ * @brief Description of a file which is published as a segmented object
+ *
+ * The manifest goes through sync in a ChatMessage of type FILE, the file itself is
+ * fetched from the segments <prefix>/<segment number>, see FilePublisher and FileFetcher.
+ * Every segment but the last holds exactly segmentSize bytes.
+ */
+class FileManifest
+{
+
+public:
+
+  class Error : public std::runtime_error
+  {
+  public:
+    explicit
+    Error(const std::string& what)
+      : std::runtime_error(what)
+    {
+    }
+  };
+
+public:
+
+  FileManifest();
+
+  explicit
+  FileManifest(const Block& manifestWire);
+
+  const Block&
+  wireEncode() const;
+
+  void
+  wireDecode(const Block& manifestWire);
+
+  const Name&
+  getPrefix() const;
+
+  const std::string&
+  getFileName() const;
+
+  uint64_t
+  getFileSize() const;
+
+  uint64_t
+  getSegmentSize() const;
+
+  /// @brief get the number of segments, an empty file has none
+  uint64_t
+  getNSegments() const;
+
+  void
+  setPrefix(const Name& prefix);
+
+  void
+  setFileName(const std::string& fileName);
+
+  void
+  setFileSize(uint64_t fileSize);
+
+  void
+  setSegmentSize(uint64_t segmentSize);
+
+private:
+  // TLV schema, see tlv-codec.hpp
+  struct Schema;
+
+private:
+  mutable Block m_wire;
+  Name m_prefix;
+  std::string m_fileName;
+  uint64_t m_fileSize;
+  uint64_t m_segmentSize;
+};
+
+inline const Name&
+FileManifest::getPrefix() const
+{
+  return m_prefix;
+}
+
+inline const std::string&
+FileManifest::getFileName() const
+{
+  return m_fileName;
+}
+
+inline uint64_t
+FileManifest::getFileSize() const
+{
+  return m_fileSize;
+}
+
+inline uint64_t
+FileManifest::getSegmentSize() const
+{
+  return m_segmentSize;
+}
+
+inline uint64_t
+FileManifest::getNSegments() const
+{
+  return (m_fileSize + m_segmentSize - 1) / m_segmentSize;
+}
+
+} // namespace chronochat
+
+#endif // CHRONOCHAT_FILE_MANIFEST_HPP
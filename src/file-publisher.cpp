@@ -0,0 +1,140 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#include "file-publisher.hpp"
+
+#include <boost/filesystem.hpp>
+#include "logging.h"
+
+INIT_LOGGER("FilePublisher");
+
+namespace chronochat {
+
+namespace fs = boost::filesystem;
+
+const size_t FilePublisher::DEFAULT_SEGMENT_SIZE;
+const size_t FilePublisher::DEFAULT_MAX_CACHED_SEGMENTS;
+
+FilePublisher::FilePublisher(const SignFunction& sign,
+                             size_t segmentSize,
+                             const time::milliseconds& freshnessPeriod,
+                             size_t maxCachedSegments)
+  : m_sign(sign)
+  , m_segmentSize(segmentSize)
+  , m_freshnessPeriod(freshnessPeriod)
+  , m_maxCachedSegments(maxCachedSegments)
+{
+  BOOST_ASSERT(segmentSize > 0);
+}
+
+FileManifest
+FilePublisher::addFile(const Name& prefix, const std::string& path)
+{
+  File file;
+  try {
+    file.size = fs::file_size(path);
+    if (file.size > 0)
+      file.source = make_shared<boost::iostreams::mapped_file_source>(path);
+  }
+  catch (const std::exception& e) {
+    throw Error("Cannot publish " + path + ": " + e.what());
+  }
+
+  // the segments of a file published before under the same prefix are stale
+  evictFile(prefix);
+  m_files[prefix] = file;
+
+  FileManifest manifest;
+  manifest.setPrefix(prefix);
+  manifest.setFileName(fs::path(path).filename().string());
+  manifest.setFileSize(file.size);
+  manifest.setSegmentSize(m_segmentSize);
+
+  _LOG_DEBUG("Publish " << path << " (" << file.size << " bytes) as " << prefix);
+  return manifest;
+}
+
+void
+FilePublisher::removeFile(const Name& prefix)
+{
+  m_files.erase(prefix);
+  evictFile(prefix);
+}
+
+void
+FilePublisher::clear()
+{
+  m_files.clear();
+  m_segments.clear();
+  m_lru.clear();
+}
+
+shared_ptr<const Data>
+FilePublisher::makeSegment(const Name& segmentName)
+{
+  if (segmentName.empty())
+    return nullptr;
+
+  std::map<Name, CachedSegment>::iterator cached = m_segments.find(segmentName);
+  if (cached != m_segments.end()) {
+    m_lru.splice(m_lru.begin(), m_lru, cached->second.lruPosition);
+    return cached->second.data;
+  }
+
+  std::map<Name, File>::const_iterator it = m_files.find(segmentName.getPrefix(-1));
+  if (it == m_files.end())
+    return nullptr;
+
+  uint64_t segment = 0;
+  try {
+    segment = segmentName.get(-1).toSegment();
+  }
+  catch (const Name::Component::Error&) {
+    return nullptr;
+  }
+
+  const File& file = it->second;
+  uint64_t nSegments = (file.size + m_segmentSize - 1) / m_segmentSize;
+  if (segment >= nSegments)
+    return nullptr;
+
+  uint64_t offset = segment * m_segmentSize;
+  size_t length = static_cast<size_t>(std::min<uint64_t>(m_segmentSize, file.size - offset));
+
+  // only this segment of the file is paged in
+  shared_ptr<Data> data = make_shared<Data>(segmentName);
+  data->setContent(reinterpret_cast<const uint8_t*>(file.source->data()) + offset, length);
+  data->setFreshnessPeriod(m_freshnessPeriod);
+  data->setFinalBlockId(Name::Component::fromSegment(nSegments - 1));
+  m_sign(*data);
+
+  if (m_maxCachedSegments > 0) {
+    CachedSegment& entry = m_segments[segmentName];
+    entry.data = data;
+    entry.lruPosition = m_lru.insert(m_lru.begin(), segmentName);
+
+    if (m_segments.size() > m_maxCachedSegments) {
+      m_segments.erase(m_lru.back());
+      m_lru.pop_back();
+    }
+  }
+
+  return data;
+}
+
+void
+FilePublisher::evictFile(const Name& prefix)
+{
+  std::map<Name, CachedSegment>::iterator it = m_segments.lower_bound(prefix);
+  while (it != m_segments.end() && prefix.isPrefixOf(it->first)) {
+    m_lru.erase(it->second.lruPosition);
+    it = m_segments.erase(it);
+  }
+}
+
+} // namespace chronochat
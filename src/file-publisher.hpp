@@ -0,0 +1,121 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#ifndef CHRONOCHAT_FILE_PUBLISHER_HPP
+#define CHRONOCHAT_FILE_PUBLISHER_HPP
+
+#include "common.hpp"
+#include "file-manifest.hpp"
+
+#include <boost/iostreams/device/mapped_file.hpp>
+
+namespace chronochat {
+
+/**
+ * @brief Publisher of files as segmented objects
+ *
+ * A published file is mapped into memory rather than read, so files of any size can be
+ * shared.  Its segments are made and signed only when they are asked for, the recently
+ * asked ones are kept so every receiver of a file does not cost another signature.  A file
+ * must not be truncated while it is published.
+ */
+class FilePublisher : noncopyable
+{
+public:
+  class Error : public std::runtime_error
+  {
+  public:
+    explicit
+    Error(const std::string& what)
+      : std::runtime_error(what)
+    {
+    }
+  };
+
+  typedef function<void(Data& data)> SignFunction;
+
+  // leaves room for the name and the signature within the maximum packet size
+  static const size_t DEFAULT_SEGMENT_SIZE = 7168;
+
+  // signed segments kept, about 2 MB with the default segment size
+  static const size_t DEFAULT_MAX_CACHED_SEGMENTS = 256;
+
+  explicit
+  FilePublisher(const SignFunction& sign,
+                size_t segmentSize = DEFAULT_SEGMENT_SIZE,
+                const time::milliseconds& freshnessPeriod = time::milliseconds(60000),
+                size_t maxCachedSegments = DEFAULT_MAX_CACHED_SEGMENTS);
+
+  /**
+   * @brief publish the file at @p path as the segments <@p prefix>/<segment number>
+   * @return the manifest of the file
+   * @throw Error the file cannot be read
+   */
+  FileManifest
+  addFile(const Name& prefix, const std::string& path);
+
+  /// @brief stop publishing the file under @p prefix
+  void
+  removeFile(const Name& prefix);
+
+  void
+  clear();
+
+  size_t
+  size() const
+  {
+    return m_files.size();
+  }
+
+  /// @brief number of signed segments kept
+  size_t
+  getNCachedSegments() const
+  {
+    return m_segments.size();
+  }
+
+  /**
+   * @brief get the segment named @p segmentName, nullptr unless it is published
+   *
+   * The segment is made and signed unless it is cached.
+   */
+  shared_ptr<const Data>
+  makeSegment(const Name& segmentName);
+
+private:
+  /// @brief drop the cached segments of the file under @p prefix
+  void
+  evictFile(const Name& prefix);
+
+private:
+  struct File
+  {
+    uint64_t size;
+    // empty files are not mapped
+    shared_ptr<boost::iostreams::mapped_file_source> source;
+  };
+
+  SignFunction m_sign;
+  size_t m_segmentSize;
+  time::milliseconds m_freshnessPeriod;
+  std::map<Name, File> m_files;
+
+  struct CachedSegment
+  {
+    shared_ptr<const Data> data;
+    std::list<Name>::iterator lruPosition;
+  };
+
+  size_t m_maxCachedSegments;
+  std::map<Name, CachedSegment> m_segments;
+  std::list<Name> m_lru;                 // cached segments, most recently used first
+};
+
+} // namespace chronochat
+
+#endif // CHRONOCHAT_FILE_PUBLISHER_HPP
@@ -0,0 +1,61 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#include "hello-interval.hpp"
+
+namespace chronochat {
+
+static const double MIN_JITTER = 0.75;
+static const double MAX_JITTER = 1.25;
+static const int TIMEOUT_MULTIPLIER = 3;
+
+HelloInterval::HelloInterval(const time::milliseconds& minInterval, size_t nHellosPerInterval,
+                             uint32_t seed)
+  : m_minInterval(minInterval)
+  , m_nHellosPerInterval(std::max<size_t>(nHellosPerInterval, 1))
+  , m_randomGenerator(seed)
+  , m_jitter(m_randomGenerator, boost::uniform_real<>(MIN_JITTER, MAX_JITTER))
+{
+}
+
+time::milliseconds
+HelloInterval::getMeanInterval(size_t nParticipants) const
+{
+  if (nParticipants <= m_nHellosPerInterval)
+    return m_minInterval;
+
+  return time::milliseconds(static_cast<int64_t>(
+    static_cast<double>(m_minInterval.count()) * nParticipants / m_nHellosPerInterval));
+}
+
+time::milliseconds
+HelloInterval::getNextInterval(size_t nParticipants)
+{
+  return getNextInterval(getMeanInterval(nParticipants));
+}
+
+time::milliseconds
+HelloInterval::getNextInterval(const time::milliseconds& meanInterval)
+{
+  return time::milliseconds(static_cast<int64_t>(meanInterval.count() * m_jitter()));
+}
+
+time::milliseconds
+HelloInterval::getTimeout(size_t nParticipants) const
+{
+  return getTimeout(getMeanInterval(nParticipants));
+}
+
+time::milliseconds
+HelloInterval::getTimeout(const time::milliseconds& meanInterval)
+{
+  return time::milliseconds(static_cast<int64_t>(
+    meanInterval.count() * MAX_JITTER * TIMEOUT_MULTIPLIER));
+}
+
+} // namespace chronochat
@@ -0,0 +1,70 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#ifndef CHRONOCHAT_HELLO_INTERVAL_HPP
+#define CHRONOCHAT_HELLO_INTERVAL_HPP
+
+#include "common.hpp"
+
+#include <boost/random.hpp>
+
+namespace chronochat {
+
+/**
+ * @brief Interval of the HELLO messages of a room participant
+ *
+ * Like RTCP reports, the interval grows with the number of participants so that the
+ * whole room sends at most @p nHellosPerInterval hellos per @p minInterval.  Each
+ * interval is randomized between 3/4 and 5/4 of the mean, so that participants which
+ * joined together do not stay in lockstep.
+ */
+class HelloInterval
+{
+public:
+  HelloInterval(const time::milliseconds& minInterval, size_t nHellosPerInterval,
+                uint32_t seed);
+
+  time::milliseconds
+  getMeanInterval(size_t nParticipants) const;
+
+  /// @brief get a randomized interval until the next hello
+  time::milliseconds
+  getNextInterval(size_t nParticipants);
+
+  /// @brief get a randomized interval until the next hello, around @p meanInterval
+  time::milliseconds
+  getNextInterval(const time::milliseconds& meanInterval);
+
+  /**
+   * @brief get the time after which a silent participant is considered gone
+   *
+   * The timeout covers two lost hellos at the longest randomized interval.
+   */
+  time::milliseconds
+  getTimeout(size_t nParticipants) const;
+
+  /**
+   * @brief get the timeout of a participant whose hellos come every @p meanInterval
+   *
+   * The participants of a room may count different rosters, so the timeout of a remote
+   * participant is derived from the interval it announces rather than from the own one.
+   */
+  static time::milliseconds
+  getTimeout(const time::milliseconds& meanInterval);
+
+private:
+  time::milliseconds m_minInterval;
+  size_t m_nHellosPerInterval;
+
+  boost::mt19937 m_randomGenerator;
+  boost::variate_generator<boost::mt19937&, boost::uniform_real<>> m_jitter;
+};
+
+} // namespace chronochat
+
+#endif // CHRONOCHAT_HELLO_INTERVAL_HPP
@@ -0,0 +1,139 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#include "latency-histogram.hpp"
+
+#include <algorithm>
+#include <limits>
+
+namespace chronochat {
+
+static const int SUB_BUCKET_BITS = 5;
+static const uint64_t SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+static const uint64_t SUB_BUCKET_HALF_COUNT = SUB_BUCKET_COUNT / 2;
+// shift of the largest 64-bit values onto a sub-bucket
+static const int MAX_SHIFT = 64 - SUB_BUCKET_BITS;
+static const size_t N_BUCKETS = SUB_BUCKET_COUNT + MAX_SHIFT * SUB_BUCKET_HALF_COUNT;
+
+LatencyHistogram::LatencyHistogram()
+  : m_buckets(N_BUCKETS, 0)
+  , m_count(0)
+  , m_min(std::numeric_limits<uint64_t>::max())
+  , m_max(0)
+  , m_sum(0)
+{
+}
+
+void
+LatencyHistogram::record(const time::nanoseconds& latency)
+{
+  int64_t microseconds = time::duration_cast<time::microseconds>(latency).count();
+  uint64_t value = static_cast<uint64_t>(std::max<int64_t>(microseconds, 0));
+
+  m_buckets[getBucketIndex(value)]++;
+  m_count++;
+  m_min = std::min(m_min, value);
+  m_max = std::max(m_max, value);
+  m_sum += value;
+}
+
+void
+LatencyHistogram::merge(const LatencyHistogram& other)
+{
+  for (size_t i = 0; i < N_BUCKETS; i++)
+    m_buckets[i] += other.m_buckets[i];
+
+  m_count += other.m_count;
+  m_min = std::min(m_min, other.m_min);
+  m_max = std::max(m_max, other.m_max);
+  m_sum += other.m_sum;
+}
+
+void
+LatencyHistogram::reset()
+{
+  std::fill(m_buckets.begin(), m_buckets.end(), 0);
+  m_count = 0;
+  m_min = std::numeric_limits<uint64_t>::max();
+  m_max = 0;
+  m_sum = 0;
+}
+
+time::microseconds
+LatencyHistogram::getMin() const
+{
+  return time::microseconds(m_count == 0 ? 0 : m_min);
+}
+
+time::microseconds
+LatencyHistogram::getMax() const
+{
+  return time::microseconds(m_max);
+}
+
+time::microseconds
+LatencyHistogram::getMean() const
+{
+  if (m_count == 0)
+    return time::microseconds(0);
+
+  return time::microseconds(static_cast<int64_t>(m_sum / m_count));
+}
+
+time::microseconds
+LatencyHistogram::getPercentile(double percentile) const
+{
+  if (m_count == 0)
+    return time::microseconds(0);
+
+  percentile = std::min(std::max(percentile, 0.0), 100.0);
+  uint64_t rank = std::max<uint64_t>(static_cast<uint64_t>(percentile / 100 * m_count + 0.5), 1);
+
+  uint64_t nCounted = 0;
+  for (size_t i = 0; i < N_BUCKETS; i++) {
+    nCounted += m_buckets[i];
+    if (nCounted >= rank) {
+      // the bucket bound may exceed the largest latency actually seen
+      return time::microseconds(std::min(getBucketHighest(i), m_max));
+    }
+  }
+
+  return time::microseconds(m_max);
+}
+
+size_t
+LatencyHistogram::getBucketIndex(uint64_t value)
+{
+  if (value < SUB_BUCKET_COUNT)
+    return value;
+
+  int msb = 63;
+  while ((value >> msb) == 0)
+    msb--;
+
+  // the top SUB_BUCKET_BITS bits select the sub-bucket, its top bit is always set
+  int shift = msb - (SUB_BUCKET_BITS - 1);
+  uint64_t subBucket = (value >> shift) - SUB_BUCKET_HALF_COUNT;
+
+  return SUB_BUCKET_COUNT + (shift - 1) * SUB_BUCKET_HALF_COUNT + subBucket;
+}
+
+uint64_t
+LatencyHistogram::getBucketHighest(size_t index)
+{
+  if (index < SUB_BUCKET_COUNT)
+    return index;
+
+  size_t offset = index - SUB_BUCKET_COUNT;
+  int shift = offset / SUB_BUCKET_HALF_COUNT + 1;
+  uint64_t top = offset % SUB_BUCKET_HALF_COUNT + SUB_BUCKET_HALF_COUNT;
+
+  return (top << shift) + ((uint64_t(1) << shift) - 1);
+}
+
+} // namespace chronochat
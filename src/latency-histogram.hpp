@@ -0,0 +1,78 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#ifndef CHRONOCHAT_LATENCY_HISTOGRAM_HPP
+#define CHRONOCHAT_LATENCY_HISTOGRAM_HPP
+
+#include "common.hpp"
+
+namespace chronochat {
+
+/**
+ * @brief Histogram of latencies with a bounded relative error
+ *
+ * Latencies are counted in microseconds.  Buckets are exact below 32 us; above, every
+ * power of two is split into 16 buckets of equal width, so a reported latency is at
+ * most about 6% larger than the recorded one, from microseconds up to days, in a few KB.
+ *
+ * The histogram is not thread-safe.
+ */
+class LatencyHistogram
+{
+public:
+  LatencyHistogram();
+
+  /// @brief count one latency, negative ones (e.g., from clock skew) count as zero
+  void
+  record(const time::nanoseconds& latency);
+
+  /// @brief add all latencies counted by @p other
+  void
+  merge(const LatencyHistogram& other);
+
+  void
+  reset();
+
+  uint64_t
+  getCount() const
+  {
+    return m_count;
+  }
+
+  time::microseconds
+  getMin() const;
+
+  time::microseconds
+  getMax() const;
+
+  time::microseconds
+  getMean() const;
+
+  /// @brief get the latency which @p percentile percent of the counted ones do not exceed
+  time::microseconds
+  getPercentile(double percentile) const;
+
+CHRONOCHAT_PUBLIC_WITH_TESTS_ELSE_PRIVATE:
+  static size_t
+  getBucketIndex(uint64_t value);
+
+  /// @brief get the largest value counted in the bucket at @p index
+  static uint64_t
+  getBucketHighest(size_t index);
+
+private:
+  std::vector<uint64_t> m_buckets;
+  uint64_t m_count;
+  uint64_t m_min;
+  uint64_t m_max;
+  double m_sum;
+};
+
+} // namespace chronochat
+
+#endif // CHRONOCHAT_LATENCY_HISTOGRAM_HPP
@@ -0,0 +1,82 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#include "message-bundler.hpp"
+
+namespace chronochat {
+
+MessageBundler::MessageBundler(ndn::Scheduler& scheduler,
+                               const time::nanoseconds& window,
+                               size_t maxBundleSize,
+                               const PublishCallback& publish)
+  : m_scheduler(scheduler)
+  , m_window(window)
+  , m_maxBundleSize(maxBundleSize)
+  , m_publish(publish)
+  , m_outgoingSize(0)
+  // the first message goes out at once
+  , m_lastPublishTime(time::steady_clock::now() - window)
+{
+}
+
+MessageBundler::~MessageBundler()
+{
+  stop();
+}
+
+void
+MessageBundler::send(const ChatMessage& msg, bool canBundle)
+{
+  if (msg.getMsgType() != ChatMessage::CHAT || !canBundle) {
+    flush();
+    m_outgoing.addMessage(msg);
+    flush();
+    return;
+  }
+
+  size_t msgSize = msg.wireEncode().size();
+  if (m_outgoingSize + msgSize > m_maxBundleSize)
+    flush();
+
+  m_outgoing.addMessage(msg);
+  m_outgoingSize += msgSize;
+
+  time::nanoseconds sinceLastPublish = time::steady_clock::now() - m_lastPublishTime;
+  if (sinceLastPublish >= m_window)
+    flush();
+  else if (!static_cast<bool>(m_publishEventId))
+    m_publishEventId = m_scheduler.scheduleEvent(m_window - sinceLastPublish,
+                                                 bind(&MessageBundler::flush, this));
+}
+
+void
+MessageBundler::flush()
+{
+  stop();
+
+  if (m_outgoing.empty())
+    return;
+
+  // the messages are kept if they cannot be published
+  m_publish(m_outgoing);
+
+  m_lastPublishTime = time::steady_clock::now();
+  m_outgoing.clear();
+  m_outgoingSize = 0;
+}
+
+void
+MessageBundler::stop()
+{
+  if (static_cast<bool>(m_publishEventId)) {
+    m_scheduler.cancelEvent(m_publishEventId);
+    m_publishEventId.reset();
+  }
+}
+
+} // namespace chronochat
@@ -0,0 +1,91 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#ifndef CHRONOCHAT_MESSAGE_BUNDLER_HPP
+#define CHRONOCHAT_MESSAGE_BUNDLER_HPP
+
+#include "common.hpp"
+#include "chat-message-bundle.hpp"
+
+#include <ndn-cxx/util/scheduler.hpp>
+
+namespace chronochat {
+
+/**
+ * @brief Collects the own chat messages of bursts into bundles
+ *
+ * A chat message is only held back if another one has been published within the window,
+ * so bursts are bundled while a single message goes out at once.  A bundle is published
+ * before it would grow beyond the maximum size.
+ *
+ * Other messages are never bundled.  The held back messages are published first, then the
+ * message alone, so the order is kept and JOIN, HELLO and LEAVE are never delayed.
+ *
+ * The bundler must be destroyed before the scheduler.
+ */
+class MessageBundler : noncopyable
+{
+public:
+  /// @brief publish @p messages as the data of one sequence number, in the order they are
+  typedef function<void(const ChatMessageBundle& messages)> PublishCallback;
+
+  MessageBundler(ndn::Scheduler& scheduler,
+                 const time::nanoseconds& window,
+                 size_t maxBundleSize,
+                 const PublishCallback& publish);
+
+  ~MessageBundler();
+
+  /**
+   * @brief send @p msg
+   * @param canBundle false if some receivers do not understand bundles, then every
+   *                  message is published alone
+   */
+  void
+  send(const ChatMessage& msg, bool canBundle);
+
+  /// @brief publish the held back messages now
+  void
+  flush();
+
+  /**
+   * @brief stop the timer, the held back messages stay until the next send or flush
+   *
+   * This must be called before the events of the scheduler are cancelled all at once.
+   */
+  void
+  stop();
+
+  /// @brief true if no message is held back
+  bool
+  empty() const
+  {
+    return m_outgoing.empty();
+  }
+
+  const time::steady_clock::TimePoint&
+  getLastPublishTime() const
+  {
+    return m_lastPublishTime;
+  }
+
+private:
+  ndn::Scheduler& m_scheduler;
+  time::nanoseconds m_window;
+  size_t m_maxBundleSize;
+  PublishCallback m_publish;
+
+  ChatMessageBundle m_outgoing;          // messages held back
+  size_t m_outgoingSize;                 // encoded size of the messages in m_outgoing
+  ndn::EventId m_publishEventId;
+  time::steady_clock::TimePoint m_lastPublishTime;
+};
+
+} // namespace chronochat
+
+#endif // CHRONOCHAT_MESSAGE_BUNDLER_HPP
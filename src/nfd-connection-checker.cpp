@@ -10,62 +10,159 @@
 #include "nfd-connection-checker.hpp"
 
 #ifndef Q_MOC_RUN
-
+#include "logging.h"
+#include <algorithm>
 #endif
 
+INIT_LOGGER("NfdConnectionChecker");
+
 namespace chronochat {
 
-static const int CONNECTION_RETRY_TIMER = 2;
+static const time::milliseconds INITIAL_RETRY_DELAY(100);
+static const time::milliseconds MAX_RETRY_DELAY(5000);
+static const time::milliseconds PROBE_LIFETIME(1000);
+
+NfdConnectionChecker::NfdConnectionChecker(const shared_ptr<SyncRuntime>& runtime,
+                                           QObject* parent)
+  : QObject(parent)
+  , m_runtime(runtime)
+  , m_shard(0)
+  , m_isAttached(false)
+  , m_isNfdConnected(true)
+  , m_retryDelay(INITIAL_RETRY_DELAY)
+  , m_random(std::random_device()())
+{
+}
 
-NfdConnectionChecker::NfdConnectionChecker(QObject* parent)
-  :QThread(parent)
+NfdConnectionChecker::~NfdConnectionChecker()
 {
+  shutdown();
 }
 
 void
-NfdConnectionChecker::run()
+NfdConnectionChecker::start()
 {
-  m_face = unique_ptr<ndn::Face>(new ndn::Face);
-#ifdef BOOST_THREAD_USES_CHRONO
-  time::seconds reconnetTimer = time::seconds(CONNECTION_RETRY_TIMER);
-#else
-  boost::posix_time::time_duration reconnectTimer;
-  reconnectTimer = boost::posix_time::seconds(CONNECTION_RETRY_TIMER);
-#endif
-  do {
-    {
-      std::lock_guard<std::mutex>lock(m_nfdMutex);
-      m_nfdConnected = true;
-    }
-    try {
-      m_face->expressInterest(Interest("/localhost/nfd/status"),
-                              [&] (const Interest& interest, const Data& data) {
-                                m_face->shutdown();
-                              },
-                              [] (const Interest& interest) {});
-      m_face->processEvents(time::milliseconds::zero(), true);
-    }
-    catch (std::runtime_error& e) {
-      {
-        std::lock_guard<std::mutex>lock(m_nfdMutex);
-        m_nfdConnected = false;
-      }
-#ifdef BOOST_THREAD_USES_CHRONO
-      boost::this_thread::sleep_for(reconnetTimer);
-#else
-      boost::this_thread::sleep(reconnectTimer);
-#endif
-    }
-  } while (!m_nfdConnected);
-  emit nfdConnected();
+  m_shard = m_runtime->attach(this);
+  m_isAttached = true;
+
+  m_runtime->invoke(m_shard, [this] {
+      m_scheduler.reset(new ndn::Scheduler(m_runtime->getIoService(m_shard)));
+    });
+}
+
+void
+NfdConnectionChecker::reportFailure()
+{
+  if (m_isAttached)
+    m_runtime->post(m_shard, [this] { this->onFailure(); });
+}
+
+LatencyHistogram
+NfdConnectionChecker::getReconnectLatency()
+{
+  LatencyHistogram latency;
+  if (m_isAttached)
+    m_runtime->invoke(m_shard, [this, &latency] { latency = m_reconnectLatency; });
+  else
+    latency = m_reconnectLatency;
+
+  return latency;
 }
 
 void
 NfdConnectionChecker::shutdown()
 {
-  // In this case, we just stop checking the nfd connection and exit
-  std::lock_guard<std::mutex>lock(m_nfdMutex);
-  m_nfdConnected = true;
+  if (!m_isAttached)
+    return;
+
+  m_runtime->invoke(m_shard, [this] {
+      stopProbe();
+      m_scheduler.reset();
+    });
+  m_runtime->detach(m_shard, this);
+  m_isAttached = false;
+}
+
+void
+NfdConnectionChecker::onShardError(const std::runtime_error& e)
+{
+  // the probe of this shard has found no forwarder, or the connection of the shard is lost
+  if (m_probeToken != nullptr)
+    onProbed(false);
+  else
+    onFailure();
+}
+
+void
+NfdConnectionChecker::onFailure()
+{
+  if (!m_isNfdConnected)
+    return;
+
+  m_isNfdConnected = false;
+  m_failureTime = time::steady_clock::now();
+  m_retryDelay = INITIAL_RETRY_DELAY;
+  probe();
+}
+
+void
+NfdConnectionChecker::probe()
+{
+  // the face connects the shard to the forwarder again, or the shard reports the error
+  m_face = m_runtime->makeFace(m_shard);
+  m_probeToken = make_shared<bool>(true);
+
+  weak_ptr<bool> probeToken = m_probeToken;
+  Interest interest("/localhost/nfd/status");
+  interest.setInterestLifetime(PROBE_LIFETIME);
+  m_face->expressInterest(interest,
+                          [this, probeToken] (const Interest& interest, const Data& data) {
+                            if (!probeToken.expired())
+                              this->onProbed(true);
+                          },
+                          [this, probeToken] (const Interest& interest) {
+                            if (!probeToken.expired())
+                              this->onProbed(true);
+                          });
+}
+
+void
+NfdConnectionChecker::onProbed(bool isConnected)
+{
+  stopProbe();
+
+  if (!isConnected) {
+    // the jitter keeps the instances on one host from probing in lockstep
+    std::uniform_int_distribution<int64_t> jitter(m_retryDelay.count() / 2,
+                                                  m_retryDelay.count());
+    m_scheduler->scheduleEvent(time::milliseconds(jitter(m_random)), [this] { probe(); });
+    m_retryDelay = std::min(m_retryDelay * 2, MAX_RETRY_DELAY);
+    return;
+  }
+
+  m_isNfdConnected = true;
+  m_reconnectLatency.record(time::steady_clock::now() - m_failureTime);
+  _LOG_DEBUG("Reconnected to NFD after " <<
+             time::duration_cast<time::milliseconds>(time::steady_clock::now() -
+                                                     m_failureTime).count() <<
+             " ms, p50 of " << m_reconnectLatency.getCount() << " reconnects: " <<
+             m_reconnectLatency.getPercentile(50).count() << " us");
+
+  emit nfdConnected();
+}
+
+void
+NfdConnectionChecker::stopProbe()
+{
+  m_probeToken.reset();
+  if (m_face == nullptr)
+    return;
+
+  // the face may be dispatching the answer of the probe
+  m_face->shutdown();
+  shared_ptr<ndn::Face> face = m_face;
+  m_face->getIoService().post([face] () mutable { face.reset(); });
+  m_face.reset();
 }
 
 } // namespace chronochat
@@ -10,27 +10,46 @@
 #ifndef CHRONOCHAT_NFD_CONNECTION_CHECKER_HPP
 #define CHRONOCHAT_NFD_CONNECTION_CHECKER_HPP
 
-#include <QThread>
+#include <QObject>
 
 #ifndef Q_MOC_RUN
 #include "common.hpp"
-#include <mutex>
-#include <boost/thread.hpp>
-#include <ndn-cxx/face.hpp>
+#include "latency-histogram.hpp"
+#include "sync-runtime.hpp"
+#include <random>
+#include <ndn-cxx/util/scheduler.hpp>
 #endif
 
 namespace chronochat {
 
-class NfdConnectionChecker : public QThread
+/**
+ * @brief supervisor of the connection to the local forwarder, shared by all backends
+ *
+ * The checker lives on a shard of the SyncRuntime and is idle until a backend reports a
+ * failure.  It then probes the forwarder with exponential backoff and jitter.  When the
+ * forwarder answers, nfdConnected() is emitted, and the backends connect again.
+ */
+class NfdConnectionChecker : public QObject, public SyncRuntime::Client
 {
   Q_OBJECT
 
 public:
-  NfdConnectionChecker(QObject* parent = nullptr);
+  explicit
+  NfdConnectionChecker(const shared_ptr<SyncRuntime>& runtime, QObject* parent = nullptr);
+
+  ~NfdConnectionChecker();
+
+  /// @brief attach to the runtime
+  void
+  start();
 
-protected:
+  /// @brief report that a face has lost the forwarder, probing starts unless it runs already
   void
-  run();
+  reportFailure();
+
+  /// @brief the time from the first failure report to the answer of the forwarder
+  LatencyHistogram
+  getReconnectLatency();
 
 signals:
   void
@@ -41,10 +60,36 @@ public slots:
   shutdown();
 
 private:
-  bool m_nfdConnected;
-  std::mutex m_nfdMutex;
+  virtual void
+  onShardError(const std::runtime_error& e);
+
+  void
+  onFailure();
+
+  void
+  probe();
+
+  void
+  onProbed(bool isConnected);
+
+  /// @brief release the face of the probe in flight, if any
+  void
+  stopProbe();
+
+private:
+  shared_ptr<SyncRuntime> m_runtime;
+  size_t m_shard;                        // shard of m_runtime the checker runs on
+  bool m_isAttached;                     // accessed by GUI thread only
 
-  unique_ptr<ndn::Face> m_face;
+  // only accessed on the shard thread
+  unique_ptr<ndn::Scheduler> m_scheduler;
+  shared_ptr<ndn::Face> m_face;          // of the probe in flight
+  shared_ptr<bool> m_probeToken;         // expires when the probe has completed
+  bool m_isNfdConnected;
+  time::milliseconds m_retryDelay;
+  time::steady_clock::TimePoint m_failureTime;
+  LatencyHistogram m_reconnectLatency;
+  std::mt19937 m_random;
 };
 
 } // namespace chronochat
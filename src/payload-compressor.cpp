@@ -0,0 +1,124 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#include "payload-compressor.hpp"
+#include "tlv-codec.hpp"
+
+#ifdef HAVE_LZ4
+#include <lz4.h>
+#endif
+
+namespace chronochat {
+
+const size_t PayloadCompressor::DEFAULT_THRESHOLD;
+const size_t PayloadCompressor::MAX_UNCOMPRESSED_SIZE;
+
+// CompressedContent := COMPRESSED-CONTENT-TYPE TLV-LENGTH
+//                        UncompressedSize
+//                        CompressedData
+//
+// UncompressedSize := UNCOMPRESSED-SIZE-TYPE TLV-LENGTH
+//                       nonNegativeInteger
+//
+// CompressedData := COMPRESSED-DATA-TYPE TLV-LENGTH
+//                     LZ4 block of the wire of a ChatMessage or ChatMessageBundle
+//
+struct CompressedContent
+{
+  typedef PayloadCompressor::Error Error;
+
+  uint64_t uncompressedSize;
+  StringRef data;
+};
+
+typedef codec::Fields<CompressedContent> CompressedContentFields;
+
+typedef codec::Record<CompressedContent, tlv::CompressedContent,
+                      CompressedContentFields::Required<
+                        codec::Tlv<tlv::UncompressedSize, codec::NonNegativeInteger<uint64_t>>,
+                        &CompressedContent::uncompressedSize>,
+                      CompressedContentFields::Required<
+                        codec::Tlv<tlv::CompressedData, codec::StringView>,
+                        &CompressedContent::data>
+                      > CompressedContentSchema;
+
+PayloadCompressor::PayloadCompressor(size_t threshold)
+  : m_threshold(threshold)
+{
+}
+
+bool
+PayloadCompressor::isAvailable()
+{
+#ifdef HAVE_LZ4
+  return true;
+#else
+  return false;
+#endif
+}
+
+Block
+PayloadCompressor::compress(const Block& content)
+{
+#ifdef HAVE_LZ4
+  if (!isWorthCompressing(content) || content.size() > MAX_UNCOMPRESSED_SIZE)
+    return content;
+
+  int srcSize = static_cast<int>(content.size());
+  m_compressBuffer.resize(LZ4_compressBound(srcSize));
+  int compressedSize = LZ4_compress_default(reinterpret_cast<const char*>(content.wire()),
+                                            &m_compressBuffer.front(), srcSize,
+                                            static_cast<int>(m_compressBuffer.size()));
+
+  CompressedContent compressed;
+  compressed.uncompressedSize = content.size();
+  compressed.data = StringRef(&m_compressBuffer.front(), compressedSize);
+
+  if (compressedSize <= 0 || CompressedContentSchema::size(compressed) >= content.size())
+    return content;
+
+  return CompressedContentSchema::encode(compressed);
+#else
+  return content;
+#endif
+}
+
+Block
+PayloadCompressor::decompress(const Block& compressedWire)
+{
+#ifdef HAVE_LZ4
+  CompressedContent compressed;
+  CompressedContentSchema::decode(compressedWire, compressed);
+
+  if (compressed.uncompressedSize == 0 || compressed.uncompressedSize > MAX_UNCOMPRESSED_SIZE)
+    throw Error("Invalid uncompressed size " + std::to_string(compressed.uncompressedSize));
+
+  // the buffer is still held by blocks of the previous content
+  if (m_decompressBuffer == nullptr || !m_decompressBuffer.unique())
+    m_decompressBuffer = make_shared<ndn::Buffer>();
+  m_decompressBuffer->resize(compressed.uncompressedSize);
+
+  int size = LZ4_decompress_safe(compressed.data.data(),
+                                 reinterpret_cast<char*>(&m_decompressBuffer->front()),
+                                 static_cast<int>(compressed.data.size()),
+                                 static_cast<int>(m_decompressBuffer->size()));
+  if (size < 0 || static_cast<uint64_t>(size) != compressed.uncompressedSize)
+    throw Error("Cannot decompress content");
+
+  try {
+    return Block(m_decompressBuffer);
+  }
+  catch (const tlv::Error& e) {
+    throw Error(std::string("Malformed decompressed content: ") + e.what());
+  }
+#else
+  throw Error("Compressed content is not supported by this build");
+#endif
+}
+
+} // namespace chronochat
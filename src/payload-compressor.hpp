@@ -0,0 +1,88 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#ifndef CHRONOCHAT_PAYLOAD_COMPRESSOR_HPP
+#define CHRONOCHAT_PAYLOAD_COMPRESSOR_HPP
+
+#include "common.hpp"
+#include "tlv.hpp"
+#include <ndn-cxx/encoding/block.hpp>
+#include <ndn-cxx/encoding/buffer.hpp>
+
+namespace chronochat {
+
+/**
+ * @brief LZ4 compression of the content of chat data, i.e., a ChatMessage or a bundle
+ *
+ * Content below the threshold, or which does not shrink, is left as it is.  Compressed
+ * content is a CompressedContent element, so receivers tell the two apart by the TLV type.
+ * Only peers which announce SessionInfo::FEATURE_COMPRESSION can decompress it.
+ *
+ * LZ4 is optional, a build without it leaves all content as it is and cannot decompress.
+ *
+ * Decompression reuses its output buffer as soon as no block refers to it any more.
+ */
+class PayloadCompressor : noncopyable
+{
+public:
+  class Error : public std::runtime_error
+  {
+  public:
+    explicit
+    Error(const std::string& what)
+      : std::runtime_error(what)
+    {
+    }
+  };
+
+  static const size_t DEFAULT_THRESHOLD = 256;
+  // bounds the memory which a small packet can make the receiver allocate
+  static const size_t MAX_UNCOMPRESSED_SIZE = 1 << 20;
+
+  explicit
+  PayloadCompressor(size_t threshold = DEFAULT_THRESHOLD);
+
+  /// @brief true if the library is built with LZ4
+  static bool
+  isAvailable();
+
+  /// @brief true if @p content should be compressed
+  bool
+  isWorthCompressing(const Block& content) const
+  {
+    return content.size() >= m_threshold;
+  }
+
+  /**
+   * @brief compress @p content into a CompressedContent element
+   * @return the element, or @p content if it is below the threshold or does not shrink,
+   *         or if LZ4 is not available
+   */
+  Block
+  compress(const Block& content);
+
+  /**
+   * @brief decompress a CompressedContent element
+   *
+   * The result and the blocks parsed from it keep the buffer, which is reused by a later
+   * call once they are all released.
+   *
+   * @throw Error @p compressed is malformed, or LZ4 is not available
+   */
+  Block
+  decompress(const Block& compressed);
+
+private:
+  size_t m_threshold;
+  std::vector<char> m_compressBuffer;
+  shared_ptr<ndn::Buffer> m_decompressBuffer;
+};
+
+} // namespace chronochat
+
+#endif // CHRONOCHAT_PAYLOAD_COMPRESSOR_HPP
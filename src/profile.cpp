@@ -10,6 +10,7 @@
  */
 
 #include "profile.hpp"
+#include "tlv-codec.hpp"
 #include "logging.h"
 
 namespace chronochat {
@@ -77,62 +78,34 @@ Profile::Profile(const Profile& profile)
 {
 }
 
-template<bool T>
-size_t
-Profile::wireEncode(ndn::EncodingImpl<T>& block) const
+// Profile := PROFILE-TYPE TLV-LENGTH
+//             ProfileEntry+
+//
+// ProfileEntry := PROFILEENTRY-TYPE TLV-LENGTH
+//                   Oid
+//                   EntryData
+//
+// Oid := OID-TYPE TLV-LENGTH
+//            String
+//
+// EntryData := ENTRYDATA-TYPE TLV-LENGTH
+//                  String
+typedef codec::Pair<tlv::ProfileEntry,
+                    codec::Tlv<tlv::Oid, codec::String>,
+                    codec::Tlv<tlv::EntryData, codec::String>> ProfileEntrySchema;
+
+struct Profile::Schema
+  : codec::Record<Profile, tlv::Profile,
+                  codec::Fields<Profile>::Repeated<ProfileEntrySchema,
+                                                   map<string, string>,
+                                                   &Profile::m_entries>>
 {
-  size_t totalLength = 0;
-
-  // Profile := PROFILE-TYPE TLV-LENGTH
-  //             ProfileEntry+
-  //
-  // ProfileEntry := PROFILEENTRY-TYPE TLV-LENGTH
-  //                   Oid
-  //                   EntryData
-  //
-  // Oid := OID-TYPE TLV-LENGTH
-  //            String
-  //
-  // EntryData := ENTRYDATA-TYPE TLV-LENGTH
-  //                  String
-
-  // Entries
-  size_t entryLength = 0;
-  for (map<string, string>::const_reverse_iterator it = m_entries.rbegin();
-       it != m_entries.rend(); it++) {
-    // Entry Data
-    const uint8_t* dataWire = reinterpret_cast<const uint8_t*>(it->second.c_str());
-    entryLength += block.prependByteArrayBlock(tlv::EntryData, dataWire, it->second.length());
-    // Oid
-    const uint8_t* oidWire = reinterpret_cast<const uint8_t*>(it->first.c_str());
-    entryLength += block.prependByteArrayBlock(tlv::Oid, oidWire, it->first.length());
-    entryLength += block.prependVarNumber(entryLength);
-    entryLength += block.prependVarNumber(tlv::ProfileEntry);
-    totalLength += entryLength;
-    entryLength = 0;
-  }
-
-  // Profile
-  totalLength += block.prependVarNumber(totalLength);
-  totalLength += block.prependVarNumber(tlv::Profile);
-
-  return totalLength;
-}
-
-
+};
 
 const Block&
 Profile::wireEncode() const
 {
-  ndn::EncodingEstimator estimator;
-  size_t estimatedSize = wireEncode(estimator);
-
-  ndn::EncodingBuffer buffer(estimatedSize, 0);
-  wireEncode(buffer);
-
-  m_wire = buffer.block();
-  m_wire.parse();
-
+  m_wire = Schema::encode(*this);
   return m_wire;
 }
 
@@ -140,48 +113,7 @@ void
 Profile::wireDecode(const Block& profileWire)
 {
   m_wire = profileWire;
-  m_wire.parse();
-
-  if (m_wire.type() != tlv::Profile)
-    throw Error("Unexpected TLV number when decoding profile packet");
-
-  Block::element_const_iterator i = m_wire.elements_begin();
-  if (i == m_wire.elements_end())
-    throw Error("Missing Profile Entry");
-  if (i->type() != tlv::ProfileEntry)
-    throw Error("Expect Profile Entry but get TLV Type " + std::to_string(i->type()));
-
-  while (i != m_wire.elements_end() && i->type() == tlv::ProfileEntry) {
-    Block temp = *i;
-    temp.parse();
-    Block::element_const_iterator j = temp.elements_begin();
-    if (j == temp.elements_end())
-      throw Error("Missing Oid");
-    if (j->type() != tlv::Oid)
-      throw Error("Expect Oid but get TLV Type" + std::to_string(j->type()));
-
-    string Oid = std::string(reinterpret_cast<const char* >(j->value()),
-                             j->value_size());
-    ++j;
-    if (j == temp.elements_end())
-      throw Error("Missing EntryData");
-    if (j->type() != tlv::EntryData)
-      throw Error("Expect EntryData but get TLV Type " + std::to_string(j->type()));
-
-    string EntryData = std::string(reinterpret_cast<const char* >(j->value()),
-                                   j->value_size());
-    ++j;
-    if (j != temp.elements_end()) {
-      throw Error("Unexpected element");
-    }
-    m_entries[Oid] = EntryData;
-    ++i;
-  }
-
-  if (i != m_wire.elements_end()) {
-      throw Error("Unexpected element");
-  }
-
+  Schema::decode(m_wire, *this);
 }
 
 bool
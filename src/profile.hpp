@@ -117,9 +117,8 @@ public:
   operator!=(const Profile& profile) const;
 
 private:
-  template<bool T>
-  size_t
-  wireEncode(ndn::EncodingImpl<T>& block) const;
+  // TLV schema, see tlv-codec.hpp
+  struct Schema;
 
 
 private:
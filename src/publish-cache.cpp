@@ -0,0 +1,308 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#include "publish-cache.hpp"
+#include "cryptopp.hpp"
+
+#include <algorithm>
+#include <boost/filesystem.hpp>
+#include "logging.h"
+
+INIT_LOGGER("PublishCache");
+
+namespace chronochat {
+
+namespace fs = boost::filesystem;
+
+const size_t PublishCache::DEFAULT_MEMORY_SIZE;
+const uint64_t PublishCache::DEFAULT_DISK_SIZE;
+
+static bool
+readVarNumber(std::istream& is, uint64_t& number, std::vector<uint8_t>& header)
+{
+  int first = is.get();
+  if (first == std::char_traits<char>::eof())
+    return false;
+  header.push_back(static_cast<uint8_t>(first));
+
+  size_t nBytes = first < 253 ? 0 : first == 253 ? 2 : first == 254 ? 4 : 8;
+  number = first < 253 ? first : 0;
+  for (size_t i = 0; i < nBytes; i++) {
+    int byte = is.get();
+    if (byte == std::char_traits<char>::eof())
+      return false;
+    header.push_back(static_cast<uint8_t>(byte));
+    number = (number << 8) | static_cast<uint8_t>(byte);
+  }
+  return true;
+}
+
+// read the next Data from the log, false at the end of the log or if the rest is garbage
+static bool
+readRecord(std::istream& is, Block& record)
+{
+  std::vector<uint8_t> header;
+  uint64_t type = 0;
+  uint64_t length = 0;
+  if (!readVarNumber(is, type, header) || !readVarNumber(is, length, header) ||
+      type != ndn::tlv::Data || length > ndn::MAX_NDN_PACKET_SIZE)
+    return false;
+
+  shared_ptr<ndn::Buffer> buffer = make_shared<ndn::Buffer>(header.size() + length);
+  std::copy(header.begin(), header.end(), buffer->begin());
+  if (!is.read(reinterpret_cast<char*>(&buffer->front()) + header.size(), length))
+    return false;
+
+  try {
+    record = Block(buffer);
+    record.parse();
+  }
+  catch (const ndn::tlv::Error&) {
+    return false;
+  }
+  return record.find(ndn::tlv::Name) != record.elements_end();
+}
+
+PublishCache::PublishCache(const std::string& path,
+                           size_t maxMemorySize,
+                           uint64_t maxDiskSize)
+  : m_currentSize(0)
+  , m_maxMemorySize(maxMemorySize)
+  , m_maxDiskSize(maxDiskSize)
+  , m_memorySize(0)
+{
+  m_paths[LOG_CURRENT] = path;
+  m_paths[LOG_OLD] = path + ".old";
+
+  try {
+    openLog();
+  }
+  catch (const fs::filesystem_error& e) {
+    throw Error(std::string("Cannot open the publish cache: ") + e.what());
+  }
+
+  scanLog(LOG_OLD);
+  scanLog(LOG_CURRENT);
+}
+
+PublishCache::~PublishCache()
+{
+  flush();
+}
+
+void
+PublishCache::insert(const Data& data)
+{
+  std::pair<Index::iterator, bool> result = m_index.insert({data.getName(), Entry()});
+  if (!result.second)
+    return;
+
+  // the copy shares the wire
+  Entry& entry = result.first->second;
+  entry.data = make_shared<Data>(data);
+  entry.size = data.wireEncode().size();
+  entry.file = LOG_NONE;
+  entry.offset = 0;
+  entry.lruPosition = m_lru.insert(m_lru.begin(), data.getName());
+  m_memorySize += entry.size;
+
+  evict();
+}
+
+shared_ptr<const Data>
+PublishCache::find(const Name& name)
+{
+  Index::iterator it = m_index.find(name);
+  if (it == m_index.end())
+    return nullptr;
+
+  Entry& entry = it->second;
+  if (entry.data != nullptr) {
+    m_lru.splice(m_lru.begin(), m_lru, entry.lruPosition);
+    return entry.data;
+  }
+
+  // read the data back into memory
+  std::fstream& log = m_logs[entry.file];
+  shared_ptr<ndn::Buffer> buffer = make_shared<ndn::Buffer>(entry.size);
+  log.clear();
+  log.seekg(entry.offset);
+  if (!log.read(reinterpret_cast<char*>(&buffer->front()), entry.size)) {
+    _LOG_ERROR("Cannot read " << name << " from " << m_paths[entry.file]);
+    return nullptr;
+  }
+
+  shared_ptr<Data> data;
+  try {
+    data = make_shared<Data>(Block(buffer));
+  }
+  catch (const ndn::tlv::Error& e) {
+    _LOG_ERROR("Cannot decode " << name << " from " << m_paths[entry.file]);
+    return nullptr;
+  }
+
+  entry.data = data;
+  entry.lruPosition = m_lru.insert(m_lru.begin(), name);
+  m_memorySize += entry.size;
+
+  evict();
+  return data;
+}
+
+void
+PublishCache::flush()
+{
+  for (const Name& name : m_lru) {
+    Index::iterator it = m_index.find(name);
+    if (it->second.file == LOG_NONE)
+      spill(it);
+  }
+
+  m_logs[LOG_CURRENT].flush();
+}
+
+std::string
+PublishCache::getFileName(const Name& userChatPrefix)
+{
+  std::string fileName("chronochat-publish-");
+
+  std::stringstream ss;
+  {
+    using namespace CryptoPP;
+
+    SHA256 hash;
+    StringSource(userChatPrefix.wireEncode().wire(), userChatPrefix.wireEncode().size(), true,
+                 new HashFilter(hash, new HexEncoder(new FileSink(ss), false)));
+  }
+  fileName.append(ss.str()).append(".log");
+
+  return fileName;
+}
+
+void
+PublishCache::openLog()
+{
+  for (int file = LOG_CURRENT; file <= LOG_OLD; file++) {
+    if (!fs::exists(m_paths[file]))
+      std::ofstream(m_paths[file].c_str(), std::ios::binary);
+
+    m_logs[file].open(m_paths[file].c_str(),
+                      std::ios::in | std::ios::out | std::ios::binary);
+    if (!m_logs[file].is_open())
+      throw Error("Cannot open " + m_paths[file]);
+  }
+
+  m_currentSize = fs::file_size(m_paths[LOG_CURRENT]);
+}
+
+void
+PublishCache::scanLog(LogFile file)
+{
+  std::fstream& log = m_logs[file];
+  log.clear();
+  log.seekg(0);
+
+  uint64_t offset = 0;
+  Block record;
+  while (readRecord(log, record)) {
+    Entry& entry = m_index[Name(*record.find(ndn::tlv::Name))];
+    entry.file = file;
+    entry.offset = offset;
+    entry.size = record.size();
+    offset += record.size();
+  }
+
+  if (offset < fs::file_size(m_paths[file])) {
+    // a write which was cut short, the log continues from there
+    _LOG_DEBUG("Truncate " << m_paths[file] << " at " << offset);
+    log.close();
+    boost::system::error_code error;
+    fs::resize_file(m_paths[file], offset, error);
+    log.open(m_paths[file].c_str(), std::ios::in | std::ios::out | std::ios::binary);
+  }
+
+  if (file == LOG_CURRENT)
+    m_currentSize = offset;
+}
+
+void
+PublishCache::spill(Index::iterator it)
+{
+  Entry& entry = it->second;
+  if (m_currentSize + entry.size > m_maxDiskSize / 2)
+    rotateLog();
+
+  const Block& wire = entry.data->wireEncode();
+  std::fstream& log = m_logs[LOG_CURRENT];
+  log.clear();
+  log.seekp(m_currentSize);
+  if (!log.write(reinterpret_cast<const char*>(wire.wire()), wire.size())) {
+    _LOG_ERROR("Cannot write " << it->first << " to " << m_paths[LOG_CURRENT]);
+    return;
+  }
+
+  entry.file = LOG_CURRENT;
+  entry.offset = m_currentSize;
+  m_currentSize += wire.size();
+}
+
+void
+PublishCache::rotateLog()
+{
+  _LOG_DEBUG("Rotate " << m_paths[LOG_CURRENT]);
+
+  // the data which is only in the old file is dropped, the current file becomes the old one
+  for (Index::iterator it = m_index.begin(); it != m_index.end();) {
+    Entry& entry = it->second;
+    if (entry.file == LOG_OLD) {
+      if (entry.data == nullptr) {
+        it = m_index.erase(it);
+        continue;
+      }
+      entry.file = LOG_NONE;
+    }
+    else if (entry.file == LOG_CURRENT) {
+      entry.file = LOG_OLD;
+    }
+    ++it;
+  }
+
+  m_logs[LOG_CURRENT].close();
+  m_logs[LOG_OLD].close();
+
+  boost::system::error_code error;
+  fs::rename(m_paths[LOG_CURRENT], m_paths[LOG_OLD], error);
+  fs::remove(m_paths[LOG_CURRENT], error);
+  try {
+    openLog();
+  }
+  catch (const std::exception& e) {
+    _LOG_ERROR("Cannot reopen the publish cache: " << e.what());
+  }
+  m_currentSize = 0;
+}
+
+void
+PublishCache::evict()
+{
+  while (m_memorySize > m_maxMemorySize && !m_lru.empty()) {
+    Index::iterator it = m_index.find(m_lru.back());
+    Entry& entry = it->second;
+    if (entry.file == LOG_NONE)
+      spill(it);
+
+    m_memorySize -= entry.size;
+    m_lru.pop_back();
+    if (entry.file == LOG_NONE)
+      m_index.erase(it);
+    else
+      entry.data.reset();
+  }
+}
+
+} // namespace chronochat
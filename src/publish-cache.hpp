@@ -0,0 +1,128 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#ifndef CHRONOCHAT_PUBLISH_CACHE_HPP
+#define CHRONOCHAT_PUBLISH_CACHE_HPP
+
+#include "common.hpp"
+
+#include <fstream>
+
+namespace chronochat {
+
+/**
+ * @brief Store of the own published data, which outlives the sync session and the process
+ *
+ * Recently used data is kept in memory up to maxMemorySize bytes, the least recently used
+ * data is spilled to a log file.  Data which is only in memory is also written by flush().
+ * The log is split into a current and an old file of up to maxDiskSize / 2 bytes each.
+ * When the current file is full, the old one is dropped along with its data, so the oldest
+ * data is forgotten first.  The files are indexed again when the cache is opened.
+ */
+class PublishCache : noncopyable
+{
+public:
+  class Error : public std::runtime_error
+  {
+  public:
+    explicit
+    Error(const std::string& what)
+      : std::runtime_error(what)
+    {
+    }
+  };
+
+  static const size_t DEFAULT_MEMORY_SIZE = 4 << 20;
+  static const uint64_t DEFAULT_DISK_SIZE = 64 << 20;
+
+  /**
+   * @param path the log files are <path> and <path>.old
+   * @throw Error the log cannot be opened
+   */
+  explicit
+  PublishCache(const std::string& path,
+               size_t maxMemorySize = DEFAULT_MEMORY_SIZE,
+               uint64_t maxDiskSize = DEFAULT_DISK_SIZE);
+
+  /// @brief flush the data which is only in memory
+  ~PublishCache();
+
+  void
+  insert(const Data& data);
+
+  /// @brief get the data named @p name, nullptr if there is none
+  shared_ptr<const Data>
+  find(const Name& name);
+
+  /// @brief write the data which is only in memory to the log
+  void
+  flush();
+
+  size_t
+  size() const
+  {
+    return m_index.size();
+  }
+
+  size_t
+  getMemorySize() const
+  {
+    return m_memorySize;
+  }
+
+  static std::string
+  getFileName(const Name& userChatPrefix);
+
+private:
+  enum LogFile {
+    LOG_CURRENT = 0,
+    LOG_OLD = 1,
+    LOG_NONE = 2,
+  };
+
+  struct Entry
+  {
+    shared_ptr<const Data> data;         // nullptr unless in memory
+    std::list<Name>::iterator lruPosition;
+    LogFile file;                        // LOG_NONE unless in the log
+    uint64_t offset;
+    size_t size;
+  };
+
+  typedef std::map<Name, Entry> Index;
+
+  void
+  openLog();
+
+  void
+  scanLog(LogFile file);
+
+  void
+  spill(Index::iterator entry);
+
+  void
+  rotateLog();
+
+  void
+  evict();
+
+private:
+  std::string m_paths[2];
+  std::fstream m_logs[2];
+  uint64_t m_currentSize;                // of the current log file
+  size_t m_maxMemorySize;
+  uint64_t m_maxDiskSize;
+
+  Index m_index;
+  std::list<Name> m_lru;                 // data in memory, most recently used first
+  size_t m_memorySize;
+};
+
+} // namespace chronochat
+
+#endif // CHRONOCHAT_PUBLISH_CACHE_HPP
@@ -0,0 +1,83 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#include "session-info.hpp"
+#include "tlv-codec.hpp"
+
+namespace chronochat {
+
+BOOST_CONCEPT_ASSERT((ndn::WireEncodable<SessionInfo>));
+BOOST_CONCEPT_ASSERT((ndn::WireDecodable<SessionInfo>));
+
+SessionInfo::SessionInfo()
+  : m_features(0)
+{
+}
+
+SessionInfo::SessionInfo(const Block& infoWire)
+  : m_features(0)
+{
+  this->wireDecode(infoWire);
+}
+
+// SessionInfo := SESSION-INFO-TYPE TLV-LENGTH
+//                  Nick
+//                  Features
+//
+// Nick := NICK-NAME-TYPE TLV-LENGTH
+//           String
+//
+// Features := FEATURES-TYPE TLV-LENGTH
+//               nonNegativeInteger (SessionInfo::Feature flags)
+//
+// Elements added by later versions are skipped, so are unknown feature flags.
+typedef codec::Fields<SessionInfo> SessionInfoFields;
+
+struct SessionInfo::Schema
+  : codec::Record<SessionInfo, tlv::SessionInfo,
+                  SessionInfoFields::Required<codec::Tlv<tlv::Nick, codec::String>,
+                                              &SessionInfo::m_nick>,
+                  SessionInfoFields::Required<codec::Tlv<tlv::Features,
+                                                         codec::NonNegativeInteger<uint64_t>>,
+                                              &SessionInfo::m_features>,
+                  codec::IgnoreRest>
+{
+};
+
+const Block&
+SessionInfo::wireEncode() const
+{
+  if (m_wire.hasWire())
+    return m_wire;
+
+  m_wire = Schema::encode(*this);
+  return m_wire;
+}
+
+void
+SessionInfo::wireDecode(const Block& infoWire)
+{
+  m_wire = infoWire;
+  Schema::decode(m_wire, *this);
+}
+
+void
+SessionInfo::setNick(const std::string& nick)
+{
+  m_wire.reset();
+  m_nick = nick;
+}
+
+void
+SessionInfo::setFeatures(uint64_t features)
+{
+  m_wire.reset();
+  m_features = features;
+}
+
+} // namespace chronochat
@@ -0,0 +1,106 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#ifndef CHRONOCHAT_SESSION_INFO_HPP
+#define CHRONOCHAT_SESSION_INFO_HPP
+
+#include "common.hpp"
+#include "tlv.hpp"
+#include <ndn-cxx/util/concepts.hpp>
+#include <ndn-cxx/encoding/block.hpp>
+
+namespace chronochat {
+
+/**
+ * @brief Description of a sync session, which the others fetch when they first see it
+ *
+ * The info is published as the data <session name>/info.  Older versions neither publish
+ * nor fetch it, so it announces the features of the session without reaching them.  A
+ * session whose info cannot be fetched is one of an older version, which has no features.
+ */
+class SessionInfo
+{
+
+public:
+
+  class Error : public std::runtime_error
+  {
+  public:
+    explicit
+    Error(const std::string& what)
+      : std::runtime_error(what)
+    {
+    }
+  };
+
+  /**
+   * @brief what the session understands in the chat data of the others
+   *
+   * A session with an info understands versioned content (see ChatContent), which is the
+   * only content that may use these features.
+   */
+  enum Feature {
+    FEATURE_COMPRESSION = 1 << 0,       ///< CompressedContent (see PayloadCompressor)
+    FEATURE_COMPACT = 1 << 1,           ///< messages without Nick and ChatroomName
+    FEATURE_PRECISE_TIMESTAMP = 1 << 2, ///< messages with a PreciseTimestamp
+    FEATURE_BUNDLE = 1 << 3,            ///< ChatMessageBundle
+    FEATURE_HELLO_INTERVAL = 1 << 4,    ///< JOIN and HELLO with a HelloInterval, which the
+                                        ///  session times the sender out by
+  };
+
+public:
+
+  SessionInfo();
+
+  explicit
+  SessionInfo(const Block& infoWire);
+
+  const Block&
+  wireEncode() const;
+
+  void
+  wireDecode(const Block& infoWire);
+
+  const std::string&
+  getNick() const;
+
+  /// @brief get the features, a combination of Feature flags
+  uint64_t
+  getFeatures() const;
+
+  void
+  setNick(const std::string& nick);
+
+  void
+  setFeatures(uint64_t features);
+
+private:
+  // TLV schema, see tlv-codec.hpp
+  struct Schema;
+
+private:
+  mutable Block m_wire;
+  std::string m_nick;
+  uint64_t m_features;
+};
+
+inline const std::string&
+SessionInfo::getNick() const
+{
+  return m_nick;
+}
+
+inline uint64_t
+SessionInfo::getFeatures() const
+{
+  return m_features;
+}
+
+} // namespace chronochat
+
+#endif // CHRONOCHAT_SESSION_INFO_HPP
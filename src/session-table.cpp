@@ -0,0 +1,56 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#include "session-table.hpp"
+
+namespace chronochat {
+
+SessionId
+SessionTable::intern(const Name& sessionPrefix)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  auto it = m_ids.find(sessionPrefix);
+  if (it != m_ids.end())
+    return it->second;
+
+  m_names.push_back(sessionPrefix);
+  SessionId id = m_names.size();
+  m_ids[sessionPrefix] = id;
+  return id;
+}
+
+SessionId
+SessionTable::find(const Name& sessionPrefix) const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  auto it = m_ids.find(sessionPrefix);
+  if (it == m_ids.end())
+    return 0;
+  return it->second;
+}
+
+Name
+SessionTable::getName(SessionId id) const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  if (id == 0 || id > m_names.size())
+    return Name();
+  return m_names[id - 1];
+}
+
+size_t
+SessionTable::size() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_names.size();
+}
+
+} // namespace chronochat
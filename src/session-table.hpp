@@ -0,0 +1,59 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#ifndef CHRONOCHAT_SESSION_TABLE_HPP
+#define CHRONOCHAT_SESSION_TABLE_HPP
+
+#include "common.hpp"
+
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace chronochat {
+
+// compact ID of a sync session within one chatroom, 0 is no session
+typedef uint32_t SessionId;
+
+/**
+ * @brief Interning table of the sync sessions of one chatroom
+ *
+ * A session gets the next ID when it is first seen, and keeps it as long as the table
+ * lives, so the signals of the backend and the structures of the GUI carry the ID instead
+ * of the session name.  The name is looked up only to be displayed or stored.  IDs are
+ * not reused, a late signal about a removed session does not refer to another one.
+ *
+ * The backend interns on its shard thread, the GUI looks up from the GUI thread.
+ */
+class SessionTable : noncopyable
+{
+public:
+  /// @brief get the ID of @p sessionPrefix, which is assigned at first sight
+  SessionId
+  intern(const Name& sessionPrefix);
+
+  /// @return the ID of @p sessionPrefix, 0 if it has not been seen
+  SessionId
+  find(const Name& sessionPrefix) const;
+
+  /// @return the name of session @p id, an empty name if unknown
+  Name
+  getName(SessionId id) const;
+
+  size_t
+  size() const;
+
+private:
+  mutable std::mutex m_mutex;
+  std::map<Name, SessionId> m_ids;
+  std::vector<Name> m_names;             // of the session IDs from 1
+};
+
+} // namespace chronochat
+
+#endif // CHRONOCHAT_SESSION_TABLE_HPP
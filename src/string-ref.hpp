@@ -0,0 +1,101 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#ifndef CHRONOCHAT_STRING_REF_HPP
+#define CHRONOCHAT_STRING_REF_HPP
+
+#include "common.hpp"
+
+#include <cstring>
+#include <ostream>
+
+namespace chronochat {
+
+/**
+ * @brief Non-owning view of a string, e.g., of a TLV value in a wire buffer
+ *
+ * The view is valid as long as the referenced characters are.
+ */
+class StringRef
+{
+public:
+  StringRef()
+    : m_data(nullptr)
+    , m_size(0)
+  {
+  }
+
+  StringRef(const char* data, size_t size)
+    : m_data(data)
+    , m_size(size)
+  {
+  }
+
+  StringRef(const char* str)
+    : m_data(str)
+    , m_size(std::strlen(str))
+  {
+  }
+
+  StringRef(const std::string& str)
+    : m_data(str.data())
+    , m_size(str.size())
+  {
+  }
+
+  const char*
+  data() const
+  {
+    return m_data;
+  }
+
+  size_t
+  size() const
+  {
+    return m_size;
+  }
+
+  bool
+  empty() const
+  {
+    return m_size == 0;
+  }
+
+  std::string
+  toString() const
+  {
+    return std::string(m_data, m_size);
+  }
+
+private:
+  const char* m_data;
+  size_t m_size;
+};
+
+inline bool
+operator==(const StringRef& lhs, const StringRef& rhs)
+{
+  return lhs.size() == rhs.size() &&
+         (lhs.size() == 0 || std::memcmp(lhs.data(), rhs.data(), lhs.size()) == 0);
+}
+
+inline bool
+operator!=(const StringRef& lhs, const StringRef& rhs)
+{
+  return !(lhs == rhs);
+}
+
+inline std::ostream&
+operator<<(std::ostream& os, const StringRef& str)
+{
+  return os.write(str.data(), str.size());
+}
+
+} // namespace chronochat
+
+#endif // CHRONOCHAT_STRING_REF_HPP
@@ -0,0 +1,183 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#include "sync-runtime.hpp"
+
+#include <future>
+#include "logging.h"
+
+INIT_LOGGER("SyncRuntime");
+
+namespace chronochat {
+
+// a handful of threads is enough for any number of rooms
+static const size_t MAX_DEFAULT_SHARDS = 4;
+
+SyncRuntime::SyncRuntime(size_t nShards,
+                         const FaceFactory& makeFace,
+                         const shared_ptr<CertificateStore>& certificateStore,
+                         bool isFaceShared)
+  : m_makeFace(makeFace)
+  , m_isFaceShared(isFaceShared)
+  , m_certificateStore(certificateStore)
+{
+  if (m_certificateStore == nullptr)
+    m_certificateStore = make_shared<CertificateStore>();
+
+  for (size_t i = 0; i < std::max<size_t>(nShards, 1); i++) {
+    unique_ptr<Shard> shard(new Shard);
+    shard->work.reset(new boost::asio::io_service::work(shard->ioService));
+    shard->nClients = 0;
+
+    Shard& shardRef = *shard;
+    shard->thread = boost::thread([this, &shardRef] { this->run(shardRef); });
+    shard->threadId = shard->thread.get_id();
+
+    m_shards.push_back(std::move(shard));
+  }
+}
+
+SyncRuntime::~SyncRuntime()
+{
+  // the connections are closed on their threads, where the faces are used
+  for (size_t i = 0; i < m_shards.size(); i++) {
+    Shard& shard = *m_shards[i];
+    invoke(i, [&shard] { shard.faceMultiplexer.reset(); });
+  }
+
+  for (auto& shard : m_shards) {
+    shard->work.reset();
+    shard->ioService.stop();
+  }
+
+  for (auto& shard : m_shards)
+    shard->thread.join();
+
+  m_validationPool.reset();
+}
+
+size_t
+SyncRuntime::attach(Client* client)
+{
+  size_t index = 0;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (size_t i = 1; i < m_shards.size(); i++) {
+      if (m_shards[i]->nClients < m_shards[index]->nClients)
+        index = i;
+    }
+    m_shards[index]->nClients++;
+  }
+
+  Shard& shard = *m_shards[index];
+  post(index, [&shard, client] { shard.clients.insert(client); });
+
+  return index;
+}
+
+void
+SyncRuntime::detach(size_t index, Client* client)
+{
+  Shard& shard = *m_shards[index];
+  invoke(index, [&shard, client] { shard.clients.erase(client); });
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  shard.nClients--;
+}
+
+boost::asio::io_service&
+SyncRuntime::getIoService(size_t shard)
+{
+  return m_shards[shard]->ioService;
+}
+
+shared_ptr<ndn::Face>
+SyncRuntime::makeFace(size_t index)
+{
+  Shard& shard = *m_shards[index];
+  if (!m_isFaceShared)
+    return m_makeFace(shard.ioService);
+
+  shared_ptr<ndn::Face> face;
+  invoke(index, [this, &shard, &face] {
+      if (shard.faceMultiplexer == nullptr)
+        shard.faceMultiplexer.reset(new FaceMultiplexer(shard.ioService, m_makeFace));
+      face = shard.faceMultiplexer->makeFace();
+    });
+  return face;
+}
+
+void
+SyncRuntime::post(size_t shard, const function<void()>& task)
+{
+  m_shards[shard]->ioService.post(task);
+}
+
+void
+SyncRuntime::invoke(size_t shard, const function<void()>& task)
+{
+  if (boost::this_thread::get_id() == m_shards[shard]->threadId) {
+    task();
+    return;
+  }
+
+  std::promise<void> isDone;
+  std::future<void> future = isDone.get_future();
+  post(shard, [&task, &isDone] {
+      // the error is the caller's, the shard and its other clients are not affected
+      try {
+        task();
+        isDone.set_value();
+      }
+      catch (...) {
+        isDone.set_exception(std::current_exception());
+      }
+    });
+  future.get();
+}
+
+ValidationPool&
+SyncRuntime::getValidationPool(const ValidationPool::ValidatorFactory& makeValidator)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (m_validationPool == nullptr)
+    m_validationPool.reset(new ValidationPool(makeValidator));
+  return *m_validationPool;
+}
+
+size_t
+SyncRuntime::getDefaultNShards()
+{
+  unsigned int nCores = boost::thread::hardware_concurrency();
+  return std::min<size_t>(std::max(nCores, 1u), MAX_DEFAULT_SHARDS);
+}
+
+void
+SyncRuntime::run(Shard& shard)
+{
+  while (true) {
+    try {
+      shard.ioService.run();
+      return;
+    }
+    catch (std::runtime_error& e) {
+      _LOG_DEBUG("Shard error: " << e.what());
+
+      // the connection is broken, the clients connect again when they use their faces
+      if (shard.faceMultiplexer != nullptr)
+        shard.faceMultiplexer->reset();
+
+      // a client may detach itself from the callback
+      std::vector<Client*> clients(shard.clients.begin(), shard.clients.end());
+      for (Client* client : clients)
+        client->onShardError(e);
+    }
+  }
+}
+
+} // namespace chronochat
@@ -0,0 +1,157 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#ifndef CHRONOCHAT_SYNC_RUNTIME_HPP
+#define CHRONOCHAT_SYNC_RUNTIME_HPP
+
+#include "common.hpp"
+#include "validation-pool.hpp"
+#include "certificate-store.hpp"
+#include "face-factory.hpp"
+#include "face-multiplexer.hpp"
+
+#include <mutex>
+#include <boost/thread.hpp>
+
+namespace chronochat {
+
+/**
+ * @brief Process-wide event loop of all chatrooms
+ *
+ * The runtime runs a fixed number of shards.  A shard is one io_service run by one thread.
+ * Every client (e.g., a chatroom) is attached to one shard, creates its Face, timers and
+ * sockets on the io_service of that shard, and must only touch them on that thread.
+ *
+ * The faces of the clients of a shard share one connection to the forwarder (see
+ * FaceMultiplexer), so the number of connections does not grow with the number of rooms.
+ * A client shuts its own Face down, which withdraws only the prefixes and pending
+ * Interests of that client.
+ *
+ * A Face reports a broken connection to the forwarder by throwing from the io_service.
+ * The shard then drops its connection, notifies all its clients and keeps running.  The
+ * faces connect again when they are used next.
+ */
+class SyncRuntime : noncopyable
+{
+public:
+  class Client
+  {
+  public:
+    virtual
+    ~Client()
+    {
+    }
+
+    /// @brief called on the shard thread when a handler of the shard threw @p e
+    virtual void
+    onShardError(const std::runtime_error& e) = 0;
+  };
+
+  /**
+   * @param nShards number of sync threads
+   * @param makeFace factory of the connections to the forwarder
+   * @param certificateStore certificate cache of the validators of the clients, which all
+   *                         follow the same rules, an in-memory one if nullptr
+   * @param isFaceShared false if every Face is made by @p makeFace and has a connection of
+   *                     its own, e.g., to simulate a host per client
+   */
+  explicit
+  SyncRuntime(size_t nShards = getDefaultNShards(),
+              const FaceFactory& makeFace = &makeNfdFace,
+              const shared_ptr<CertificateStore>& certificateStore = nullptr,
+              bool isFaceShared = true);
+
+  /// @brief stop all shards, all clients must have been detached
+  ~SyncRuntime();
+
+  /// @brief attach @p client to the least loaded shard and return the shard
+  size_t
+  attach(Client* client);
+
+  /**
+   * @brief detach @p client from @p shard
+   *
+   * When this returns, all tasks which were posted to the shard before have completed.
+   */
+  void
+  detach(size_t shard, Client* client);
+
+  boost::asio::io_service&
+  getIoService(size_t shard);
+
+  /**
+   * @brief make a Face on the io_service of @p shard
+   *
+   * The Face shares the connection of the shard, shutting it down withdraws only its own
+   * prefixes and pending Interests.
+   */
+  shared_ptr<ndn::Face>
+  makeFace(size_t shard);
+
+  void
+  post(size_t shard, const function<void()>& task);
+
+  /**
+   * @brief run @p task on @p shard and wait for it to complete
+   *
+   * @throw any exception of @p task, which is not reported to the clients of the shard
+   */
+  void
+  invoke(size_t shard, const function<void()>& task);
+
+  /**
+   * @brief get the validation pool shared by all clients
+   *
+   * The pool is created by the first call, using @p makeValidator.
+   */
+  ValidationPool&
+  getValidationPool(const ValidationPool::ValidatorFactory& makeValidator);
+
+  /// @brief get the certificate cache shared by the validators of the clients
+  const shared_ptr<CertificateStore>&
+  getCertificateStore() const
+  {
+    return m_certificateStore;
+  }
+
+  size_t
+  getNShards() const
+  {
+    return m_shards.size();
+  }
+
+  static size_t
+  getDefaultNShards();
+
+private:
+  struct Shard
+  {
+    boost::asio::io_service ioService;
+    unique_ptr<boost::asio::io_service::work> work;
+    boost::thread thread;
+    boost::thread::id threadId;
+    std::set<Client*> clients;           // only accessed on the shard thread
+    unique_ptr<FaceMultiplexer> faceMultiplexer; // likewise, nullptr until a Face is made
+    size_t nClients;                     // guarded by m_mutex
+  };
+
+  void
+  run(Shard& shard);
+
+private:
+  FaceFactory m_makeFace;
+  bool m_isFaceShared;
+  shared_ptr<CertificateStore> m_certificateStore;
+  std::vector<unique_ptr<Shard>> m_shards;
+  unique_ptr<ValidationPool> m_validationPool;
+  std::mutex m_mutex;
+};
+
+} // namespace chronochat
+
+#endif // CHRONOCHAT_SYNC_RUNTIME_HPP
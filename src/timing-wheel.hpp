@@ -0,0 +1,268 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#ifndef CHRONOCHAT_TIMING_WHEEL_HPP
+#define CHRONOCHAT_TIMING_WHEEL_HPP
+
+#include "common.hpp"
+
+#include <ndn-cxx/util/scheduler.hpp>
+
+namespace chronochat {
+
+/**
+ * @brief Hierarchical timing wheel for coarse timeouts of many records
+ *
+ * Records derive from TimingWheel<T>::Entry, which links them into the slots of the wheel,
+ * so (re)scheduling a record is O(1) and allocates nothing.  Time advances in ticks; all
+ * records which expire in the ticks processed at once are handed to the callback in one
+ * batch, already unscheduled.  A timeout may fire up to one tick late.
+ *
+ * The wheel has four levels of 64 slots, so timeouts up to 64^4 ticks are exact; longer
+ * ones are cut to that.  Ticks are driven by the scheduler only while records are
+ * scheduled.  The wheel must be destroyed before the scheduler.
+ */
+template<class T>
+class TimingWheel : noncopyable
+{
+public:
+  class Entry
+  {
+  public:
+    Entry()
+      : m_wheel(nullptr)
+      , m_prev(nullptr)
+      , m_next(nullptr)
+      , m_deadline(0)
+    {
+    }
+
+    // a copy is not scheduled
+    Entry(const Entry& other)
+      : Entry()
+    {
+    }
+
+    Entry&
+    operator=(const Entry& other)
+    {
+      return *this;
+    }
+
+    ~Entry()
+    {
+      if (m_wheel != nullptr)
+        m_wheel->unlink(*this);
+    }
+
+    bool
+    isScheduled() const
+    {
+      return m_wheel != nullptr;
+    }
+
+  private:
+    TimingWheel* m_wheel;
+    Entry* m_prev;
+    Entry* m_next;
+    uint64_t m_deadline;                 // tick on which the entry expires
+
+    friend class TimingWheel;
+  };
+
+  /// @brief the callback may (re)schedule and destroy the records of the batch
+  typedef function<void(const std::vector<T*>& expired)> ExpireCallback;
+
+  TimingWheel(ndn::Scheduler& scheduler, const time::nanoseconds& tick,
+              const ExpireCallback& onExpire)
+    : m_scheduler(scheduler)
+    , m_tick(tick)
+    , m_origin(time::steady_clock::now())
+    , m_onExpire(onExpire)
+    , m_nextTick(0)
+    , m_size(0)
+    , m_isTickScheduled(false)
+  {
+    for (auto& level : m_slots) {
+      for (Entry& head : level)
+        head.m_prev = head.m_next = &head;
+    }
+  }
+
+  ~TimingWheel()
+  {
+    clear();
+  }
+
+  /// @brief (re)schedule @p record to expire after @p timeout
+  void
+  schedule(T& record, const time::nanoseconds& timeout)
+  {
+    Entry& entry = record;
+    if (entry.m_wheel != nullptr)
+      unlink(entry);
+
+    if (m_size == 0)
+      m_nextTick = getClockTick();       // nothing is in the slots, so the wheel can jump
+
+    // the first tick at or after the timeout
+    time::nanoseconds due = time::steady_clock::now() - m_origin + timeout;
+    uint64_t deadline = (std::max<int64_t>(due.count(), 0) + m_tick.count() - 1) / m_tick.count();
+    entry.m_deadline = std::max(deadline, m_nextTick);
+    link(entry);
+
+    if (!m_isTickScheduled)
+      scheduleTick();
+  }
+
+  void
+  cancel(T& record)
+  {
+    Entry& entry = record;
+    if (entry.m_wheel != nullptr)
+      unlink(entry);
+  }
+
+  /// @brief unschedule all records
+  void
+  clear()
+  {
+    for (auto& level : m_slots) {
+      for (Entry& head : level) {
+        while (head.m_next != &head)
+          unlink(*head.m_next);
+      }
+    }
+
+    if (m_isTickScheduled) {
+      m_scheduler.cancelEvent(m_tickEventId);
+      m_isTickScheduled = false;
+    }
+  }
+
+  size_t
+  size() const
+  {
+    return m_size;
+  }
+
+private:
+  static const int SLOT_BITS = 6;
+  static const size_t N_SLOTS = 1 << SLOT_BITS;
+  static const size_t N_LEVELS = 4;
+
+  uint64_t
+  getClockTick() const
+  {
+    return (time::steady_clock::now() - m_origin) / m_tick;
+  }
+
+  void
+  link(Entry& entry)
+  {
+    uint64_t delta = entry.m_deadline - m_nextTick;
+
+    size_t level = 0;
+    while (level + 1 < N_LEVELS && delta >= (uint64_t(1) << (SLOT_BITS * (level + 1))))
+      level++;
+
+    if (level + 1 == N_LEVELS && delta >= (uint64_t(1) << (SLOT_BITS * N_LEVELS)))
+      entry.m_deadline = m_nextTick + (uint64_t(1) << (SLOT_BITS * N_LEVELS)) - 1;
+
+    Entry& head = m_slots[level][(entry.m_deadline >> (SLOT_BITS * level)) & (N_SLOTS - 1)];
+    entry.m_prev = &head;
+    entry.m_next = head.m_next;
+    head.m_next->m_prev = &entry;
+    head.m_next = &entry;
+    entry.m_wheel = this;
+    m_size++;
+  }
+
+  void
+  unlink(Entry& entry)
+  {
+    entry.m_prev->m_next = entry.m_next;
+    entry.m_next->m_prev = entry.m_prev;
+    entry.m_prev = entry.m_next = nullptr;
+    entry.m_wheel = nullptr;
+    m_size--;
+  }
+
+  /// @brief move the records of a slot to lower levels, as they are due soon
+  void
+  cascade(size_t level, size_t slot)
+  {
+    Entry& head = m_slots[level][slot];
+    while (head.m_next != &head) {
+      Entry& entry = *head.m_next;
+      unlink(entry);
+      link(entry);
+    }
+  }
+
+  void
+  scheduleTick()
+  {
+    time::steady_clock::TimePoint next = m_origin + m_tick * static_cast<int64_t>(m_nextTick);
+    time::steady_clock::TimePoint now = time::steady_clock::now();
+
+    m_tickEventId = m_scheduler.scheduleEvent(next > now ? next - now : time::nanoseconds(0),
+                                              [this] { this->onTick(); });
+    m_isTickScheduled = true;
+  }
+
+  void
+  onTick()
+  {
+    m_isTickScheduled = false;
+
+    uint64_t now = getClockTick();
+    m_expired.clear();
+    while (m_nextTick <= now && m_size > 0) {
+      size_t slot = m_nextTick & (N_SLOTS - 1);
+      for (size_t level = 1; slot == 0 && level < N_LEVELS; level++) {
+        slot = (m_nextTick >> (SLOT_BITS * level)) & (N_SLOTS - 1);
+        cascade(level, slot);
+      }
+
+      Entry& head = m_slots[0][m_nextTick & (N_SLOTS - 1)];
+      while (head.m_next != &head) {
+        Entry& entry = *head.m_next;
+        unlink(entry);
+        m_expired.push_back(static_cast<T*>(&entry));
+      }
+
+      m_nextTick++;
+    }
+
+    if (m_size > 0)
+      scheduleTick();
+
+    // the buffer keeps its capacity, so expiring allocates nothing in the long run
+    if (!m_expired.empty())
+      m_onExpire(m_expired);
+  }
+
+private:
+  ndn::Scheduler& m_scheduler;
+  time::nanoseconds m_tick;
+  time::steady_clock::TimePoint m_origin;
+  ExpireCallback m_onExpire;
+
+  Entry m_slots[N_LEVELS][N_SLOTS];      // heads of the circular lists of the slots
+  uint64_t m_nextTick;                   // next tick to process
+  size_t m_size;
+  std::vector<T*> m_expired;
+
+  bool m_isTickScheduled;
+  ndn::EventId m_tickEventId;
+};
+
+} // namespace chronochat
+
+#endif // CHRONOCHAT_TIMING_WHEEL_HPP
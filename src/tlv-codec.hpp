@@ -0,0 +1,717 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#ifndef CHRONOCHAT_TLV_CODEC_HPP
+#define CHRONOCHAT_TLV_CODEC_HPP
+
+#include "common.hpp"
+#include "string-ref.hpp"
+
+#include <ndn-cxx/encoding/block.hpp>
+#include <ndn-cxx/encoding/block-helpers.hpp>
+
+#include <cstring>
+
+/**
+ * Declarative TLV codec of the ChronoChat wire types
+ *
+ * A type is declared once as a Record: its TLV number and the list of its elements, each
+ * bound to a TLV number, a value encoding and a member.  E.g.,
+ *
+ *   typedef codec::Fields<Conf> F;
+ *   typedef codec::Record<Conf, tlv::Conf,
+ *                         F::Required<codec::Self<ndn::tlv::Name, Name>, &Conf::m_identity>,
+ *                         F::Optional<codec::Tlv<tlv::Nick, codec::String>, &Conf::m_nick>
+ *                         > Schema;
+ *
+ * Encoding computes the size of the record in one pass, the sizes of the TLV numbers are
+ * compile-time constants, and then writes the record front to back into a buffer of exactly
+ * that size.  The result is not parsed again.  Decoding is a single linear scan over the
+ * elements, which throws R::Error on unexpected input.
+ */
+
+namespace chronochat {
+namespace codec {
+
+class Error : public std::runtime_error
+{
+public:
+  explicit
+  Error(const std::string& what)
+    : std::runtime_error(what)
+  {
+  }
+};
+
+constexpr size_t
+sizeOfVarNumber(uint64_t number)
+{
+  return number < 253 ? 1 : number <= 0xFFFF ? 3 : number <= 0xFFFFFFFF ? 5 : 9;
+}
+
+constexpr size_t
+sizeOfNonNegativeInteger(uint64_t number)
+{
+  return number <= 0xFF ? 1 : number <= 0xFFFF ? 2 : number <= 0xFFFFFFFF ? 4 : 8;
+}
+
+inline uint8_t*
+writeBigEndian(uint8_t* pos, uint64_t number, size_t nBytes)
+{
+  for (size_t i = nBytes; i > 0; i--) {
+    pos[i - 1] = static_cast<uint8_t>(number);
+    number >>= 8;
+  }
+  return pos + nBytes;
+}
+
+inline uint8_t*
+writeVarNumber(uint8_t* pos, uint64_t number)
+{
+  switch (sizeOfVarNumber(number)) {
+  case 1:
+    *pos = static_cast<uint8_t>(number);
+    return pos + 1;
+  case 3:
+    *pos = 253;
+    return writeBigEndian(pos + 1, number, 2);
+  case 5:
+    *pos = 254;
+    return writeBigEndian(pos + 1, number, 4);
+  default:
+    *pos = 255;
+    return writeBigEndian(pos + 1, number, 8);
+  }
+}
+
+inline uint8_t*
+writeBytes(uint8_t* pos, const void* bytes, size_t nBytes)
+{
+  if (nBytes > 0)
+    std::memcpy(pos, bytes, nBytes);
+  return pos + nBytes;
+}
+
+inline std::string
+toTypeString(uint32_t type)
+{
+  return std::to_string(type);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Value encodings: how a value is written as the TLV-VALUE of an element
+//
+//   typedef ... Value;
+//   static size_t size(const Value&);                       // length of the TLV-VALUE
+//   static uint8_t* write(uint8_t* pos, const Value&);
+//   static void read(const Block& element, Value&);          // from the element's value
+
+struct String
+{
+  typedef std::string Value;
+
+  static size_t
+  size(const Value& value)
+  {
+    return value.size();
+  }
+
+  static uint8_t*
+  write(uint8_t* pos, const Value& value)
+  {
+    return writeBytes(pos, value.data(), value.size());
+  }
+
+  static void
+  read(const Block& element, Value& value)
+  {
+    value.assign(reinterpret_cast<const char*>(element.value()), element.value_size());
+  }
+};
+
+/// @brief string which refers to the decoded wire, so it is valid as long as the wire
+struct StringView
+{
+  typedef StringRef Value;
+
+  static size_t
+  size(const Value& value)
+  {
+    return value.size();
+  }
+
+  static uint8_t*
+  write(uint8_t* pos, const Value& value)
+  {
+    return writeBytes(pos, value.data(), value.size());
+  }
+
+  static void
+  read(const Block& element, Value& value)
+  {
+    value = StringRef(reinterpret_cast<const char*>(element.value()), element.value_size());
+  }
+};
+
+/// @brief integral or enumeration type as nonNegativeInteger
+template<class T>
+struct NonNegativeInteger
+{
+  typedef T Value;
+
+  static size_t
+  size(const Value& value)
+  {
+    return sizeOfNonNegativeInteger(static_cast<uint64_t>(value));
+  }
+
+  static uint8_t*
+  write(uint8_t* pos, const Value& value)
+  {
+    uint64_t number = static_cast<uint64_t>(value);
+    return writeBigEndian(pos, number, sizeOfNonNegativeInteger(number));
+  }
+
+  static void
+  read(const Block& element, Value& value)
+  {
+    value = static_cast<T>(ndn::readNonNegativeInteger(element));
+  }
+};
+
+/// @brief time point as nonNegativeInteger milliseconds since the epoch
+struct UnixTimestamp
+{
+  typedef time::system_clock::TimePoint Value;
+
+  static size_t
+  size(const Value& value)
+  {
+    return sizeOfNonNegativeInteger(time::toUnixTimestamp(value).count());
+  }
+
+  static uint8_t*
+  write(uint8_t* pos, const Value& value)
+  {
+    uint64_t number = time::toUnixTimestamp(value).count();
+    return writeBigEndian(pos, number, sizeOfNonNegativeInteger(number));
+  }
+
+  static void
+  read(const Block& element, Value& value)
+  {
+    value = time::fromUnixTimestamp(time::milliseconds(ndn::readNonNegativeInteger(element)));
+  }
+};
+
+/// @brief type with its own TLV encoding, e.g., Name or Name::Component, as a nested TLV
+template<class T>
+struct Wire
+{
+  typedef T Value;
+
+  static size_t
+  size(const Value& value)
+  {
+    return value.wireEncode().size();
+  }
+
+  static uint8_t*
+  write(uint8_t* pos, const Value& value)
+  {
+    const Block& wire = value.wireEncode();
+    return writeBytes(pos, wire.wire(), wire.size());
+  }
+
+  static void
+  read(const Block& element, Value& value)
+  {
+    value.wireDecode(element.blockFromValue());
+  }
+};
+
+/// @brief container of one or more items, which are elements of the kind Item
+template<class Item, class Container>
+struct Sequence
+{
+  typedef Container Value;
+
+  static size_t
+  size(const Value& value)
+  {
+    size_t length = 0;
+    for (const auto& item : value)
+      length += Item::size(item);
+    return length;
+  }
+
+  static uint8_t*
+  write(uint8_t* pos, const Value& value)
+  {
+    for (const auto& item : value)
+      pos = Item::write(pos, item);
+    return pos;
+  }
+
+  static void
+  read(const Block& element, Value& value)
+  {
+    element.parse();
+    value.clear();
+    for (const Block& itemElement : element.elements()) {
+      if (itemElement.type() != Item::TYPE)
+        throw Error("Expect TLV type " + toTypeString(Item::TYPE) +
+                    " but get TLV type " + toTypeString(itemElement.type()));
+      typename Item::Value item;
+      Item::read(itemElement, item);
+      value.insert(value.end(), item);
+    }
+    if (value.empty())
+      throw Error("Missing TLV type " + toTypeString(Item::TYPE));
+  }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Element kinds: how a value is written as a whole element
+//
+//   static const uint32_t TYPE;
+//   typedef ... Value;
+//   static size_t size(const Value&);                       // size of the element
+//   static uint8_t* write(uint8_t* pos, const Value&);
+//   static void read(const Block& element, Value&);          // element.type() == TYPE
+
+/// @brief element of type TYPE, whose value is encoded by Encoding
+template<uint32_t T, class Encoding>
+struct Tlv
+{
+  static const uint32_t TYPE = T;
+  typedef typename Encoding::Value Value;
+
+  static size_t
+  size(const Value& value)
+  {
+    size_t length = Encoding::size(value);
+    return sizeOfVarNumber(TYPE) + sizeOfVarNumber(length) + length;
+  }
+
+  static uint8_t*
+  write(uint8_t* pos, const Value& value)
+  {
+    pos = writeVarNumber(pos, TYPE);
+    pos = writeVarNumber(pos, Encoding::size(value));
+    return Encoding::write(pos, value);
+  }
+
+  static void
+  read(const Block& element, Value& value)
+  {
+    Encoding::read(element, value);
+  }
+};
+
+/// @brief type with its own TLV encoding of type TYPE as the element itself
+template<uint32_t T, class V>
+struct Self
+{
+  static const uint32_t TYPE = T;
+  typedef V Value;
+
+  static size_t
+  size(const Value& value)
+  {
+    return value.wireEncode().size();
+  }
+
+  static uint8_t*
+  write(uint8_t* pos, const Value& value)
+  {
+    const Block& wire = value.wireEncode();
+    return writeBytes(pos, wire.wire(), wire.size());
+  }
+
+  static void
+  read(const Block& element, Value& value)
+  {
+    value.wireDecode(element);
+  }
+};
+
+/// @brief std::pair, e.g., of a map, as an element of type TYPE with two elements
+template<uint32_t T, class First, class Second>
+struct Pair
+{
+  static const uint32_t TYPE = T;
+  // decoded pairs are converted on insertion into a map
+  typedef std::pair<typename First::Value, typename Second::Value> Value;
+
+  template<class P>
+  static size_t
+  size(const P& value)
+  {
+    size_t length = First::size(value.first) + Second::size(value.second);
+    return sizeOfVarNumber(TYPE) + sizeOfVarNumber(length) + length;
+  }
+
+  template<class P>
+  static uint8_t*
+  write(uint8_t* pos, const P& value)
+  {
+    pos = writeVarNumber(pos, TYPE);
+    pos = writeVarNumber(pos, First::size(value.first) + Second::size(value.second));
+    pos = First::write(pos, value.first);
+    return Second::write(pos, value.second);
+  }
+
+  static void
+  read(const Block& element, Value& value)
+  {
+    element.parse();
+    Block::element_const_iterator i = element.elements_begin();
+    Block::element_const_iterator end = element.elements_end();
+
+    readNext<First>(i, end, value.first);
+    readNext<Second>(i, end, value.second);
+    if (i != end)
+      throw Error("Unexpected element");
+  }
+
+private:
+  template<class Kind>
+  static void
+  readNext(Block::element_const_iterator& i, const Block::element_const_iterator& end,
+           typename Kind::Value& value)
+  {
+    if (i == end)
+      throw Error("Missing TLV type " + toTypeString(Kind::TYPE));
+    if (i->type() != Kind::TYPE)
+      throw Error("Expect TLV type " + toTypeString(Kind::TYPE) +
+                  " but get TLV type " + toTypeString(i->type()));
+    Kind::read(*i, value);
+    ++i;
+  }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Record elements, bound to the members of the record R
+//
+//   static size_t size(const R&);
+//   static uint8_t* write(uint8_t* pos, const R&);
+//   static void read(Block::element_const_iterator& i, end, R&); // consumes its elements
+
+typedef Block::element_const_iterator ElementIterator;
+
+inline bool
+isNext(const ElementIterator& i, const ElementIterator& end, uint32_t type)
+{
+  return i != end && i->type() == type;
+}
+
+inline void
+expectNext(const ElementIterator& i, const ElementIterator& end, uint32_t type)
+{
+  if (i == end)
+    throw Error("Missing TLV type " + toTypeString(type));
+  if (i->type() != type)
+    throw Error("Expect TLV type " + toTypeString(type) +
+                " but get TLV type " + toTypeString(i->type()));
+}
+
+template<class R>
+struct Fields
+{
+  /// @brief element which must be present
+  template<class Kind, typename Kind::Value R::*MEMBER>
+  struct Required
+  {
+    static size_t
+    size(const R& record)
+    {
+      return Kind::size(record.*MEMBER);
+    }
+
+    static uint8_t*
+    write(uint8_t* pos, const R& record)
+    {
+      return Kind::write(pos, record.*MEMBER);
+    }
+
+    static void
+    read(ElementIterator& i, const ElementIterator& end, R& record)
+    {
+      expectNext(i, end, Kind::TYPE);
+      Kind::read(*i, record.*MEMBER);
+      ++i;
+    }
+  };
+
+  /// @brief element which is always written, but older versions may not have
+  template<class Kind, typename Kind::Value R::*MEMBER>
+  struct Optional
+  {
+    static size_t
+    size(const R& record)
+    {
+      return Kind::size(record.*MEMBER);
+    }
+
+    static uint8_t*
+    write(uint8_t* pos, const R& record)
+    {
+      return Kind::write(pos, record.*MEMBER);
+    }
+
+    static void
+    read(ElementIterator& i, const ElementIterator& end, R& record)
+    {
+      if (isNext(i, end, Kind::TYPE)) {
+        Kind::read(*i, record.*MEMBER);
+        ++i;
+      }
+    }
+  };
+
+  /// @brief element which is present if and only if the member FLAG is true
+  template<class Kind, typename Kind::Value R::*MEMBER, bool R::*FLAG>
+  struct Flagged
+  {
+    static size_t
+    size(const R& record)
+    {
+      return record.*FLAG ? Kind::size(record.*MEMBER) : 0;
+    }
+
+    static uint8_t*
+    write(uint8_t* pos, const R& record)
+    {
+      return record.*FLAG ? Kind::write(pos, record.*MEMBER) : pos;
+    }
+
+    static void
+    read(ElementIterator& i, const ElementIterator& end, R& record)
+    {
+      record.*FLAG = isNext(i, end, Kind::TYPE);
+      if (record.*FLAG) {
+        Kind::read(*i, record.*MEMBER);
+        ++i;
+      }
+    }
+  };
+
+  /// @brief element which is present if and only if IS_PRESENT holds for the elements before
+  template<class Kind, typename Kind::Value R::*MEMBER, bool (*IS_PRESENT)(const R&)>
+  struct Conditional
+  {
+    static size_t
+    size(const R& record)
+    {
+      return IS_PRESENT(record) ? Kind::size(record.*MEMBER) : 0;
+    }
+
+    static uint8_t*
+    write(uint8_t* pos, const R& record)
+    {
+      return IS_PRESENT(record) ? Kind::write(pos, record.*MEMBER) : pos;
+    }
+
+    static void
+    read(ElementIterator& i, const ElementIterator& end, R& record)
+    {
+      if (!IS_PRESENT(record)) {
+        record.*MEMBER = typename Kind::Value();
+        return;
+      }
+      Required<Kind, MEMBER>::read(i, end, record);
+    }
+  };
+
+  /// @brief items of a container as one or more consecutive elements
+  template<class Kind, class Container, Container R::*MEMBER>
+  struct Repeated
+  {
+    static size_t
+    size(const R& record)
+    {
+      size_t length = 0;
+      for (const auto& item : record.*MEMBER)
+        length += Kind::size(item);
+      return length;
+    }
+
+    static uint8_t*
+    write(uint8_t* pos, const R& record)
+    {
+      for (const auto& item : record.*MEMBER)
+        pos = Kind::write(pos, item);
+      return pos;
+    }
+
+    static void
+    read(ElementIterator& i, const ElementIterator& end, R& record)
+    {
+      Container& container = record.*MEMBER;
+      container.clear();
+
+      expectNext(i, end, Kind::TYPE);
+      while (isNext(i, end, Kind::TYPE)) {
+        typename Kind::Value item;
+        Kind::read(*i, item);
+        container.insert(container.end(), item);
+        ++i;
+      }
+    }
+  };
+};
+
+/// @brief skip the elements added by later versions
+struct IgnoreRest
+{
+  template<class R>
+  static size_t
+  size(const R& record)
+  {
+    return 0;
+  }
+
+  template<class R>
+  static uint8_t*
+  write(uint8_t* pos, const R& record)
+  {
+    return pos;
+  }
+
+  template<class R>
+  static void
+  read(ElementIterator& i, const ElementIterator& end, R& record)
+  {
+    i = end;
+  }
+};
+
+template<class... Elements>
+struct ElementList;
+
+template<>
+struct ElementList<>
+{
+  template<class R>
+  static size_t
+  size(const R& record)
+  {
+    return 0;
+  }
+
+  template<class R>
+  static uint8_t*
+  write(uint8_t* pos, const R& record)
+  {
+    return pos;
+  }
+
+  template<class R>
+  static void
+  read(ElementIterator& i, const ElementIterator& end, R& record)
+  {
+  }
+};
+
+template<class Element, class... Rest>
+struct ElementList<Element, Rest...>
+{
+  template<class R>
+  static size_t
+  size(const R& record)
+  {
+    return Element::size(record) + ElementList<Rest...>::size(record);
+  }
+
+  template<class R>
+  static uint8_t*
+  write(uint8_t* pos, const R& record)
+  {
+    return ElementList<Rest...>::write(Element::write(pos, record), record);
+  }
+
+  template<class R>
+  static void
+  read(ElementIterator& i, const ElementIterator& end, R& record)
+  {
+    Element::read(i, end, record);
+    ElementList<Rest...>::read(i, end, record);
+  }
+};
+
+/// @brief record R as an element of type TYPE, which is also an element kind
+template<class R, uint32_t T, class... Elements>
+struct Record
+{
+  static const uint32_t TYPE = T;
+  typedef R Value;
+
+  static size_t
+  size(const R& record)
+  {
+    size_t length = ElementList<Elements...>::size(record);
+    return sizeOfVarNumber(TYPE) + sizeOfVarNumber(length) + length;
+  }
+
+  static uint8_t*
+  write(uint8_t* pos, const R& record)
+  {
+    pos = writeVarNumber(pos, TYPE);
+    pos = writeVarNumber(pos, ElementList<Elements...>::size(record));
+    return ElementList<Elements...>::write(pos, record);
+  }
+
+  static void
+  read(const Block& element, R& record)
+  {
+    element.parse();
+    ElementIterator i = element.elements_begin();
+    ElementIterator end = element.elements_end();
+
+    ElementList<Elements...>::read(i, end, record);
+    if (i != end)
+      throw Error("Unexpected element");
+  }
+
+  /// @brief encode @p record into a block of its own
+  static Block
+  encode(const R& record)
+  {
+    size_t length = ElementList<Elements...>::size(record);
+    size_t totalLength = sizeOfVarNumber(TYPE) + sizeOfVarNumber(length) + length;
+
+    auto buffer = make_shared<ndn::Buffer>(totalLength);
+    uint8_t* pos = writeVarNumber(&buffer->front(), TYPE);
+    pos = writeVarNumber(pos, length);
+    pos = ElementList<Elements...>::write(pos, record);
+    BOOST_ASSERT(pos == &buffer->front() + totalLength);
+
+    return Block(buffer);
+  }
+
+  /// @brief decode @p wire into @p record, throws R::Error
+  static void
+  decode(const Block& wire, R& record)
+  {
+    if (wire.type() != TYPE)
+      throw typename R::Error("Unexpected TLV type " + toTypeString(wire.type()) +
+                              " when decoding TLV type " + toTypeString(TYPE));
+    try {
+      read(wire, record);
+    }
+    catch (const Error& e) {
+      throw typename R::Error(e.what());
+    }
+  }
+};
+
+} // namespace codec
+} // namespace chronochat
+
+#endif // CHRONOCHAT_TLV_CODEC_HPP
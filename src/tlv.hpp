@@ -31,6 +31,19 @@ enum {
   ChatMessageType = 150,
   ChatData = 151,
   Timestamp = 152,
+  PreciseTimestamp = 153,
+  ChatMessageBundle = 154,
+  Features = 155,
+  CompressedContent = 156,
+  UncompressedSize = 157,
+  CompressedData = 158,
+  FileManifest = 159,
+  FileName = 160,
+  FileSize = 161,
+  SegmentSize = 162,
+  SessionInfo = 163,
+  ContentVersion = 164,
+  HelloInterval = 165,
 };
 
 } // namespace tlv
@@ -0,0 +1,347 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#include "transcript-model.hpp"
+
+#include <QAbstractItemView>
+#include <QPainter>
+
+#ifndef Q_MOC_RUN
+#include <limits>
+#endif
+
+namespace chronochat {
+
+const size_t TranscriptModel::DEFAULT_MAX_ROWS = 1000;
+const size_t TranscriptModel::DEFAULT_PAGE_SIZE = 50;
+
+static const int MARGIN = 4;
+
+TranscriptModel::TranscriptModel(ChatHistoryStorage* history, const SessionTable* sessions,
+                                 size_t maxRows, size_t pageSize, QObject* parent)
+  : QAbstractListModel(parent)
+  , m_history(history)
+  , m_sessions(sessions)
+  , m_maxRows(std::max(maxRows, pageSize))
+  , m_pageSize(pageSize)
+  , m_hasOlderRows(history != nullptr)
+  , m_isDetached(false)
+{
+}
+
+int
+TranscriptModel::rowCount(const QModelIndex& parent) const
+{
+  if (parent.isValid())
+    return 0;
+  return m_rows.size();
+}
+
+QVariant
+TranscriptModel::data(const QModelIndex& index, int role) const
+{
+  if (!index.isValid() || index.row() >= static_cast<int>(m_rows.size()))
+    return QVariant();
+
+  const TranscriptRow& row = m_rows[index.row()];
+  switch (role) {
+  case Qt::DisplayRole:
+    return row.text;
+  case NickRole:
+    return row.nick;
+  case TimeRole:
+    return static_cast<qlonglong>(row.timestamp);
+  case TypeRole:
+    return static_cast<int>(row.type);
+  default:
+    return QVariant();
+  }
+}
+
+void
+TranscriptModel::appendRows(const std::vector<TranscriptRow>& rows)
+{
+  if (rows.empty())
+    return;
+
+  if (m_isDetached) {
+    // the rows without a session will not be in the history
+    for (const auto& row : rows) {
+      if (row.sessionId != 0)
+        m_tail.push_back(row);
+    }
+    while (m_tail.size() > m_pageSize)
+      m_tail.pop_front();
+    return;
+  }
+
+  addRows(m_rows.size(), rows);
+  trimFront();
+}
+
+size_t
+TranscriptModel::fetchOlder()
+{
+  if (!m_hasOlderRows)
+    return 0;
+
+  // a live row has no position in the history yet, the page then overlaps the rows
+  ChatHistoryEntry last;
+  if (!m_rows.empty()) {
+    last.timestamp = m_rows.front().timestamp;
+    last.id = m_rows.front().historyId != 0 ? m_rows.front().historyId :
+                                              std::numeric_limits<int64_t>::max();
+  }
+
+  std::vector<ChatHistoryEntry> entries;
+  m_history->getMessagesBefore(m_rows.empty() ? nullptr : &last, m_pageSize, entries);
+  if (entries.size() < m_pageSize)
+    m_hasOlderRows = false;
+
+  std::vector<TranscriptRow> rows;
+  for (const auto& entry : entries) {
+    TranscriptRow row;
+    if (makeRow(entry, row) && !hasRow(row))
+      rows.push_back(row);
+  }
+  addRows(0, rows);
+
+  // the newest rows are read back from the history when the view scrolls down
+  if (m_rows.size() > m_maxRows) {
+    eraseRows(m_maxRows, m_rows.size() - m_maxRows);
+    m_isDetached = true;
+  }
+
+  return rows.size();
+}
+
+size_t
+TranscriptModel::fetchNewer(size_t& nRemoved)
+{
+  nRemoved = 0;
+  if (!m_isDetached)
+    return 0;
+
+  ChatHistoryEntry first;
+  if (!m_rows.empty()) {
+    first.timestamp = m_rows.back().timestamp;
+    first.id = m_rows.back().historyId;
+  }
+
+  std::vector<ChatHistoryEntry> entries;
+  m_history->getMessagesAfter(first, m_pageSize, entries);
+
+  std::vector<TranscriptRow> rows;
+  for (const auto& entry : entries) {
+    TranscriptRow row;
+    if (makeRow(entry, row) && !hasRow(row))
+      rows.push_back(row);
+  }
+
+  // at the end of the history, the live rows which have not been written yet follow
+  if (entries.size() < m_pageSize) {
+    std::vector<std::pair<Name, uint64_t>> tailMessages;
+    for (const auto& row : m_tail)
+      tailMessages.push_back(std::make_pair(m_sessions->getName(row.sessionId), row.seqNo));
+
+    std::vector<bool> isInHistory = m_history->hasMessages(tailMessages);
+    for (size_t i = 0; i < m_tail.size(); i++) {
+      if (!isInHistory[i])
+        rows.push_back(m_tail[i]);
+    }
+    m_tail.clear();
+    m_isDetached = false;
+  }
+
+  addRows(m_rows.size(), rows);
+  nRemoved = trimFront();
+
+  return rows.size();
+}
+
+bool
+TranscriptModel::makeRow(const ChatHistoryEntry& entry, TranscriptRow& row) const
+{
+  row.nick = QString::fromStdString(entry.nick);
+  row.timestamp = entry.timestamp;
+  row.historyId = entry.id;
+  // sessions which have not been seen since the start have no live rows to match
+  row.sessionId = m_sessions != nullptr ? m_sessions->find(entry.sessionPrefix) : 0;
+  row.seqNo = entry.seqNo;
+
+  switch (entry.msgType) {
+  case ChatMessage::CHAT:
+    row.type = TranscriptRow::CHAT;
+    if (!entry.isValidated)
+      row.nick += " (Unverified)";
+    row.text = QString::fromStdString(entry.data);
+    return true;
+  case ChatMessage::JOIN:
+    row.type = TranscriptRow::CONTROL;
+    row.text = "enters room";
+    return true;
+  case ChatMessage::LEAVE:
+    row.type = TranscriptRow::CONTROL;
+    row.text = "leaves room";
+    return true;
+  case ChatMessage::FILE:
+    row.type = TranscriptRow::CONTROL;
+    row.text = "shares file " + QString::fromStdString(entry.data);
+    return true;
+  default:
+    return false;
+  }
+}
+
+void
+TranscriptModel::addRows(int position, const std::vector<TranscriptRow>& rows)
+{
+  if (rows.empty())
+    return;
+
+  beginInsertRows(QModelIndex(), position, position + rows.size() - 1);
+  m_rows.insert(m_rows.begin() + position, rows.begin(), rows.end());
+  endInsertRows();
+}
+
+void
+TranscriptModel::eraseRows(int position, int count)
+{
+  if (count <= 0)
+    return;
+
+  beginRemoveRows(QModelIndex(), position, position + count - 1);
+  m_rows.erase(m_rows.begin() + position, m_rows.begin() + position + count);
+  endRemoveRows();
+}
+
+size_t
+TranscriptModel::trimFront()
+{
+  if (m_rows.size() <= m_maxRows)
+    return 0;
+
+  size_t nRemoved = m_rows.size() - m_maxRows;
+  eraseRows(0, nRemoved);
+  m_hasOlderRows = (m_history != nullptr);
+  return nRemoved;
+}
+
+bool
+TranscriptModel::hasRow(const TranscriptRow& row) const
+{
+  // a page overlaps the rows of the same second at the ends only
+  for (auto it = m_rows.begin(); it != m_rows.end() && it->timestamp <= row.timestamp; ++it) {
+    if (isSameRow(*it, row))
+      return true;
+  }
+  for (auto it = m_rows.rbegin(); it != m_rows.rend() && it->timestamp >= row.timestamp; ++it) {
+    if (isSameRow(*it, row))
+      return true;
+  }
+  return false;
+}
+
+bool
+TranscriptModel::isSameRow(const TranscriptRow& a, const TranscriptRow& b)
+{
+  if (a.historyId != 0 && b.historyId != 0)
+    return a.historyId == b.historyId;
+  return a.sessionId != 0 && a.sessionId == b.sessionId && a.seqNo == b.seqNo &&
+         a.text == b.text;
+}
+
+TranscriptDelegate::TranscriptDelegate(QAbstractItemView* view)
+  : QStyledItemDelegate(view)
+  , m_view(view)
+{
+}
+
+void
+TranscriptDelegate::paint(QPainter* painter, const QStyleOptionViewItem& option,
+                          const QModelIndex& index) const
+{
+  QString nick = index.data(TranscriptModel::NickRole).toString();
+  QString text = index.data(Qt::DisplayRole).toString();
+  QString time = formatTime(index.data(TranscriptModel::TimeRole).toLongLong());
+  bool isChat = index.data(TranscriptModel::TypeRole).toInt() == TranscriptRow::CHAT;
+
+  painter->save();
+
+  QFont nickFont = option.font;
+  nickFont.setBold(true);
+  nickFont.setUnderline(true);
+  QFont timeFont = option.font;
+  timeFont.setUnderline(true);
+
+  QRect rect = option.rect.adjusted(MARGIN, MARGIN, -MARGIN, -MARGIN);
+  QString from = isChat ? QString("%1 ").arg(nick) : QString("%1 %2  ").arg(nick).arg(text);
+
+  // Print who & when
+  painter->setFont(nickFont);
+  painter->setPen(isChat ? Qt::darkGreen : Qt::gray);
+  QRect fromRect;
+  painter->drawText(rect, Qt::AlignLeft | Qt::AlignTop, from, &fromRect);
+
+  painter->setFont(timeFont);
+  painter->setPen(Qt::gray);
+  painter->drawText(rect.adjusted(fromRect.width(), 0, 0, 0), Qt::AlignLeft | Qt::AlignTop,
+                    time);
+
+  // Print what
+  if (isChat) {
+    painter->setFont(option.font);
+    painter->setPen(option.palette.color(QPalette::Text));
+    painter->drawText(rect.adjusted(0, fromRect.height(), 0, 0),
+                      Qt::AlignLeft | Qt::AlignTop | Qt::TextWordWrap, text);
+  }
+
+  painter->restore();
+}
+
+QSize
+TranscriptDelegate::sizeHint(const QStyleOptionViewItem& option, const QModelIndex& index) const
+{
+  QFont nickFont = option.font;
+  nickFont.setBold(true);
+  int height = QFontMetrics(nickFont).height();
+
+  if (index.data(TranscriptModel::TypeRole).toInt() == TranscriptRow::CHAT) {
+    QRect textRect = QFontMetrics(option.font)
+      .boundingRect(QRect(0, 0, getTextWidth(), std::numeric_limits<int>::max()),
+                    Qt::AlignLeft | Qt::AlignTop | Qt::TextWordWrap,
+                    index.data(Qt::DisplayRole).toString());
+    height += textRect.height();
+  }
+
+  return QSize(getTextWidth() + 2 * MARGIN, height + 2 * MARGIN);
+}
+
+QString
+TranscriptDelegate::formatTime(time_t timestamp)
+{
+  struct tm* localTime = localtime(&timestamp);
+
+  return QString("%1:%2:%3")
+           .arg(localTime->tm_hour, 2, 10, QChar('0'))
+           .arg(localTime->tm_min, 2, 10, QChar('0'))
+           .arg(localTime->tm_sec, 2, 10, QChar('0'));
+}
+
+int
+TranscriptDelegate::getTextWidth() const
+{
+  // rows wrap at the width of the view, which lays them out again when resized
+  return std::max(m_view->viewport()->width() - 2 * MARGIN, 1);
+}
+
+} // namespace chronochat
+
+#if WAF
+#include "transcript-model.moc"
+#endif
@@ -0,0 +1,195 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#ifndef CHRONOCHAT_TRANSCRIPT_MODEL_HPP
+#define CHRONOCHAT_TRANSCRIPT_MODEL_HPP
+
+#include <QAbstractListModel>
+#include <QStyledItemDelegate>
+
+#ifndef Q_MOC_RUN
+#include "chat-history-storage.hpp"
+#include "session-table.hpp"
+#include <deque>
+#endif
+
+class QAbstractItemView;
+
+namespace chronochat {
+
+class TranscriptRow
+{
+public:
+  enum Type {
+    CHAT,
+    CONTROL
+  };
+
+  TranscriptRow()
+    : type(CHAT)
+    , timestamp(0)
+    , historyId(0)
+    , sessionId(0)
+    , seqNo(0)
+  {
+  }
+
+public:
+  Type type;
+  QString nick;                          // with the mark of unverified senders
+  QString text;                          // chat text, or the action of a control message
+  time_t timestamp;
+
+  // a row is identified by its position in the history, or by session, seqNo and text
+  // until it has been read from the history; rows without a session are not in the history
+  int64_t historyId;
+  SessionId sessionId;
+  uint64_t seqNo;
+};
+
+/**
+ * @brief Chat transcript of bounded size
+ *
+ * The model retains at most maxRows rows, the rest of the transcript is in the history.
+ * Live rows are appended and push out the oldest rows, which are read back page by page
+ * when the view scrolls up.  Loading older pages pushes out the newest rows instead, and
+ * then the model is detached: live rows are not appended until the view has scrolled down
+ * through the history to the end.  In the meantime, the live rows are kept in a tail of
+ * one page, so that rows which have not reached the history yet are not lost.
+ */
+class TranscriptModel : public QAbstractListModel
+{
+  Q_OBJECT
+
+public:
+  enum Role {
+    NickRole = Qt::UserRole + 1,
+    TimeRole,
+    TypeRole
+  };
+
+  /**
+   * @param history the history of the chatroom, which may be nullptr
+   * @param sessions the session IDs of the chatroom, which live rows are identified by
+   * @param maxRows maximum number of retained rows
+   * @param pageSize number of rows read from the history at once
+   */
+  TranscriptModel(ChatHistoryStorage* history, const SessionTable* sessions,
+                  size_t maxRows = DEFAULT_MAX_ROWS, size_t pageSize = DEFAULT_PAGE_SIZE,
+                  QObject* parent = 0);
+
+  int
+  rowCount(const QModelIndex& parent = QModelIndex()) const;
+
+  QVariant
+  data(const QModelIndex& index, int role) const;
+
+  /// @brief append live rows, or keep them in the tail if the model is detached
+  void
+  appendRows(const std::vector<TranscriptRow>& rows);
+
+  /**
+   * @brief prepend the page of the history before the oldest row
+   *
+   * @return the number of prepended rows
+   */
+  size_t
+  fetchOlder();
+
+  /**
+   * @brief append the page of the history after the newest row, if the model is detached
+   *
+   * @param nRemoved output number of the oldest rows which have been pushed out
+   * @return the number of appended rows
+   */
+  size_t
+  fetchNewer(size_t& nRemoved);
+
+  bool
+  isDetached() const
+  {
+    return m_isDetached;
+  }
+
+  size_t
+  getNTailRows() const
+  {
+    return m_tail.size();
+  }
+
+  /// @return false if the entry is not displayed
+  bool
+  makeRow(const ChatHistoryEntry& entry, TranscriptRow& row) const;
+
+private:
+  void
+  addRows(int position, const std::vector<TranscriptRow>& rows);
+
+  void
+  eraseRows(int position, int count);
+
+  /// @brief remove the oldest rows beyond maxRows
+  size_t
+  trimFront();
+
+  bool
+  hasRow(const TranscriptRow& row) const;
+
+  static bool
+  isSameRow(const TranscriptRow& a, const TranscriptRow& b);
+
+public:
+  static const size_t DEFAULT_MAX_ROWS;
+  static const size_t DEFAULT_PAGE_SIZE;
+
+private:
+  ChatHistoryStorage* m_history;
+  const SessionTable* m_sessions;
+  size_t m_maxRows;
+  size_t m_pageSize;
+
+  std::deque<TranscriptRow> m_rows;
+  bool m_hasOlderRows;
+  bool m_isDetached;
+  std::deque<TranscriptRow> m_tail;      // live rows received while detached
+};
+
+/**
+ * @brief Paints the rows of a TranscriptModel
+ *
+ * Chat rows show the nick and time above the wrapped text, control rows show the nick,
+ * action and time on one line.  Only the rows in the viewport are painted.
+ */
+class TranscriptDelegate : public QStyledItemDelegate
+{
+  Q_OBJECT
+
+public:
+  explicit
+  TranscriptDelegate(QAbstractItemView* view);
+
+  void
+  paint(QPainter* painter, const QStyleOptionViewItem& option, const QModelIndex& index) const;
+
+  QSize
+  sizeHint(const QStyleOptionViewItem& option, const QModelIndex& index) const;
+
+  static QString
+  formatTime(time_t timestamp);
+
+private:
+  int
+  getTextWidth() const;
+
+private:
+  QAbstractItemView* m_view;
+};
+
+} // namespace chronochat
+
+#endif // CHRONOCHAT_TRANSCRIPT_MODEL_HPP
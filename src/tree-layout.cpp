@@ -12,12 +12,15 @@
 
 #include "tree-layout.hpp"
 #include <iostream>
+#include <cmath>
 
 namespace chronochat {
 
 using std::vector;
 using std::map;
 
+static const double Pi = 3.14159265358979323846264338327950288419717;
+
 void
 OneLevelTreeLayout::setOneLevelLayout(vector<Coordinate>& childNodesCo)
 {
@@ -35,6 +38,16 @@ OneLevelTreeLayout::setOneLevelLayout(vector<Coordinate>& childNodesCo)
   }
 }
 
+TreeLayout::Coordinate
+OneLevelTreeLayout::getSlotPosition(size_t slot)
+{
+  double offset = static_cast<double>((slot + 1) / 2) * getSiblingDistance();
+  Coordinate co;
+  co.x = slot % 2 == 1 ? offset : -offset;
+  co.y = getLevelDistance();
+  return co;
+}
+
 void
 MultipleLevelTreeLayout::setMultipleLevelTreeLayout(TrustTreeNodeList& nodeList)
 {
@@ -64,4 +77,85 @@ MultipleLevelTreeLayout::setMultipleLevelTreeLayout(TrustTreeNodeList& nodeList)
   }
 }
 
+void
+RingTreeLayout::setOneLevelLayout(vector<Coordinate>& childNodesCo)
+{
+  placeOnRings(childNodesCo, getLevelDistance());
+}
+
+TreeLayout::Coordinate
+RingTreeLayout::getSlotPosition(size_t slot)
+{
+  double radius = getLevelDistance();
+  size_t capacity = getRingCapacity(radius);
+  while (slot >= capacity) {
+    slot -= capacity;
+    radius += getSiblingDistance();
+    capacity = getRingCapacity(radius);
+  }
+
+  // the last ring is spaced as if it were full, so its nodes stay when it fills up
+  double angle = Pi / 2 + 2 * Pi * slot / capacity;
+  Coordinate co;
+  co.x = radius * std::cos(angle);
+  co.y = radius * std::sin(angle);
+  return co;
+}
+
+void
+RingTreeLayout::setMultipleLevelTreeLayout(TrustTreeNodeList& nodeList)
+{
+  if (nodeList.empty())
+    return;
+
+  map<int, TrustTreeNodeList> levels;
+  for (TrustTreeNodeList::iterator it = nodeList.begin(); it != nodeList.end(); it++)
+    levels[(*it)->level()].push_back(*it);
+
+  // a single root is in the center
+  double radius = 0;
+  for (map<int, TrustTreeNodeList>::iterator levelIt = levels.begin();
+       levelIt != levels.end(); levelIt++) {
+    TrustTreeNodeList& level = levelIt->second;
+    vector<Coordinate> co(level.size());
+    radius = placeOnRings(co, radius) + getLevelDistance();
+
+    for (size_t i = 0; i < level.size(); i++) {
+      level[i]->x = co[i].x;
+      level[i]->y = co[i].y;
+    }
+  }
+}
+
+double
+RingTreeLayout::placeOnRings(vector<Coordinate>& childNodesCo, double radius)
+{
+  double sd = getSiblingDistance();
+  size_t n = childNodesCo.size();
+  size_t i = 0;
+
+  while (i < n) {
+    size_t capacity = getRingCapacity(radius);
+    size_t count = std::min(capacity, n - i);
+
+    // the first node of a ring is right below the center, like the one-level layout
+    for (size_t j = 0; j < count; j++, i++) {
+      double angle = Pi / 2 + 2 * Pi * j / count;
+      childNodesCo[i].x = radius * std::cos(angle);
+      childNodesCo[i].y = radius * std::sin(angle);
+    }
+
+    if (i < n)
+      radius += sd;
+  }
+
+  return radius;
+}
+
+size_t
+RingTreeLayout::getRingCapacity(double radius)
+{
+  return std::max<size_t>(1, std::floor(2 * Pi * radius / getSiblingDistance()));
+}
+
 } // namespace chronochat
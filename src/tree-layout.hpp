@@ -17,6 +17,9 @@
 
 namespace chronochat {
 
+// below this scale of a view, the scenes draw nodes without text and edges
+const double LEVEL_OF_DETAIL_SCALE = 0.4;
+
 class TreeLayout
 {
 public:
@@ -40,6 +43,19 @@ public:
   {
   }
 
+  /**
+   * @brief get the position of the child in @p slot of a one level tree
+   *
+   * Unlike in setOneLevelLayout, the position does not depend on the number of children,
+   * so a child keeps its place while the others come and go.
+   */
+  virtual Coordinate
+  getSlotPosition(size_t slot)
+  {
+    Coordinate co = {0, 0};
+    return co;
+  }
+
   void
   setSiblingDistance(int d)
   {
@@ -84,6 +100,9 @@ public:
   virtual void
   setOneLevelLayout(std::vector<Coordinate>& childNodesCo);
 
+  /// @brief the slots alternate between the right and the left of the root
+  virtual Coordinate
+  getSlotPosition(size_t slot);
 };
 
 class MultipleLevelTreeLayout : public TreeLayout
@@ -100,6 +119,50 @@ public:
   virtual void setMultipleLevelTreeLayout(TrustTreeNodeList& nodeList);
 };
 
+/**
+ * @brief Layout of large trees on concentric rings around the root
+ *
+ * Nodes on a ring are a sibling distance apart, and rings are a sibling distance apart, so
+ * the extent of the layout grows with the square root of the number of nodes rather than
+ * linearly.  The first ring of children is a level distance away from the root.  In a
+ * multiple level tree, each level starts on the ring a level distance outside the previous
+ * one.
+ */
+class RingTreeLayout : public MultipleLevelTreeLayout
+{
+public:
+  RingTreeLayout()
+  {
+  }
+
+  virtual ~RingTreeLayout()
+  {
+  }
+
+  virtual void
+  setOneLevelLayout(std::vector<Coordinate>& childNodesCo);
+
+  /// @brief the slots fill the rings from the inside, a ring is a sibling distance apart
+  virtual Coordinate
+  getSlotPosition(size_t slot);
+
+  virtual void
+  setMultipleLevelTreeLayout(TrustTreeNodeList& nodeList);
+
+private:
+  /// @brief get the number of nodes on the ring of @p radius
+  size_t
+  getRingCapacity(double radius);
+
+  /**
+   * @brief place @p childNodesCo on rings, starting with the one of @p radius
+   *
+   * @return the radius of the outermost ring used
+   */
+  double
+  placeOnRings(std::vector<Coordinate>& childNodesCo, double radius);
+};
+
 } // namespace chronochat
 
 #endif // CHRONOCHAT_TREE_LAYOUT_HPP
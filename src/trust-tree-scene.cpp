@@ -14,15 +14,20 @@
 
 #ifndef Q_MOC_RUN
 #include <assert.h>
+#include <algorithm>
+#include <cmath>
 #include <memory>
 #endif
 
 namespace chronochat {
 
 static const double Pi = 3.14159265358979323846264338327950288419717;
+// larger trees are laid out on rings
+static const size_t RING_LAYOUT_SIZE = 32;
 
 TrustTreeScene::TrustTreeScene(QWidget* parent)
   : QGraphicsScene(parent)
+  , m_isDetailed(true)
 {
 }
 
@@ -30,12 +35,17 @@ void
 TrustTreeScene::plotTrustTree(TrustTreeNodeList& nodeList)
 {
   clear();
+  m_detailItems.clear();
 
   int nodeSize = 40;
   int siblingDistance = 100;
   int levelDistance = 100;
 
-  shared_ptr<MultipleLevelTreeLayout> layout(new MultipleLevelTreeLayout());
+  shared_ptr<MultipleLevelTreeLayout> layout;
+  if (nodeList.size() <= RING_LAYOUT_SIZE)
+    layout = make_shared<MultipleLevelTreeLayout>();
+  else
+    layout = make_shared<RingTreeLayout>();
   layout->setSiblingDistance(siblingDistance);
   layout->setLevelDistance(levelDistance);
   layout->setMultipleLevelTreeLayout(nodeList);
@@ -62,20 +72,21 @@ TrustTreeScene::plotEdge(const TrustTreeNodeList& nodeList, int nodeSize)
       QPointF src(x1 + nodeSize/2, y1 + nodeSize/2);
       QPointF dest(x2 + nodeSize/2, y2 + nodeSize/2);
       QLineF line(src, dest);
-      double angle = ::acos(line.dx() / line.length());
+      double angle = ::atan2(line.dy(), line.dx());
 
+      // the edge ends on the borders of the nodes, which may be in any direction on rings
       double arrowSize = 10;
-      QPointF endP0 = src + QPointF((nodeSize/2) * line.dx() / line.dy(), nodeSize/2);
-      QPointF sourceArrowP0 = dest + QPointF((-nodeSize/2) * line.dx() / line.dy(),
-                                             -nodeSize/2);
+      double border = (nodeSize/2) / std::max(std::abs(line.dx()), std::abs(line.dy()));
+      QPointF endP0 = src + QPointF(border * line.dx(), border * line.dy());
+      QPointF sourceArrowP0 = dest - QPointF(border * line.dx(), border * line.dy());
       QPointF sourceArrowP1 = sourceArrowP0 + QPointF(-cos(angle - Pi / 6) * arrowSize,
                                                       -sin(angle - Pi / 6) * arrowSize);
       QPointF sourceArrowP2 = sourceArrowP0 + QPointF(-cos(angle + Pi / 6) * arrowSize,
                                                       -sin(angle + Pi / 6) * arrowSize);
 
-      addLine(QLineF(sourceArrowP0, endP0), QPen(Qt::black));
-      addPolygon(QPolygonF() << sourceArrowP0 << sourceArrowP1 << sourceArrowP2,
-                 QPen(Qt::black), QBrush(Qt::black));
+      addDetailItem(addLine(QLineF(sourceArrowP0, endP0), QPen(Qt::black)));
+      addDetailItem(addPolygon(QPolygonF() << sourceArrowP0 << sourceArrowP1 << sourceArrowP2,
+                               QPen(Qt::black), QBrush(Qt::black)));
     }
   }
 }
@@ -92,17 +103,37 @@ TrustTreeScene::plotNode(const TrustTreeNodeList& nodeList, int nodeSize)
     QRectF boundingRect(x, y, nodeSize, nodeSize);
     QRectF innerBoundingRect(x + rim, y + rim, nodeSize - rim * 2, nodeSize - rim * 2);
     addRect(boundingRect, QPen(Qt::black), QBrush(Qt::darkBlue));
-    addRect(innerBoundingRect, QPen(Qt::black), QBrush(Qt::lightGray));
+    addDetailItem(addRect(innerBoundingRect, QPen(Qt::black), QBrush(Qt::lightGray)));
 
     QRectF textRect(x - nodeSize / 2, y + nodeSize, 2 * nodeSize, 30);
-    addRect(textRect, QPen(Qt::darkCyan), QBrush(Qt::darkCyan));
+    addDetailItem(addRect(textRect, QPen(Qt::darkCyan), QBrush(Qt::darkCyan)));
     QGraphicsTextItem *nickItem = addText(QString::fromStdString((*it)->name().toUri()));
     nickItem->setDefaultTextColor(Qt::white);
     nickItem->setFont(QFont("Cursive", 8, QFont::Bold));
     nickItem->setPos(x - nodeSize / 2 + 10, y + nodeSize + 5);
+    addDetailItem(nickItem);
   }
 }
 
+void
+TrustTreeScene::setLevelOfDetail(double scale)
+{
+  bool isDetailed = scale >= LEVEL_OF_DETAIL_SCALE;
+  if (isDetailed == m_isDetailed)
+    return;
+
+  m_isDetailed = isDetailed;
+  for (QList<QGraphicsItem*>::iterator it = m_detailItems.begin(); it != m_detailItems.end(); ++it)
+    (*it)->setVisible(isDetailed);
+}
+
+void
+TrustTreeScene::addDetailItem(QGraphicsItem* item)
+{
+  item->setVisible(m_isDetailed);
+  m_detailItems.push_back(item);
+}
+
 } //namespace chronochat
 
 #if WAF
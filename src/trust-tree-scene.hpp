@@ -21,6 +21,7 @@
 #endif
 
 class QGraphicsTextItem;
+class QGraphicsItem;
 
 namespace chronochat {
 
@@ -34,12 +35,28 @@ public:
   void
   plotTrustTree(chronochat::TrustTreeNodeList& nodeList);
 
+  /**
+   * @brief draw the nodes as plain squares if the view shows the scene below LEVEL_OF_DETAIL_SCALE
+   *
+   * @param scale of the view showing the scene
+   */
+  void
+  setLevelOfDetail(double scale);
+
 private:
   void
   plotEdge(const chronochat::TrustTreeNodeList& nodeList, int nodeSize);
 
   void
   plotNode(const chronochat::TrustTreeNodeList& nodeList, int nodeSize);
+
+  void
+  addDetailItem(QGraphicsItem* item);
+
+private:
+  // the items which are hidden below LEVEL_OF_DETAIL_SCALE
+  QList<QGraphicsItem*> m_detailItems;
+  bool m_isDetailed;
 };
 
 } // namespace chronochat
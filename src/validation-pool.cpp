@@ -0,0 +1,75 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#include "validation-pool.hpp"
+
+#include "logging.h"
+
+INIT_LOGGER("ValidationPool");
+
+namespace chronochat {
+
+ValidationPool::ValidationPool(const ValidatorFactory& makeValidator, size_t nThreads)
+{
+  for (size_t i = 0; i < std::max<size_t>(nThreads, 1); i++) {
+    unique_ptr<Worker> worker(new Worker);
+    worker->work.reset(new boost::asio::io_service::work(worker->ioService));
+    worker->validator = makeValidator();
+
+    boost::asio::io_service& workerIoService = worker->ioService;
+    worker->thread = boost::thread([&workerIoService] { workerIoService.run(); });
+
+    m_workers.push_back(std::move(worker));
+  }
+
+  _LOG_DEBUG("Started " << m_workers.size() << " validation workers");
+}
+
+ValidationPool::~ValidationPool()
+{
+  for (auto& worker : m_workers) {
+    worker->work.reset();
+    worker->ioService.stop();
+  }
+
+  for (auto& worker : m_workers)
+    worker->thread.join();
+}
+
+void
+ValidationPool::validate(const Name& sessionPrefix,
+                         const shared_ptr<const Data>& data,
+                         boost::asio::io_service& ioService,
+                         const ndn::OnDataValidated& onValidated,
+                         const ndn::OnDataValidationFailed& onValidationFailed)
+{
+  size_t index = std::hash<std::string>()(sessionPrefix.toUri()) % m_workers.size();
+  Worker& worker = *m_workers[index];
+
+  worker.ioService.post([&worker, &ioService, data, onValidated, onValidationFailed] {
+      // a face-less validator completes synchronously
+      worker.validator->validate(*data,
+        [&ioService, onValidated] (const shared_ptr<const Data>& data) {
+          ioService.post([onValidated, data] { onValidated(data); });
+        },
+        [&ioService, onValidationFailed] (const shared_ptr<const Data>& data,
+                                          const std::string& reason) {
+          ioService.post([onValidationFailed, data, reason] { onValidationFailed(data, reason); });
+        });
+    });
+}
+
+size_t
+ValidationPool::getDefaultNThreads()
+{
+  // leave one core to the sync thread
+  unsigned int nCores = boost::thread::hardware_concurrency();
+  return nCores > 1 ? nCores - 1 : 1;
+}
+
+} // namespace chronochat
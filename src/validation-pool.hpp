@@ -0,0 +1,78 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#ifndef CHRONOCHAT_VALIDATION_POOL_HPP
+#define CHRONOCHAT_VALIDATION_POOL_HPP
+
+#include "common.hpp"
+
+#include <ndn-cxx/security/validator-regex.hpp>
+#include <boost/thread.hpp>
+
+namespace chronochat {
+
+/**
+ * @brief Pool of worker threads which verify Data signatures
+ *
+ * Every worker owns a face-less validator made by the factory, so it can only verify
+ * Data whose signer is a trust anchor of the pool; any other Data fails and is left to
+ * a validator which can fetch certificates.  Certificates verified that way reach the
+ * workers through the certificate cache that the factory gives their validators.
+ *
+ * All Data of one session is verified by the same worker, so the results of a session
+ * are posted back in the order the Data was submitted.  The pool can be shared by
+ * several users, each result is posted to the io_service given with the Data.
+ */
+class ValidationPool : noncopyable
+{
+public:
+  typedef function<shared_ptr<ndn::ValidatorRegex>()> ValidatorFactory;
+
+  /**
+   * @param makeValidator factory of the face-less validator of one worker
+   * @param nThreads number of worker threads
+   */
+  explicit
+  ValidationPool(const ValidatorFactory& makeValidator,
+                 size_t nThreads = getDefaultNThreads());
+
+  /// @brief stop the workers, pending validations are dropped
+  ~ValidationPool();
+
+  /// @brief verify @p data and post the result to @p ioService
+  void
+  validate(const Name& sessionPrefix,
+           const shared_ptr<const Data>& data,
+           boost::asio::io_service& ioService,
+           const ndn::OnDataValidated& onValidated,
+           const ndn::OnDataValidationFailed& onValidationFailed);
+
+  size_t
+  getNThreads() const
+  {
+    return m_workers.size();
+  }
+
+  static size_t
+  getDefaultNThreads();
+
+private:
+  struct Worker
+  {
+    boost::asio::io_service ioService;
+    unique_ptr<boost::asio::io_service::work> work;
+    shared_ptr<ndn::ValidatorRegex> validator;
+    boost::thread thread;
+  };
+
+  std::vector<unique_ptr<Worker>> m_workers;
+};
+
+} // namespace chronochat
+
+#endif // CHRONOCHAT_VALIDATION_POOL_HPP
@@ -0,0 +1,165 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include "backfill-fetcher.hpp"
+
+namespace chronochat {
+namespace tests {
+
+class BackfillFixture
+{
+public:
+  struct Request
+  {
+    Name session;
+    uint64_t seqNo;
+    BackfillFetcher::DataCallback onData;
+    BackfillFetcher::TimeoutCallback onTimeout;
+  };
+
+  BackfillFixture()
+    : fetcher([this] (const Name& session, uint64_t seqNo,
+                      const BackfillFetcher::DataCallback& onData,
+                      const BackfillFetcher::TimeoutCallback& onTimeout) {
+                requests.push_back({session, seqNo, onData, onTimeout});
+              },
+              [this] (const shared_ptr<const Data>& data, bool isValidated) {
+                delivered.push_back(data->getName());
+              },
+              4, 100)
+  {
+  }
+
+  void
+  satisfy(size_t index)
+  {
+    Request request = requests[index];
+    Name name = request.session;
+    name.appendNumber(request.seqNo);
+    request.onData(make_shared<Data>(name), true);
+  }
+
+public:
+  std::vector<Request> requests;
+  std::vector<Name> delivered;
+  BackfillFetcher fetcher;
+};
+
+BOOST_FIXTURE_TEST_SUITE(TestBackfillFetcher, BackfillFixture)
+
+BOOST_AUTO_TEST_CASE(NewestFirstInOrderDelivery)
+{
+  Name session("/alice/session");
+  fetcher.addGap(session, 1, 5);
+
+  // initial window
+  BOOST_REQUIRE_EQUAL(requests.size(), 2);
+  BOOST_CHECK_EQUAL(requests[0].seqNo, 5);
+  BOOST_CHECK_EQUAL(requests[1].seqNo, 4);
+
+  satisfy(0);
+  satisfy(1);
+  // nothing can be delivered before the older data arrives
+  BOOST_CHECK(delivered.empty());
+  BOOST_CHECK_EQUAL(fetcher.getWindow(session), BackfillFetcher::INITIAL_WINDOW + 2);
+
+  BOOST_REQUIRE_EQUAL(requests.size(), 5);
+  BOOST_CHECK_EQUAL(requests[2].seqNo, 3);
+  BOOST_CHECK_EQUAL(requests[3].seqNo, 2);
+  BOOST_CHECK_EQUAL(requests[4].seqNo, 1);
+
+  satisfy(4);
+  BOOST_CHECK_EQUAL(delivered.size(), 1);
+
+  // a timed out seq does not hold back the newer ones
+  requests[3].onTimeout();
+  BOOST_CHECK_EQUAL(delivered.size(), 1);
+  BOOST_CHECK_EQUAL(fetcher.getWindow(session), (BackfillFetcher::INITIAL_WINDOW + 3) / 2);
+
+  satisfy(2);
+  BOOST_REQUIRE_EQUAL(delivered.size(), 4);
+  BOOST_CHECK_EQUAL(delivered[0], Name("/alice/session").appendNumber(1));
+  BOOST_CHECK_EQUAL(delivered[1], Name("/alice/session").appendNumber(3));
+  BOOST_CHECK_EQUAL(delivered[2], Name("/alice/session").appendNumber(4));
+  BOOST_CHECK_EQUAL(delivered[3], Name("/alice/session").appendNumber(5));
+  BOOST_CHECK_EQUAL(fetcher.getNOutstanding(), 0);
+
+  // the same data is never requested twice
+  fetcher.addGap(session, 3, 6);
+  BOOST_REQUIRE_EQUAL(requests.size(), 6);
+  BOOST_CHECK_EQUAL(requests[5].seqNo, 6);
+}
+
+BOOST_AUTO_TEST_CASE(OutstandingCap)
+{
+  fetcher.addGap("/alice/session", 1, 10);
+  fetcher.addGap("/bob/session", 1, 10);
+  fetcher.addGap("/carol/session", 1, 10);
+
+  BOOST_CHECK_EQUAL(requests.size(), 4);
+  BOOST_CHECK_EQUAL(fetcher.getNOutstanding(), 4);
+
+  fetcher.removeSession(requests[0].session);
+  BOOST_CHECK_EQUAL(fetcher.getNOutstanding(), 4);
+
+  // late data of a removed session is ignored
+  satisfy(0);
+  BOOST_CHECK(delivered.empty());
+  BOOST_CHECK_EQUAL(fetcher.getNOutstanding(), 4);
+}
+
+BOOST_AUTO_TEST_CASE(MaxDepth)
+{
+  fetcher.addGap("/alice/session", 1, 1000);
+  BOOST_REQUIRE_EQUAL(requests.size(), 2);
+  BOOST_CHECK_EQUAL(requests[0].seqNo, 1000);
+
+  for (size_t i = 0; i < requests.size(); i++)
+    satisfy(i);
+
+  BOOST_REQUIRE_EQUAL(delivered.size(), 100);
+  BOOST_CHECK_EQUAL(delivered[0], Name("/alice/session").appendNumber(901));
+}
+
+BOOST_AUTO_TEST_CASE(SuspendResume)
+{
+  Name session("/alice/session");
+  fetcher.addGap(session, 1, 4);
+  satisfy(0);
+  BOOST_REQUIRE_EQUAL(requests.size(), 4);
+
+  fetcher.suspend();
+  BOOST_CHECK_EQUAL(fetcher.getNOutstanding(), 0);
+
+  // late data of the forgotten fetches is ignored, new gaps wait for resume()
+  satisfy(1);
+  fetcher.addGap(session, 3, 6);
+  BOOST_CHECK_EQUAL(requests.size(), 4);
+  BOOST_CHECK(delivered.empty());
+
+  fetcher.resume();
+  BOOST_REQUIRE_EQUAL(requests.size(), 6);
+  BOOST_CHECK_EQUAL(requests[4].seqNo, 6);
+  BOOST_CHECK_EQUAL(requests[5].seqNo, 5);
+
+  for (size_t i = 4; i < requests.size(); i++)
+    satisfy(i);
+
+  // the data that arrived before the suspension is not requested again
+  BOOST_CHECK_EQUAL(requests.size(), 9);
+  BOOST_REQUIRE_EQUAL(delivered.size(), 6);
+  for (uint64_t seqNo = 1; seqNo <= 6; seqNo++)
+    BOOST_CHECK_EQUAL(delivered[seqNo - 1], Name("/alice/session").appendNumber(seqNo));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace tests
+} // namespace chronochat
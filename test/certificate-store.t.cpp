@@ -0,0 +1,235 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include "certificate-store.hpp"
+
+#include <ndn-cxx/security/key-chain.hpp>
+#include <ndn-cxx/security/signature-sha256-with-rsa.hpp>
+#include <ndn-cxx/encoding/block-helpers.hpp>
+#include <ndn-cxx/encoding/buffer-stream.hpp>
+#include <boost/filesystem.hpp>
+#include "cryptopp.hpp"
+#include <cryptopp/osrng.h>
+#include <cryptopp/rsa.h>
+
+namespace chronochat {
+namespace tests {
+
+namespace fs = boost::filesystem;
+
+using ndn::IdentityCertificate;
+
+const std::string testKey("\
+MIIBIDANBgkqhkiG9w0BAQEFAAOCAQ0AMIIBCAKCAQEA2LFg9IsUBUX2LN+gRzbE\
+Tb+aLhC+vaGkul1/4bEDdQcuETSOnkhuQ6Wo7QMCtcvg1z8JCx3eUga78C80Xhe0\
+rKxdjm2sM51NeBimkHW5/nlSBEewlr0qSYR+cikuHwj0Tfm9TD/EEgy72mhrteU/\
+fHIFbHCBKhZC351kkG3TehJ6HYzh9uyZAQs/C8b/RmS64XyhszspUXy87wiMiF2J\
+eh1q6DvsUyUGj/pokmTVRsn+I2Ks+Vm0B+emvWY1JXU6YY7g2wY1KkGjVTs6Ck/h\
++KofJp9/fWkPfwYzPuv1oK0sO/zDtlAoKGYckkGOB1as1FVVp2MDlDWD6Dktx3bx\
+iwIBEQ==");
+
+class CertificateStoreFixture
+{
+public:
+  CertificateStoreFixture()
+    : path(fs::temp_directory_path() / fs::unique_path())
+  {
+    using namespace CryptoPP;
+
+    ndn::OBufferStream os;
+    StringSource(testKey, true, new Base64Decoder(new FileSink(os)));
+    publicKey = ndn::PublicKey(os.buf()->buf(), os.buf()->size());
+  }
+
+  // a certificate with a key of its own, signed by the key of @p signer
+  struct Signer
+  {
+    Name name;
+    CryptoPP::RSA::PrivateKey key;
+    shared_ptr<IdentityCertificate> certificate;
+  };
+
+  Signer
+  makeSigner(const Name& name, const Signer* signer)
+  {
+    using namespace CryptoPP;
+
+    Signer result;
+    result.name = name;
+    result.key.GenerateRandomWithKeySize(rng, 1024);
+
+    ndn::OBufferStream os;
+    RSA::PublicKey(result.key).DEREncode(FileSink(os).Ref());
+
+    result.certificate = make_shared<IdentityCertificate>();
+    result.certificate->setName(name);
+    result.certificate->setNotBefore(time::system_clock::now() - time::hours(1));
+    result.certificate->setNotAfter(time::system_clock::now() + time::hours(1));
+    result.certificate->setPublicKeyInfo(ndn::PublicKey(os.buf()->buf(), os.buf()->size()));
+    result.certificate->encode();
+    if (signer != nullptr)
+      sign(*result.certificate, *signer);
+    else
+      sign(*result.certificate, result);
+    return result;
+  }
+
+  void
+  sign(Data& data, const Signer& signer)
+  {
+    using namespace CryptoPP;
+
+    data.setSignature(ndn::SignatureSha256WithRsa(KeyLocator(signer.name.getPrefix(-1))));
+    ndn::EncodingBuffer encoder;
+    data.wireEncode(encoder, true);
+
+    RSASS<PKCS1v15, SHA256>::Signer rsaSigner(signer.key);
+    ndn::OBufferStream os;
+    StringSource(encoder.buf(), encoder.size(), true,
+                 new SignerFilter(rng, rsaSigner, new FileSink(os)));
+    data.wireEncode(encoder, ndn::dataBlock(tlv::SignatureValue,
+                                            os.buf()->buf(), os.buf()->size()));
+  }
+
+  ~CertificateStoreFixture()
+  {
+    fs::remove(path);
+  }
+
+  shared_ptr<IdentityCertificate>
+  makeCertificate(const Name& name, const time::system_clock::Duration& validity)
+  {
+    auto certificate = make_shared<IdentityCertificate>();
+    certificate->setName(name);
+    certificate->setNotBefore(time::system_clock::now() - time::hours(1));
+    certificate->setNotAfter(time::system_clock::now() + validity);
+    certificate->setPublicKeyInfo(publicKey);
+    certificate->encode();
+    keyChain.signWithSha256(*certificate);
+    return certificate;
+  }
+
+  Data
+  makeData(const Name& name, const Name& signer)
+  {
+    Data data(name);
+    data.setSignature(ndn::SignatureSha256WithRsa(KeyLocator(signer)));
+    uint8_t signatureValue[] = {1, 2, 3, 4};
+    data.setSignatureValue(ndn::dataBlock(tlv::SignatureValue,
+                                          signatureValue, sizeof(signatureValue)));
+    data.wireEncode();
+    return data;
+  }
+
+public:
+  fs::path path;
+  ndn::PublicKey publicKey;
+  ndn::KeyChain keyChain;
+  CryptoPP::AutoSeededRandomPool rng;
+};
+
+BOOST_FIXTURE_TEST_SUITE(TestCertificateStore, CertificateStoreFixture)
+
+BOOST_AUTO_TEST_CASE(Persistence)
+{
+  Signer anchor = makeSigner("/ndn/KEY/ksk-1/ID-CERT/%FD%01", nullptr);
+  Signer alice = makeSigner("/ndn/alice/KEY/ksk-1/ID-CERT/%FD%01", &anchor);
+  Signer bob = makeSigner("/ndn/bob/KEY/ksk-1/ID-CERT/%FD%01", &alice);
+  Name expiredName("/ndn/carol/KEY/ksk-1/ID-CERT/%FD%01");
+
+  {
+    CertificateStore store(path.string(), anchor.certificate);
+    // the chain is stored in any order
+    store.insertCertificate(bob.certificate);
+    store.insertCertificate(alice.certificate);
+    // a certificate is kept until the end of its validity period only
+    store.insertCertificate(makeCertificate(expiredName, -time::minutes(1)));
+
+    BOOST_CHECK_EQUAL(store.getSize(), 2);
+    BOOST_REQUIRE(store.getCertificate(alice.name.getPrefix(-1)) != nullptr);
+    BOOST_CHECK_EQUAL(store.getCertificate(alice.name.getPrefix(-1))->getName(), alice.name);
+    BOOST_CHECK(store.getCertificate(expiredName.getPrefix(-1)) == nullptr);
+  }
+
+  // the next start does not fetch the certificates again
+  CertificateStore store(path.string(), anchor.certificate);
+  BOOST_CHECK_EQUAL(store.getSize(), 2);
+  BOOST_REQUIRE(store.getCertificate(bob.name.getPrefix(-1)) != nullptr);
+  BOOST_CHECK(store.getCertificate(bob.name.getPrefix(-1))->getPublicKeyInfo().get() ==
+              bob.certificate->getPublicKeyInfo().get());
+
+  store.reset();
+  BOOST_CHECK_EQUAL(store.getSize(), 0);
+  BOOST_CHECK_EQUAL(CertificateStore(path.string(), anchor.certificate).getSize(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(UntrustedDatabase)
+{
+  Signer anchor = makeSigner("/ndn/KEY/ksk-1/ID-CERT/%FD%01", nullptr);
+  Signer alice = makeSigner("/ndn/alice/KEY/ksk-1/ID-CERT/%FD%01", &anchor);
+  Signer mallory = makeSigner("/ndn/mallory/KEY/ksk-1/ID-CERT/%FD%01", nullptr);
+  Signer eve = makeSigner("/ndn/eve/KEY/ksk-1/ID-CERT/%FD%01", &mallory);
+
+  {
+    // e.g., written by another validator
+    CertificateStore store(path.string(), anchor.certificate);
+    store.insertCertificate(alice.certificate);
+    store.insertCertificate(eve.certificate);
+    store.insertCertificate(makeCertificate("/ndn/bob/KEY/ksk-1/ID-CERT/%FD%01",
+                                            time::hours(1)));
+    BOOST_CHECK_EQUAL(store.getSize(), 3);
+  }
+
+  // only the certificates which chain up to the anchor are loaded
+  {
+    CertificateStore store(path.string(), anchor.certificate);
+    BOOST_CHECK_EQUAL(store.getSize(), 1);
+    BOOST_CHECK(store.getCertificate(alice.name.getPrefix(-1)) != nullptr);
+  }
+
+  // a store of another anchor trusts none of them
+  CertificateStore store(path.string(), mallory.certificate);
+  BOOST_CHECK_EQUAL(store.getSize(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(VerifiedData)
+{
+  CertificateStore store(2);
+  Name aliceName("/alice/KEY/ksk-1/ID-CERT");
+  Name bobName("/bob/KEY/ksk-1/ID-CERT");
+  store.insertCertificate(makeCertificate(Name(aliceName).appendVersion(), time::hours(1)));
+
+  Data data = makeData("/alice/chat/1", aliceName);
+  BOOST_CHECK(!store.isVerified(data));
+  store.addVerified(data);
+  BOOST_CHECK(store.isVerified(data));
+
+  // the digest covers the whole packet
+  Data other = makeData("/alice/chat/2", aliceName);
+  BOOST_CHECK(!store.isVerified(other));
+
+  // the signer has to be known
+  Data bobData = makeData("/bob/chat/1", bobName);
+  store.addVerified(bobData);
+  BOOST_CHECK(!store.isVerified(bobData));
+
+  // the oldest results are dropped first
+  store.addVerified(other);
+  BOOST_CHECK(!store.isVerified(data));
+  BOOST_CHECK(store.isVerified(other));
+
+  store.reset();
+  BOOST_CHECK(!store.isVerified(other));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace tests
+} // namespace chronochat
@@ -0,0 +1,113 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include "chat-content.hpp"
+#include "chat-message-bundle.hpp"
+
+namespace chronochat {
+namespace tests {
+
+BOOST_AUTO_TEST_SUITE(TestChatContent)
+
+static ChatMessage
+makeMessage(const std::string& data)
+{
+  ChatMessage msg;
+  msg.setNick("alice");
+  msg.setChatroomName("room");
+  msg.setMsgType(ChatMessage::CHAT);
+  msg.setTimestamp(100);
+  msg.setData(data);
+  return msg;
+}
+
+BOOST_AUTO_TEST_CASE(Legacy)
+{
+  ChatMessage msg = makeMessage("hello");
+  BOOST_CHECK(ChatContent::isLegacy(msg));
+
+  Block content = ChatContent::encodeLegacy(msg.wireEncode());
+  BOOST_CHECK_EQUAL(content.type(), static_cast<uint32_t>(ndn::tlv::Content));
+
+  // the first release takes the message from the content like this
+  Block msgWire = content.blockFromValue();
+  BOOST_CHECK(msgWire == msg.wireEncode());
+
+  Block payload = ChatContent::decode(content);
+  BOOST_CHECK(payload == msg.wireEncode());
+
+  msg.removeNick();
+  BOOST_CHECK(!ChatContent::isLegacy(msg));
+  msg = makeMessage("hello");
+  msg.setPreciseTimestamp(time::system_clock::now());
+  BOOST_CHECK(!ChatContent::isLegacy(msg));
+  msg = makeMessage("hello");
+  msg.setMsgType(ChatMessage::FILE);
+  BOOST_CHECK(!ChatContent::isLegacy(msg));
+  msg = makeMessage("hello");
+  msg.setMsgType(ChatMessage::HELLO);
+  msg.setHelloInterval(time::seconds(90));
+  BOOST_CHECK(!ChatContent::isLegacy(msg));
+}
+
+BOOST_AUTO_TEST_CASE(Versioned)
+{
+  ChatMessageBundle bundle;
+  bundle.addMessage(makeMessage("first"));
+  bundle.addMessage(makeMessage("second"));
+
+  Block content = ChatContent::encode(bundle.wireEncode());
+  BOOST_CHECK_EQUAL(content.type(), static_cast<uint32_t>(ndn::tlv::Content));
+
+  Block payload = ChatContent::decode(content);
+  BOOST_CHECK(payload == bundle.wireEncode());
+
+  ChatMessageBundle decodedBundle(payload);
+  BOOST_CHECK_EQUAL(decodedBundle.size(), 2);
+
+  // The first release drops content which throws tlv::Error, any other error stops its
+  // face.  It cannot take one element from the versioned content.
+  BOOST_CHECK_THROW(content.blockFromValue(), ndn::tlv::Error);
+
+  ChatMessage compact = makeMessage("compact");
+  compact.removeNick();
+  compact.removeChatroomName();
+  BOOST_CHECK_THROW(ChatContent::encode(compact.wireEncode()).blockFromValue(),
+                    ndn::tlv::Error);
+}
+
+BOOST_AUTO_TEST_CASE(DecodeError)
+{
+  const uint8_t laterVersion[] = {
+    0x15, 0x05, // Content
+      0xa4, 0x01, 0x02, // ContentVersion
+      0x80, 0x00,
+  };
+  BOOST_CHECK_THROW(ChatContent::decode(Block(laterVersion, sizeof(laterVersion))),
+                    ChatContent::Error);
+
+  const uint8_t noPayload[] = {
+    0x15, 0x03,
+      0xa4, 0x01, 0x01,
+  };
+  BOOST_CHECK_THROW(ChatContent::decode(Block(noPayload, sizeof(noPayload))),
+                    ChatContent::Error);
+
+  const uint8_t empty[] = {
+    0x15, 0x00,
+  };
+  BOOST_CHECK_THROW(ChatContent::decode(Block(empty, sizeof(empty))),
+                    ChatContent::Error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace tests
+} // namespace chronochat
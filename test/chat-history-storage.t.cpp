@@ -0,0 +1,186 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include "chat-history-storage.hpp"
+#include <boost/filesystem.hpp>
+
+namespace chronochat {
+namespace tests {
+
+namespace fs = boost::filesystem;
+
+class ChatHistoryFixture
+{
+public:
+  ChatHistoryFixture()
+    : userChatPrefix("/TestChatHistoryStorage/alice/CHRONOCHAT-CHATROOM/room")
+    , session("/TestChatHistoryStorage/alice/session")
+  {
+    fs::remove(getDBPath());
+  }
+
+  ~ChatHistoryFixture()
+  {
+    fs::remove(getDBPath());
+    fs::remove(getDBPath().string() + "-wal");
+    fs::remove(getDBPath().string() + "-shm");
+  }
+
+  fs::path
+  getDBPath()
+  {
+    return fs::path(getenv("HOME")) / ".chronos" / "history" /
+      ChatHistoryStorage::getDBName(userChatPrefix);
+  }
+
+  ChatMessage
+  makeMessage(ChatMessage::ChatMessageType type, time_t timestamp, const std::string& data)
+  {
+    ChatMessage msg;
+    msg.setNick("alice");
+    msg.setChatroomName("room");
+    msg.setMsgType(type);
+    msg.setTimestamp(timestamp);
+    if (type == ChatMessage::CHAT)
+      msg.setData(data);
+    return msg;
+  }
+
+public:
+  Name userChatPrefix;
+  Name session;
+};
+
+BOOST_FIXTURE_TEST_SUITE(TestChatHistoryStorage, ChatHistoryFixture)
+
+BOOST_AUTO_TEST_CASE(BatchedWrite)
+{
+  ChatHistoryStorage storage(userChatPrefix, 3);
+  BOOST_CHECK(fs::exists(getDBPath()));
+
+  storage.addMessage(session, 1, makeMessage(ChatMessage::JOIN, 100, ""));
+  storage.addMessage(session, 2, makeMessage(ChatMessage::CHAT, 101, "hello"));
+  BOOST_CHECK_EQUAL(storage.getNPendingMessages(), 2);
+  BOOST_CHECK(storage.hasMessage(session, 2));
+
+  // a second connection does not see buffered messages
+  {
+    ChatHistoryStorage reader(userChatPrefix);
+    std::vector<ChatHistoryEntry> entries;
+    reader.getMessagesBefore(nullptr, 10, entries);
+    BOOST_CHECK(entries.empty());
+  }
+
+  storage.addMessage(session, 3, makeMessage(ChatMessage::CHAT, 102, "world"));
+  BOOST_CHECK_EQUAL(storage.getNPendingMessages(), 0);
+
+  // duplicates are ignored
+  storage.addMessage(session, 3, makeMessage(ChatMessage::CHAT, 102, "world"));
+  storage.flush();
+
+  ChatHistoryStorage reader(userChatPrefix);
+  BOOST_CHECK(reader.hasMessage(session, 3));
+  BOOST_CHECK(!reader.hasMessage(session, 4));
+
+  // buffered and written messages are looked up together
+  storage.addMessage(session, 5, makeMessage(ChatMessage::CHAT, 103, "again"));
+  std::vector<std::pair<Name, uint64_t>> messages;
+  for (uint64_t seqNo = 1; seqNo <= 600; seqNo++)
+    messages.push_back(std::make_pair(session, seqNo));
+  messages.push_back(std::make_pair(Name("/TestChatHistoryStorage/bob/session"), 1));
+  std::vector<bool> exists = storage.hasMessages(messages);
+  BOOST_REQUIRE_EQUAL(exists.size(), messages.size());
+  for (size_t i = 0; i < messages.size(); i++) {
+    uint64_t seqNo = messages[i].second;
+    bool isStored = messages[i].first == session && (seqNo <= 3 || seqNo == 5);
+    BOOST_CHECK_EQUAL(static_cast<bool>(exists[i]), isStored);
+  }
+
+  std::vector<ChatHistoryEntry> entries;
+  reader.getMessagesBefore(nullptr, 10, entries);
+  BOOST_REQUIRE_EQUAL(entries.size(), 3);
+  BOOST_CHECK_EQUAL(entries[0].msgType, ChatMessage::JOIN);
+  BOOST_CHECK_EQUAL(entries[1].data, "hello");
+  BOOST_CHECK_EQUAL(entries[2].data, "world");
+  BOOST_CHECK_EQUAL(entries[2].sessionPrefix, session);
+  BOOST_CHECK_EQUAL(entries[2].seqNo, 3);
+  BOOST_CHECK_EQUAL(entries[2].nick, "alice");
+}
+
+BOOST_AUTO_TEST_CASE(Paging)
+{
+  ChatHistoryStorage storage(userChatPrefix);
+
+  // messages with the same timestamp are ordered by arrival
+  for (uint64_t seqNo = 1; seqNo <= 10; seqNo++) {
+    storage.addMessage(session, seqNo,
+                       makeMessage(ChatMessage::CHAT, 100 + seqNo / 2,
+                                   boost::lexical_cast<std::string>(seqNo)));
+    storage.addMessage(session, seqNo + 100, makeMessage(ChatMessage::HELLO, 100 + seqNo, ""));
+  }
+  storage.flush();
+
+  std::vector<ChatHistoryEntry> entries;
+  storage.getMessagesBefore(nullptr, 4, entries);
+  BOOST_REQUIRE_EQUAL(entries.size(), 4);
+  BOOST_CHECK_EQUAL(entries[0].data, "7");
+  BOOST_CHECK_EQUAL(entries[3].data, "10");
+
+  ChatHistoryEntry last = entries[0];
+  storage.getMessagesBefore(&last, 4, entries);
+  BOOST_REQUIRE_EQUAL(entries.size(), 4);
+  BOOST_CHECK_EQUAL(entries[0].data, "3");
+  BOOST_CHECK_EQUAL(entries[3].data, "6");
+
+  last = entries[0];
+  storage.getMessagesBefore(&last, 4, entries);
+  BOOST_REQUIRE_EQUAL(entries.size(), 2);
+  BOOST_CHECK_EQUAL(entries[0].data, "1");
+  BOOST_CHECK_EQUAL(entries[1].data, "2");
+
+  // and forward again
+  ChatHistoryEntry first = entries[1];
+  storage.getMessagesAfter(first, 4, entries);
+  BOOST_REQUIRE_EQUAL(entries.size(), 4);
+  BOOST_CHECK_EQUAL(entries[0].data, "3");
+  BOOST_CHECK_EQUAL(entries[3].data, "6");
+
+  first = entries[3];
+  storage.getMessagesAfter(first, 10, entries);
+  BOOST_REQUIRE_EQUAL(entries.size(), 4);
+  BOOST_CHECK_EQUAL(entries[0].data, "7");
+  BOOST_CHECK_EQUAL(entries[3].data, "10");
+}
+
+BOOST_AUTO_TEST_CASE(Bundle)
+{
+  ChatHistoryStorage storage(userChatPrefix);
+
+  // the messages of a bundle share the sequence number
+  storage.addMessage(session, 1, makeMessage(ChatMessage::CHAT, 100, "first"), true, 0);
+  storage.addMessage(session, 1, makeMessage(ChatMessage::CHAT, 100, "second"), true, 1);
+  storage.addMessage(session, 1, makeMessage(ChatMessage::CHAT, 100, "second"), true, 1);
+  storage.flush();
+
+  BOOST_CHECK(storage.hasMessage(session, 1));
+
+  std::vector<ChatHistoryEntry> entries;
+  storage.getMessagesBefore(nullptr, 10, entries);
+  BOOST_REQUIRE_EQUAL(entries.size(), 2);
+  BOOST_CHECK_EQUAL(entries[0].data, "first");
+  BOOST_CHECK_EQUAL(entries[1].data, "second");
+  BOOST_CHECK_EQUAL(entries[1].seqNo, 1);
+  BOOST_CHECK_EQUAL(entries[1].bundleIndex, 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace tests
+} // namespace chronochat
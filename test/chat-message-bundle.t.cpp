@@ -0,0 +1,85 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include "chat-message-bundle.hpp"
+
+namespace chronochat {
+namespace tests {
+
+BOOST_AUTO_TEST_SUITE(TestChatMessageBundle)
+
+static ChatMessage
+makeMessage(ChatMessage::ChatMessageType type, const std::string& data)
+{
+  ChatMessage msg;
+  msg.setNick("alice");
+  msg.setChatroomName("room");
+  msg.setMsgType(type);
+  msg.setTimestamp(100);
+  if (type == ChatMessage::CHAT)
+    msg.setData(data);
+  return msg;
+}
+
+BOOST_AUTO_TEST_CASE(EncodeDecode)
+{
+  ChatMessageBundle bundle;
+  bundle.addMessage(makeMessage(ChatMessage::CHAT, "first"));
+  bundle.addMessage(makeMessage(ChatMessage::CHAT, "second"));
+  bundle.addMessage(makeMessage(ChatMessage::LEAVE, ""));
+
+  Block wire = bundle.wireEncode();
+  BOOST_CHECK_EQUAL(wire.type(), static_cast<uint32_t>(tlv::ChatMessageBundle));
+
+  ChatMessageBundle decodedBundle;
+  {
+    // the messages keep the wire alive
+    ChatMessageBundle temporary(wire);
+    decodedBundle = temporary;
+  }
+  wire = Block();
+
+  BOOST_REQUIRE_EQUAL(decodedBundle.size(), 3);
+  const std::vector<ChatMessage>& messages = decodedBundle.getMessages();
+  BOOST_CHECK_EQUAL(messages[0].getDataView(), "first");
+  BOOST_CHECK_EQUAL(messages[1].getDataView(), "second");
+  BOOST_CHECK_EQUAL(messages[1].getNick(), "alice");
+  BOOST_CHECK_EQUAL(messages[2].getMsgType(), ChatMessage::LEAVE);
+
+  // the messages are encoded as they were received
+  Block reencoded = decodedBundle.wireEncode();
+  BOOST_CHECK_EQUAL(reencoded.size(), bundle.wireEncode().size());
+
+  decodedBundle.clear();
+  BOOST_CHECK(decodedBundle.empty());
+}
+
+BOOST_AUTO_TEST_CASE(DecodeError)
+{
+  const uint8_t empty[] = {
+    0x9a, 0x00, // ChatMessageBundle
+  };
+  BOOST_CHECK_THROW(ChatMessageBundle(Block(empty, sizeof(empty))), ChatMessageBundle::Error);
+
+  const uint8_t notAMessage[] = {
+    0x9a, 0x03,
+      0x87, 0x01, 0x71, // Nick
+  };
+  BOOST_CHECK_THROW(ChatMessageBundle(Block(notAMessage, sizeof(notAMessage))),
+                    ChatMessageBundle::Error);
+
+  ChatMessage msg = makeMessage(ChatMessage::HELLO, "");
+  BOOST_CHECK_THROW(ChatMessageBundle(msg.wireEncode()), ChatMessageBundle::Error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace tests
+} // namespace chronochat
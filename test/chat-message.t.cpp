@@ -11,6 +11,9 @@
 
 #include "chat-message.hpp"
 #include <ndn-cxx/encoding/buffer-stream.hpp>
+#include <ndn-cxx/encoding/block-helpers.hpp>
+
+#include <limits>
 
 namespace chronochat{
 namespace tests{
@@ -19,6 +22,53 @@ using std::string;
 
 BOOST_AUTO_TEST_SUITE(TestChatMessage)
 
+// what the decoder of the first release throws, which is not a tlv::Error
+class BaselineError : public std::runtime_error
+{
+public:
+  explicit
+  BaselineError(const std::string& what)
+    : std::runtime_error(what)
+  {
+  }
+};
+
+// the decoder of the first release, which takes the elements in a fixed order
+static void
+decodeWithBaselineSchema(const Block& wire)
+{
+  wire.parse();
+  if (wire.type() != tlv::ChatMessage)
+    throw BaselineError("Unexpected TLV number when decoding chat message packet");
+
+  Block::element_const_iterator i = wire.elements_begin();
+  if (i == wire.elements_end() || i->type() != tlv::Nick)
+    throw BaselineError("Expect Nick but get ...");
+  i++;
+
+  if (i == wire.elements_end() || i->type() != tlv::ChatroomName)
+    throw BaselineError("Expect Chatroom Name but get ...");
+  i++;
+
+  if (i == wire.elements_end() || i->type() != tlv::ChatMessageType)
+    throw BaselineError("Expect Chat Message Type but get ...");
+  uint64_t msgType = ndn::readNonNegativeInteger(*i);
+  i++;
+
+  if (msgType == ChatMessage::CHAT) {
+    if (i == wire.elements_end() || i->type() != tlv::ChatData)
+      throw BaselineError("Expect Chat Data but get ...");
+    i++;
+  }
+
+  if (i == wire.elements_end() || i->type() != tlv::Timestamp)
+    throw BaselineError("Expect Timestamp but get ...");
+  i++;
+
+  if (i != wire.elements_end())
+    throw BaselineError("Unexpected element");
+}
+
 BOOST_AUTO_TEST_CASE(EncodeDecode)
 {
   string nick("qiuhan");
@@ -59,7 +109,177 @@ BOOST_AUTO_TEST_CASE(EncodeDecode)
   BOOST_CHECK_EQUAL(decodedChatMsg.getTimestamp(), seconds);
   BOOST_CHECK_EQUAL(decodedChatMsg.getData(), data);
   BOOST_CHECK_EQUAL(decodedChatMsg.getMsgType(), ChatMessage::ChatMessageType::CHAT);
+  BOOST_CHECK_EQUAL(decodedChatMsg.hasPreciseTimestamp(), false);
+
+}
+
+BOOST_AUTO_TEST_CASE(PreciseTimestamp)
+{
+  time::system_clock::TimePoint now = time::system_clock::now();
+
+  ChatMessage msg;
+  msg.setNick("qiuhan");
+  msg.setChatroomName("test");
+  msg.setTimestamp(time::toUnixTimestamp(now).count() / 1000);
+  msg.setPreciseTimestamp(now);
+  msg.setMsgType(ChatMessage::ChatMessageType::HELLO);
+
+  ChatMessage decodedMsg;
+  BOOST_REQUIRE_NO_THROW(decodedMsg.wireDecode(msg.wireEncode()));
+
+  BOOST_REQUIRE(decodedMsg.hasPreciseTimestamp());
+  BOOST_CHECK_EQUAL(time::toUnixTimestamp(decodedMsg.getPreciseTimestamp()).count(),
+                    time::toUnixTimestamp(now).count());
+  BOOST_CHECK_EQUAL(decodedMsg.getTimestamp(), msg.getTimestamp());
+}
+
+BOOST_AUTO_TEST_CASE(HelloInterval)
+{
+  ChatMessage msg;
+  msg.setNick("qiuhan");
+  msg.setChatroomName("test");
+  msg.setTimestamp(1000);
+  msg.setMsgType(ChatMessage::ChatMessageType::HELLO);
+
+  ChatMessage decodedMsg(msg.wireEncode());
+  BOOST_CHECK(!decodedMsg.hasHelloInterval());
+
+  msg.setHelloInterval(time::seconds(90));
+  decodedMsg.wireDecode(msg.wireEncode());
+  BOOST_REQUIRE(decodedMsg.hasHelloInterval());
+  BOOST_CHECK_EQUAL(decodedMsg.getHelloInterval().count(), 90000);
+
+  // only sent to the sessions which announced it
+  BOOST_CHECK_THROW(decodeWithBaselineSchema(msg.wireEncode()), BaselineError);
+}
+
+BOOST_AUTO_TEST_CASE(BaselineSchema)
+{
+  ChatMessage msg;
+  msg.setNick("qiuhan");
+  msg.setChatroomName("test");
+  msg.setTimestamp(1000);
+  msg.setData("This is for testing");
+  msg.setMsgType(ChatMessage::ChatMessageType::CHAT);
+
+  // what is sent to a room with a session of the first release
+  BOOST_CHECK_NO_THROW(decodeWithBaselineSchema(msg.wireEncode()));
+  msg.setMsgType(ChatMessage::ChatMessageType::HELLO);
+  BOOST_CHECK_NO_THROW(decodeWithBaselineSchema(msg.wireEncode()));
+
+  // The first release only drops messages which throw tlv::Error, any other error stops its
+  // face.  This is why the extensions are only sent to the sessions which announced them.
+  msg.setPreciseTimestamp(time::system_clock::now());
+  BOOST_CHECK_THROW(decodeWithBaselineSchema(msg.wireEncode()), BaselineError);
+
+  msg.setMsgType(ChatMessage::ChatMessageType::CHAT);
+  msg.removeNick();
+  BOOST_CHECK_THROW(decodeWithBaselineSchema(msg.wireEncode()), BaselineError);
+}
+
+BOOST_AUTO_TEST_CASE(DecodeView)
+{
+  ChatMessage msg;
+  msg.setNick("qiuhan");
+  msg.setChatroomName("test");
+  msg.setTimestamp(1000);
+  msg.setData("This is for testing");
+  msg.setMsgType(ChatMessage::ChatMessageType::CHAT);
+  Block wire = msg.wireEncode();
+
+  ChatMessage decodedMsg(wire, ChatMessage::DECODE_VIEW);
+  ChatMessage copiedMsg = decodedMsg;
+
+  // the views point into the wire
+  BOOST_CHECK_EQUAL(decodedMsg.getNickView(), StringRef("qiuhan"));
+  BOOST_CHECK_EQUAL(decodedMsg.getChatroomNameView(), StringRef("test"));
+  BOOST_CHECK_EQUAL(decodedMsg.getDataView(), StringRef("This is for testing"));
+  BOOST_CHECK(decodedMsg.getNickView().data() >= reinterpret_cast<const char*>(wire.wire()));
+  BOOST_CHECK(decodedMsg.getDataView().data() <
+              reinterpret_cast<const char*>(wire.wire() + wire.size()));
+  BOOST_CHECK(decodedMsg.wireEncode() == wire);
+
+  // strings are made on demand, and modifying the message does not affect its copies
+  BOOST_CHECK_EQUAL(decodedMsg.getNick(), "qiuhan");
+  decodedMsg.setNick("yingdi");
+  BOOST_CHECK_EQUAL(decodedMsg.getNickView(), StringRef("yingdi"));
+  BOOST_CHECK_EQUAL(decodedMsg.getDataView(), StringRef("This is for testing"));
+  BOOST_CHECK_EQUAL(copiedMsg.getNickView(), StringRef("qiuhan"));
+
+  ChatMessage reencodedMsg(decodedMsg.wireEncode(), ChatMessage::DECODE_VIEW);
+  BOOST_CHECK_EQUAL(reencodedMsg.getNick(), "yingdi");
+  BOOST_CHECK_EQUAL(reencodedMsg.getData(), "This is for testing");
+}
+
+BOOST_AUTO_TEST_CASE(Compact)
+{
+  ChatMessage msg;
+  msg.setNick("qiuhan");
+  msg.setChatroomName("test");
+  msg.setTimestamp(1000);
+  msg.setData("This is for testing");
+  msg.setMsgType(ChatMessage::ChatMessageType::CHAT);
+  size_t fullSize = msg.wireEncode().size();
+
+  msg.removeNick();
+  msg.removeChatroomName();
+  BOOST_CHECK_EQUAL(msg.wireEncode().size(), fullSize - 8 - 6);
+
+  ChatMessage decodedMsg(msg.wireEncode(), ChatMessage::DECODE_VIEW);
+  BOOST_CHECK(!decodedMsg.hasNick());
+  BOOST_CHECK(!decodedMsg.hasChatroomName());
+  BOOST_CHECK(decodedMsg.getNickView().empty());
+  BOOST_CHECK_EQUAL(decodedMsg.getData(), "This is for testing");
+
+  // a hello only carries the nick
+  ChatMessage hello;
+  hello.setNick("qiuhan");
+  hello.removeChatroomName();
+  hello.setTimestamp(1000);
+  hello.setMsgType(ChatMessage::ChatMessageType::HELLO);
+
+  decodedMsg.wireDecode(hello.wireEncode());
+  BOOST_CHECK(decodedMsg.hasNick());
+  BOOST_CHECK(!decodedMsg.hasChatroomName());
+  BOOST_CHECK_EQUAL(decodedMsg.getNick(), "qiuhan");
+}
+
+BOOST_AUTO_TEST_CASE(FileMessage)
+{
+  FileManifest manifest;
+  manifest.setPrefix(Name("/ndn/qiuhan/test/123/file/0"));
+  manifest.setFileName("notes.txt");
+  manifest.setFileSize(10000);
+  manifest.setSegmentSize(4096);
+  BOOST_CHECK_EQUAL(manifest.getNSegments(), 3);
+
+  ChatMessage msg;
+  msg.setNick("qiuhan");
+  msg.setChatroomName("test");
+  msg.setTimestamp(1000);
+  msg.setMsgType(ChatMessage::ChatMessageType::FILE);
+  msg.setFileManifest(manifest);
+
+  ChatMessage decodedMsg(msg.wireEncode(), ChatMessage::DECODE_VIEW);
+  BOOST_CHECK_EQUAL(decodedMsg.getMsgType(), ChatMessage::ChatMessageType::FILE);
+  BOOST_CHECK(decodedMsg.getDataView().empty());
+
+  const FileManifest& decodedManifest = decodedMsg.getFileManifest();
+  BOOST_CHECK_EQUAL(decodedManifest.getPrefix(), manifest.getPrefix());
+  BOOST_CHECK_EQUAL(decodedManifest.getFileName(), "notes.txt");
+  BOOST_CHECK_EQUAL(decodedManifest.getFileSize(), 10000);
+  BOOST_CHECK_EQUAL(decodedManifest.getSegmentSize(), 4096);
+
+  // other messages do not carry a manifest
+  msg.setMsgType(ChatMessage::ChatMessageType::HELLO);
+  decodedMsg.wireDecode(msg.wireEncode());
+  BOOST_CHECK_EQUAL(decodedMsg.getFileManifest().getFileSize(), 0);
 
+  // the number of segments of a received manifest cannot overflow
+  manifest.setFileSize(std::numeric_limits<uint64_t>::max() - 4094);
+  BOOST_CHECK_THROW(FileManifest(manifest.wireEncode()), FileManifest::Error);
+  manifest.setFileSize(std::numeric_limits<uint64_t>::max() - 4095);
+  BOOST_CHECK_NO_THROW(FileManifest(manifest.wireEncode()));
 }
 
 BOOST_AUTO_TEST_SUITE_END()
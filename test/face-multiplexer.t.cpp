@@ -0,0 +1,206 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#include "face-multiplexer.hpp"
+
+#include <boost/test/unit_test.hpp>
+
+#include "loopback-forwarder.hpp"
+
+namespace chronochat {
+namespace tests {
+
+class FaceMultiplexerFixture
+{
+public:
+  FaceMultiplexerFixture()
+    : forwarder(ioService)
+    , nUplinks(0)
+    , multiplexer(ioService, [this] (boost::asio::io_service&) {
+        nUplinks++;
+        return forwarder.makeFace();
+      })
+    , consumer(forwarder.makeFace())
+  {
+  }
+
+  void
+  advance(const time::milliseconds& duration)
+  {
+    clock.advance(ioService, time::milliseconds(1), duration.count());
+  }
+
+  /// @brief make a client which counts the Interests of @p prefix
+  shared_ptr<ndn::Face>
+  makeProducer(const Name& prefix, size_t& nInterests)
+  {
+    shared_ptr<ndn::Face> face = multiplexer.makeFace();
+    face->setInterestFilter(prefix,
+                            [&nInterests] (const Name& prefix, const Interest& interest) {
+                              nInterests++;
+                            },
+                            [] (const Name& prefix, const std::string& reason) {
+                              BOOST_FAIL("Cannot register prefix");
+                            });
+    return face;
+  }
+
+  void
+  express(const Name& name)
+  {
+    consumer->expressInterest(Interest(name),
+                              [] (const Interest& interest, const Data& data) {},
+                              [] (const Interest& interest) {});
+  }
+
+public:
+  VirtualClock clock;
+  boost::asio::io_service ioService;
+  LoopbackForwarder forwarder;
+  size_t nUplinks;
+  FaceMultiplexer multiplexer;
+  shared_ptr<ndn::Face> consumer;        // connected to the forwarder by itself
+};
+
+BOOST_FIXTURE_TEST_SUITE(TestFaceMultiplexer, FaceMultiplexerFixture)
+
+BOOST_AUTO_TEST_CASE(SharedConnection)
+{
+  size_t nInterestsA = 0;
+  size_t nInterestsB = 0;
+  shared_ptr<ndn::Face> faceA = makeProducer("/a", nInterestsA);
+  shared_ptr<ndn::Face> faceB = makeProducer("/b", nInterestsB);
+  advance(time::milliseconds(10));
+
+  BOOST_CHECK_EQUAL(nUplinks, 1);
+  BOOST_CHECK_EQUAL(multiplexer.getNClients(), 2);
+  BOOST_CHECK_EQUAL(multiplexer.getNRegisteredPrefixes(), 2);
+
+  express("/a/1");
+  express("/b/1");
+  express("/b/2");
+  advance(time::milliseconds(10));
+
+  // every client only gets the Interests of its own prefix
+  BOOST_CHECK_EQUAL(nInterestsA, 1);
+  BOOST_CHECK_EQUAL(nInterestsB, 2);
+}
+
+BOOST_AUTO_TEST_CASE(ShutdownWithdrawsOwnPrefixes)
+{
+  size_t nInterestsA = 0;
+  size_t nInterestsB = 0;
+  shared_ptr<ndn::Face> faceA = makeProducer("/a", nInterestsA);
+  shared_ptr<ndn::Face> faceB = makeProducer("/b", nInterestsB);
+  advance(time::milliseconds(10));
+
+  faceA->shutdown();
+  advance(time::milliseconds(10));
+
+  BOOST_CHECK_EQUAL(multiplexer.getNClients(), 1);
+  BOOST_CHECK_EQUAL(multiplexer.getNRegisteredPrefixes(), 1);
+
+  express("/a/1");
+  express("/b/1");
+  advance(time::milliseconds(10));
+
+  BOOST_CHECK_EQUAL(nInterestsA, 0);
+  BOOST_CHECK_EQUAL(nInterestsB, 1);
+  BOOST_CHECK_EQUAL(nUplinks, 1);
+}
+
+BOOST_AUTO_TEST_CASE(SharedPrefix)
+{
+  size_t nInterestsA = 0;
+  size_t nInterestsB = 0;
+  shared_ptr<ndn::Face> faceA = multiplexer.makeFace();
+  const ndn::RegisteredPrefixId* prefixIdA =
+    faceA->setInterestFilter("/shared",
+                             [&nInterestsA] (const Name& prefix, const Interest& interest) {
+                               nInterestsA++;
+                             },
+                             [] (const Name& prefix, const std::string& reason) {});
+  shared_ptr<ndn::Face> faceB = makeProducer("/shared", nInterestsB);
+  advance(time::milliseconds(10));
+
+  BOOST_CHECK_EQUAL(multiplexer.getNRegisteredPrefixes(), 1);
+
+  // the prefix stays registered for the other client
+  faceA->unsetInterestFilter(prefixIdA);
+  advance(time::milliseconds(10));
+  BOOST_CHECK_EQUAL(multiplexer.getNRegisteredPrefixes(), 1);
+
+  express("/shared/1");
+  advance(time::milliseconds(10));
+  BOOST_CHECK_EQUAL(nInterestsA, 0);
+  BOOST_CHECK_EQUAL(nInterestsB, 1);
+
+  faceB->shutdown();
+  advance(time::milliseconds(10));
+  BOOST_CHECK_EQUAL(multiplexer.getNRegisteredPrefixes(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(LocalDelivery)
+{
+  shared_ptr<ndn::Face> producer = multiplexer.makeFace();
+  producer->setInterestFilter("/producer",
+                              [&] (const Name& prefix, const Interest& interest) {
+                                Data data(interest.getName());
+                                ndn::KeyChain keyChain;
+                                keyChain.signWithSha256(data);
+                                producer->put(data);
+                              },
+                              [] (const Name& prefix, const std::string& reason) {});
+  advance(time::milliseconds(10));
+
+  // the forwarder would not send the Interest back to the uplink it came from
+  shared_ptr<ndn::Face> face = multiplexer.makeFace();
+  size_t nData = 0;
+  face->expressInterest(Interest("/producer/a"),
+                        [&nData] (const Interest& interest, const Data& data) { nData++; },
+                        [] (const Interest& interest) {});
+  advance(time::milliseconds(10));
+
+  BOOST_CHECK_EQUAL(nData, 1);
+}
+
+BOOST_AUTO_TEST_CASE(Reset)
+{
+  size_t nInterests = 0;
+  shared_ptr<ndn::Face> face = makeProducer("/a", nInterests);
+  advance(time::milliseconds(10));
+
+  multiplexer.reset();
+  advance(time::milliseconds(10));
+  BOOST_CHECK_EQUAL(multiplexer.getNClients(), 0);
+  BOOST_CHECK_EQUAL(multiplexer.getNRegisteredPrefixes(), 0);
+
+  express("/a/1");
+  advance(time::milliseconds(10));
+  BOOST_CHECK_EQUAL(nInterests, 0);
+
+  // the client connects to a new uplink, and registers again
+  face->setInterestFilter("/a",
+                          [&nInterests] (const Name& prefix, const Interest& interest) {
+                            nInterests++;
+                          },
+                          [] (const Name& prefix, const std::string& reason) {
+                            BOOST_FAIL("Cannot register prefix");
+                          });
+  advance(time::milliseconds(10));
+
+  express("/a/2");
+  advance(time::milliseconds(10));
+  BOOST_CHECK_EQUAL(nInterests, 1);
+  BOOST_CHECK_EQUAL(nUplinks, 2);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace tests
+} // namespace chronochat
@@ -0,0 +1,222 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include "file-fetcher.hpp"
+#include "file-publisher.hpp"
+
+#include <fstream>
+#include <iterator>
+#include <boost/filesystem.hpp>
+
+namespace chronochat {
+namespace tests {
+
+namespace fs = boost::filesystem;
+
+class FileFetcherFixture
+{
+public:
+  struct Request
+  {
+    Name segmentName;
+    FileFetcher::DataCallback onData;
+    FileFetcher::TimeoutCallback onTimeout;
+  };
+
+  FileFetcherFixture()
+    : sourcePath(fs::temp_directory_path() / fs::unique_path())
+    , path(fs::temp_directory_path() / fs::unique_path())
+    , publisher([] (Data& data) {}, 10)
+    , isComplete(false)
+  {
+    std::ofstream os(sourcePath.c_str(), std::ios::binary);
+    for (int i = 0; i < 1000; i++)
+      os << static_cast<char>(i % 251);
+  }
+
+  ~FileFetcherFixture()
+  {
+    fetcher.reset();
+    publisher.clear();
+    fs::remove(sourcePath);
+    fs::remove(path);
+  }
+
+  void
+  makeFetcher(const FileManifest& manifest)
+  {
+    fetcher.reset(new FileFetcher(manifest, path.string(),
+                                  [this] (const Name& segmentName,
+                                          const FileFetcher::DataCallback& onData,
+                                          const FileFetcher::TimeoutCallback& onTimeout) {
+                                    requests.push_back({segmentName, onData, onTimeout});
+                                  },
+                                  [this] (uint64_t nReceivedBytes) {
+                                    progress.push_back(nReceivedBytes);
+                                  },
+                                  [this] { isComplete = true; },
+                                  [this] (const std::string& reason) { errors.push_back(reason); }));
+  }
+
+  void
+  satisfy(size_t index)
+  {
+    Request request = requests[index];
+    request.onData(publisher.makeSegment(request.segmentName), true);
+  }
+
+  void
+  timeout(size_t index)
+  {
+    Request request = requests[index];
+    request.onTimeout();
+  }
+
+  std::string
+  readFile(const fs::path& file)
+  {
+    std::ifstream is(file.c_str(), std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>());
+  }
+
+public:
+  fs::path sourcePath;
+  fs::path path;
+  FilePublisher publisher;
+  unique_ptr<FileFetcher> fetcher;
+
+  std::vector<Request> requests;
+  std::vector<uint64_t> progress;
+  std::vector<std::string> errors;
+  bool isComplete;
+};
+
+BOOST_FIXTURE_TEST_SUITE(TestFileFetcher, FileFetcherFixture)
+
+BOOST_AUTO_TEST_CASE(PipelinedTransfer)
+{
+  FileManifest manifest = publisher.addFile("/alice/session/file/0", sourcePath.string());
+  makeFetcher(manifest);
+  fetcher->start();
+
+  // initial window, in ascending order
+  BOOST_REQUIRE_EQUAL(requests.size(), 2);
+  BOOST_CHECK_EQUAL(requests[0].segmentName.get(-1).toSegment(), 0);
+  BOOST_CHECK_EQUAL(requests[1].segmentName.get(-1).toSegment(), 1);
+
+  // the partial file has its final size from the start
+  BOOST_CHECK(!fs::exists(path));
+  BOOST_CHECK_EQUAL(fs::file_size(path.string() + ".part"), 1000);
+
+  satisfy(1);
+  satisfy(0);
+  BOOST_CHECK_EQUAL(fetcher->getWindow(), FileFetcher::INITIAL_WINDOW + 2);
+  BOOST_CHECK_EQUAL(fetcher->getNOutstanding(), 4);
+  BOOST_REQUIRE_EQUAL(progress.size(), 2);
+  BOOST_CHECK_EQUAL(progress.back(), 20);
+
+  for (size_t i = 2; i < requests.size(); i++)
+    satisfy(i);
+
+  BOOST_CHECK_EQUAL(requests.size(), 100);
+  BOOST_CHECK(errors.empty());
+  BOOST_REQUIRE(isComplete);
+  BOOST_CHECK_EQUAL(fetcher->getNReceivedBytes(), 1000);
+  BOOST_CHECK(!fs::exists(path.string() + ".part"));
+  BOOST_CHECK_EQUAL(readFile(path), readFile(sourcePath));
+}
+
+BOOST_AUTO_TEST_CASE(Retransmission)
+{
+  FileManifest manifest = publisher.addFile("/alice/session/file/0", sourcePath.string());
+  makeFetcher(manifest);
+  fetcher->start();
+  BOOST_REQUIRE_EQUAL(requests.size(), 2);
+
+  satisfy(0);
+  BOOST_REQUIRE_EQUAL(requests.size(), 4);
+
+  // the window is halved and the segment is requested again before the newer ones
+  timeout(1);
+  BOOST_CHECK_EQUAL(fetcher->getWindow(), (FileFetcher::INITIAL_WINDOW + 1) / 2);
+  BOOST_CHECK_EQUAL(fetcher->getNOutstanding(), 2);
+
+  satisfy(2);
+  BOOST_REQUIRE_EQUAL(requests.size(), 5);
+  BOOST_CHECK_EQUAL(requests[4].segmentName.get(-1).toSegment(), 1);
+
+  // a segment is given up after MAX_RETRIES retries
+  for (size_t i = 3; i < requests.size() && errors.empty(); i++)
+    timeout(i);
+  BOOST_CHECK_EQUAL(requests.size(), 8);
+
+  BOOST_REQUIRE_EQUAL(errors.size(), 1);
+  BOOST_CHECK(!isComplete);
+  BOOST_CHECK(!fs::exists(path.string() + ".part"));
+  BOOST_CHECK(!fs::exists(path));
+
+  // late data of the failed transfer is ignored
+  satisfy(3);
+  BOOST_CHECK_EQUAL(errors.size(), 1);
+  BOOST_CHECK_EQUAL(progress.size(), 2);
+}
+
+BOOST_AUTO_TEST_CASE(UnvalidatedSegment)
+{
+  FileManifest manifest = publisher.addFile("/alice/session/file/0", sourcePath.string());
+  makeFetcher(manifest);
+  fetcher->start();
+
+  requests[0].onData(publisher.makeSegment(requests[0].segmentName), false);
+  BOOST_CHECK_EQUAL(errors.size(), 1);
+  BOOST_CHECK(!fs::exists(path.string() + ".part"));
+}
+
+BOOST_AUTO_TEST_CASE(TooLargeFile)
+{
+  // the announced size is not trusted, nothing is created for a file over the limit
+  FileManifest manifest;
+  manifest.setPrefix("/alice/session/file/0");
+  manifest.setFileName("large");
+  manifest.setFileSize(FileFetcher::MAX_FILE_SIZE + 1);
+  manifest.setSegmentSize(10);
+  BOOST_CHECK_THROW(makeFetcher(manifest), FileFetcher::Error);
+  BOOST_CHECK(!fs::exists(path.string() + ".part"));
+}
+
+BOOST_AUTO_TEST_CASE(EmptyFileAndCancel)
+{
+  FileManifest manifest;
+  manifest.setPrefix("/alice/session/file/1");
+  manifest.setFileName("empty");
+  manifest.setFileSize(0);
+  makeFetcher(manifest);
+  fetcher->start();
+  BOOST_CHECK(requests.empty());
+  BOOST_CHECK(isComplete);
+  BOOST_CHECK_EQUAL(fs::file_size(path), 0);
+  fs::remove(path);
+
+  // a cancelled transfer leaves nothing behind
+  isComplete = false;
+  manifest = publisher.addFile("/alice/session/file/0", sourcePath.string());
+  makeFetcher(manifest);
+  fetcher->start();
+  fetcher.reset();
+  satisfy(0);
+  BOOST_CHECK(!isComplete);
+  BOOST_CHECK(progress.empty());
+  BOOST_CHECK(!fs::exists(path.string() + ".part"));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace tests
+} // namespace chronochat
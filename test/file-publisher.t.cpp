@@ -0,0 +1,126 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include "file-publisher.hpp"
+
+#include <fstream>
+#include <boost/filesystem.hpp>
+
+namespace chronochat {
+namespace tests {
+
+namespace fs = boost::filesystem;
+
+class FilePublisherFixture
+{
+public:
+  FilePublisherFixture()
+    : path(fs::temp_directory_path() / fs::unique_path())
+    , nSigned(0)
+    , publisher([this] (Data& data) { nSigned++; }, 4)
+  {
+    std::ofstream os(path.c_str(), std::ios::binary);
+    os << "0123456789";
+  }
+
+  ~FilePublisherFixture()
+  {
+    publisher.clear();
+    fs::remove(path);
+  }
+
+public:
+  fs::path path;
+  int nSigned;
+  FilePublisher publisher;
+};
+
+BOOST_FIXTURE_TEST_SUITE(TestFilePublisher, FilePublisherFixture)
+
+BOOST_AUTO_TEST_CASE(Segments)
+{
+  Name prefix("/alice/session/file/0");
+  FileManifest manifest = publisher.addFile(prefix, path.string());
+  BOOST_CHECK_EQUAL(manifest.getPrefix(), prefix);
+  BOOST_CHECK_EQUAL(manifest.getFileName(), path.filename().string());
+  BOOST_CHECK_EQUAL(manifest.getFileSize(), 10);
+  BOOST_CHECK_EQUAL(manifest.getNSegments(), 3);
+
+  // segments are only made when they are asked for
+  BOOST_CHECK_EQUAL(nSigned, 0);
+
+  shared_ptr<const Data> first = publisher.makeSegment(Name(prefix).appendSegment(0));
+  BOOST_REQUIRE(first != nullptr);
+  BOOST_CHECK_EQUAL(std::string(reinterpret_cast<const char*>(first->getContent().value()),
+                                first->getContent().value_size()), "0123");
+  BOOST_CHECK_EQUAL(first->getFinalBlockId().toSegment(), 2);
+
+  shared_ptr<const Data> last = publisher.makeSegment(Name(prefix).appendSegment(2));
+  BOOST_REQUIRE(last != nullptr);
+  BOOST_CHECK_EQUAL(std::string(reinterpret_cast<const char*>(last->getContent().value()),
+                                last->getContent().value_size()), "89");
+  BOOST_CHECK_EQUAL(nSigned, 2);
+
+  BOOST_CHECK(publisher.makeSegment(Name(prefix).appendSegment(3)) == nullptr);
+  BOOST_CHECK(publisher.makeSegment(Name(prefix).appendNumber(1)) == nullptr);
+  BOOST_CHECK(publisher.makeSegment(Name("/alice/session/file/1").appendSegment(0)) == nullptr);
+
+  publisher.removeFile(prefix);
+  BOOST_CHECK(publisher.makeSegment(Name(prefix).appendSegment(0)) == nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(SegmentCache)
+{
+  FilePublisher smallPublisher([this] (Data& data) { nSigned++; }, 4,
+                               time::milliseconds(60000), 2);
+  Name prefix("/alice/session/file/0");
+  smallPublisher.addFile(prefix, path.string());
+
+  // a segment asked for again is not signed again
+  shared_ptr<const Data> first = smallPublisher.makeSegment(Name(prefix).appendSegment(0));
+  BOOST_CHECK(smallPublisher.makeSegment(Name(prefix).appendSegment(0)) == first);
+  BOOST_CHECK_EQUAL(nSigned, 1);
+
+  // the least recently used segment is dropped
+  smallPublisher.makeSegment(Name(prefix).appendSegment(1));
+  smallPublisher.makeSegment(Name(prefix).appendSegment(0));
+  smallPublisher.makeSegment(Name(prefix).appendSegment(2));
+  BOOST_CHECK_EQUAL(smallPublisher.getNCachedSegments(), 2);
+  BOOST_CHECK_EQUAL(nSigned, 3);
+  BOOST_CHECK(smallPublisher.makeSegment(Name(prefix).appendSegment(0)) == first);
+  smallPublisher.makeSegment(Name(prefix).appendSegment(1));
+  BOOST_CHECK_EQUAL(nSigned, 4);
+
+  // the segments of a file which is not published any more are gone
+  smallPublisher.removeFile(prefix);
+  BOOST_CHECK_EQUAL(smallPublisher.getNCachedSegments(), 0);
+  BOOST_CHECK(smallPublisher.makeSegment(Name(prefix).appendSegment(0)) == nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(EmptyAndMissingFiles)
+{
+  fs::path emptyPath = fs::temp_directory_path() / fs::unique_path();
+  std::ofstream(emptyPath.c_str());
+
+  FileManifest manifest = publisher.addFile("/alice/session/file/0", emptyPath.string());
+  BOOST_CHECK_EQUAL(manifest.getFileSize(), 0);
+  BOOST_CHECK_EQUAL(manifest.getNSegments(), 0);
+  BOOST_CHECK(publisher.makeSegment(Name("/alice/session/file/0").appendSegment(0)) == nullptr);
+  fs::remove(emptyPath);
+
+  BOOST_CHECK_THROW(publisher.addFile("/alice/session/file/1", emptyPath.string()),
+                    FilePublisher::Error);
+  BOOST_CHECK_EQUAL(publisher.size(), 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace tests
+} // namespace chronochat
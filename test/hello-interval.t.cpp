@@ -0,0 +1,72 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include "hello-interval.hpp"
+
+namespace chronochat {
+namespace tests {
+
+BOOST_AUTO_TEST_SUITE(TestHelloInterval)
+
+BOOST_AUTO_TEST_CASE(ScaleWithRoom)
+{
+  HelloInterval interval(time::seconds(60), 20, 1);
+
+  BOOST_CHECK_EQUAL(interval.getMeanInterval(1).count(), 60000);
+  BOOST_CHECK_EQUAL(interval.getMeanInterval(20).count(), 60000);
+  BOOST_CHECK_EQUAL(interval.getMeanInterval(40).count(), 120000);
+  BOOST_CHECK_EQUAL(interval.getMeanInterval(1000).count(), 3000000);
+
+  // the aggregate rate of the room stays flat
+  for (size_t n : {100, 1000, 10000}) {
+    double rate = n / static_cast<double>(interval.getMeanInterval(n).count());
+    BOOST_CHECK_CLOSE(rate, 20.0 / 60000, 0.1);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(Jitter)
+{
+  HelloInterval interval(time::seconds(60), 20, 1);
+
+  bool isRandomized = false;
+  time::milliseconds first = interval.getNextInterval(10);
+  for (int i = 0; i < 100; i++) {
+    time::milliseconds next = interval.getNextInterval(10);
+    BOOST_CHECK_GE(next.count(), 45000);
+    BOOST_CHECK_LE(next.count(), 75000);
+    isRandomized = isRandomized || next != first;
+  }
+  BOOST_CHECK(isRandomized);
+
+  BOOST_CHECK_EQUAL(interval.getTimeout(10).count(), 225000);
+}
+
+BOOST_AUTO_TEST_CASE(AnnouncedInterval)
+{
+  HelloInterval interval(time::seconds(60), 20, 1);
+
+  // a participant which counts 40 in the room sends its hellos twice as far apart, which
+  // a participant counting only 10 must not time out
+  time::milliseconds announced = interval.getMeanInterval(40);
+  BOOST_CHECK_EQUAL(HelloInterval::getTimeout(announced).count(), 450000);
+  BOOST_CHECK_EQUAL(HelloInterval::getTimeout(announced), interval.getTimeout(40));
+  BOOST_CHECK_GT(HelloInterval::getTimeout(announced), interval.getTimeout(10));
+
+  for (int i = 0; i < 100; i++) {
+    time::milliseconds next = interval.getNextInterval(announced);
+    BOOST_CHECK_GE(next.count(), 90000);
+    BOOST_CHECK_LE(next.count(), 150000);
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace tests
+} // namespace chronochat
@@ -0,0 +1,76 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include "latency-histogram.hpp"
+
+#include <limits>
+
+namespace chronochat {
+namespace tests {
+
+BOOST_AUTO_TEST_SUITE(TestLatencyHistogram)
+
+BOOST_AUTO_TEST_CASE(Buckets)
+{
+  std::vector<uint64_t> values = {0, 1, 31, 32, 33, 63, 64, 1000, 123456789,
+                                  std::numeric_limits<uint64_t>::max()};
+
+  for (uint64_t value : values) {
+    size_t index = LatencyHistogram::getBucketIndex(value);
+    uint64_t highest = LatencyHistogram::getBucketHighest(index);
+
+    BOOST_CHECK_GE(highest, value);
+    BOOST_CHECK_LE(highest - value, value / 16);
+    if (index > 0)
+      BOOST_CHECK_LT(LatencyHistogram::getBucketHighest(index - 1), value);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(Percentiles)
+{
+  LatencyHistogram histogram;
+  BOOST_CHECK_EQUAL(histogram.getPercentile(50).count(), 0);
+
+  for (int i = 1; i <= 1000; i++)
+    histogram.record(time::milliseconds(i));
+  histogram.record(time::milliseconds(-5));
+
+  BOOST_CHECK_EQUAL(histogram.getCount(), 1001);
+  BOOST_CHECK_EQUAL(histogram.getMin().count(), 0);
+  BOOST_CHECK_EQUAL(histogram.getMax().count(), 1000000);
+
+  BOOST_CHECK_CLOSE(static_cast<double>(histogram.getPercentile(50).count()), 500000, 6.25);
+  BOOST_CHECK_CLOSE(static_cast<double>(histogram.getPercentile(99).count()), 990000, 6.25);
+  BOOST_CHECK_EQUAL(histogram.getPercentile(100).count(), 1000000);
+}
+
+BOOST_AUTO_TEST_CASE(Merge)
+{
+  LatencyHistogram first;
+  LatencyHistogram second;
+  first.record(time::microseconds(10));
+  second.record(time::microseconds(20));
+  second.record(time::microseconds(30));
+
+  first.merge(second);
+  BOOST_CHECK_EQUAL(first.getCount(), 3);
+  BOOST_CHECK_EQUAL(first.getMin().count(), 10);
+  BOOST_CHECK_EQUAL(first.getMax().count(), 30);
+  BOOST_CHECK_EQUAL(first.getMean().count(), 20);
+
+  first.reset();
+  BOOST_CHECK_EQUAL(first.getCount(), 0);
+  BOOST_CHECK_EQUAL(first.getMax().count(), 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace tests
+} // namespace chronochat
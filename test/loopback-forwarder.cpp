@@ -0,0 +1,204 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#include "loopback-forwarder.hpp"
+
+#include <ndn-cxx/management/nfd-control-parameters.hpp>
+
+namespace chronochat {
+namespace tests {
+
+static const Name LOCALHOST_RIB("/localhost/nfd/rib");
+static const ssize_t COMMAND_VERB_OFFSET = 3;
+static const ssize_t COMMAND_PARAMETERS_OFFSET = 4;
+
+VirtualClock::VirtualClock()
+  : m_steadyClock(make_shared<time::UnitTestSteadyClock>())
+  , m_systemClock(make_shared<time::UnitTestSystemClock>())
+{
+  time::setCustomClocks(m_steadyClock, m_systemClock);
+}
+
+VirtualClock::~VirtualClock()
+{
+  time::setCustomClocks(nullptr, nullptr);
+}
+
+void
+VirtualClock::advance(boost::asio::io_service& ioService,
+                      const time::nanoseconds& tick, size_t nTicks)
+{
+  for (size_t i = 0; i < nTicks; i++) {
+    m_steadyClock->advance(tick);
+    m_systemClock->advance(tick);
+
+    if (ioService.stopped())
+      ioService.reset();
+    ioService.poll();
+  }
+}
+
+LoopbackForwarder::LoopbackForwarder(boost::asio::io_service& ioService, uint32_t seed)
+  : m_ioService(ioService)
+  , m_scheduler(ioService)
+  , m_randomGenerator(seed)
+  , m_defaultLink({time::milliseconds(0), 0.0})
+  , m_nextFaceId(0)
+  , m_nDropped(0)
+  , m_nBytes(0)
+{
+}
+
+shared_ptr<ndn::Face>
+LoopbackForwarder::makeFace()
+{
+  // the forwarder answers prefix registrations through the face itself
+  shared_ptr<ndn::util::DummyClientFace> face =
+    ndn::util::makeDummyClientFace(m_ioService, {false, true});
+
+  FaceId faceId = m_nextFaceId++;
+  m_faces[faceId].face = face;
+  m_faces[faceId].link = m_defaultLink;
+
+  face->onSendInterest.connect([this, faceId] (const Interest& interest) {
+      this->onInterest(faceId, interest);
+    });
+  face->onSendData.connect([this, faceId] (const Data& data) {
+      this->onData(faceId, data);
+    });
+
+  return face;
+}
+
+FaceFactory
+LoopbackForwarder::getFaceFactory()
+{
+  return [this] (boost::asio::io_service& ioService) {
+    BOOST_ASSERT(&ioService == &m_ioService);
+    return this->makeFace();
+  };
+}
+
+void
+LoopbackForwarder::setLink(const ndn::Face& face, const Link& link)
+{
+  for (auto& entry : m_faces) {
+    if (entry.second.face.lock().get() == &face)
+      entry.second.link = link;
+  }
+}
+
+void
+LoopbackForwarder::onInterest(FaceId inFace, const Interest& interest)
+{
+  if (processCommand(inFace, interest))
+    return;
+
+  removeExpiredEntries();
+  m_pit.push_back({interest, inFace,
+                   time::steady_clock::now() + interest.getInterestLifetime()});
+
+  for (const auto& entry : m_faces) {
+    if (entry.first == inFace)
+      continue;
+
+    for (const Name& prefix : entry.second.prefixes) {
+      if (prefix.isPrefixOf(interest.getName())) {
+        send(inFace, entry.first, interest);
+        break;
+      }
+    }
+  }
+}
+
+void
+LoopbackForwarder::onData(FaceId inFace, const Data& data)
+{
+  removeExpiredEntries();
+
+  // every downstream face gets the Data once
+  std::set<FaceId> outFaces;
+  for (auto it = m_pit.begin(); it != m_pit.end();) {
+    if (it->inFace != inFace && it->interest.matchesData(data)) {
+      outFaces.insert(it->inFace);
+      it = m_pit.erase(it);
+    }
+    else
+      ++it;
+  }
+
+  for (FaceId outFace : outFaces)
+    send(inFace, outFace, data);
+}
+
+bool
+LoopbackForwarder::processCommand(FaceId inFace, const Interest& interest)
+{
+  const Name& name = interest.getName();
+  if (!LOCALHOST_RIB.isPrefixOf(name))
+    return false;
+
+  if (name.size() <= static_cast<size_t>(COMMAND_PARAMETERS_OFFSET))
+    return true;
+
+  ndn::nfd::ControlParameters parameters;
+  try {
+    parameters.wireDecode(name.get(COMMAND_PARAMETERS_OFFSET).blockFromValue());
+  }
+  catch (tlv::Error&) {
+    return true;
+  }
+
+  const name::Component& verb = name.get(COMMAND_VERB_OFFSET);
+  if (verb == name::Component("register"))
+    m_faces[inFace].prefixes.insert(parameters.getName());
+  else if (verb == name::Component("unregister"))
+    m_faces[inFace].prefixes.erase(parameters.getName());
+
+  return true;
+}
+
+template<typename Packet>
+void
+LoopbackForwarder::send(FaceId inFace, FaceId outFace, const Packet& packet)
+{
+  const Link& inLink = m_faces[inFace].link;
+  const Link& outLink = m_faces[outFace].link;
+
+  m_nBytes += packet.wireEncode().size();
+  if (isDropped(inLink) || isDropped(outLink)) {
+    m_nDropped++;
+    return;
+  }
+
+  weak_ptr<ndn::util::DummyClientFace> face = m_faces[outFace].face;
+  m_scheduler.scheduleEvent(inLink.delay + outLink.delay, [face, packet] {
+      shared_ptr<ndn::util::DummyClientFace> outFace = face.lock();
+      if (outFace != nullptr)
+        outFace->receive(packet);
+    });
+}
+
+bool
+LoopbackForwarder::isDropped(const Link& link)
+{
+  if (link.lossRate <= 0.0)
+    return false;
+
+  return std::uniform_real_distribution<double>(0.0, 1.0)(m_randomGenerator) < link.lossRate;
+}
+
+void
+LoopbackForwarder::removeExpiredEntries()
+{
+  time::steady_clock::TimePoint now = time::steady_clock::now();
+  m_pit.remove_if([now] (const PitEntry& entry) { return entry.expiry <= now; });
+}
+
+} // namespace tests
+} // namespace chronochat
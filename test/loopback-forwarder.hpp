@@ -0,0 +1,159 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#ifndef CHRONOCHAT_TEST_LOOPBACK_FORWARDER_HPP
+#define CHRONOCHAT_TEST_LOOPBACK_FORWARDER_HPP
+
+#include "common.hpp"
+#include "face-factory.hpp"
+
+#include <ndn-cxx/util/dummy-client-face.hpp>
+#include <ndn-cxx/util/scheduler.hpp>
+#include <ndn-cxx/util/time-unit-test-clock.hpp>
+
+#include <random>
+
+namespace chronochat {
+namespace tests {
+
+/**
+ * @brief Replaces the system clocks with clocks which only move when advanced
+ *
+ * Everything scheduled on an io_service (Face timeouts, Scheduler events) runs on the
+ * virtual time, so a simulation of minutes completes as fast as the handlers run.
+ */
+class VirtualClock : noncopyable
+{
+public:
+  VirtualClock();
+
+  ~VirtualClock();
+
+  /// @brief advance the clocks @p nTicks times by @p tick, running @p ioService after each
+  void
+  advance(boost::asio::io_service& ioService,
+          const time::nanoseconds& tick, size_t nTicks = 1);
+
+private:
+  shared_ptr<time::UnitTestSteadyClock> m_steadyClock;
+  shared_ptr<time::UnitTestSystemClock> m_systemClock;
+};
+
+/**
+ * @brief In-process stand-in of NFD which connects the faces it makes
+ *
+ * Every face is connected to the forwarder by its own link.  Interests are forwarded to
+ * all other faces which registered a matching prefix (multicast), Data goes back along
+ * the pending Interests.  A packet crossing a link is delayed by the delay of the link and
+ * dropped with its loss rate; a packet between two faces crosses both links.
+ *
+ * All faces must use the io_service of the forwarder, which must outlive them.
+ */
+class LoopbackForwarder : noncopyable
+{
+public:
+  struct Link
+  {
+    time::milliseconds delay;
+    double lossRate;                     // probability of dropping a packet, in [0, 1]
+  };
+
+  explicit
+  LoopbackForwarder(boost::asio::io_service& ioService, uint32_t seed = 0);
+
+  /// @brief make a face connected to the forwarder by a link with the default parameters
+  shared_ptr<ndn::Face>
+  makeFace();
+
+  /// @brief get a factory for backends, which ignores the io_service it is given
+  FaceFactory
+  getFaceFactory();
+
+  /// @brief set the link of faces made from now on
+  void
+  setDefaultLink(const Link& link)
+  {
+    m_defaultLink = link;
+  }
+
+  void
+  setLink(const ndn::Face& face, const Link& link);
+
+  /// @brief number of packets dropped by all links
+  size_t
+  getNDropped() const
+  {
+    return m_nDropped;
+  }
+
+  /// @brief number of bytes sent to the links, including dropped packets
+  uint64_t
+  getNBytes() const
+  {
+    return m_nBytes;
+  }
+
+  boost::asio::io_service&
+  getIoService()
+  {
+    return m_ioService;
+  }
+
+private:
+  typedef size_t FaceId;
+
+  struct FaceEntry
+  {
+    weak_ptr<ndn::util::DummyClientFace> face;
+    Link link;
+    std::set<Name> prefixes;
+  };
+
+  struct PitEntry
+  {
+    Interest interest;
+    FaceId inFace;
+    time::steady_clock::TimePoint expiry;
+  };
+
+  void
+  onInterest(FaceId inFace, const Interest& interest);
+
+  void
+  onData(FaceId inFace, const Data& data);
+
+  bool
+  processCommand(FaceId inFace, const Interest& interest);
+
+  template<typename Packet>
+  void
+  send(FaceId inFace, FaceId outFace, const Packet& packet);
+
+  bool
+  isDropped(const Link& link);
+
+  void
+  removeExpiredEntries();
+
+private:
+  boost::asio::io_service& m_ioService;
+  ndn::Scheduler m_scheduler;
+  std::mt19937 m_randomGenerator;
+
+  Link m_defaultLink;
+  FaceId m_nextFaceId;
+  std::map<FaceId, FaceEntry> m_faces;
+  std::list<PitEntry> m_pit;
+  size_t m_nDropped;
+  uint64_t m_nBytes;
+};
+
+} // namespace tests
+} // namespace chronochat
+
+#endif // CHRONOCHAT_TEST_LOOPBACK_FORWARDER_HPP
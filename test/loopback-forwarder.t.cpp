@@ -0,0 +1,167 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include "loopback-forwarder.hpp"
+#include <ndn-cxx/security/key-chain.hpp>
+#include <socket.hpp>
+
+namespace chronochat {
+namespace tests {
+
+class LoopbackFixture
+{
+public:
+  LoopbackFixture()
+    : forwarder(ioService)
+  {
+  }
+
+  void
+  advance(const time::milliseconds& duration)
+  {
+    clock.advance(ioService, time::milliseconds(1), duration.count());
+  }
+
+public:
+  VirtualClock clock;
+  boost::asio::io_service ioService;
+  LoopbackForwarder forwarder;
+};
+
+BOOST_FIXTURE_TEST_SUITE(TestLoopbackForwarder, LoopbackFixture)
+
+BOOST_AUTO_TEST_CASE(InterestDataExchange)
+{
+  forwarder.setDefaultLink({time::milliseconds(10), 0.0});
+  shared_ptr<ndn::Face> consumer = forwarder.makeFace();
+  shared_ptr<ndn::Face> producer = forwarder.makeFace();
+
+  producer->setInterestFilter("/producer",
+                              [&] (const Name& prefix, const Interest& interest) {
+                                Data data(interest.getName());
+                                ndn::KeyChain keyChain;
+                                keyChain.signWithSha256(data);
+                                producer->put(data);
+                              },
+                              [] (const Name& prefix, const std::string& reason) {
+                                BOOST_FAIL("Cannot register prefix");
+                              });
+  advance(time::milliseconds(10));
+
+  time::steady_clock::TimePoint start = time::steady_clock::now();
+  time::steady_clock::TimePoint received;
+  size_t nData = 0;
+  consumer->expressInterest(Interest("/producer/a"),
+                            [&] (const Interest& interest, const Data& data) {
+                              received = time::steady_clock::now();
+                              nData++;
+                            },
+                            [] (const Interest& interest) {});
+
+  advance(time::milliseconds(100));
+
+  // both ways cross both links
+  BOOST_CHECK_EQUAL(nData, 1);
+  BOOST_CHECK(received - start >= time::milliseconds(40));
+}
+
+BOOST_AUTO_TEST_CASE(UnregisteredPrefix)
+{
+  shared_ptr<ndn::Face> consumer = forwarder.makeFace();
+  shared_ptr<ndn::Face> producer = forwarder.makeFace();
+
+  size_t nInterests = 0;
+  producer->setInterestFilter("/producer",
+                              [&] (const Name& prefix, const Interest& interest) {
+                                nInterests++;
+                              },
+                              [] (const Name& prefix, const std::string& reason) {});
+  advance(time::milliseconds(10));
+
+  size_t nTimeouts = 0;
+  Interest interest("/other/a");
+  interest.setInterestLifetime(time::milliseconds(100));
+  consumer->expressInterest(interest,
+                            [] (const Interest& interest, const Data& data) {},
+                            [&] (const Interest& interest) { nTimeouts++; });
+
+  advance(time::milliseconds(200));
+
+  BOOST_CHECK_EQUAL(nInterests, 0);
+  BOOST_CHECK_EQUAL(nTimeouts, 1);
+}
+
+BOOST_AUTO_TEST_CASE(LossyLink)
+{
+  shared_ptr<ndn::Face> consumer = forwarder.makeFace();
+  shared_ptr<ndn::Face> producer = forwarder.makeFace();
+  forwarder.setLink(*consumer, {time::milliseconds(1), 1.0});
+
+  size_t nInterests = 0;
+  producer->setInterestFilter("/producer",
+                              [&] (const Name& prefix, const Interest& interest) {
+                                nInterests++;
+                              },
+                              [] (const Name& prefix, const std::string& reason) {});
+  advance(time::milliseconds(10));
+
+  for (int i = 0; i < 10; i++) {
+    Name name("/producer");
+    name.appendNumber(i);
+    consumer->expressInterest(Interest(name),
+                              [] (const Interest& interest, const Data& data) {},
+                              [] (const Interest& interest) {});
+  }
+  advance(time::milliseconds(10));
+
+  BOOST_CHECK_EQUAL(nInterests, 0);
+  BOOST_CHECK_EQUAL(forwarder.getNDropped(), 10);
+}
+
+BOOST_AUTO_TEST_CASE(SyncConvergence)
+{
+  const size_t N_PARTICIPANTS = 5;
+  forwarder.setDefaultLink({time::milliseconds(5), 0.0});
+
+  Name syncPrefix("/ndn/broadcast/ChronoChat/test-room");
+  std::vector<shared_ptr<ndn::Face>> faces;
+  std::vector<shared_ptr<chronosync::Socket>> sockets;
+  std::vector<std::set<Name>> seenSessions(N_PARTICIPANTS);
+
+  for (size_t i = 0; i < N_PARTICIPANTS; i++) {
+    Name userPrefix("/participant");
+    userPrefix.appendNumber(i);
+
+    faces.push_back(forwarder.makeFace());
+    sockets.push_back(make_shared<chronosync::Socket>(
+      syncPrefix, userPrefix, ref(*faces.back()),
+      [&seenSessions, i] (const std::vector<chronosync::MissingDataInfo>& updates) {
+        for (const auto& update : updates)
+          seenSessions[i].insert(update.session);
+      }));
+  }
+  advance(time::milliseconds(1000));
+
+  std::string content("hello");
+  for (auto& socket : sockets)
+    socket->publishData(reinterpret_cast<const uint8_t*>(content.data()), content.size(),
+                        time::milliseconds(1000));
+
+  // ten seconds of virtual time
+  advance(time::milliseconds(10000));
+
+  for (size_t i = 0; i < N_PARTICIPANTS; i++)
+    BOOST_CHECK_EQUAL(seenSessions[i].size(), N_PARTICIPANTS - 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace tests
+} // namespace chronochat
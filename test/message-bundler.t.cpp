@@ -0,0 +1,190 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include "message-bundler.hpp"
+#include "loopback-forwarder.hpp"
+
+namespace chronochat {
+namespace tests {
+
+static const time::milliseconds WINDOW(5);
+
+class MessageBundlerFixture
+{
+public:
+  MessageBundlerFixture()
+    : scheduler(ioService)
+  {
+    makeBundler(4096);
+  }
+
+  void
+  makeBundler(size_t maxBundleSize)
+  {
+    bundler.reset(new MessageBundler(scheduler, WINDOW, maxBundleSize,
+                                     [this] (const ChatMessageBundle& messages) {
+                                       published.push_back({});
+                                       for (const ChatMessage& msg : messages.getMessages())
+                                         published.back().push_back(getText(msg));
+                                     }));
+  }
+
+  static ChatMessage
+  makeMessage(ChatMessage::ChatMessageType type, const std::string& data)
+  {
+    ChatMessage msg;
+    msg.setNick("alice");
+    msg.setChatroomName("room");
+    msg.setMsgType(type);
+    msg.setTimestamp(100);
+    if (type == ChatMessage::CHAT)
+      msg.setData(data);
+    return msg;
+  }
+
+  // chat messages by their text, the others by their type
+  static std::string
+  getText(const ChatMessage& msg)
+  {
+    if (msg.getMsgType() == ChatMessage::CHAT)
+      return msg.getData();
+    return msg.getMsgType() == ChatMessage::HELLO ? "HELLO" : "LEAVE";
+  }
+
+  void
+  send(const std::string& text, bool canBundle = true)
+  {
+    bundler->send(makeMessage(ChatMessage::CHAT, text), canBundle);
+  }
+
+  void
+  advance(const time::milliseconds& duration)
+  {
+    clock.advance(ioService, time::milliseconds(1), duration.count());
+  }
+
+public:
+  VirtualClock clock;
+  boost::asio::io_service ioService;
+  ndn::Scheduler scheduler;
+  unique_ptr<MessageBundler> bundler;
+  std::vector<std::vector<std::string>> published;
+};
+
+BOOST_FIXTURE_TEST_SUITE(TestMessageBundler, MessageBundlerFixture)
+
+BOOST_AUTO_TEST_CASE(Window)
+{
+  // a single message goes out at once
+  send("a");
+  BOOST_REQUIRE_EQUAL(published.size(), 1);
+  BOOST_CHECK_EQUAL(published[0][0], "a");
+
+  // a burst within the window is held back until the window expires
+  advance(time::milliseconds(1));
+  send("b");
+  send("c");
+  BOOST_CHECK_EQUAL(published.size(), 1);
+  BOOST_CHECK(!bundler->empty());
+
+  advance(time::milliseconds(3));
+  BOOST_CHECK_EQUAL(published.size(), 1);
+  advance(time::milliseconds(1));
+  BOOST_REQUIRE_EQUAL(published.size(), 2);
+  BOOST_REQUIRE_EQUAL(published[1].size(), 2);
+  BOOST_CHECK_EQUAL(published[1][0], "b");
+  BOOST_CHECK_EQUAL(published[1][1], "c");
+  BOOST_CHECK(bundler->empty());
+
+  // a message after the window goes out at once again
+  advance(WINDOW);
+  send("d");
+  BOOST_REQUIRE_EQUAL(published.size(), 3);
+  BOOST_CHECK_EQUAL(published[2].size(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(MaxBundleSize)
+{
+  size_t msgSize = makeMessage(ChatMessage::CHAT, "0").wireEncode().size();
+  makeBundler(msgSize * 3);
+
+  send("0");
+  for (int i = 1; i <= 7; i++)
+    send(std::to_string(i));
+
+  // the held back messages are split in order, no bundle exceeds the maximum size
+  BOOST_REQUIRE_EQUAL(published.size(), 3);
+  BOOST_CHECK_EQUAL(published[1].size(), 3);
+  BOOST_CHECK_EQUAL(published[2].size(), 3);
+
+  advance(WINDOW);
+  BOOST_REQUIRE_EQUAL(published.size(), 4);
+  BOOST_CHECK_EQUAL(published[3].size(), 1);
+
+  std::vector<std::string> order;
+  for (const auto& bundle : published)
+    order.insert(order.end(), bundle.begin(), bundle.end());
+  std::vector<std::string> expected = {"0", "1", "2", "3", "4", "5", "6", "7"};
+  BOOST_CHECK_EQUAL_COLLECTIONS(order.begin(), order.end(), expected.begin(), expected.end());
+}
+
+BOOST_AUTO_TEST_CASE(ControlMessages)
+{
+  send("a");
+  send("b");
+  send("c");
+  BOOST_CHECK_EQUAL(published.size(), 1);
+
+  // a control message is not delayed, nor bundled with the held back messages
+  bundler->send(makeMessage(ChatMessage::HELLO, ""), true);
+  BOOST_REQUIRE_EQUAL(published.size(), 3);
+  BOOST_REQUIRE_EQUAL(published[1].size(), 2);
+  BOOST_CHECK_EQUAL(published[1][1], "c");
+  BOOST_REQUIRE_EQUAL(published[2].size(), 1);
+  BOOST_CHECK_EQUAL(published[2][0], "HELLO");
+
+  send("d");
+  bundler->send(makeMessage(ChatMessage::LEAVE, ""), true);
+  BOOST_REQUIRE_EQUAL(published.size(), 5);
+  BOOST_CHECK_EQUAL(published[3][0], "d");
+  BOOST_CHECK_EQUAL(published[4][0], "LEAVE");
+}
+
+BOOST_AUTO_TEST_CASE(NoBundles)
+{
+  // every message is published alone for receivers which do not understand bundles
+  send("a", false);
+  send("b", false);
+  send("c", false);
+  BOOST_REQUIRE_EQUAL(published.size(), 3);
+  for (const auto& bundle : published)
+    BOOST_CHECK_EQUAL(bundle.size(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(Stop)
+{
+  send("a");
+  send("b");
+
+  // the held back message stays until it is flushed, e.g., by the next session
+  bundler->stop();
+  advance(WINDOW * 2);
+  BOOST_CHECK_EQUAL(published.size(), 1);
+  BOOST_CHECK(!bundler->empty());
+
+  bundler->flush();
+  BOOST_REQUIRE_EQUAL(published.size(), 2);
+  BOOST_CHECK_EQUAL(published[1][0], "b");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace tests
+} // namespace chronochat
@@ -0,0 +1,133 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include "payload-compressor.hpp"
+#include "chat-message-bundle.hpp"
+
+namespace chronochat {
+namespace tests {
+
+BOOST_AUTO_TEST_SUITE(TestPayloadCompressor)
+
+static ChatMessage
+makeMessage(const std::string& data)
+{
+  ChatMessage msg;
+  msg.setNick("alice");
+  msg.setChatroomName("room");
+  msg.setMsgType(ChatMessage::CHAT);
+  msg.setTimestamp(100);
+  msg.setData(data);
+  return msg;
+}
+
+#ifdef HAVE_LZ4
+
+BOOST_AUTO_TEST_CASE(CompressDecompress)
+{
+  PayloadCompressor compressor;
+
+  std::string text;
+  for (int i = 0; i < 50; i++)
+    text += "the quick brown fox jumps over the lazy dog ";
+  ChatMessage msg = makeMessage(text);
+  Block content = msg.wireEncode();
+
+  Block compressed = compressor.compress(content);
+  BOOST_CHECK_EQUAL(compressed.type(), static_cast<uint32_t>(tlv::CompressedContent));
+  BOOST_CHECK_LT(compressed.size(), content.size());
+
+  Block decompressed = compressor.decompress(compressed);
+  BOOST_CHECK_EQUAL_COLLECTIONS(decompressed.wire(), decompressed.wire() + decompressed.size(),
+                                content.wire(), content.wire() + content.size());
+
+  ChatMessage decodedMsg(decompressed, ChatMessage::DECODE_VIEW);
+  BOOST_CHECK_EQUAL(decodedMsg.getData(), text);
+
+  // the buffer is not reused while the decoded message refers to it
+  Block other = compressor.decompress(compressed);
+  BOOST_CHECK(other.wire() != decompressed.wire());
+  BOOST_CHECK_EQUAL(decodedMsg.getDataView(), text);
+}
+
+BOOST_AUTO_TEST_CASE(Bundle)
+{
+  PayloadCompressor compressor;
+
+  ChatMessageBundle bundle;
+  for (int i = 0; i < 20; i++)
+    bundle.addMessage(makeMessage("line " + std::to_string(i)));
+
+  Block compressed = compressor.compress(bundle.wireEncode());
+  BOOST_REQUIRE_EQUAL(compressed.type(), static_cast<uint32_t>(tlv::CompressedContent));
+
+  ChatMessageBundle decodedBundle(compressor.decompress(compressed));
+  BOOST_REQUIRE_EQUAL(decodedBundle.size(), 20);
+  BOOST_CHECK_EQUAL(decodedBundle.getMessages()[19].getDataView(), "line 19");
+}
+
+#else
+
+BOOST_AUTO_TEST_CASE(Unavailable)
+{
+  PayloadCompressor compressor;
+  BOOST_CHECK(!PayloadCompressor::isAvailable());
+
+  std::string text;
+  for (int i = 0; i < 50; i++)
+    text += "the quick brown fox jumps over the lazy dog ";
+  Block content = makeMessage(text).wireEncode();
+  BOOST_CHECK(compressor.compress(content) == content);
+}
+
+#endif // HAVE_LZ4
+
+BOOST_AUTO_TEST_CASE(Uncompressed)
+{
+  PayloadCompressor compressor;
+
+  // below the threshold
+  Block small = makeMessage("hello").wireEncode();
+  BOOST_CHECK(!compressor.isWorthCompressing(small));
+  BOOST_CHECK(compressor.compress(small) == small);
+
+  // random text does not shrink
+  std::string noise;
+  for (int i = 0; i < 512; i++)
+    noise.push_back(static_cast<char>((i * 7919 + i * i * 104729) % 251));
+  Block random = makeMessage(noise).wireEncode();
+  BOOST_CHECK_EQUAL(compressor.compress(random).type(), static_cast<uint32_t>(tlv::ChatMessage));
+}
+
+BOOST_AUTO_TEST_CASE(DecompressError)
+{
+  PayloadCompressor compressor;
+
+  const uint8_t garbage[] = {
+    0x9c, 0x07, // CompressedContent
+      0x9d, 0x01, 0x10, // UncompressedSize
+      0x9e, 0x02, 0xff, 0xff, // CompressedData
+  };
+  BOOST_CHECK_THROW(compressor.decompress(Block(garbage, sizeof(garbage))),
+                    PayloadCompressor::Error);
+
+  const uint8_t tooLarge[] = {
+    0x9c, 0x09,
+      0x9d, 0x04, 0x10, 0x00, 0x00, 0x00,
+      0x9e, 0x01, 0x00,
+  };
+  BOOST_CHECK_THROW(compressor.decompress(Block(tooLarge, sizeof(tooLarge))),
+                    PayloadCompressor::Error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace tests
+} // namespace chronochat
@@ -0,0 +1,126 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include "publish-cache.hpp"
+
+#include <ndn-cxx/security/key-chain.hpp>
+#include <boost/filesystem.hpp>
+
+namespace chronochat {
+namespace tests {
+
+namespace fs = boost::filesystem;
+
+class PublishCacheFixture
+{
+public:
+  PublishCacheFixture()
+    : path(fs::temp_directory_path() / fs::unique_path())
+  {
+  }
+
+  ~PublishCacheFixture()
+  {
+    fs::remove(path);
+    fs::remove(path.string() + ".old");
+  }
+
+  Data
+  makeData(uint64_t seqNo, size_t contentSize = 100)
+  {
+    Data data(Name("/alice/session").appendNumber(seqNo));
+    std::vector<uint8_t> content(contentSize, static_cast<uint8_t>(seqNo));
+    data.setContent(content.data(), content.size());
+    keyChain.signWithSha256(data);
+    return data;
+  }
+
+public:
+  fs::path path;
+  ndn::KeyChain keyChain;
+};
+
+BOOST_FIXTURE_TEST_SUITE(TestPublishCache, PublishCacheFixture)
+
+BOOST_AUTO_TEST_CASE(SpillToDisk)
+{
+  size_t dataSize = makeData(0).wireEncode().size();
+  PublishCache cache(path.string(), 4 * dataSize);
+
+  for (uint64_t seqNo = 0; seqNo < 10; seqNo++)
+    cache.insert(makeData(seqNo));
+
+  // only the most recently used data stays in memory
+  BOOST_CHECK_EQUAL(cache.size(), 10);
+  BOOST_CHECK_EQUAL(cache.getMemorySize(), 4 * dataSize);
+
+  shared_ptr<const Data> data = cache.find(makeData(1).getName());
+  BOOST_REQUIRE(data != nullptr);
+  BOOST_CHECK(data->wireEncode() == makeData(1).wireEncode());
+  BOOST_CHECK_EQUAL(cache.getMemorySize(), 4 * dataSize);
+
+  // data which is read back is not written again, the others are written once
+  cache.flush();
+  BOOST_CHECK_EQUAL(fs::file_size(path), 10 * dataSize);
+
+  BOOST_CHECK(cache.find(Name("/alice/session").appendNumber(10)) == nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(Reopen)
+{
+  size_t dataSize = makeData(0).wireEncode().size();
+  {
+    PublishCache cache(path.string());
+    for (uint64_t seqNo = 0; seqNo < 3; seqNo++)
+      cache.insert(makeData(seqNo));
+  }
+
+  // a write which was cut short is dropped
+  fs::resize_file(path, 3 * dataSize - 1);
+
+  PublishCache cache(path.string());
+  BOOST_CHECK_EQUAL(cache.size(), 2);
+  BOOST_CHECK_EQUAL(cache.getMemorySize(), 0);
+  BOOST_CHECK_EQUAL(fs::file_size(path), 2 * dataSize);
+
+  shared_ptr<const Data> data = cache.find(makeData(1).getName());
+  BOOST_REQUIRE(data != nullptr);
+  BOOST_CHECK(data->wireEncode() == makeData(1).wireEncode());
+  BOOST_CHECK(cache.find(makeData(2).getName()) == nullptr);
+
+  cache.insert(makeData(2));
+  cache.flush();
+  BOOST_CHECK_EQUAL(fs::file_size(path), 3 * dataSize);
+}
+
+BOOST_AUTO_TEST_CASE(Rotation)
+{
+  size_t dataSize = makeData(0).wireEncode().size();
+  PublishCache cache(path.string(), 0, 8 * dataSize);
+
+  for (uint64_t seqNo = 0; seqNo < 10; seqNo++)
+    cache.insert(makeData(seqNo));
+  cache.flush();
+
+  // the current file took 4 data, then it became the old one, the oldest data is dropped
+  BOOST_CHECK_EQUAL(cache.size(), 6);
+  BOOST_CHECK_EQUAL(fs::file_size(path.string() + ".old"), 4 * dataSize);
+  BOOST_CHECK_EQUAL(fs::file_size(path), 2 * dataSize);
+  BOOST_CHECK(cache.find(makeData(1).getName()) == nullptr);
+
+  shared_ptr<const Data> data = cache.find(makeData(5).getName());
+  BOOST_REQUIRE(data != nullptr);
+  BOOST_CHECK(data->wireEncode() == makeData(5).wireEncode());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace tests
+} // namespace chronochat
@@ -0,0 +1,65 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include "session-info.hpp"
+
+namespace chronochat {
+namespace tests {
+
+BOOST_AUTO_TEST_SUITE(TestSessionInfo)
+
+const uint8_t sessionInfo[] = {
+  0xa3, 0x0a, // SessionInfo
+    0x87, 0x05, // Nick
+      0x61, 0x6c, 0x69, 0x63, 0x65,
+    0x9b, 0x01, // Features
+      0x03,
+};
+
+BOOST_AUTO_TEST_CASE(Encode)
+{
+  SessionInfo info;
+  info.setNick("alice");
+  info.setFeatures(SessionInfo::FEATURE_COMPRESSION | SessionInfo::FEATURE_COMPACT);
+
+  const Block& wire = info.wireEncode();
+  BOOST_CHECK_EQUAL_COLLECTIONS(wire.wire(), wire.wire() + wire.size(),
+                                sessionInfo, sessionInfo + sizeof(sessionInfo));
+}
+
+BOOST_AUTO_TEST_CASE(Decode)
+{
+  SessionInfo info(Block(sessionInfo, sizeof(sessionInfo)));
+  BOOST_CHECK_EQUAL(info.getNick(), "alice");
+  BOOST_CHECK_EQUAL(info.getFeatures(),
+                    SessionInfo::FEATURE_COMPRESSION | SessionInfo::FEATURE_COMPACT);
+
+  // elements of later versions are skipped
+  const uint8_t laterInfo[] = {
+    0xa3, 0x0e,
+      0x87, 0x05, 0x61, 0x6c, 0x69, 0x63, 0x65,
+      0x9b, 0x01, 0x03,
+      0xfd, 0x01, 0x00, 0x00,
+  };
+  BOOST_REQUIRE_NO_THROW(info.wireDecode(Block(laterInfo, sizeof(laterInfo))));
+  BOOST_CHECK_EQUAL(info.getNick(), "alice");
+
+  const uint8_t noFeatures[] = {
+    0xa3, 0x07,
+      0x87, 0x05, 0x61, 0x6c, 0x69, 0x63, 0x65,
+  };
+  BOOST_CHECK_THROW(info.wireDecode(Block(noFeatures, sizeof(noFeatures))),
+                    SessionInfo::Error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace tests
+} // namespace chronochat
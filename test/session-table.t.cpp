@@ -0,0 +1,44 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include "session-table.hpp"
+
+namespace chronochat {
+namespace tests {
+
+BOOST_AUTO_TEST_SUITE(TestSessionTable)
+
+BOOST_AUTO_TEST_CASE(Intern)
+{
+  SessionTable table;
+  Name alice("/ndn/alice/CHRONOCHAT-CHATROOM/room/1428000000000");
+  Name bob("/ndn/bob/CHRONOCHAT-CHATROOM/room/1428000000000");
+
+  BOOST_CHECK_EQUAL(table.find(alice), 0);
+
+  // IDs are assigned at first sight and kept
+  SessionId aliceId = table.intern(alice);
+  SessionId bobId = table.intern(bob);
+  BOOST_CHECK_EQUAL(aliceId, 1);
+  BOOST_CHECK_EQUAL(bobId, 2);
+  BOOST_CHECK_EQUAL(table.intern(alice), aliceId);
+  BOOST_CHECK_EQUAL(table.find(bob), bobId);
+  BOOST_CHECK_EQUAL(table.size(), 2);
+
+  BOOST_CHECK_EQUAL(table.getName(aliceId), alice);
+  BOOST_CHECK_EQUAL(table.getName(bobId), bob);
+  BOOST_CHECK_EQUAL(table.getName(0), Name());
+  BOOST_CHECK_EQUAL(table.getName(3), Name());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace tests
+} // namespace chronochat
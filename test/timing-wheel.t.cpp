@@ -0,0 +1,125 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include "timing-wheel.hpp"
+#include "loopback-forwarder.hpp"
+
+namespace chronochat {
+namespace tests {
+
+class Session : public TimingWheel<Session>::Entry
+{
+public:
+  int id;
+};
+
+class TimingWheelFixture
+{
+public:
+  TimingWheelFixture()
+    : scheduler(ioService)
+    , wheel(scheduler, time::seconds(1),
+            [this] (const std::vector<Session*>& expired) {
+              batches.push_back({});
+              for (Session* session : expired)
+                batches.back().push_back(session->id);
+            })
+  {
+  }
+
+  void
+  advance(const time::seconds& duration)
+  {
+    clock.advance(ioService, time::milliseconds(100), duration.count() * 10);
+  }
+
+public:
+  VirtualClock clock;
+  boost::asio::io_service ioService;
+  ndn::Scheduler scheduler;
+  TimingWheel<Session> wheel;
+  std::vector<std::vector<int>> batches;
+};
+
+BOOST_FIXTURE_TEST_SUITE(TestTimingWheel, TimingWheelFixture)
+
+BOOST_AUTO_TEST_CASE(ExpireInBatch)
+{
+  std::vector<Session> sessions(3);
+  for (int i = 0; i < 3; i++) {
+    sessions[i].id = i;
+    wheel.schedule(sessions[i], time::milliseconds(2500 + i * 100));
+  }
+  BOOST_CHECK_EQUAL(wheel.size(), 3);
+
+  advance(time::seconds(2));
+  BOOST_CHECK(batches.empty());
+
+  advance(time::seconds(2));
+  BOOST_REQUIRE_EQUAL(batches.size(), 1);
+  BOOST_CHECK_EQUAL(batches[0].size(), 3);
+  BOOST_CHECK_EQUAL(wheel.size(), 0);
+  BOOST_CHECK(!sessions[0].isScheduled());
+}
+
+BOOST_AUTO_TEST_CASE(Touch)
+{
+  Session session;
+  session.id = 1;
+
+  // a session which is touched in time never expires
+  for (int i = 0; i < 10; i++) {
+    wheel.schedule(session, time::seconds(3));
+    advance(time::seconds(2));
+  }
+  BOOST_CHECK(batches.empty());
+
+  advance(time::seconds(2));
+  BOOST_REQUIRE_EQUAL(batches.size(), 1);
+  BOOST_CHECK_EQUAL(batches[0][0], 1);
+}
+
+BOOST_AUTO_TEST_CASE(LongTimeout)
+{
+  // beyond the first level, the session is cascaded down before it expires
+  Session session;
+  session.id = 1;
+  wheel.schedule(session, time::seconds(5000));
+
+  advance(time::seconds(4990));
+  BOOST_CHECK(batches.empty());
+
+  advance(time::seconds(20));
+  BOOST_CHECK_EQUAL(batches.size(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(CancelAndDestroy)
+{
+  Session first;
+  first.id = 1;
+  wheel.schedule(first, time::seconds(1));
+  wheel.cancel(first);
+
+  {
+    Session second;
+    second.id = 2;
+    wheel.schedule(second, time::seconds(1));
+    BOOST_CHECK_EQUAL(wheel.size(), 1);
+  }
+  BOOST_CHECK_EQUAL(wheel.size(), 0);
+
+  advance(time::seconds(3));
+  BOOST_CHECK(batches.empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace tests
+} // namespace chronochat
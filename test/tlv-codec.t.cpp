@@ -0,0 +1,158 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include "tlv-codec.hpp"
+#include "chat-message.hpp"
+#include "endorse-info.hpp"
+#include "endorse-extension.hpp"
+
+namespace chronochat {
+namespace tests {
+
+BOOST_AUTO_TEST_SUITE(TestTlvCodec)
+
+static_assert(codec::sizeOfVarNumber(tlv::ChatMessage) == 1, "");
+
+BOOST_AUTO_TEST_CASE(VarNumber)
+{
+  std::vector<std::pair<uint64_t, std::vector<uint8_t>>> cases = {
+    {252, {0xfc}},
+    {253, {0xfd, 0x00, 0xfd}},
+    {0xffff, {0xfd, 0xff, 0xff}},
+    {0x10000, {0xfe, 0x00, 0x01, 0x00, 0x00}},
+    {0x100000000, {0xff, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00}},
+  };
+
+  for (const auto& c : cases) {
+    uint8_t buffer[9];
+    BOOST_CHECK_EQUAL(codec::sizeOfVarNumber(c.first), c.second.size());
+    uint8_t* end = codec::writeVarNumber(buffer, c.first);
+    BOOST_CHECK_EQUAL_COLLECTIONS(buffer, end, c.second.begin(), c.second.end());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(EncodeEndorseInfo)
+{
+  const uint8_t expected[] = {
+    0x90, 0x0b, // EndorseInfo
+      0x91, 0x09, // Endorsement
+        0x92, 0x01, 0x61, // EndorseType
+        0x93, 0x01, 0x62, // EndorseValue
+        0x94, 0x01, 0x31, // EndorseCount
+  };
+
+  EndorseInfo info;
+  info.addEndorsement("a", "b", "1");
+  const Block& wire = info.wireEncode();
+  BOOST_CHECK_EQUAL_COLLECTIONS(wire.wire(), wire.wire() + wire.size(),
+                                expected, expected + sizeof(expected));
+
+  EndorseInfo decodedInfo(Block(expected, sizeof(expected)));
+  BOOST_REQUIRE_EQUAL(decodedInfo.getEndorsements().size(), 1);
+  BOOST_CHECK_EQUAL(decodedInfo.getEndorsements()[0].count, "1");
+
+  const uint8_t extraElement[] = {
+    0x90, 0x0e,
+      0x91, 0x09,
+        0x92, 0x01, 0x61,
+        0x93, 0x01, 0x62,
+        0x94, 0x01, 0x31,
+      0x8b, 0x01, 0x61, // EntryData
+  };
+  BOOST_CHECK_THROW(EndorseInfo(Block(extraElement, sizeof(extraElement))), EndorseInfo::Error);
+
+  const uint8_t noEndorsement[] = {
+    0x90, 0x00,
+  };
+  BOOST_CHECK_THROW(EndorseInfo(Block(noEndorsement, sizeof(noEndorsement))), EndorseInfo::Error);
+}
+
+BOOST_AUTO_TEST_CASE(EncodeEndorseExtension)
+{
+  const uint8_t expected[] = {
+    0x8c, 0x07, // EndorseExtension
+      0x8b, 0x01, 0x78, // EntryData
+      0x8b, 0x02, 0x79, 0x7a, // EntryData
+  };
+
+  EndorseExtension extension;
+  extension.addEntry("x");
+  extension.addEntry("yz");
+  const Block& wire = extension.wireEncode();
+  BOOST_CHECK_EQUAL_COLLECTIONS(wire.wire(), wire.wire() + wire.size(),
+                                expected, expected + sizeof(expected));
+
+  EndorseExtension decodedExtension(wire);
+  BOOST_CHECK_EQUAL(decodedExtension.getEntries().size(), 2);
+}
+
+BOOST_AUTO_TEST_CASE(EncodeChatMessage)
+{
+  const uint8_t expected[] = {
+    0x95, 0x0d, // ChatMessage
+      0x87, 0x01, 0x71, // Nick
+      0x81, 0x01, 0x72, // ChatroomName
+      0x96, 0x01, 0x01, // ChatMessageType
+      0x98, 0x02, 0x01, 0x2c, // Timestamp
+  };
+
+  ChatMessage msg;
+  msg.setNick("q");
+  msg.setChatroomName("r");
+  msg.setMsgType(ChatMessage::HELLO);
+  msg.setTimestamp(300);
+  const Block& wire = msg.wireEncode();
+  BOOST_CHECK_EQUAL_COLLECTIONS(wire.wire(), wire.wire() + wire.size(),
+                                expected, expected + sizeof(expected));
+
+  // elements of later versions are skipped
+  const uint8_t laterVersion[] = {
+    0x95, 0x10,
+      0x87, 0x01, 0x71,
+      0x81, 0x01, 0x72,
+      0x96, 0x01, 0x01,
+      0x98, 0x02, 0x01, 0x2c,
+      0xfc, 0x01, 0x00, // unknown element
+  };
+  ChatMessage decodedMsg(Block(laterVersion, sizeof(laterVersion)));
+  BOOST_CHECK_EQUAL(decodedMsg.getNick(), "q");
+  BOOST_CHECK_EQUAL(decodedMsg.getTimestamp(), 300);
+  BOOST_CHECK_EQUAL(decodedMsg.hasPreciseTimestamp(), false);
+
+  // a chat message must have data
+  const uint8_t noData[] = {
+    0x95, 0x0d,
+      0x87, 0x01, 0x71,
+      0x81, 0x01, 0x72,
+      0x96, 0x01, 0x00,
+      0x98, 0x02, 0x01, 0x2c,
+  };
+  BOOST_CHECK_THROW(ChatMessage(Block(noData, sizeof(noData))), ChatMessage::Error);
+}
+
+BOOST_AUTO_TEST_CASE(LongValue)
+{
+  typedef codec::Tlv<tlv::ChatData, codec::String> ChatDataTlv;
+
+  std::string data(300, 'a');
+  BOOST_CHECK_EQUAL(ChatDataTlv::size(data), 304);
+
+  std::vector<uint8_t> buffer(ChatDataTlv::size(data));
+  uint8_t* end = ChatDataTlv::write(&buffer.front(), data);
+  BOOST_CHECK(end == &buffer.front() + buffer.size());
+  BOOST_CHECK_EQUAL(buffer[1], 0xfd);
+  BOOST_CHECK_EQUAL(buffer[2], 0x01);
+  BOOST_CHECK_EQUAL(buffer[3], 0x2c);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace tests
+} // namespace chronochat
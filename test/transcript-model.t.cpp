@@ -0,0 +1,198 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include "transcript-model.hpp"
+#include <boost/filesystem.hpp>
+#include <boost/lexical_cast.hpp>
+
+namespace chronochat {
+namespace tests {
+
+namespace fs = boost::filesystem;
+
+class TranscriptFixture
+{
+public:
+  TranscriptFixture()
+    : userChatPrefix("/TestTranscriptModel/alice/CHRONOCHAT-CHATROOM/room")
+    , session("/TestTranscriptModel/alice/session")
+  {
+    sessionId = sessions.intern(session);
+    fs::remove(getDBPath());
+  }
+
+  ~TranscriptFixture()
+  {
+    fs::remove(getDBPath());
+    fs::remove(getDBPath().string() + "-wal");
+    fs::remove(getDBPath().string() + "-shm");
+  }
+
+  fs::path
+  getDBPath()
+  {
+    return fs::path(getenv("HOME")) / ".chronos" / "history" /
+      ChatHistoryStorage::getDBName(userChatPrefix);
+  }
+
+  void
+  addMessage(ChatHistoryStorage& history, uint64_t seqNo, time_t timestamp,
+             ChatMessage::ChatMessageType type = ChatMessage::CHAT)
+  {
+    ChatMessage msg;
+    msg.setNick("alice");
+    msg.setChatroomName("room");
+    msg.setMsgType(type);
+    msg.setTimestamp(timestamp);
+    if (type == ChatMessage::CHAT)
+      msg.setData(boost::lexical_cast<std::string>(seqNo));
+    history.addMessage(session, seqNo, msg);
+  }
+
+  // a row as received from the backend
+  TranscriptRow
+  makeLiveRow(uint64_t seqNo, time_t timestamp)
+  {
+    TranscriptRow row;
+    row.nick = "alice";
+    row.text = QString::number(seqNo);
+    row.timestamp = timestamp;
+    row.sessionId = sessionId;
+    row.seqNo = seqNo;
+    return row;
+  }
+
+  std::string
+  getText(const TranscriptModel& model, int row)
+  {
+    return model.data(model.index(row), Qt::DisplayRole).toString().toStdString();
+  }
+
+public:
+  Name userChatPrefix;
+  Name session;
+  SessionTable sessions;
+  SessionId sessionId;
+};
+
+BOOST_FIXTURE_TEST_SUITE(TestTranscriptModel, TranscriptFixture)
+
+BOOST_AUTO_TEST_CASE(Bounded)
+{
+  TranscriptModel model(nullptr, &sessions, 10, 5);
+
+  std::vector<TranscriptRow> rows;
+  for (uint64_t seqNo = 1; seqNo <= 25; seqNo++)
+    rows.push_back(makeLiveRow(seqNo, 100));
+  model.appendRows(rows);
+
+  // the oldest rows are pushed out
+  BOOST_CHECK_EQUAL(model.rowCount(), 10);
+  BOOST_CHECK_EQUAL(getText(model, 0), "16");
+  BOOST_CHECK_EQUAL(getText(model, 9), "25");
+
+  // without a history, there is nothing to read back
+  BOOST_CHECK_EQUAL(model.fetchOlder(), 0);
+  BOOST_CHECK(!model.isDetached());
+}
+
+BOOST_AUTO_TEST_CASE(Paging)
+{
+  ChatHistoryStorage history(userChatPrefix);
+  for (uint64_t seqNo = 1; seqNo <= 30; seqNo++)
+    addMessage(history, seqNo, 100 + seqNo);
+  history.flush();
+
+  TranscriptModel model(&history, &sessions, 10, 5);
+  BOOST_CHECK_EQUAL(model.fetchOlder(), 5);
+  BOOST_CHECK_EQUAL(model.fetchOlder(), 5);
+  BOOST_CHECK_EQUAL(getText(model, 0), "21");
+  BOOST_CHECK(!model.isDetached());
+
+  // the newest rows are pushed out
+  BOOST_CHECK_EQUAL(model.fetchOlder(), 5);
+  BOOST_CHECK_EQUAL(model.rowCount(), 10);
+  BOOST_CHECK_EQUAL(getText(model, 0), "16");
+  BOOST_CHECK_EQUAL(getText(model, 9), "25");
+  BOOST_CHECK(model.isDetached());
+
+  // live rows wait until the view is back at the end
+  model.appendRows(std::vector<TranscriptRow>(1, makeLiveRow(31, 131)));
+  BOOST_CHECK_EQUAL(model.rowCount(), 10);
+  BOOST_CHECK_EQUAL(model.getNTailRows(), 1);
+
+  size_t nRemoved = 0;
+  BOOST_CHECK_EQUAL(model.fetchNewer(nRemoved), 5);
+  BOOST_CHECK_EQUAL(nRemoved, 5);
+  BOOST_CHECK_EQUAL(getText(model, 0), "21");
+  BOOST_CHECK_EQUAL(getText(model, 9), "30");
+  BOOST_CHECK(model.isDetached());
+
+  // the live row has not been written to the history
+  BOOST_CHECK_EQUAL(model.fetchNewer(nRemoved), 1);
+  BOOST_CHECK_EQUAL(nRemoved, 1);
+  BOOST_CHECK_EQUAL(getText(model, 9), "31");
+  BOOST_CHECK(!model.isDetached());
+  BOOST_CHECK_EQUAL(model.getNTailRows(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(LiveRowsInHistory)
+{
+  ChatHistoryStorage history(userChatPrefix);
+  for (uint64_t seqNo = 1; seqNo <= 5; seqNo++)
+    addMessage(history, seqNo, 100);
+  history.flush();
+
+  // the live rows have been written to the history in the same second
+  TranscriptModel model(&history, &sessions, 10, 5);
+  std::vector<TranscriptRow> rows;
+  rows.push_back(makeLiveRow(4, 100));
+  rows.push_back(makeLiveRow(5, 100));
+  model.appendRows(rows);
+
+  BOOST_CHECK_EQUAL(model.fetchOlder(), 3);
+  BOOST_REQUIRE_EQUAL(model.rowCount(), 5);
+  for (int i = 0; i < 5; i++)
+    BOOST_CHECK_EQUAL(getText(model, i), boost::lexical_cast<std::string>(i + 1));
+}
+
+BOOST_AUTO_TEST_CASE(ControlRowsInHistory)
+{
+  ChatHistoryStorage history(userChatPrefix);
+  addMessage(history, 1, 100, ChatMessage::JOIN);
+  addMessage(history, 2, 100);
+  addMessage(history, 3, 100, ChatMessage::LEAVE);
+  history.flush();
+
+  // the control rows are identified like the chat rows
+  TranscriptModel model(&history, &sessions, 10, 5);
+  std::vector<TranscriptRow> rows;
+  TranscriptRow joinRow = makeLiveRow(1, 100);
+  joinRow.type = TranscriptRow::CONTROL;
+  joinRow.text = "enters room";
+  rows.push_back(joinRow);
+  rows.push_back(makeLiveRow(2, 100));
+  TranscriptRow leaveRow = makeLiveRow(3, 100);
+  leaveRow.type = TranscriptRow::CONTROL;
+  leaveRow.text = "leaves room";
+  rows.push_back(leaveRow);
+  model.appendRows(rows);
+
+  BOOST_CHECK_EQUAL(model.fetchOlder(), 0);
+  BOOST_REQUIRE_EQUAL(model.rowCount(), 3);
+  BOOST_CHECK_EQUAL(getText(model, 0), "enters room");
+  BOOST_CHECK_EQUAL(getText(model, 1), "2");
+  BOOST_CHECK_EQUAL(getText(model, 2), "leaves room");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace tests
+} // namespace chronochat
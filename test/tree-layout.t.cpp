@@ -0,0 +1,130 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include "tree-layout.hpp"
+
+#include <cmath>
+
+namespace chronochat {
+namespace tests {
+
+typedef TreeLayout::Coordinate Coordinate;
+
+static double
+getDistance(double x1, double y1, double x2, double y2)
+{
+  return std::sqrt((x1 - x2) * (x1 - x2) + (y1 - y2) * (y1 - y2));
+}
+
+BOOST_AUTO_TEST_SUITE(TestTreeLayout)
+
+BOOST_AUTO_TEST_CASE(OneLevelRings)
+{
+  RingTreeLayout layout;
+  layout.setSiblingDistance(100);
+  layout.setLevelDistance(300);
+
+  std::vector<Coordinate> co(1000);
+  layout.setOneLevelLayout(co);
+
+  // the first node is right below the root
+  BOOST_CHECK_SMALL(co[0].x, 0.001);
+  BOOST_CHECK_CLOSE(co[0].y, 300, 0.001);
+
+  double minRootDistance = 1e9;
+  double maxRootDistance = 0;
+  double minSiblingDistance = 1e9;
+  for (size_t i = 0; i < co.size(); i++) {
+    double rootDistance = getDistance(co[i].x, co[i].y, 0, 0);
+    minRootDistance = std::min(minRootDistance, rootDistance);
+    maxRootDistance = std::max(maxRootDistance, rootDistance);
+    for (size_t j = i + 1; j < co.size(); j++)
+      minSiblingDistance = std::min(minSiblingDistance,
+                                    getDistance(co[i].x, co[i].y, co[j].x, co[j].y));
+  }
+
+  BOOST_CHECK_CLOSE(minRootDistance, 300, 0.001);
+  // one line would be 100,000 wide
+  BOOST_CHECK_LT(maxRootDistance, 2000);
+  // chords are slightly shorter than the arcs
+  BOOST_CHECK_GT(minSiblingDistance, 90);
+}
+
+BOOST_AUTO_TEST_CASE(Slots)
+{
+  OneLevelTreeLayout line;
+  line.setSiblingDistance(100);
+  line.setLevelDistance(100);
+
+  BOOST_CHECK_SMALL(line.getSlotPosition(0).x, 0.001);
+  BOOST_CHECK_CLOSE(line.getSlotPosition(1).x, 100, 0.001);
+  BOOST_CHECK_CLOSE(line.getSlotPosition(2).x, -100, 0.001);
+  BOOST_CHECK_CLOSE(line.getSlotPosition(3).x, 200, 0.001);
+  BOOST_CHECK_CLOSE(line.getSlotPosition(2).y, 100, 0.001);
+
+  RingTreeLayout rings;
+  rings.setSiblingDistance(100);
+  rings.setLevelDistance(300);
+
+  // the slots are as far apart as the nodes of a full layout, also on a ring being filled
+  std::vector<Coordinate> co(1000);
+  for (size_t i = 0; i < co.size(); i++)
+    co[i] = rings.getSlotPosition(i);
+
+  BOOST_CHECK_SMALL(co[0].x, 0.001);
+  BOOST_CHECK_CLOSE(co[0].y, 300, 0.001);
+
+  double minSiblingDistance = 1e9;
+  double maxRootDistance = 0;
+  for (size_t i = 0; i < co.size(); i++) {
+    maxRootDistance = std::max(maxRootDistance, getDistance(co[i].x, co[i].y, 0, 0));
+    for (size_t j = i + 1; j < co.size(); j++)
+      minSiblingDistance = std::min(minSiblingDistance,
+                                    getDistance(co[i].x, co[i].y, co[j].x, co[j].y));
+  }
+  BOOST_CHECK_GT(minSiblingDistance, 90);
+  BOOST_CHECK_LT(maxRootDistance, 2000);
+}
+
+BOOST_AUTO_TEST_CASE(MultipleLevelRings)
+{
+  RingTreeLayout layout;
+  layout.setSiblingDistance(100);
+  layout.setLevelDistance(100);
+
+  TrustTreeNodeList nodeList;
+  for (int i = 0; i < 201; i++) {
+    shared_ptr<TrustTreeNode> node = make_shared<TrustTreeNode>();
+    node->setLevel(i == 0 ? 0 : (i <= 20 ? 1 : 2));
+    nodeList.push_back(node);
+  }
+  layout.setMultipleLevelTreeLayout(nodeList);
+
+  BOOST_CHECK_SMALL(nodeList[0]->x, 0.001);
+  BOOST_CHECK_SMALL(nodeList[0]->y, 0.001);
+
+  // every level is outside the previous one
+  double maxLevel1 = 0;
+  double minLevel2 = 1e9;
+  for (size_t i = 1; i < nodeList.size(); i++) {
+    double rootDistance = getDistance(nodeList[i]->x, nodeList[i]->y, 0, 0);
+    BOOST_CHECK_GE(rootDistance, 100 - 0.001);
+    if (nodeList[i]->level() == 1)
+      maxLevel1 = std::max(maxLevel1, rootDistance);
+    else
+      minLevel2 = std::min(minLevel2, rootDistance);
+  }
+  BOOST_CHECK_CLOSE(minLevel2 - maxLevel1, 100, 0.001);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace tests
+} // namespace chronochat
@@ -0,0 +1,178 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013, Regents of the University of California
+ *
+ * BSD license, See the LICENSE file for more information
+ *
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include "validation-pool.hpp"
+
+#include <atomic>
+
+namespace chronochat {
+namespace tests {
+
+// accepts Data unless its last name component is "bad", and takes a while like an RSA
+// verification does
+class SlowValidator : public ndn::ValidatorRegex
+{
+public:
+  SlowValidator(std::atomic<int>& nRunning, std::atomic<int>& maxRunning)
+    : m_nRunning(nRunning)
+    , m_maxRunning(maxRunning)
+  {
+  }
+
+protected:
+  virtual void
+  checkPolicy(const Data& data, int nSteps,
+              const ndn::OnDataValidated& onValidated,
+              const ndn::OnDataValidationFailed& onValidationFailed,
+              std::vector<shared_ptr<ndn::ValidationRequest>>& nextSteps)
+  {
+    int nRunning = ++m_nRunning;
+    int maxRunning = m_maxRunning;
+    while (nRunning > maxRunning && !m_maxRunning.compare_exchange_weak(maxRunning, nRunning))
+      ;
+    boost::this_thread::sleep_for(boost::chrono::milliseconds(5));
+    --m_nRunning;
+
+    if (data.getName().get(-1).toUri() == "bad")
+      onValidationFailed(data.shared_from_this(), "bad");
+    else
+      onValidated(data.shared_from_this());
+  }
+
+private:
+  std::atomic<int>& m_nRunning;
+  std::atomic<int>& m_maxRunning;
+};
+
+class ValidationPoolFixture
+{
+public:
+  ValidationPoolFixture()
+    : nRunning(0)
+    , maxRunning(0)
+  {
+  }
+
+  unique_ptr<ValidationPool>
+  makePool(size_t nThreads)
+  {
+    return unique_ptr<ValidationPool>(new ValidationPool([this] {
+          return make_shared<SlowValidator>(nRunning, maxRunning);
+        }, nThreads));
+  }
+
+  void
+  validate(ValidationPool& pool, const Name& session, const std::string& suffix)
+  {
+    shared_ptr<Data> data = make_shared<Data>(Name(session).append(suffix));
+    pool.validate(session, data, ioService,
+                  [this] (const shared_ptr<const Data>& data) {
+                    results.push_back(data->getName());
+                    resultThreads.insert(boost::this_thread::get_id());
+                  },
+                  [this] (const shared_ptr<const Data>& data, const std::string& reason) {
+                    results.push_back(data->getName());
+                    resultThreads.insert(boost::this_thread::get_id());
+                  });
+  }
+
+  /// @brief run the handlers posted by the workers until @p nResults results are in
+  void
+  waitForResults(size_t nResults)
+  {
+    for (int i = 0; i < 1000 && results.size() < nResults; i++) {
+      boost::this_thread::sleep_for(boost::chrono::milliseconds(5));
+      ioService.poll();
+      ioService.reset();
+    }
+  }
+
+public:
+  boost::asio::io_service ioService;
+  std::atomic<int> nRunning;
+  std::atomic<int> maxRunning;
+  std::vector<Name> results;
+  std::set<boost::thread::id> resultThreads;
+};
+
+BOOST_FIXTURE_TEST_SUITE(TestValidationPool, ValidationPoolFixture)
+
+BOOST_AUTO_TEST_CASE(Parallel)
+{
+  unique_ptr<ValidationPool> pool = makePool(4);
+  BOOST_CHECK_EQUAL(pool->getNThreads(), 4);
+
+  for (int session = 0; session < 16; session++)
+    for (int i = 0; i < 4; i++)
+      validate(*pool, Name("/session").appendNumber(session), std::to_string(i));
+
+  waitForResults(64);
+  BOOST_CHECK_EQUAL(results.size(), 64);
+  BOOST_CHECK_GT(maxRunning, 1);
+
+  // the results are handed over on the thread of the io_service
+  BOOST_REQUIRE_EQUAL(resultThreads.size(), 1);
+  BOOST_CHECK(*resultThreads.begin() == boost::this_thread::get_id());
+}
+
+BOOST_AUTO_TEST_CASE(SessionOrder)
+{
+  unique_ptr<ValidationPool> pool = makePool(4);
+
+  // failures keep their place among the results of the session
+  std::vector<Name> expected;
+  for (int i = 0; i < 20; i++) {
+    Name session = Name("/session").appendNumber(i % 2);
+    std::string suffix = (i % 3 == 0 ? "bad" : std::to_string(i));
+    validate(*pool, session, suffix);
+    expected.push_back(Name(session).append(suffix));
+  }
+
+  waitForResults(20);
+  BOOST_REQUIRE_EQUAL(results.size(), 20);
+  for (int session = 0; session < 2; session++) {
+    std::vector<Name> expectedOfSession;
+    std::vector<Name> resultsOfSession;
+    for (size_t i = 0; i < expected.size(); i++) {
+      if (expected[i].get(1).toNumber() == static_cast<uint64_t>(session))
+        expectedOfSession.push_back(expected[i]);
+      if (results[i].get(1).toNumber() == static_cast<uint64_t>(session))
+        resultsOfSession.push_back(results[i]);
+    }
+    BOOST_CHECK_EQUAL_COLLECTIONS(resultsOfSession.begin(), resultsOfSession.end(),
+                                  expectedOfSession.begin(), expectedOfSession.end());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(TeardownInFlight)
+{
+  unique_ptr<ValidationPool> pool = makePool(2);
+  for (int i = 0; i < 100; i++)
+    validate(*pool, Name("/session").appendNumber(i % 4), std::to_string(i));
+
+  // the pending validations are dropped, the running ones post their result
+  pool.reset();
+  BOOST_CHECK_EQUAL(nRunning, 0);
+
+  ioService.poll();
+  BOOST_CHECK_LT(results.size(), 100);
+
+  // nothing arrives later
+  size_t nResults = results.size();
+  boost::this_thread::sleep_for(boost::chrono::milliseconds(20));
+  ioService.reset();
+  ioService.poll();
+  BOOST_CHECK_EQUAL(results.size(), nResults);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace tests
+} // namespace chronochat